@@ -37,13 +37,154 @@ bool CCallbackMgr::isServer(class CCallbackBase *pCallback)
 
 
 
+// payloads bigger than the inline buffer use power of 2 buffers starting from this size
+#define PAYLOAD_POOL_MIN_SHIFT 10
+// no pooling above 1 << (PAYLOAD_POOL_MIN_SHIFT + PAYLOAD_POOL_CLASSES - 1) bytes
+#define PAYLOAD_POOL_CLASSES 7
+// how many free buffers to keep per size
+#define PAYLOAD_POOL_MAX_FREE 32
+
+static std::mutex payload_pool_mutex{};
+static std::vector<char *> payload_pool[PAYLOAD_POOL_CLASSES]{};
+static std::atomic<uint64> payload_copies{};
+static std::atomic<uint64> payload_bytes_copied{};
+static std::atomic<uint64> payload_heap_allocations{};
+static std::atomic<uint64> payload_pool_reuses{};
+
+static int payload_pool_class(size_t capacity)
+{
+    for (int i = 0; i < PAYLOAD_POOL_CLASSES; ++i) {
+        if (capacity == ((size_t)1 << (PAYLOAD_POOL_MIN_SHIFT + i))) return i;
+    }
+
+    return -1;
+}
+
+static char *payload_alloc(size_t size, size_t &capacity)
+{
+    capacity = (size_t)1 << PAYLOAD_POOL_MIN_SHIFT;
+    while (capacity < size && payload_pool_class(capacity) >= 0) capacity <<= 1;
+
+    int pool_class = payload_pool_class(capacity);
+    if (pool_class < 0) {
+        // too big for the pool
+        capacity = size;
+    } else {
+        std::lock_guard<std::mutex> lock(payload_pool_mutex);
+        auto &pool = payload_pool[pool_class];
+        if (pool.size()) {
+            char *buf = pool.back();
+            pool.pop_back();
+            ++payload_pool_reuses;
+            return buf;
+        }
+    }
+
+    ++payload_heap_allocations;
+    return new char[capacity];
+}
+
+static void payload_free(char *buf, size_t capacity)
+{
+    int pool_class = payload_pool_class(capacity);
+    if (pool_class >= 0) {
+        std::lock_guard<std::mutex> lock(payload_pool_mutex);
+        auto &pool = payload_pool[pool_class];
+        if (pool.size() < PAYLOAD_POOL_MAX_FREE) {
+            pool.push_back(buf);
+            return;
+        }
+    }
+
+    delete[] buf;
+}
+
+Callback_Payload::Callback_Payload(const void *data, size_t size)
+{
+    assign(data, size);
+}
+
+Callback_Payload::Callback_Payload(Callback_Payload &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+Callback_Payload &Callback_Payload::operator=(Callback_Payload &&other) noexcept
+{
+    if (this == &other) return *this;
+
+    release();
+    if (other.heap_data) {
+        heap_data = other.heap_data;
+        heap_capacity = other.heap_capacity;
+        other.heap_data = nullptr;
+        other.heap_capacity = 0;
+    } else if (other.data_size) {
+        memcpy(inline_data, other.inline_data, other.data_size);
+        ++payload_copies;
+        payload_bytes_copied += other.data_size;
+    }
+
+    data_size = other.data_size;
+    other.data_size = 0;
+    return *this;
+}
+
+Callback_Payload::~Callback_Payload()
+{
+    release();
+}
+
+void Callback_Payload::release()
+{
+    if (heap_data) {
+        payload_free(heap_data, heap_capacity);
+        heap_data = nullptr;
+        heap_capacity = 0;
+    }
+
+    data_size = 0;
+}
+
+void Callback_Payload::assign(const void *data, size_t size)
+{
+    if (size > INLINE_SIZE) {
+        if (size > heap_capacity) {
+            release();
+            heap_data = payload_alloc(size, heap_capacity);
+        }
+    } else {
+        release();
+    }
+
+    data_size = size;
+    if (size > 0) {
+        if (data) {
+            memcpy(this->data(), data, size);
+            ++payload_copies;
+            payload_bytes_copied += size;
+        } else {
+            memset(this->data(), 0, size);
+        }
+    }
+}
+
+Callback_Payload::Stats Callback_Payload::get_stats()
+{
+    Stats stats{};
+    stats.copies = payload_copies;
+    stats.bytes_copied = payload_bytes_copied;
+    stats.heap_allocations = payload_heap_allocations;
+    stats.pool_reuses = payload_pool_reuses;
+    return stats;
+}
+
+
+
 Steam_Call_Result::Steam_Call_Result(SteamAPICall_t a, int icb, void *r, unsigned int s, double r_in, bool run_cc_cb)
 {
     api_call = a;
-    result.resize(s);
-    if (s > 0 && r != NULL) {
-        memcpy(&(result[0]), r, s);
-    }
+    result.assign(r, s);
     run_in = r_in;
     run_call_completed_cb = run_cc_cb;
     iCallback = icb;
@@ -94,10 +235,73 @@ void SteamCallResults::rmCallCompleted(class CCallbackBase *cb)
     }
 }
 
+// how often finished call results are looked at for removal
+#define CALLRESULTS_COMPACT_INTERVAL 1.0
+
+struct Steam_Call_Result *SteamCallResults::find_callresult(SteamAPICall_t api_call)
+{
+    auto it = callresults_index.find(api_call);
+    if (it == callresults_index.end()) return nullptr;
+    return &callresults[it->second];
+}
+
+const struct Steam_Call_Result *SteamCallResults::find_callresult(SteamAPICall_t api_call) const
+{
+    auto it = callresults_index.find(api_call);
+    if (it == callresults_index.end()) return nullptr;
+    return &callresults[it->second];
+}
+
+SteamAPICall_t SteamCallResults::push_callresult(struct Steam_Call_Result &&res)
+{
+    callresults_index[res.api_call] = callresults.size();
+    callresults.push_back(std::move(res));
+    return callresults.back().api_call;
+}
+
+void SteamCallResults::mark_to_delete(struct Steam_Call_Result &res)
+{
+    if (!res.to_delete) {
+        res.to_delete = true;
+        ++callresults_to_delete;
+    }
+}
+
+void SteamCallResults::compact_callresults()
+{
+    auto new_end = std::remove_if(callresults.begin(), callresults.end(), [](struct Steam_Call_Result const& item) {
+        if (item.to_delete && item.timed_out()) {
+            PRINT_DEBUG("removed callresult %i", item.iCallback);
+            return true;
+        }
+
+        return false;
+    });
+    if (new_end == callresults.end()) return;
+
+    size_t removed = static_cast<size_t>(callresults.end() - new_end);
+    callresults.erase(new_end, callresults.end());
+    callresults_to_delete -= removed;
+
+    // the survivors were shifted down, rebuild their positions
+    callresults_index.clear();
+    for (size_t i = 0; i < callresults.size(); ++i) {
+        callresults_index[callresults[i].api_call] = i;
+    }
+
+#ifndef EMU_RELEASE_BUILD
+    auto stats = Callback_Payload::get_stats();
+    PRINT_DEBUG(
+        "%zu callresults left, payload copies=%llu (%llu bytes), heap allocations=%llu, pool reuses=%llu",
+        callresults.size(), stats.copies, stats.bytes_copied, stats.heap_allocations, stats.pool_reuses
+    );
+#endif
+}
+
 void SteamCallResults::addCallBack(SteamAPICall_t api_call, class CCallbackBase *cb)
 {
-    auto cb_result = std::find_if(callresults.begin(), callresults.end(), [api_call](struct Steam_Call_Result const& item) { return item.api_call == api_call; });
-    if (cb_result != callresults.end()) {
+    auto cb_result = find_callresult(api_call);
+    if (cb_result) {
         cb_result->callbacks.push_back(cb);
         CCallbackMgr::SetRegister(cb, cb->GetICallback());
         PRINT_DEBUG("new cb for call result [api id=%llu, result k_iCallback=%i] %p", api_call, cb ? (cb->GetICallback()) : -1, cb);
@@ -106,25 +310,21 @@ void SteamCallResults::addCallBack(SteamAPICall_t api_call, class CCallbackBase
 
 bool SteamCallResults::exists(SteamAPICall_t api_call) const
 {
-    auto cr = std::find_if(callresults.begin(), callresults.end(), [api_call](struct Steam_Call_Result const& item) {
-        return item.api_call == api_call;
-    });
-    if (callresults.end() == cr) return false;
+    auto cr = find_callresult(api_call);
+    if (!cr) return false;
     if (!cr->call_completed()) return false;
     return true;
 }
 
 bool SteamCallResults::callback_result(SteamAPICall_t api_call, void *copy_to, unsigned int size)
 {
-    auto cb_result = std::find_if(callresults.begin(), callresults.end(), [api_call](struct Steam_Call_Result const& item) {
-        return item.api_call == api_call;
-    });
-    if (cb_result != callresults.end()) {
+    auto cb_result = find_callresult(api_call);
+    if (cb_result) {
         if (!cb_result->call_completed()) return false;
         if (cb_result->result.size() > size) return false;
 
-        memcpy(copy_to, &(cb_result->result[0]), cb_result->result.size());
-        cb_result->to_delete = true;
+        memcpy(copy_to, cb_result->result.data(), cb_result->result.size());
+        mark_to_delete(*cb_result);
         return true;
     } else {
         return false;
@@ -133,8 +333,8 @@ bool SteamCallResults::callback_result(SteamAPICall_t api_call, void *copy_to, u
 
 void SteamCallResults::rmCallBack(SteamAPICall_t api_call, class CCallbackBase *cb)
 {
-    auto cb_result = std::find_if(callresults.begin(), callresults.end(), [api_call](struct Steam_Call_Result const& item) { return item.api_call == api_call; });
-    if (cb_result != callresults.end()) {
+    auto cb_result = find_callresult(api_call);
+    if (cb_result) {
         auto it = std::find(cb_result->callbacks.begin(), cb_result->callbacks.end(), cb);
         if (it != cb_result->callbacks.end()) {
             cb_result->callbacks.erase(it);
@@ -155,7 +355,7 @@ void SteamCallResults::rmCallBack(class CCallbackBase *cb)
         }
 
         if (cr.callbacks.size() == 0) {
-            cr.to_delete = true;
+            mark_to_delete(cr);
         }
     }
 }
@@ -163,21 +363,20 @@ void SteamCallResults::rmCallBack(class CCallbackBase *cb)
 SteamAPICall_t SteamCallResults::addCallResult(SteamAPICall_t api_call, int iCallback, void *result, unsigned int size, double timeout, bool run_call_completed_cb)
 {
     PRINT_DEBUG("%i", iCallback);
-    auto cb_result = std::find_if(callresults.begin(), callresults.end(), [api_call](struct Steam_Call_Result const& item) { return item.api_call == api_call; });
-    if (cb_result != callresults.end()) {
+    auto cb_result = find_callresult(api_call);
+    if (cb_result) {
         // only change the data if this is a previously reserved callresult
         if (cb_result->reserved) {
             std::chrono::high_resolution_clock::time_point created = cb_result->created;
-            std::vector<class CCallbackBase *> temp_cbs = cb_result->callbacks;
+            std::vector<class CCallbackBase *> temp_cbs = std::move(cb_result->callbacks);
+            if (cb_result->to_delete) --callresults_to_delete;
             *cb_result = Steam_Call_Result(api_call, iCallback, result, size, timeout, run_call_completed_cb);
-            cb_result->callbacks = temp_cbs;
+            cb_result->callbacks = std::move(temp_cbs);
             cb_result->created = created;
             return cb_result->api_call;
         }
     } else {
-        struct Steam_Call_Result res = Steam_Call_Result(api_call, iCallback, result, size, timeout, run_call_completed_cb);
-        callresults.push_back(res);
-        return callresults.back().api_call;
+        return push_callresult(Steam_Call_Result(api_call, iCallback, result, size, timeout, run_call_completed_cb));
     }
 
     PRINT_DEBUG("ERROR");
@@ -188,8 +387,7 @@ SteamAPICall_t SteamCallResults::reserveCallResult()
 {
     struct Steam_Call_Result res = Steam_Call_Result(generate_steam_api_call_id(), 0, NULL, 0, 0.0, true);
     res.reserved = true;
-    callresults.push_back(res);
-    return callresults.back().api_call;
+    return push_callresult(std::move(res));
 }
 
 SteamAPICall_t SteamCallResults::addCallResult(int iCallback, void *result, unsigned int size, double timeout, bool run_call_completed_cb)
@@ -197,20 +395,26 @@ SteamAPICall_t SteamCallResults::addCallResult(int iCallback, void *result, unsi
     return addCallResult(generate_steam_api_call_id(), iCallback, result, size, timeout, run_call_completed_cb);
 }
 
-void SteamCallResults::setCbAll(void (*cb_all)(std::vector<char> result, int callback))
+void SteamCallResults::setCbAll(void (*cb_all)(Callback_Payload &&result, int callback))
 {
     this->cb_all = cb_all;
 }
 
 void SteamCallResults::runCallResults()
 {
+    // a call result may run the callbacks again, positions must not change until the outer run is done
+    ++run_depth;
+    if (run_cbs.size() < run_depth) run_cbs.resize(run_depth);
+
     unsigned long current_size = static_cast<unsigned long>(callresults.size());
     for (unsigned i = 0; i < current_size; ++i) {
         unsigned index = i;
 
         if (!callresults[index].to_delete) {
             if (callresults[index].can_execute()) {
-                std::vector<char> result = callresults[index].result;
+                // the entries don't move before the outer run is done, the callbacks get the stored data itself
+                // it stays there for GetAPICallResult()
+                Callback_Payload &result = callresults[index].result;
                 SteamAPICall_t api_call = callresults[index].api_call;
                 bool run_call_completed_cb = callresults[index].run_call_completed_cb;
                 int iCallback = callresults[index].iCallback;
@@ -218,18 +422,19 @@ void SteamCallResults::runCallResults()
                     callresults[index].run_call_completed_cb = false;
                 }
 
-                callresults[index].to_delete = true;
+                mark_to_delete(callresults[index]);
                 if (callresults[index].has_cb()) {
-                    std::vector<class CCallbackBase *> temp_cbs = callresults[index].callbacks;
+                    auto &temp_cbs = run_cbs[run_depth - 1];
+                    temp_cbs = callresults[index].callbacks;
                     for (auto & cb : temp_cbs) {
                         PRINT_DEBUG("Calling callresult %p %i, kind=%i (0=callback, 1=call result)", cb, cb->GetICallback(), (int)run_call_completed_cb);
                         global_mutex.unlock();
 
                         //TODO: unlock relock doesn't work if mutex was locked more than once.
                         if (run_call_completed_cb) { //run the right function depending on if it's a callback or a call result.
-                            cb->Run(&(result[0]), false, api_call);
+                            cb->Run(result.data(), false, api_call);
                         } else { // if this is a callback
-                            cb->Run(&(result[0]));
+                            cb->Run(result.data());
                         }
 
                         // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
@@ -243,7 +448,8 @@ void SteamCallResults::runCallResults()
 
                 if (run_call_completed_cb) {
                     //can it happen that one is removed during the callback?
-                    std::vector<class CCallbackBase *> callbacks = completed_callbacks;
+                    auto &callbacks = run_cbs[run_depth - 1];
+                    callbacks = completed_callbacks;
                     SteamAPICallCompleted_t data{};
                     data.m_hAsyncCall = api_call;
                     data.m_iCallback = iCallback;
@@ -259,37 +465,29 @@ void SteamCallResults::runCallResults()
                     }
 
                     if (cb_all) {
-                        std::vector<char> res{};
-                        res.resize(sizeof(data));
-                        memcpy(&(res[0]), &data, sizeof(data));
-                        cb_all(res, data.k_iCallback);
+                        cb_all(Callback_Payload(&data, sizeof(data)), data.k_iCallback);
                     }
                 } else {
                     if (cb_all) {
-                        cb_all(result, iCallback);
+                        // nothing asks for the result of a callback later, hand over the stored one
+                        cb_all(std::move(callresults[index].result), iCallback);
                     }
                 }
             } else {
                 if (callresults[index].timed_out()) {
-                    callresults[index].to_delete = true;
+                    mark_to_delete(callresults[index]);
                 }
             }
         }
     }
 
+    --run_depth;
+
     // PRINT_DEBUG("erase to_delete");
-    auto c = std::begin(callresults);
-    while (c != std::end(callresults)) {
-        if (c->to_delete) {
-            if (c->timed_out()) {
-                PRINT_DEBUG("removed callresult %i", c->iCallback);
-                c = callresults.erase(c);
-            } else {
-                ++c;
-            }
-        } else {
-            ++c;
-        }
+    // finished entries stay around until they time out, no need to look at them every frame
+    if (run_depth == 0 && callresults_to_delete > 0 && check_timedout(last_compact, CALLRESULTS_COMPACT_INTERVAL)) {
+        last_compact = std::chrono::high_resolution_clock::now();
+        compact_callresults();
     }
 }
 
@@ -315,7 +513,7 @@ void SteamCallBacks::addCallBack(int iCallback, class CCallbackBase *cb)
         CCallbackMgr::SetRegister(cb, iCallback);
         for (auto & res: callbacks[iCallback].results) {
             //TODO: timeout?
-            SteamAPICall_t api_id = results->addCallResult(iCallback, &(res[0]), static_cast<unsigned long>(res.size()), 0.0, false);
+            SteamAPICall_t api_id = results->addCallResult(iCallback, res.data(), static_cast<unsigned long>(res.size()), 0.0, false);
             results->addCallBack(api_id, cb);
         }
     }
@@ -326,7 +524,7 @@ void SteamCallBacks::addCBResult(int iCallback, void *result, unsigned int size,
     if (dont_post_if_already) {
         for (auto & r : callbacks[iCallback].results) {
             if (r.size() == size) {
-                if (memcmp(&(r[0]), result, size) == 0) {
+                if (memcmp(r.data(), result, size) == 0) {
                     //cb already posted
                     return;
                 }
@@ -334,11 +532,9 @@ void SteamCallBacks::addCBResult(int iCallback, void *result, unsigned int size,
         }
     }
 
-    std::vector<char> temp{};
-    temp.resize(size);
-    memcpy(&(temp[0]), result, size);
-    callbacks[iCallback].results.push_back(temp);
-    for (auto cb: callbacks[iCallback].callbacks) {
+    auto &cb_entry = callbacks[iCallback];
+    cb_entry.results.emplace_back(result, size);
+    for (auto cb: cb_entry.callbacks) {
         SteamAPICall_t api_id = results->addCallResult(iCallback, result, size, timeout, false);
         results->addCallBack(api_id, cb);
     }
@@ -186,6 +186,11 @@ Steam_Client *get_steam_client()
 
 void destroy_client()
 {
+    // the destructors wait for these threads, which would never get global_mutex if it was held here
+    if (steamclient_instance) {
+        steamclient_instance->stopThreads();
+    }
+
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     if (steamclient_instance) {
         delete steamclient_instance;
@@ -1048,27 +1053,27 @@ STEAMAPI_API void S_CALLTYPE SteamAPI_SetBreakpadAppID( uint32 unAppID )
 
 struct cb_data {
     int cb_id{};
-    std::vector<char> result{};
+    Callback_Payload result{};
 };
 static std::queue<struct cb_data> client_cb{};
 static std::queue<struct cb_data> server_cb{};
 
-static void cb_add_queue_server(std::vector<char> result, int callback)
+static void cb_add_queue_server(Callback_Payload &&result, int callback)
 {
     PRINT_DEBUG("adding callback=%i, size=%zu", callback, result.size());
     struct cb_data cb{};
     cb.cb_id = callback;
-    cb.result = result;
-    server_cb.push(cb);
+    cb.result = std::move(result);
+    server_cb.push(std::move(cb));
 }
 
-static void cb_add_queue_client(std::vector<char> result, int callback)
+static void cb_add_queue_client(Callback_Payload &&result, int callback)
 {
-    PRINT_DEBUG("adding callback=%i, m_iCallback=%i", callback, ((SteamAPICallCompleted_t *)&result[0])->m_iCallback);
+    PRINT_DEBUG("adding callback=%i, m_iCallback=%i", callback, ((SteamAPICallCompleted_t *)result.data())->m_iCallback);
     struct cb_data cb{};
     cb.cb_id = callback;
-    cb.result = result;
-    client_cb.push(cb);
+    cb.result = std::move(result);
+    client_cb.push(std::move(cb));
 }
 
 /// Inform the API that you wish to use manual event dispatch.  This must be called after SteamAPI_Init, but before
@@ -1140,7 +1145,7 @@ STEAMAPI_API steam_bool S_CALLTYPE SteamAPI_ManualDispatch_GetNextCallback( HSte
     if (pCallbackMsg) {
         pCallbackMsg->m_hSteamUser = m_hSteamUser;
         pCallbackMsg->m_iCallback = q->front().cb_id;
-        pCallbackMsg->m_pubParam = (uint8 *)&(q->front().result[0]);
+        pCallbackMsg->m_pubParam = (uint8 *)q->front().result.data();
         pCallbackMsg->m_cubParam = static_cast<unsigned long>(q->front().result.size());
         PRINT_DEBUG("cb number %i", q->front().cb_id);
         return true;
@@ -34,10 +34,52 @@ public:
     static bool isServer(class CCallbackBase *pCallback);
 };
 
+// the data of a callback or call result
+// small results are stored inline and bigger ones in pooled buffers, so passing a result around
+// doesn't allocate, it's move-only to make sure it's never copied by accident
+class Callback_Payload {
+public:
+    // most callback structs fit
+    static constexpr size_t INLINE_SIZE = 320;
+
+    struct Stats {
+        uint64 copies; // times the bytes of a payload were copied, including moves of inline payloads
+        uint64 bytes_copied;
+        uint64 heap_allocations;
+        uint64 pool_reuses;
+    };
+
+private:
+    alignas(8) char inline_data[INLINE_SIZE];
+    char *heap_data = nullptr;
+    size_t heap_capacity = 0;
+    size_t data_size = 0;
+
+    void release();
+
+public:
+    Callback_Payload() = default;
+    Callback_Payload(const void *data, size_t size);
+    Callback_Payload(Callback_Payload &&other) noexcept;
+    Callback_Payload &operator=(Callback_Payload &&other) noexcept;
+    Callback_Payload(const Callback_Payload &) = delete;
+    Callback_Payload &operator=(const Callback_Payload &) = delete;
+    ~Callback_Payload();
+
+    void assign(const void *data, size_t size);
+
+    char *data() { return heap_data ? heap_data : inline_data; }
+    const char *data() const { return heap_data ? heap_data : inline_data; }
+    size_t size() const { return data_size; }
+    bool empty() const { return data_size == 0; }
+
+    static Stats get_stats();
+};
+
 struct Steam_Call_Result {
     SteamAPICall_t api_call{};
     std::vector<class CCallbackBase *> callbacks{};
-    std::vector<char> result{};
+    Callback_Payload result{};
     bool to_delete = false;
     bool reserved = false;
     std::chrono::high_resolution_clock::time_point created{};
@@ -60,9 +102,28 @@ struct Steam_Call_Result {
 };
 
 class SteamCallResults {
-    std::vector<struct Steam_Call_Result> callresults{};
+    // kept in creation order, 'callresults_index' maps an api call to its position
+    // finished entries are only marked and removed together in compact_callresults()
+    // a deque so an entry keeps its address while its result is handed to the callbacks,
+    // even if they add new call results
+    std::deque<struct Steam_Call_Result> callresults{};
+    std::unordered_map<SteamAPICall_t, size_t> callresults_index{};
+    size_t callresults_to_delete = 0;
+    std::chrono::high_resolution_clock::time_point last_compact{};
+    unsigned run_depth = 0;
+
     std::vector<class CCallbackBase *> completed_callbacks{};
-    void (*cb_all)(std::vector<char> result, int callback) = nullptr;
+    void (*cb_all)(Callback_Payload &&result, int callback) = nullptr;
+
+    // reused copies of the callbacks lists, one per nested runCallResults()
+    // a deque so growing it in a nested run doesn't move the lists of the outer runs
+    std::deque<std::vector<class CCallbackBase *>> run_cbs{};
+
+    struct Steam_Call_Result *find_callresult(SteamAPICall_t api_call);
+    const struct Steam_Call_Result *find_callresult(SteamAPICall_t api_call) const;
+    SteamAPICall_t push_callresult(struct Steam_Call_Result &&res);
+    void mark_to_delete(struct Steam_Call_Result &res);
+    void compact_callresults();
 
 public:
     void addCallCompleted(class CCallbackBase *cb);
@@ -85,14 +146,14 @@ public:
 
     SteamAPICall_t addCallResult(int iCallback, void *result, unsigned int size, double timeout=DEFAULT_CB_TIMEOUT, bool run_call_completed_cb=true);
 
-    void setCbAll(void (*cb_all)(std::vector<char> result, int callback));
+    void setCbAll(void (*cb_all)(Callback_Payload &&result, int callback));
 
     void runCallResults();
 };
 
 struct Steam_Call_Back {
     std::vector<class CCallbackBase *> callbacks{};
-    std::vector<std::vector<char>> results{};
+    std::vector<Callback_Payload> results{};
 };
 
 class SteamCallBacks {
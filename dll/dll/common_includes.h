@@ -47,10 +47,14 @@
 #include <map>
 #include <set>
 #include <queue>
+#include <deque>
 #include <list>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 
 #include <string.h>
@@ -129,6 +133,9 @@ static inline void reset_LastError()
     #include <netinet/tcp.h>
     #include <linux/netdevice.h>
 
+    #include <poll.h>
+    #include <sys/epoll.h>
+
     #include <fcntl.h>
     #include <unistd.h>
     #include <dirent.h>
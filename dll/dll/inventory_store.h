@@ -0,0 +1,85 @@
+/* Copyright (C) 2019 Mr Goldberg
+   This file is part of the Goldberg Emulator
+
+   The Goldberg Emulator is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   The Goldberg Emulator is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the Goldberg Emulator; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#ifndef __INCLUDED_INVENTORY_STORE_H__
+#define __INCLUDED_INVENTORY_STORE_H__
+
+#include "base.h" // For SteamItemDef_t
+
+// the item definitions (items.json) and the user inventory (default_items.json or the saved items.json)
+// compiled once at load time, so the ISteamInventory queries never touch json nor convert ids to/from strings
+//
+// definitions and inventory items are kept in vectors sorted by id, the properties of all the definitions
+// share a single array and their values a single string pool, property names are interned so a lookup
+// is one hash of the requested name then integer compares over the properties of one definition
+class Inventory_Store
+{
+public:
+    struct Item_Property {
+        uint32 name{}; // index in the interned names
+        uint32 value_offset{}; // in the values pool
+        uint32 value_size{};
+        bool is_string{}; // non-string values are kept (they show up in the names list) but read as errors
+    };
+
+    struct Item_Definition {
+        SteamItemDef_t id{};
+        uint32 first_property{};
+        uint32 property_count{};
+    };
+
+    struct Inventory_Item {
+        SteamItemInstanceID_t id{};
+        SteamItemDef_t definition{};
+        uint32 quantity{};
+    };
+
+private:
+    // deque so the views in property_names_index stay valid while new names are added
+    std::deque<std::string> property_names{};
+    std::unordered_map<std::string_view, uint32> property_names_index{};
+
+    std::vector<Item_Definition> definitions{};
+    std::vector<Item_Property> properties{};
+    std::string values_pool{};
+
+    std::vector<Inventory_Item> items{};
+
+    uint32 intern_property_name(const std::string &name);
+
+public:
+    // replaces all the definitions with the ones in the json object { "<def id>": { "<property>": "<value>", ... }, ... }
+    void load_definitions(const nlohmann::json &defined_items);
+    // replaces the inventory with the one in the json object { "<def id>": <quantity>, ... },
+    // { "quantity": <quantity> } objects are accepted too, each item instance id is its definition id
+    void load_inventory(const nlohmann::json &user_items);
+
+    const std::vector<Item_Definition>& get_definitions() const;
+    const Item_Definition* find_definition(SteamItemDef_t id) const;
+    // returns nullptr if the definition doesn't have the property
+    const Item_Property* find_property(const Item_Definition &definition, const char *name) const;
+    std::string_view get_property_name(const Item_Property &property) const;
+    std::string_view get_property_value(const Item_Property &property) const;
+    // comma separated list of the names of all the properties of the definition
+    std::string get_property_names(const Item_Definition &definition) const;
+
+    const std::vector<Inventory_Item>& get_items() const;
+    Inventory_Item* find_item(SteamItemInstanceID_t id);
+    bool remove_item(SteamItemInstanceID_t id);
+};
+
+#endif // __INCLUDED_INVENTORY_STORE_H__
@@ -58,7 +58,8 @@ public:
     static std::string get_user_appdata_path();
 
     static int get_file_data(const std::string &full_path, char *data, unsigned int max_length, unsigned int offset=0);
-    static int store_file_data(std::string folder, std::string file, const char *data, unsigned int length);
+    // returns the file size after the write, or -1 on failure
+    static int store_file_data(std::string folder, std::string file, const char *data, unsigned int length, bool append = false);
     
     static std::vector<std::string> get_filenames_path(std::string path);
     static std::vector<std::string> get_folders_path(std::string path);
@@ -67,8 +68,25 @@ public:
     static const std::string& get_saves_folder_name();
 
 private:
+    struct File_Index_Entry {
+        std::string name{}; // sanitized path relative to the indexed folder, as it is on disk
+        std::string key{}; // lookup key, case folded on Windows
+        unsigned int size{};
+        uint64_t timestamp{};
+    };
+
     std::string save_directory{};
     std::string appid{}; // game appid
+
+    // in-memory listing of the enumerated folders (currently only the remote storage one),
+    // built on the first enumeration and kept up to date by store_data() and file_delete()
+    // so that count/iterate/exists/size/timestamp queries don't have to walk the disk
+    std::map<std::string, std::vector<File_Index_Entry>> folder_indexes{};
+    std::mutex folder_indexes_mtx{};
+
+    std::vector<File_Index_Entry>* get_folder_index(const std::string &folder, bool build);
+    void index_file(const std::string &folder, const std::string &file, unsigned int size);
+    void unindex_file(const std::string &folder, const std::string &file);
     
 public:
     Local_Storage(const std::string &save_directory);
@@ -76,6 +94,7 @@ public:
     const std::string& get_current_save_directory() const;
     void setAppId(uint32 appid);
     int store_data(std::string folder, std::string file, char *data, unsigned int length);
+    int append_data(std::string folder, std::string file, const char *data, unsigned int length);
     int store_data_settings(std::string file, const char *data, unsigned int length);
     int get_data(std::string folder, std::string file, char *data, unsigned int max_length, unsigned int offset=0);
     unsigned int data_settings_size(std::string file);
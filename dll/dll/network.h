@@ -23,6 +23,8 @@
 
 #define DEFAULT_PORT 47584
 
+enum class Network_IO_Backend;
+
 #if defined(STEAM_WIN32)
 typedef unsigned int sock_t;
 #else
@@ -74,11 +76,34 @@ struct Network_Callback_Container {
     std::vector<struct Network_Callback> callbacks{};
 };
 
+// byte queue for a TCP stream, data is appended at the back and consumed from the front
+// consuming only moves a read offset, the dead space at the front is reclaimed once it
+// makes up half of the storage, so draining a large backlog stays linear
+class TCP_Buffer {
+    std::vector<char> storage{};
+    size_t read_offset{};
+
+public:
+    size_t size() const;
+    bool empty() const;
+
+    char *data();
+    const char *data() const;
+
+    // grow the buffer by 'count' bytes and return a pointer to the new area
+    char *append(size_t count);
+    // undo the last 'count' bytes of an append() which weren't used
+    void discard_back(size_t count);
+    // drop 'count' bytes from the front
+    void consume(size_t count);
+    void clear();
+};
+
 struct TCP_Socket {
     sock_t sock = static_cast<sock_t>(~0);
     bool received_data = false;
-    std::vector<char> recv_buffer{};
-    std::vector<char> send_buffer{};
+    TCP_Buffer recv_buffer{};
+    TCP_Buffer send_buffer{};
     std::chrono::high_resolution_clock::time_point last_heartbeat_sent{}, last_heartbeat_received{};
 };
 
@@ -90,15 +115,32 @@ struct Connection {
     IP_PORT tcp_ip_port{};
     std::vector<CSteamID> ids{};
     uint32 appid{};
+    uint32 features{}; // Announce::Features
     std::chrono::high_resolution_clock::time_point last_received{};
 };
 
+// tells Networking::Run() which sockets have pending data so it doesn't have to query each one
+// closed sockets are forgotten by the poller on its own, there's no need to unwatch them
+class Network_Poller
+{
+public:
+    virtual ~Network_Poller() {}
+
+    // start reporting when this socket becomes readable
+    virtual void watch(sock_t sock) = 0;
+    // collect the readable sockets, waits up to 'timeout_ms' if none is ready
+    virtual void update(int timeout_ms) = 0;
+    // was this socket readable during the last update()
+    virtual bool is_ready(sock_t sock) const = 0;
+};
+
 class Networking
 {
     bool enabled = false;
     bool query_alive{};
+    class Source_Query *query_handler{};
     std::chrono::high_resolution_clock::time_point last_run{};
-    sock_t query_socket, udp_socket{}, tcp_socket{};
+    sock_t query_socket = static_cast<sock_t>(-1), udp_socket{}, tcp_socket{};
     uint16 udp_port{}, tcp_port{};
     uint32 own_ip{};
     std::vector<struct Connection> connections{};
@@ -114,6 +156,63 @@ class Networking
     struct Network_Callback_Container callbacks[CALLBACK_IDS_MAX];
     std::vector<Common_Message> local_send;
 
+    // nullptr when every socket is checked on each run
+    Network_Poller *poller{};
+
+    // reusable storage for batched UDP I/O
+    std::vector<char> udp_recv_data{};
+    // unreliable packets waiting to be sent, while sending a message to many peers they're
+    // collected and sent together, the containers keep their capacity between sends
+    // what doesn't fit in the socket's send buffer stays here until the next flush
+    bool udp_batching = false;
+    std::vector<char> udp_send_data{};
+    std::vector<size_t> udp_send_offsets{};
+    std::vector<IP_PORT> udp_send_ip_ports{};
+    std::vector<char *> udp_send_packets{};
+    std::vector<unsigned long> udp_send_lengths{};
+    // unreliable packets given up on because the send buffer stayed full
+    std::atomic<uint64> udp_send_dropped{};
+
+    void queue_udp_packet(IP_PORT ip_port, Common_Message *msg, size_t size);
+    void flush_udp_packets();
+
+    // optional dedicated I/O thread, it owns the sockets and hands the received messages to the
+    // callback side through a bounded lock-free ring, so socket I/O doesn't wait for the game to run the callbacks
+    struct Received_Message {
+        // == position: free for the producer claiming it, == position + 1: holds a message for the consumer
+        std::atomic<size_t> sequence{};
+        Common_Message msg{};
+        bool user_status = false; // from run_callback_user()
+    };
+
+    bool io_thread_enabled = false;
+    std::thread io_thread{};
+    std::atomic<bool> io_thread_stop{};
+    // preallocated slots, their messages are cleared and reused instead of allocating one per packet
+    std::unique_ptr<Received_Message[]> received_ring{};
+    std::atomic<size_t> received_tail{}; // next position claimed by a producer
+    std::atomic<size_t> received_head{}; // next position read by the consumer, advanced with global_mutex held
+    bool received_dispatching{};
+    std::atomic<uint64> received_dropped{};
+    // user CONNECT/DISCONNECT notifications that didn't fit in the ring, they're never dropped
+    std::mutex received_overflow_mutex{};
+    std::deque<Common_Message> received_overflow{};
+    std::atomic<bool> received_overflow_used{};
+
+    void io_thread_proc();
+    // false if the ring is full and the message was dropped, user status messages go to the overflow list instead
+    bool queue_received(Common_Message *msg, bool user_status);
+    // stop taking data from the sockets when the ring is nearly full, the rest is kept for the user notifications
+    bool can_receive() const;
+    // hand a received message to the callbacks, or to Run() when the I/O thread is enabled
+    void deliver_message(Common_Message *msg);
+    // reads the pending queries in batches and sends the replies together, in the order they came in
+    void run_query();
+    void run_io();
+
+    void watch_socket(sock_t sock);
+    bool socket_readable(sock_t sock);
+
     struct Connection *find_connection(CSteamID id, uint32 appid = 0);
     struct Connection *new_connection(CSteamID id, uint32 appid);
 
@@ -131,7 +230,7 @@ class Networking
 
 
 public:
-    Networking(CSteamID id, uint32 appid, uint16 port, std::set<IP_PORT> *custom_broadcasts, bool disable_sockets);
+    Networking(CSteamID id, uint32 appid, uint16 port, std::set<IP_PORT> *custom_broadcasts, bool disable_sockets, Network_IO_Backend io_backend, bool dedicated_io_thread);
     ~Networking();
     
     //NOTE: for all functions ips/ports are passed/returned in host byte order
@@ -141,12 +240,16 @@ public:
     void addListenId(CSteamID id);
     void setAppID(uint32 appid);
     void Run();
+    // deliver the messages received by the I/O thread so far, must be called with global_mutex held
+    // Run() does it every frame, the receive functions do it too so a game polling them doesn't wait for the next frame
+    void dispatchReceived();
 
     // send to a specific user, set_dest_id() must be called
     bool sendTo(Common_Message *msg, bool reliable, Connection *conn = NULL);
     
     // send to all users whose account type is Individual, no need to call set_dest_id(), this is done automatically
-    bool sendToAllIndividuals(Common_Message *msg, bool reliable);
+    // the users which didn't announce all the 'features' get 'fallback' instead, or nothing if it's null
+    bool sendToAllIndividuals(Common_Message *msg, bool reliable, uint32 features = 0, Common_Message *fallback = nullptr);
 
     // send to all users whose account type is GameServer, no need to call set_dest_id(), this is done automatically
     bool sendToAllGameservers(Common_Message *msg, bool reliable);
@@ -162,9 +265,12 @@ public:
     void rmCallback(Callback_Ids id, CSteamID steam_id, void (*message_callback)(void *object, Common_Message *msg), void *object);
 
     uint32 getIP(CSteamID id);
+    // bytes of reliable data queued for this user which the TCP socket didn't take yet
+    size_t getPendingSendBytes(CSteamID id);
     uint32 getOwnIP();
 
-    void startQuery(IP_PORT ip_port);
+    // queries are answered by 'handler' on the I/O thread (or in Run()), without global_mutex
+    void startQuery(IP_PORT ip_port, class Source_Query *handler);
     void shutDownQuery();
     bool isQueryAlive();
 };
@@ -0,0 +1,45 @@
+/* Copyright (C) 2019 Mr Goldberg
+   This file is part of the Goldberg Emulator
+
+   The Goldberg Emulator is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   The Goldberg Emulator is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the Goldberg Emulator; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#ifndef __INCLUDED_NETWORKING_MESSAGE_H__
+#define __INCLUDED_NETWORKING_MESSAGE_H__
+
+#include "base.h"
+
+// counters for the message objects handed to the game by the networking interfaces
+struct Networking_Message_Stats {
+    uint64 allocated{}; // message objects created
+    uint64 released{}; // message objects released by the game or the emu
+    uint64 payloads_moved{}; // received payloads handed over without copying them
+    uint64 payloads_copied{}; // received payloads whose bytes had to be copied, ex: short strings stored inline
+    uint64 payloads_allocated{}; // payload buffers allocated for the game, ex: AllocateMessage()
+    uint64 pool_hits{}; // message objects and payload buffers reused from the pool
+    uint64 pool_misses{}; // message objects and payload buffers that had to be allocated
+    uint64 bytes_outstanding{}; // payload bytes held by messages not released yet
+};
+
+// SteamNetworkingMessage_t which owns its payload
+// a payload received from the network is moved into the message instead of being copied,
+// so the only copy of the data is the one made when the protobuf was parsed
+// released messages and payload buffers go back to a pool shared by all the networking interfaces
+SteamNetworkingMessage_t *new_networking_message(std::string &&payload);
+// message with an uninitialized (zeroed) payload of 'size' bytes, or without a payload if size is 0
+SteamNetworkingMessage_t *new_networking_message(size_t size);
+
+Networking_Message_Stats get_networking_message_stats();
+
+#endif // __INCLUDED_NETWORKING_MESSAGE_H__
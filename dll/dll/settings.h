@@ -186,6 +186,13 @@ struct Overlay_Appearance {
     static NotificationPosition translate_notification_position(const std::string &str);
 };
 
+// how Networking::Run() finds the sockets which have pending data
+enum class Network_IO_Backend {
+    sweep, // query every socket on each run (default)
+    poll, // a single poll() (select() on Windows) over all sockets
+    epoll, // epoll readiness list, Linux only, other platforms fall back to 'poll'
+};
+
 struct Branch_Info {
     std::string name{};
     std::string description{};
@@ -240,6 +247,9 @@ public:
 
     //networking
     bool disable_networking = false;
+    Network_IO_Backend network_io_backend = Network_IO_Backend::sweep;
+    // do the socket work on a separate thread instead of inside RunCallbacks()
+    bool network_io_thread = false;
 
     //gameserver source query
     bool disable_source_query = false;
@@ -254,6 +264,8 @@ public:
     //steamhttp external download support
     bool download_steamhttp_requests = false;
     bool force_steamhttp_success = false;
+    // scheme and host (ex: "http://127.0.0.1:8080") the online requests are sent to instead of the one in their url, empty to disable
+    std::string steamhttp_base_url_override{};
 
     //steam deck flag
     bool steam_deck = false;
@@ -318,6 +330,8 @@ public:
     bool disable_sharing_stats_with_gameserver = false;
     // synchronize user stats/achievements with game servers as soon as possible instead of caching them.
     bool immediate_gameserver_stats = false;
+    // minimum time between 2 synchronizations of changed stats/achievements with game servers, 0 = on each run of the callbacks
+    int gameserver_stats_sync_interval_ms = 0;
 
     // steam_game_stats
     std::string steam_game_stats_reports_dir{};
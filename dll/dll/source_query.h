@@ -20,13 +20,74 @@
 
 #include "base.h"
 
+struct Gameserver_Player_Info_t {
+    std::chrono::steady_clock::time_point join_time{};
+    std::string name{};
+    uint32 score{};
+};
+
+// immutable copy of what the queries report, published by Steam_GameServer whenever it changes
+// so queries can be answered from any thread without taking global_mutex
+struct Source_Query_State {
+    Gameserver server{};
+    std::vector<std::pair<CSteamID, Gameserver_Player_Info_t>> players{};
+    // bumped for each cached response the change affected
+    uint32_t generation[3]{};
+};
+
 class Source_Query
 {
-    Source_Query() = delete;
-    ~Source_Query() = delete;
+public:
+    // which cached responses are affected by a state change
+    enum Cached_Response_Type : uint8_t {
+        info    = 1 << 0,
+        players = 1 << 1,
+        rules   = 1 << 2,
+        all     = info | players | rules,
+    };
+
+    // one packet, or the fragments of a split response
+    using Packets = std::vector<std::vector<uint8_t>>;
+
+private:
+    struct Cached_Response {
+        bool valid = false;
+        uint32_t generation{};
+        std::chrono::steady_clock::time_point built{};
+        std::shared_ptr<const Packets> packets{};
+    };
+
+    // only touched by set_state(), which runs under global_mutex
+    uint32_t generation[3]{};
+    // read with std::atomic_load(), replaced with std::atomic_store()
+    std::shared_ptr<const Source_Query_State> state{};
+
+    // the caches and challenges are shared by the query socket and HandleIncomingPacket()
+    std::mutex cache_mutex{};
+    Cached_Response info_cache{};
+    Cached_Response players_cache{};
+    Cached_Response rules_cache{};
+
+    // challenges are derived from the source ip and a secret that rotates,
+    // the previous secret is still accepted so a client doesn't lose its challenge mid query
+    uint32_t challenge_secret[2]{};
+    std::chrono::steady_clock::time_point challenge_rotated{};
+    uint32_t split_response_id{};
+
+    uint32_t make_challenge(uint32_t ip, uint32_t secret) const;
+    uint32_t current_challenge(uint32_t ip);
+    bool check_challenge(uint32_t ip, uint32_t challenge);
+    void store_response(Cached_Response &cache, uint32_t generation, std::vector<uint8_t> &&response);
 
 public:
-    static std::vector<uint8_t> handle_source_query(const void* buffer, size_t len, Gameserver const& gs);
+    Source_Query();
+
+    // replaces the state queries are answered from, 'changed' tells which cached responses are stale
+    void set_state(std::shared_ptr<Source_Query_State> new_state, uint8_t changed);
+
+    // returns the packets to send back, nullptr if the query shouldn't be answered
+    // safe to call from any thread, src_ip is in host byte order
+    std::shared_ptr<const Packets> handle_source_query(const void* buffer, size_t len, uint32_t src_ip);
 };
 
 #endif // __INCLUDED_SOURCE_QUERY_H__
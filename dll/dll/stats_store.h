@@ -0,0 +1,67 @@
+/* Copyright (C) 2019 Mr Goldberg
+   This file is part of the Goldberg Emulator
+
+   The Goldberg Emulator is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   The Goldberg Emulator is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the Goldberg Emulator; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#ifndef __INCLUDED_STATS_STORE_H__
+#define __INCLUDED_STATS_STORE_H__
+
+#include "base.h"
+
+// write-behind storage for the user stats, all of them are kept in memory and persisted
+// to a single append-only journal (one record per changed stat) which gets compacted
+// once it grows too much compared to the amount of live stats
+//
+// the raw value of each stat has the same layout the old one-file-per-stat storage used,
+// 4 bytes for int/float stats and 16 bytes (avg, count, session length) for avgrate ones
+class Stats_Store
+{
+public:
+    static constexpr const auto journal_file = "stats.journal";
+
+private:
+    std::string journal_path{}; // empty when nothing should be written to disk
+    std::map<std::string, std::string> values{};
+    std::set<std::string> dirty{};
+    // amount of records currently in the journal, live or stale
+    size_t journal_records{};
+
+    bool load_journal();
+    void migrate_stats_folder(const std::string &stats_folder);
+    // renames the journal to the first free stats.journal.bak[N]
+    bool backup_journal();
+    bool append_records(const std::vector<char> &buffer, size_t count);
+
+public:
+    // loads the journal in save_folder (the app save folder, with a trailing separator),
+    // or imports the stats stored by older builds in save_folder/stats/ if there's none,
+    // a journal that can't be read is renamed to stats.journal.bak[N] and a new one is started
+    void open(const std::string &save_folder);
+    bool is_open() const;
+
+    // copies the first 'size' bytes of the raw value to data,
+    // returns false if the stat was never saved or its value is smaller than that
+    bool get(const std::string &name, void *data, size_t size) const;
+    void set(const std::string &name, const void *data, size_t size);
+
+    bool has_pending_writes() const;
+    // appends all the changed stats to the journal in one write, returns false if that failed
+    // (the changes are kept and retried on the next flush)
+    bool flush();
+    // rewrites the journal with only the live values
+    bool compact();
+};
+
+#endif // __INCLUDED_STATS_STORE_H__
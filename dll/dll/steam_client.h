@@ -345,6 +345,8 @@ public:
     void clientShutdown();
     bool IsServerInit();
     bool IsUserLogIn();
+    // stops the helper threads which lock global_mutex, before it's held to delete the client
+    void stopThreads();
 
     void DestroyAllInterfaces();
 
@@ -20,6 +20,7 @@
 
 #include "base.h"
 #include "auth.h"
+#include "source_query.h"
 
 //-----------------------------------------------------------------------------
 // Purpose: Functions for authenticating users via Steam to play on a game server
@@ -32,12 +33,6 @@ struct Gameserver_Outgoing_Packet {
     uint16 port{};
 };
 
-struct Gameserver_Player_Info_t {
-    std::chrono::steady_clock::time_point join_time{};
-    std::string name{};
-    uint32 score{};
-};
-
 class Steam_GameServer : 
 public ISteamGameServer002,
 public ISteamGameServer003,
@@ -70,9 +65,16 @@ public ISteamGameServer
     std::chrono::high_resolution_clock::time_point last_sent_server_info{};
     Auth_Manager *auth_manager{};
 
-    std::vector<struct Gameserver_Outgoing_Packet> outgoing_packets{};
+    std::deque<struct Gameserver_Outgoing_Packet> outgoing_packets{};
+    Source_Query source_query{};
+    // Source_Query::Cached_Response_Type of the changes not published yet
+    uint8_t query_state_changed{};
 
     void set_version(const char *pchVersionString);
+    // marks server_data and players as changed, they're published once per frame by publish_query_state()
+    void update_query_state(uint8_t changed);
+    // gives the source query a snapshot of server_data and players if they changed
+    void publish_query_state();
 
 
 public:
@@ -41,24 +41,45 @@ public ISteamGameServerStats
 	};
 
 	struct CachedStat {
+		uint32 id{}; // interned by the user
+		std::string name{}; // only kept for users which don't support StatsDelta
 		bool dirty = false; // true means it was changed on the server and should be sent to the user
 		GameServerStats_Messages::StatInfo stat{};
 	};
 	struct CachedAchievement {
+		uint32 id{}; // interned by the user
+		std::string name{}; // only kept for users which don't support StatsDelta
 		bool dirty = false; // true means it was changed on the server and should be sent to the user
 		GameServerStats_Messages::AchievementInfo ach{};
 	};
 
 	struct UserData {
-		std::map<std::string, CachedStat> stats{};
-		std::map<std::string, CachedAchievement> achievements{};
+		std::unordered_map<uint32, CachedStat> stats{};
+		std::unordered_map<uint32, CachedAchievement> achievements{};
+		// lower case name -> id
+		std::unordered_map<std::string, uint32> stat_ids{};
+		std::unordered_map<std::string, uint32> achievement_ids{};
+
+		// ids changed on the server since the last sync
+		std::vector<uint32> dirty_stats{};
+		std::vector<uint32> dirty_achievements{};
+		bool queued = false; // in dirty_users
+		// older builds only exchange AllStats (keyed by names), we give their stats ids of our own
+		bool supports_delta = false;
 	};
 
 	std::vector<RequestAllStats> pending_RequestUserStats{};
-	std::map<uint64, UserData> all_users_data{};
+	std::unordered_map<uint64, UserData> all_users_data{};
+	// users with something to sync, so we don't have to scan everyone on each run
+	std::vector<uint64> dirty_users{};
+	std::chrono::high_resolution_clock::time_point last_sync{};
 
 	CachedStat* find_stat(CSteamID steamIDUser, const std::string &key);
 	CachedAchievement* find_ach(CSteamID steamIDUser, const std::string &key);
+	void queue_update(CSteamID steamIDUser, CachedStat *stat);
+	void queue_update(CSteamID steamIDUser, CachedAchievement *ach);
+	void apply_user_stats(UserData &user, const GameServerStats_Messages::StatsDelta &delta);
+	void apply_user_stats(UserData &user, const GameServerStats_Messages::AllStats &all_stats);
 
 	void remove_timedout_userstats_requests();
 	void collect_and_send_updated_user_stats();
@@ -57,6 +57,35 @@ struct Steam_Http_Request {
 	HTTPCookieContainerHandle cookie_container_handle = INVALID_HTTPCOOKIE_HANDLE;
 
 	std::string response{};
+
+	// set by SendHTTPRequest() or SendHTTPRequestAndStreamResponse()
+	bool sent = false;
+	bool streaming = false;
+	bool headers_received = false;
+	bool timed_out = false;
+};
+
+// an online request downloaded by the HTTP thread, owned by that thread until it's in 'http_done'
+struct Steam_Http_Transfer {
+	HTTPRequestHandle handle{};
+	SteamAPICall_t call_res_id{};
+	bool streaming{};
+
+	CURL *curl{};
+	struct curl_slist *headers_list{};
+	std::string url{};
+	std::string target_filepath{};
+	FILE *hfile{};
+
+	// the whole response, when streaming this is sent to the game as it arrives instead
+	std::string body{};
+	// set by the header callback once the final response headers ended (not a redirect or a 1xx reply)
+	bool headers_done{};
+	bool headers_reported{};
+	bool redirecting{};
+	CURLcode result = CURLE_OK;
+	// set by ReleaseHTTPRequest(), guarded by Steam_HTTP::http_mutex
+	bool cancelled{};
 };
 
 
@@ -69,18 +98,49 @@ public ISteamHTTP
     class Networking *network{};
     class SteamCallResults *callback_results{};
     class SteamCallBacks *callbacks{};
+    class RunEveryRunCB *run_every_runcb{};
 
 	std::vector<Steam_Http_Request> requests{};
 
+	// all the online requests share a single curl multi handle running on 'http_thread',
+	// so connections are reused and only a limited amount of transfers run at once
+	std::thread http_thread{};
+	CURLM *http_multi{};
+	std::mutex http_mutex{};
+	bool http_thread_stop{};
+	// waiting for a free slot, the front is started first
+	std::deque<Steam_Http_Transfer *> http_pending{};
+	std::vector<Steam_Http_Transfer *> http_active{};
+	// finished, waiting to be reported by RunCallbacks()
+	std::vector<Steam_Http_Transfer *> http_done{};
+	// data received by streaming requests, waiting to be reported by RunCallbacks()
+	std::vector<std::pair<HTTPRequestHandle, std::string>> http_stream_data{};
+	// streaming requests whose response headers were received, waiting to be reported by RunCallbacks()
+	std::vector<HTTPRequestHandle> http_headers_received{};
+	// finished streaming requests, completed by the next RunCallbacks() so their last data is dispatched first
+	std::vector<Steam_Http_Transfer *> http_streamed_done{};
+
 	Steam_Http_Request *get_request(HTTPRequestHandle hRequest);
-	void online_http_request(Steam_Http_Request *request, SteamAPICall_t call_res_id);
+	Steam_Http_Transfer *create_transfer(Steam_Http_Request *request, SteamAPICall_t call_res_id);
+	void send_request_completed(Steam_Http_Request *request, SteamAPICall_t call_res_id);
+	bool start_transfer(Steam_Http_Transfer *transfer);
+	static void end_transfer(Steam_Http_Transfer *transfer);
+	static size_t transfer_write(char *data, size_t size, size_t count, void *object);
+	static size_t transfer_header(char *data, size_t size, size_t count, void *object);
+	void http_thread_proc();
+	void queue_online_request(Steam_Http_Request *request, SteamAPICall_t call_res_id);
+	bool send_request(HTTPRequestHandle hRequest, SteamAPICall_t *pCallHandle, bool streaming);
+
+	void RunCallbacks();
+	static void steam_run_every_runcb(void *object);
 
 	void create_http_request_web( struct Steam_Http_Request &request, unsigned url_index );
 	void create_http_request_file( struct Steam_Http_Request &request, unsigned file_index  );
 
 
 public:
-	Steam_HTTP(class Settings *settings, class Networking *network, class SteamCallResults *callback_results, class SteamCallBacks *callbacks);
+	Steam_HTTP(class Settings *settings, class Networking *network, class SteamCallResults *callback_results, class SteamCallBacks *callbacks, class RunEveryRunCB *run_every_runcb);
+	~Steam_HTTP();
 
 	// Initializes a new HTTP request, returning a handle to use in further operations on it.  Requires
 	// the method (GET or POST) and the absolute URL for the request.  Both http and https are supported,
@@ -19,6 +19,7 @@
 #define __INCLUDED_STEAM_INVENTORY_H__
 
 #include "base.h" // For SteamItemDef_t
+#include "inventory_store.h"
 
 struct Steam_Inventory_Requests {
     double timeout = 0.1;
@@ -52,8 +53,7 @@ private:
     class RunEveryRunCB *run_every_runcb{};
     class Local_Storage* local_storage{};
 
-    nlohmann::json defined_items{};
-    nlohmann::json user_items{};
+    Inventory_Store inventory_store{};
 
     std::vector<struct Steam_Inventory_Requests> inventory_requests{};
 
@@ -48,6 +48,28 @@ struct Filter_Values {
     ELobbyComparison eComparisonType{};
 };
 
+struct Near_Filter_Values {
+    std::string key{};
+    int value{};
+};
+
+// a lobby value as it's kept in the search index
+struct Lobby_Index_Value {
+    std::string value{};
+    bool is_number{};
+    long long number{};
+};
+
+// the lobbies having one key, by value
+struct Lobby_Index_Key {
+    // for string filters
+    std::unordered_map<std::string, std::unordered_set<uint64>> strings{};
+    // (number, lobby) sorted by number, for numeric and near filters
+    std::set<std::pair<long long, uint64>> numbers{};
+    // lobbies whose value isn't a number, they fail the numeric filters on this key
+    std::unordered_set<uint64> not_numbers{};
+};
+
 struct Chat_Entry {
     std::string message{};
     EChatEntryType type{};
@@ -75,17 +97,32 @@ public ISteamMatchmaking
 
     std::vector<Lobby> lobbies{};
     std::chrono::high_resolution_clock::time_point last_sent_lobbies{};
+    std::chrono::high_resolution_clock::time_point last_full_sent_lobbies{};
+    // owned lobbies as they were last sent to the other peers, used to only send what changed
+    std::map<uint64, Lobby> replicated_lobbies{};
+    // when a peer last asked the owner for the whole lobby
+    std::map<uint64, std::chrono::high_resolution_clock::time_point> lobby_sync_requests{};
     std::vector<struct Pending_Joins> pending_joins{};
     std::vector<struct Pending_Creates> pending_creates{};
 
     std::vector<struct Filter_Values> filter_values{};
+    std::vector<struct Near_Filter_Values> near_filter_values{};
+    int filter_slots_available{};
     int filter_max_results{};
     std::vector<struct Filter_Values> filter_values_copy{};
+    std::vector<struct Near_Filter_Values> near_filter_values_copy{};
+    int filter_slots_available_copy{};
     int filter_max_results_copy{};
     std::vector<CSteamID> filtered_lobbies{};
+    // search index of the lobby values, updated whenever the values of a lobby change
+    // keys are lowercased since the filters are case insensitive
+    std::unordered_map<std::string, struct Lobby_Index_Key> lobby_index{};
+    // the indexed values of each lobby, to take the old ones out of the index when they change
+    std::unordered_map<uint64, std::map<std::string, struct Lobby_Index_Value>> lobby_indexed_values{};
     std::chrono::high_resolution_clock::time_point lobby_last_search{};
     SteamAPICall_t search_call_api_id{};
     bool searching{};
+    bool searched_once{};
 
     std::vector<struct Chat_Entry> chat_entries{};
     std::vector<struct Data_Requested> data_requested{};
@@ -99,7 +136,10 @@ public ISteamMatchmaking
     static bool leave_lobby(Lobby *lobby, CSteamID id);
 
     Lobby *get_lobby(CSteamID id);
+    void send_lobby_state(Lobby *lobby, bool full, bool send_unchanged, CSteamID dest=k_steamIDNil);
     void send_lobby_data();
+    void request_lobby_sync(uint64 room_id, uint64 owner);
+    void on_lobby_state(Lobby *state);
 
     void trigger_lobby_dataupdate(CSteamID lobby, CSteamID member, bool success, double cb_timeout=0.005, bool send_changed_lobby=true);
     void trigger_lobby_member_join_leave(CSteamID lobby, CSteamID member, bool leaving, bool success, double cb_timeout=0.0);
@@ -116,6 +156,10 @@ public ISteamMatchmaking
     void on_self_enter_leave_lobby(CSteamID id, int type, bool leaving);
 
     void create_pending_lobbies();
+    // call after the values of a lobby were changed or it was added
+    void index_lobby(const Lobby &lobby);
+    void unindex_lobby(uint64 room_id);
+    void search_lobbies();
     void run_background();
     void RunCallbacks();
     void Callback(Common_Message *msg);
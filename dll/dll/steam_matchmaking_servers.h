@@ -41,9 +41,12 @@ struct Steam_Matchmaking_Servers_Gameserver_Friends {
 };
 
 struct Steam_Matchmaking_Servers_Gameserver {
-    Gameserver server{};
+    // replaced, never modified, when the server sends an update so the requests can share it
+    std::shared_ptr<const Gameserver> server{};
     std::chrono::high_resolution_clock::time_point last_recv{};
     EMatchMakingType type{};
+    // LAN servers announce everything, the others only have an address until they're queried
+    bool details_known{};
 };
 
 struct Steam_Matchmaking_Request {
@@ -52,8 +55,24 @@ struct Steam_Matchmaking_Request {
     ISteamMatchmakingServerListResponse *callbacks{};
 	ISteamMatchmakingServerListResponse001 *old_callbacks{};
     bool completed{}, cancelled{}, released{};
-    std::vector <struct Steam_Matchmaking_Servers_Gameserver> gameservers_filtered{};
     EMatchMakingType type{};
+    // the MatchMakingKeyValuePair_t filters passed with the request
+    std::vector<std::pair<std::string, std::string>> filters{};
+
+    // servers are appended as they respond, iServer is an index in this list
+    std::vector<std::shared_ptr<const Gameserver>> gameservers_filtered{};
+    // server key -> index in gameservers_filtered
+    std::unordered_map<uint64, size_t> gameservers_index{};
+    // server key of each gameservers_filtered entry
+    std::vector<uint64> gameservers_keys{};
+    // the queried details failed the filters, the index stays valid but it isn't refreshed anymore
+    std::vector<bool> gameservers_rejected{};
+    // indexes not reported to the listener yet
+    std::vector<size_t> pending_responses{};
+
+    bool scanned{}; // the servers known before the request were checked
+    bool refresh_only{}; // RefreshQuery(), only report the servers already in the list
+    std::chrono::high_resolution_clock::time_point refresh_started{};
 };
 
 class Steam_Matchmaking_Servers :
@@ -64,19 +83,29 @@ public ISteamMatchmakingServers
     class Local_Storage *local_storage{};
     class Networking *network{};
 
-    std::vector <struct Steam_Matchmaking_Servers_Gameserver> gameservers{};
+    // LAN servers are keyed by their steam id, the ones from the server lists by type and address
+    std::unordered_map<uint64, struct Steam_Matchmaking_Servers_Gameserver> gameservers{};
     std::vector <struct Steam_Matchmaking_Servers_Gameserver_Friends> gameservers_friends{};
     std::vector <struct Steam_Matchmaking_Request> requests{};
     std::vector <struct Steam_Matchmaking_Servers_Direct_IP_Request> direct_ip_requests{};
 
 	common_helpers::ForgettableMemory<gameserveritem_t> requests_from_GetServerDetails{};
 
-	HServerListRequest RequestServerList(AppId_t iApp, ISteamMatchmakingServerListResponse *pRequestServersResponse, EMatchMakingType type);
-	void RequestOldServerList(AppId_t iApp, ISteamMatchmakingServerListResponse001 *pRequestServersResponse, EMatchMakingType type);
+	HServerListRequest RequestServerList(AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse *pRequestServersResponse, EMatchMakingType type);
+	void RequestOldServerList(AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse001 *pRequestServersResponse, EMatchMakingType type);
+
+	static uint64 list_server_key(EMatchMakingType type, uint32 ip, uint16 port);
+	Steam_Matchmaking_Request *find_request(HServerListRequest id);
+	bool request_wants_server(const Steam_Matchmaking_Request &request, const Steam_Matchmaking_Servers_Gameserver &g) const;
+	// adds the server to the request if it matches, or updates its entry
+	void offer_server(Steam_Matchmaking_Request &request, uint64 key, const Steam_Matchmaking_Servers_Gameserver &g);
+	void server_updated(uint64 key, const Steam_Matchmaking_Servers_Gameserver &g);
+	// keeps the details of a listed server once its source query answered and filters it again
+	void server_queried(Steam_Matchmaking_Request &request, size_t index, const Gameserver &queried);
 	
     //
 	static void network_callback(void *object, Common_Message *msg);
-    void server_details(Gameserver *g, gameserveritem_t *server);
+    bool server_details(Gameserver *g, gameserveritem_t *server);
     void server_details_players(Gameserver *g, Steam_Matchmaking_Servers_Direct_IP_Request *r);
     void server_details_rules(Gameserver *g, Steam_Matchmaking_Servers_Direct_IP_Request *r);
     void Callback(Common_Message *msg);
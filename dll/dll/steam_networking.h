@@ -65,11 +65,15 @@ public ISteamNetworking
     class RunEveryRunCB *run_every_runcb{};
 
     std::recursive_mutex messages_mutex{};
-    std::list<Common_Message> messages{};
+    // processed messages from connected peers, in arrival order for each channel
+    std::unordered_map<int, std::deque<Common_Message>> channel_messages{};
+    // processed messages from peers we don't have a connection with yet, moved to
+    // channel_messages once the connection is made or dropped after ORPHANED_PACKET_TIMEOUT
+    std::unordered_map<uint64, std::deque<Common_Message>> pending_messages{};
     std::list<Common_Message> unprocessed_messages{};
 
     std::recursive_mutex connections_edit_mutex{};
-    std::vector<struct Steam_Networking_Connection> connections{};
+    std::unordered_map<uint64, struct Steam_Networking_Connection> connections{};
 
     std::vector<struct steam_listen_socket> listen_sockets{};
     std::vector<struct steam_connection_socket> connection_sockets{};
@@ -82,6 +86,9 @@ public ISteamNetworking
     bool connection_exists(CSteamID id);
     struct Steam_Networking_Connection *get_or_create_connection(CSteamID id);
     void remove_connection(CSteamID id);
+    void queue_processed_message(Common_Message &&msg);
+    void drop_peer_messages(uint64 id);
+    Common_Message *front_message(int channel);
     SNetSocket_t create_connection_socket(CSteamID target, int nVirtualPort, uint32 nIP, uint16 nPort, SNetListenSocket_t id=0, enum steam_socket_connection_status status=SOCKET_CONNECTING, SNetSocket_t other_id=0);
     struct steam_connection_socket *get_connection_socket(SNetSocket_t id);
     void remove_killed_connection_sockets();
@@ -19,6 +19,7 @@
 #define __INCLUDED_STEAM_NETWORKING_SOCKETS_H__
 
 #include "base.h"
+#include "networking_message.h"
 
 struct Listen_Socket {
     HSteamListenSocket socket_id{};
@@ -27,6 +28,7 @@ struct Listen_Socket {
     int real_port{};
 
     CSteamID created_by{};
+    int send_buffer_size{}; // k_ESteamNetworkingConfig_SendBufferSize for the accepted connections, 0 to use the global one
 };
 
 enum connect_socket_status {
@@ -38,9 +40,27 @@ enum connect_socket_status {
     CONNECT_SOCKET_TIMEDOUT
 };
 
+// a sent message which wasn't handed to the network yet
+struct Queued_Send_Message {
+    std::string data{};
+    uint64 message_number{};
+    bool reliable{};
+    std::chrono::steady_clock::time_point queued{};
+};
+
+// see ConfigureConnectionLanes()
+struct Send_Lane {
+    int priority{}; // lower numbers are sent first
+    uint16 weight = 1; // share of the bandwidth among the lanes with the same priority
+    double virtual_time{}; // bytes sent / weight, the lane that's furthest behind goes next
+    std::deque<Queued_Send_Message> queue{};
+    size_t pending_bytes[2]{}; // [0] unreliable, [1] reliable
+};
+
 struct Connect_Socket {
+    // min-heap on the message number for std::push_heap/std::pop_heap
     struct compare_snm_for_queue {
-        bool operator()(const Networking_Sockets &left, const Networking_Sockets &right) {
+        bool operator()(const Networking_Sockets &left, const Networking_Sockets &right) const {
             return left.message_number() > right.message_number();
         }
     };
@@ -56,11 +76,20 @@ struct Connect_Socket {
     enum connect_socket_status status{};
     int64 user_data{};
 
-    std::priority_queue<Networking_Sockets, std::vector<Networking_Sockets>, compare_snm_for_queue> data{};
+    // received messages, kept as a heap so the oldest one can be moved out of back() after std::pop_heap
+    std::vector<Networking_Sockets> data{};
     HSteamNetPollGroup poll_group{};
 
     unsigned long long packet_send_counter{};
     CSteamID created_by{};
+    // the peer announced Networking_Sockets::FEATURE_BATCH in the connection handshake
+    bool peer_batching{};
+
+    // messages waiting for the Nagle timer, or for the peer to drain what was already sent
+    std::vector<Send_Lane> send_lanes = std::vector<Send_Lane>(1);
+    size_t send_queued_bytes{};
+    double send_virtual_clock{};
+    int send_buffer_size{}; // k_ESteamNetworkingConfig_SendBufferSize for this connection, 0 to use the global one
 
     std::chrono::steady_clock::time_point connect_request_last_sent{};
     unsigned connect_requests_sent{};
@@ -71,6 +100,7 @@ struct shared_between_client_server {
     std::map<HSteamNetConnection, struct Connect_Socket> connect_sockets{};
     std::map<HSteamNetPollGroup, std::list<HSteamNetConnection>> poll_groups{};
     unsigned used{};
+    int send_buffer_size = 512 * 1024; // global k_ESteamNetworkingConfig_SendBufferSize, same default as steam
 };
 
 class Steam_Networking_Sockets :
@@ -94,14 +124,20 @@ public ISteamNetworkingSockets
     struct shared_between_client_server *sbcs{};
     std::chrono::steady_clock::time_point created{};
 
+    // sends the Nagle batches when their timer expires instead of waiting for the next RunCallbacks()
+    std::thread nagle_thread{};
+    std::mutex nagle_mutex{};
+    std::condition_variable nagle_cv{};
+    std::atomic<bool> nagle_thread_stop{};
+    // when the oldest batch must go out, time_point::max() when nothing is waiting
+    std::chrono::steady_clock::time_point nagle_deadline = std::chrono::steady_clock::time_point::max();
+
     static const int SNS_DISABLED_PORT = -1;
 
     static void steam_callback(void *object, Common_Message *msg);
     static void steam_run_every_runcb(void *object);
 
     SteamNetworkingMessage_t *get_steam_message_connection(HSteamNetConnection hConn);
-    static void free_steam_message_data(SteamNetworkingMessage_t *pMsg);
-    static void delete_steam_message(SteamNetworkingMessage_t *pMsg);
 
     static unsigned long get_socket_id();
 
@@ -109,8 +145,20 @@ public ISteamNetworkingSockets
     struct Listen_Socket *get_connection_socket(HSteamListenSocket id);
 
     bool send_packet_new_connection(HSteamNetConnection m_hConn);
+    size_t get_network_backlog(const Connect_Socket &connect_socket);
+    EResult queue_message(std::map<HSteamNetConnection, Connect_Socket>::iterator connect_socket, const void *pData, uint32 cbData, int nSendFlags, uint16 lane, int64 *pOutMessageNumber);
+    bool flush_messages(std::map<HSteamNetConnection, Connect_Socket>::iterator connect_socket, bool ignore_window=false);
+    // sends what waited long enough for the Nagle timer, returns when the next batch is due
+    std::chrono::steady_clock::time_point flush_expired_messages(std::chrono::steady_clock::time_point now);
+    void schedule_nagle_flush(std::chrono::steady_clock::time_point deadline);
+    void nagle_thread_proc();
+    void push_received_data(Connect_Socket &connect_socket, Networking_Sockets &&data);
 
     HSteamListenSocket new_listen_socket(int nSteamConnectVirtualPort, int real_port);
+    // k_ESteamNetworkingConfig_SendBufferSize from the options passed on creation, 0 when it's not there
+    static int get_send_buffer_size_option(int nOptions, const SteamNetworkingConfigValue_t *pOptions);
+    HSteamListenSocket new_listen_socket(int nSteamConnectVirtualPort, int real_port, int nOptions, const SteamNetworkingConfigValue_t *pOptions);
+    void apply_connection_options(HSteamNetConnection hConn, int nOptions, const SteamNetworkingConfigValue_t *pOptions);
 
     ESteamNetworkingConnectionState convert_status(enum connect_socket_status old_status);
 
@@ -125,6 +173,8 @@ public:
     ~Steam_Networking_Sockets();
 
     shared_between_client_server *get_shared_between_client_server();
+    // joins the Nagle thread, it locks global_mutex so this must be called before it's held for the shutdown
+    void stop_nagle_thread();
 
 
     /// Creates a "server" socket that listens for clients to connect to, either by calling
@@ -19,6 +19,7 @@
 #define __INCLUDED_STEAM_NETWORKING_UTILS_H__
 
 #include "base.h"
+#include "networking_message.h"
 
 class Steam_Networking_Utils :
 public ISteamNetworkingUtils001,
@@ -31,6 +32,7 @@ public ISteamNetworkingUtils
     class SteamCallResults *callback_results{};
     class SteamCallBacks *callbacks{};
     class RunEveryRunCB *run_every_runcb{};
+    struct shared_between_client_server *sbcs{};
 
     std::chrono::time_point<std::chrono::steady_clock> initialized_time = std::chrono::steady_clock::now();
     FSteamNetworkingSocketsDebugOutput debug_function{};
@@ -47,14 +49,12 @@ public ISteamNetworkingUtils
     which will delay that first access.
     */
 
-    static void free_steam_message_data(SteamNetworkingMessage_t *pMsg);
-    static void delete_steam_message(SteamNetworkingMessage_t *pMsg);
 
     static void steam_callback(void *object, Common_Message *msg);
     static void steam_run_every_runcb(void *object);
 
 public:
-    Steam_Networking_Utils(class Settings *settings, class Networking *network, class SteamCallResults *callback_results, class SteamCallBacks *callbacks, class RunEveryRunCB *run_every_runcb);
+    Steam_Networking_Utils(class Settings *settings, class Networking *network, class SteamCallResults *callback_results, class SteamCallBacks *callbacks, class RunEveryRunCB *run_every_runcb, struct shared_between_client_server *sbcs);
     ~Steam_Networking_Utils();
 
     /// Allocate and initialize a message object.  Usually the reason
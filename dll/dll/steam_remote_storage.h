@@ -21,13 +21,37 @@
 #include "base.h"
 #include "ugc_remote_storage_bridge.h"
 #include "common_helpers/forgettable_memory.hpp"
+#include "common_helpers/mapped_file.hpp"
+
+// number of threads servicing FileReadAsync() and FileWriteAsync()
+#define REMOTE_STORAGE_IO_WORKERS 2
+// UGCRead() maps content at least this big for the whole read sequence, smaller content is read directly
+#define UGC_READ_MAP_MIN_SIZE (4 * 1024 * 1024)
 
 struct Async_Read {
  SteamAPICall_t api_call{};
  uint32 offset{};
  uint32 to_read{};
- uint32 size{};
  std::string file_name{};
+ bool ready{}; // set once an I/O worker filled data
+ std::vector<char> data{}; // only the requested range
+};
+
+// a file operation handed to the I/O workers
+struct Async_Io_Op {
+    enum class Type {
+        Read,
+        Write,
+    };
+
+    Type type{};
+    SteamAPICall_t api_call{};
+    std::string file_name{};
+    std::string key{}; // see io_file_key()
+    uint32 offset{};
+    uint32 to_read{}; // bytes requested to be read (clamped to the file size by the worker), or written
+    std::vector<char> data{}; // write payload, or read result
+    int result{}; // bytes read or written, negative on failure
 };
 
 struct Stream_Write {
@@ -60,6 +84,12 @@ public:
 
     // *** used when source = FromUGCDownloadToLocation only
     std::string download_to_location_fullpath{};
+
+    // *** used when source = AfterSendQueryUGCRequest and FromUGCDownloadToLocation
+    // resolved on the first UGCRead(), big content stays mapped until the entry is erased (end of the read sequence)
+    // or the file changes
+    std::string content_fullpath{};
+    std::unique_ptr<common_helpers::MappedFile> content_map{};
     
 };
 
@@ -96,6 +126,25 @@ private:
     
     bool steam_cloud_enabled = true;
 
+    // async file operations run on a small pool of threads, operations on the same file
+    // always go to the same worker so they complete in the order they were issued
+    std::vector<std::thread> io_workers{};
+    std::vector<std::deque<Async_Io_Op>> io_queues{};
+    std::vector<Async_Io_Op> io_done{};
+    std::mutex io_mutex{};
+    std::condition_variable io_cv{};
+    bool io_stop{};
+    // queued or running operations per file, the sync file calls wait for the ones on their file
+    // so they never observe (or get overwritten by) an older async write
+    std::unordered_map<std::string, size_t> io_pending{};
+    std::condition_variable io_idle_cv{};
+
+    void io_worker_proc(size_t worker);
+    void queue_io(Async_Io_Op &&op);
+    void wait_io(const char *file_name);
+    void wait_all_io();
+    void post_io_results();
+
     common_helpers::ForgettableMemory<std::string> requests_GetFileNameAndSize{};
     common_helpers::ForgettableMemory<std::string> requests_GetUGCDetails{};
 
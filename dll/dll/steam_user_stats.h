@@ -21,6 +21,7 @@
 #include <limits>
 #include "base.h"
 #include "overlay/steam_overlay.h"
+#include "stats_store.h"
 
 struct Steam_Leaderboard_Entry {
     CSteamID steam_id{};
@@ -28,20 +29,63 @@ struct Steam_Leaderboard_Entry {
     std::vector<int32> score_details{};
 };
 
+// the entries of a leaderboard kept in rank order, as a treap with subtree sizes
+// so that upserts, removals, rank lookups and access by rank are all O(log n)
+// entries with the same score are ordered by the time that score was set
+class Steam_Leaderboard_Entries {
+    struct Node {
+        Steam_Leaderboard_Entry entry{};
+        uint64 seq{};
+        uint32 priority{};
+        uint32 size{};
+        int32 left = -1;
+        int32 right = -1;
+    };
+
+    ELeaderboardSortMethod sort_method = k_ELeaderboardSortMethodNone;
+    std::vector<Node> nodes{};
+    std::vector<int32> free_nodes{};
+    std::unordered_map<uint64, int32> user_nodes{}; // steamid -> node
+    int32 root = -1;
+    uint64 next_seq{};
+    uint32 rng_state = 0x9E3779B9u;
+
+    bool goes_before(const Node &a, const Node &b) const;
+    uint32 subtree_size(int32 node) const;
+    void update_size(int32 node);
+    // left gets the nodes which go before key, right gets the rest
+    void split(int32 node, const Node &key, int32 &left, int32 &right);
+    int32 merge(int32 left, int32 right);
+    void insert_node(int32 node);
+    void erase_node(int32 &node, const Node &key);
+
+public:
+    Steam_Leaderboard_Entries(ELeaderboardSortMethod sort_method = k_ELeaderboardSortMethodNone);
+
+    size_t size() const;
+    const Steam_Leaderboard_Entry* find(const CSteamID &steamid) const;
+    // 0-based rank of the user's entry, -1 if they don't have one
+    int rank(const CSteamID &steamid) const;
+    // rank is 0-based, nullptr if out of range
+    const Steam_Leaderboard_Entry* at(size_t rank) const;
+
+    // adds the user's entry or replaces their current one, returns its new 0-based rank
+    int upsert(const Steam_Leaderboard_Entry &entry);
+    bool remove(const CSteamID &steamid);
+};
+
 struct Steam_Leaderboard {
     std::string name{};
     ELeaderboardSortMethod sort_method = k_ELeaderboardSortMethodNone;
     ELeaderboardDisplayType display_type = k_ELeaderboardDisplayTypeNone;
-    std::vector<Steam_Leaderboard_Entry> entries{};
-
-    Steam_Leaderboard_Entry* find_recent_entry(const CSteamID &steamid) const;
-    void remove_entries(const CSteamID &steamid);
-
-    // remove entries with the same steamid, keeping only most recent one
-    void remove_duplicate_entries();
-
-    void sort_entries();
+    Steam_Leaderboard_Entries entries{};
+};
 
+// result of a DownloadLeaderboardEntries*() call, a snapshot of the requested rows
+struct Steam_Leaderboard_Download {
+    SteamLeaderboard_t board{};
+    // 0-based global rank of each entry
+    std::vector<std::pair<int, Steam_Leaderboard_Entry>> entries{};
 };
 
 struct achievement_trigger {
@@ -57,6 +101,15 @@ struct achievement_trigger {
     bool should_indicate_progress(int32 stat) const;
 };
 
+// a game server which requested our stats
+struct Stats_Gameserver {
+    // older builds only understand AllStats (keyed by names)
+    bool supports_delta{};
+    // ids >= these were never announced to this server with their names
+    size_t announced_stat_names{};
+    size_t announced_ach_names{};
+};
+
 class Steam_User_Stats :
 public ISteamUserStats001,
 public ISteamUserStats002,
@@ -93,26 +146,53 @@ private:
     class Steam_Overlay* overlay{};
 
     std::vector<struct Steam_Leaderboard> cached_leaderboards{};
+    // lower case name -> board handle (index in cached_leaderboards + 1)
+    std::unordered_map<std::string, unsigned int> cached_leaderboards_index{};
+    // SteamLeaderboardEntries_t -> downloaded rows, only the most recent downloads are kept
+    std::map<SteamLeaderboardEntries_t, Steam_Leaderboard_Download> leaderboard_downloads{};
+    SteamLeaderboardEntries_t last_leaderboard_download{};
 
     nlohmann::json defined_achievements{};
+    // lower case achievement name -> its index in defined_achievements
+    std::unordered_map<std::string, size_t> defined_achievements_index{};
     nlohmann::json user_achievements{};
+    // changes to user_achievements are written to disk at most once per ACHIEVEMENTS_SAVE_DELAY,
+    // or right away on StoreStats() and shutdown
+    bool achievements_save_pending = false;
+    std::chrono::high_resolution_clock::time_point achievements_save_requested{};
     std::vector<std::string> sorted_achievement_names{};
     size_t last_loaded_ach_icon{};
 
     std::map<std::string, int32> stats_cache_int{};
     std::map<std::string, float> stats_cache_float{};
 
+    // persisted values of the stats, written to disk on StoreStats(), periodically and on shutdown
+    Stats_Store stats_store{};
+    bool stats_store_loaded = false;
+    uint32 stats_store_appid{};
+    std::chrono::high_resolution_clock::time_point last_stats_flush = std::chrono::high_resolution_clock::now();
+
     std::map<std::string, std::vector<achievement_trigger>> achievement_stat_trigger{};
     
     // triggered when an achievement is unlocked
     // https://partner.steamgames.com/doc/api/ISteamUserStats#StoreStats
     std::map<std::string, UserAchievementStored_t> store_stats_trigger{};
 
-    GameServerStats_Messages::AllStats pending_server_updates{};
+    // changes not sent to game servers yet
+    GameServerStats_Messages::StatsDelta pending_server_updates{};
+    std::chrono::high_resolution_clock::time_point last_gameserver_stats_sync{};
+    // ids of the stats/achievements in the messages exchanged with game servers, they never change once assigned
+    std::vector<std::string> interned_stat_names{};
+    std::vector<std::string> interned_ach_names{};
+    std::unordered_map<std::string, uint32> interned_stat_ids{};
+    std::unordered_map<std::string, uint32> interned_ach_ids{};
+    // the updates are sent to these servers only
+    std::unordered_map<uint64, Stats_Gameserver> stats_gameservers{};
 
     void load_achievements_db();
     void load_achievements();
     void save_achievements();
+    void queue_save_achievements();
 
     int load_ach_icon(nlohmann::json &defined_ach, bool achieved);
 
@@ -121,7 +201,9 @@ private:
 
     std::vector<Steam_Leaderboard_Entry> load_leaderboard_entries(const std::string &name);
     void save_my_leaderboard_entry(const Steam_Leaderboard &leaderboard);
-    Steam_Leaderboard_Entry* update_leaderboard_entry(Steam_Leaderboard &leaderboard, const Steam_Leaderboard_Entry &entry, bool overwrite = true);
+    // returns the new 0-based rank of the entry
+    int update_leaderboard_entry(Steam_Leaderboard &leaderboard, const Steam_Leaderboard_Entry &entry, bool overwrite = true);
+    SteamLeaderboardEntries_t add_leaderboard_download(Steam_Leaderboard_Download &&download);
 
     // returns a value 1 -> leaderboards.size(), inclusive
     unsigned int find_cached_leaderboard(const std::string &name);
@@ -130,6 +212,9 @@ private:
     void send_my_leaderboard_score(const Steam_Leaderboard &board, const CSteamID *steamid = nullptr, bool want_scores_back = false);
     void request_user_leaderboard_entry(const Steam_Leaderboard &board, const CSteamID &steamid);
 
+    Stats_Store& get_stats_store();
+    void flush_stats();
+
     // change stats/achievements without sending back to server
     bool clear_stats_internal();
     InternalSetResult<int32> set_stat_internal( const char *pchName, int32 nData );
@@ -138,6 +223,9 @@ private:
     InternalSetResult<bool> set_achievement_internal( const char *pchName );
     InternalSetResult<bool> clear_achievement_internal( const char *pchName );
 
+    uint32 intern_stat_name(const std::string &name);
+    uint32 intern_ach_name(const std::string &name);
+    GameServerStats_Messages::AllStats *to_all_stats(const GameServerStats_Messages::StatsDelta &delta) const;
     void send_updated_stats();
     void load_achievements_icons();
     void steam_run_callback();
@@ -145,6 +233,8 @@ private:
     // requests from server
     void network_stats_initial(Common_Message *msg);
     void network_stats_updated(Common_Message *msg);
+    void network_stat_updated(const char *stat_name, const GameServerStats_Messages::StatInfo &new_stat);
+    void network_ach_updated(const char *ach_name, const GameServerStats_Messages::AchievementInfo &new_ach);
     void network_callback_stats(Common_Message *msg);
 
     // requests from other users to share leaderboards
@@ -0,0 +1,211 @@
+/* Copyright (C) 2019 Mr Goldberg
+   This file is part of the Goldberg Emulator
+
+   The Goldberg Emulator is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   The Goldberg Emulator is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the Goldberg Emulator; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include "dll/inventory_store.h"
+
+
+static bool parse_item_id(const std::string &key, long long &id)
+{
+    try {
+        size_t end = 0;
+        id = std::stoll(key, &end);
+        return end == key.size();
+    } catch (...) {
+        return false;
+    }
+}
+
+static uint32 parse_item_quantity(const nlohmann::json &value)
+{
+    const nlohmann::json *quantity = &value;
+    if (value.is_object()) {
+        auto it = value.find("quantity");
+        if (value.end() == it) return 0;
+        quantity = &(*it);
+    }
+
+    try {
+        if (quantity->is_number_unsigned()) {
+            return static_cast<uint32>(std::min<uint64>(quantity->get<uint64>(), std::numeric_limits<uint32>::max()));
+        }
+        if (quantity->is_number_integer()) {
+            return static_cast<uint32>(std::clamp<int64>(quantity->get<int64>(), 0, std::numeric_limits<uint32>::max()));
+        }
+        if (quantity->is_string()) {
+            return static_cast<uint32>(std::clamp<long long>(std::stoll(quantity->get<std::string>()), 0, std::numeric_limits<uint32>::max()));
+        }
+    } catch (...) {}
+
+    return 0;
+}
+
+
+uint32 Inventory_Store::intern_property_name(const std::string &name)
+{
+    auto it = property_names_index.find(name);
+    if (property_names_index.end() != it) return it->second;
+
+    uint32 index = static_cast<uint32>(property_names.size());
+    property_names.push_back(name);
+    property_names_index.emplace(property_names.back(), index);
+    return index;
+}
+
+void Inventory_Store::load_definitions(const nlohmann::json &defined_items)
+{
+    definitions.clear();
+    properties.clear();
+    values_pool.clear();
+    if (!defined_items.is_object()) return;
+
+    definitions.reserve(defined_items.size());
+    for (auto def = defined_items.begin(); def != defined_items.end(); ++def) {
+        long long id = 0;
+        if (!parse_item_id(def.key(), id) || id < std::numeric_limits<SteamItemDef_t>::min() || id > std::numeric_limits<SteamItemDef_t>::max()) {
+            PRINT_DEBUG("ignoring item definition with invalid id '%s'", def.key().c_str());
+            continue;
+        }
+        if (!def->is_object()) {
+            PRINT_DEBUG("ignoring item definition %lld, it's not an object", id);
+            continue;
+        }
+
+        Item_Definition &definition = definitions.emplace_back();
+        definition.id = static_cast<SteamItemDef_t>(id);
+        definition.first_property = static_cast<uint32>(properties.size());
+        definition.property_count = static_cast<uint32>(def->size());
+
+        for (auto attr = def->begin(); attr != def->end(); ++attr) {
+            Item_Property &property = properties.emplace_back();
+            property.name = intern_property_name(attr.key());
+            property.is_string = attr->is_string();
+            if (property.is_string) {
+                const auto &value = attr->get_ref<const std::string &>();
+                property.value_offset = static_cast<uint32>(values_pool.size());
+                property.value_size = static_cast<uint32>(value.size());
+                values_pool += value;
+            }
+        }
+    }
+
+    // the json keys are sorted as strings ("10" < "9"), sort them as numbers so definitions can be binary searched
+    // a stable sort keeps the last one of duplicated ids (ex: "1" and "01") at the back, that's the one kept
+    std::stable_sort(definitions.begin(), definitions.end(), [](const Item_Definition &a, const Item_Definition &b){ return a.id < b.id; });
+    auto last = std::unique(definitions.rbegin(), definitions.rend(), [](const Item_Definition &a, const Item_Definition &b){ return a.id == b.id; });
+    definitions.erase(definitions.begin(), last.base());
+
+    PRINT_DEBUG("loaded %zu item definitions, %zu properties, %zu unique property names", definitions.size(), properties.size(), property_names.size());
+}
+
+void Inventory_Store::load_inventory(const nlohmann::json &user_items)
+{
+    items.clear();
+    if (!user_items.is_object()) return;
+
+    items.reserve(user_items.size());
+    for (auto item = user_items.begin(); item != user_items.end(); ++item) {
+        long long id = 0;
+        if (!parse_item_id(item.key(), id) || id < std::numeric_limits<SteamItemDef_t>::min() || id > std::numeric_limits<SteamItemDef_t>::max()) {
+            PRINT_DEBUG("ignoring inventory item with invalid id '%s'", item.key().c_str());
+            continue;
+        }
+
+        Inventory_Item &inventory_item = items.emplace_back();
+        inventory_item.id = static_cast<SteamItemInstanceID_t>(id);
+        inventory_item.definition = static_cast<SteamItemDef_t>(id);
+        inventory_item.quantity = parse_item_quantity(item.value());
+    }
+
+    std::stable_sort(items.begin(), items.end(), [](const Inventory_Item &a, const Inventory_Item &b){ return a.id < b.id; });
+    auto last = std::unique(items.rbegin(), items.rend(), [](const Inventory_Item &a, const Inventory_Item &b){ return a.id == b.id; });
+    items.erase(items.begin(), last.base());
+
+    PRINT_DEBUG("loaded %zu inventory items", items.size());
+}
+
+const std::vector<Inventory_Store::Item_Definition>& Inventory_Store::get_definitions() const
+{
+    return definitions;
+}
+
+const Inventory_Store::Item_Definition* Inventory_Store::find_definition(SteamItemDef_t id) const
+{
+    auto it = std::lower_bound(definitions.begin(), definitions.end(), id, [](const Item_Definition &def, SteamItemDef_t id){ return def.id < id; });
+    if (definitions.end() == it || it->id != id) return nullptr;
+
+    return &(*it);
+}
+
+const Inventory_Store::Item_Property* Inventory_Store::find_property(const Item_Definition &definition, const char *name) const
+{
+    auto it = property_names_index.find(name);
+    if (property_names_index.end() == it) return nullptr;
+
+    uint32 name_index = it->second;
+    const Item_Property *first = properties.data() + definition.first_property;
+    const Item_Property *last = first + definition.property_count;
+    for (; first != last; ++first) {
+        if (first->name == name_index) return first;
+    }
+
+    return nullptr;
+}
+
+std::string_view Inventory_Store::get_property_name(const Item_Property &property) const
+{
+    return property_names[property.name];
+}
+
+std::string_view Inventory_Store::get_property_value(const Item_Property &property) const
+{
+    return std::string_view(values_pool.data() + property.value_offset, property.value_size);
+}
+
+std::string Inventory_Store::get_property_names(const Item_Definition &definition) const
+{
+    std::string names{};
+    const Item_Property *first = properties.data() + definition.first_property;
+    const Item_Property *last = first + definition.property_count;
+    for (const Item_Property *property = first; property != last; ++property) {
+        if (property != first) names += ',';
+        names += property_names[property->name];
+    }
+
+    return names;
+}
+
+const std::vector<Inventory_Store::Inventory_Item>& Inventory_Store::get_items() const
+{
+    return items;
+}
+
+Inventory_Store::Inventory_Item* Inventory_Store::find_item(SteamItemInstanceID_t id)
+{
+    auto it = std::lower_bound(items.begin(), items.end(), id, [](const Inventory_Item &item, SteamItemInstanceID_t id){ return item.id < id; });
+    if (items.end() == it || it->id != id) return nullptr;
+
+    return &(*it);
+}
+
+bool Inventory_Store::remove_item(SteamItemInstanceID_t id)
+{
+    auto it = std::lower_bound(items.begin(), items.end(), id, [](const Inventory_Item &item, SteamItemInstanceID_t id){ return item.id < id; });
+    if (items.end() == it || it->id != id) return false;
+
+    items.erase(it);
+    return true;
+}
@@ -40,6 +40,9 @@
 
 struct File_Data {
     std::string name{};
+    // only filled by get_filenames_recursive()
+    unsigned int size{};
+    uint64_t timestamp{};
 };
 
 
@@ -70,7 +73,7 @@ int Local_Storage::get_file_data(const std::string &full_path, char *data, unsig
     return -1;
 }
 
-int Local_Storage::store_file_data(std::string folder, std::string file, const char *data, unsigned int length)
+int Local_Storage::store_file_data(std::string folder, std::string file, const char *data, unsigned int length, bool append)
 {
     return -1;
 }
@@ -125,6 +128,11 @@ int Local_Storage::store_data(std::string folder, std::string file, char *data,
     return -1;
 }
 
+int Local_Storage::append_data(std::string folder, std::string file, const char *data, unsigned int length)
+{
+    return -1;
+}
+
 int Local_Storage::store_data_settings(std::string file, const char *data, unsigned int length)
 {
     return -1;
@@ -308,6 +316,10 @@ static std::vector<struct File_Data> get_filenames_recursive_w(std::wstring base
             } else {
                 File_Data f;
                 f.name = utf8_encode(ffd.cFileName);
+                f.size = ffd.nFileSizeLow;
+                // FILETIME counts 100ns intervals since 1601-01-01, convert to unix time
+                uint64_t write_time = ((uint64_t)ffd.ftLastWriteTime.dwHighDateTime << 32) | ffd.ftLastWriteTime.dwLowDateTime;
+                f.timestamp = write_time / 10000000ULL - 11644473600ULL;
                 output.push_back(f);
             }
         } while (::FindNextFileW(hFind, &ffd) == TRUE);
@@ -432,6 +444,11 @@ static std::vector<struct File_Data> get_filenames_recursive(std::string base_pa
             if (dp->d_type == DT_REG) {
                 File_Data f;
                 f.name = dp->d_name;
+                struct stat buffer{};
+                if (stat((base_path + "/" + f.name).c_str(), &buffer) == 0) {
+                    f.size = buffer.st_size;
+                    f.timestamp = buffer.st_mtime;
+                }
                 output.push_back(f);
             } else if (dp->d_type == DT_DIR) {
                 // Construct new path from our base path
@@ -544,6 +561,38 @@ static std::string desanitize_file_name(std::string name)
     return name;
 }
 
+static std::string file_index_key(const std::string &name)
+{
+#if defined(STEAM_WIN32)
+    // file names are case insensitive on Windows
+    std::string key(name);
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+    return key;
+#else
+    return name;
+#endif
+}
+
+static uint64_t file_timestamp_(const std::string &full_path)
+{
+#if defined(STEAM_WIN32)
+    struct _stat buffer = {};
+    if (_wstat(utf8_decode(full_path).c_str(), &buffer) != 0) return 0;
+#else
+    struct stat buffer = {};
+    if (stat (full_path.c_str(), &buffer) != 0) return 0;
+#endif
+    return buffer.st_mtime;
+}
+
+template<typename Entry>
+static auto find_index_entry(std::vector<Entry> &index, const std::string &key)
+{
+    auto it = std::lower_bound(index.begin(), index.end(), key, [](const Entry &e, const std::string &k){ return e.key < k; });
+    if (it != index.end() && it->key != key) it = index.end();
+    return it;
+}
+
 Local_Storage::Local_Storage(const std::string &save_directory)
 {
     this->save_directory = save_directory;
@@ -560,10 +609,70 @@ const std::string& Local_Storage::get_current_save_directory() const
 
 void Local_Storage::setAppId(uint32 appid)
 {
-    this->appid = std::to_string(appid) + PATH_SEPARATOR;
+    std::string new_appid(std::to_string(appid) + PATH_SEPARATOR);
+    if (new_appid == this->appid) return;
+
+    this->appid = std::move(new_appid);
+
+    // the indexed folders now live under a different path, rebuild them
+    std::lock_guard lock(folder_indexes_mtx);
+    std::vector<std::string> indexed_folders{};
+    for (auto &idx : folder_indexes) indexed_folders.push_back(idx.first);
+    folder_indexes.clear();
+    for (auto &folder : indexed_folders) get_folder_index(folder, true);
+}
+
+std::vector<Local_Storage::File_Index_Entry>* Local_Storage::get_folder_index(const std::string &folder, bool build)
+{
+    auto it = folder_indexes.find(folder);
+    if (it != folder_indexes.end()) return &it->second;
+    if (!build) return nullptr;
+
+    std::vector<struct File_Data> files = get_filenames_recursive(save_directory + appid + folder);
+    std::vector<File_Index_Entry> index{};
+    index.reserve(files.size());
+    for (auto &f : files) {
+        File_Index_Entry &entry = index.emplace_back();
+        entry.key = file_index_key(f.name);
+        entry.name = std::move(f.name);
+        entry.size = f.size;
+        entry.timestamp = f.timestamp;
+    }
+    std::sort(index.begin(), index.end(), [](const File_Index_Entry &a, const File_Index_Entry &b){ return a.key < b.key; });
+
+    PRINT_DEBUG("indexed %zu files in '%s'", index.size(), folder.c_str());
+    return &(folder_indexes[folder] = std::move(index));
+}
+
+void Local_Storage::index_file(const std::string &folder, const std::string &file, unsigned int size)
+{
+    std::lock_guard lock(folder_indexes_mtx);
+    auto index = get_folder_index(folder, false);
+    if (!index) return;
+
+    std::string key(file_index_key(file));
+    auto it = std::lower_bound(index->begin(), index->end(), key, [](const File_Index_Entry &e, const std::string &k){ return e.key < k; });
+    if (it == index->end() || it->key != key) {
+        it = index->emplace(it);
+        it->name = file;
+        it->key = std::move(key);
+    }
+
+    it->size = size;
+    it->timestamp = file_timestamp_(save_directory + appid + folder + it->name);
+}
+
+void Local_Storage::unindex_file(const std::string &folder, const std::string &file)
+{
+    std::lock_guard lock(folder_indexes_mtx);
+    auto index = get_folder_index(folder, false);
+    if (!index) return;
+
+    auto it = find_index_entry(*index, file_index_key(file));
+    if (it != index->end()) index->erase(it);
 }
 
-int Local_Storage::store_file_data(std::string folder, std::string file, const char *data, unsigned int length)
+int Local_Storage::store_file_data(std::string folder, std::string file, const char *data, unsigned int length, bool append)
 {
     if (folder.back() != *PATH_SEPARATOR) {
         folder.append(PATH_SEPARATOR);
@@ -581,7 +690,7 @@ int Local_Storage::store_file_data(std::string folder, std::string file, const c
 
     create_directory(folder + file_folder);
     std::ofstream myfile;
-    myfile.open(std::filesystem::u8path(folder + file), std::ios::binary | std::ios::out);
+    myfile.open(std::filesystem::u8path(folder + file), std::ios::binary | std::ios::out | (append ? std::ios::app : std::ios::trunc));
     if (!myfile.is_open()) return -1;
     myfile.write(data, length);
     int position = static_cast<int>(myfile.tellp());
@@ -654,7 +763,20 @@ int Local_Storage::store_data(std::string folder, std::string file, char *data,
         folder.append(PATH_SEPARATOR);
     }
 
-    return store_file_data(save_directory + appid + folder, file, data, length);
+    int stored = store_file_data(save_directory + appid + folder, file, data, length);
+    if (stored >= 0) index_file(folder, sanitize_file_name(file), static_cast<unsigned int>(stored));
+    return stored;
+}
+
+int Local_Storage::append_data(std::string folder, std::string file, const char *data, unsigned int length)
+{
+    if (folder.size() && folder.back() != *PATH_SEPARATOR) {
+        folder.append(PATH_SEPARATOR);
+    }
+
+    int stored = store_file_data(save_directory + appid + folder, file, data, length, true);
+    if (stored >= 0) index_file(folder, sanitize_file_name(file), static_cast<unsigned int>(stored));
+    return stored;
 }
 
 int Local_Storage::store_data_settings(std::string file, const char *data, unsigned int length)
@@ -707,7 +829,8 @@ int Local_Storage::count_files(std::string folder)
         folder.append(PATH_SEPARATOR);
     }
 
-    return static_cast<int>(get_filenames_recursive(save_directory + appid + folder).size());
+    std::lock_guard lock(folder_indexes_mtx);
+    return static_cast<int>(get_folder_index(folder, true)->size());
 }
 
 bool Local_Storage::file_exists(std::string folder, std::string file)
@@ -717,6 +840,12 @@ bool Local_Storage::file_exists(std::string folder, std::string file)
         folder.append(PATH_SEPARATOR);
     }
 
+    {
+        std::lock_guard lock(folder_indexes_mtx);
+        auto index = get_folder_index(folder, false);
+        if (index) return find_index_entry(*index, file_index_key(file)) != index->end();
+    }
+
     std::string full_path(save_directory + appid + folder + file);
     return file_exists_(full_path);
 }
@@ -728,6 +857,15 @@ unsigned int Local_Storage::file_size(std::string folder, std::string file)
         folder.append(PATH_SEPARATOR);
     }
 
+    {
+        std::lock_guard lock(folder_indexes_mtx);
+        auto index = get_folder_index(folder, false);
+        if (index) {
+            auto it = find_index_entry(*index, file_index_key(file));
+            return it != index->end() ? it->size : 0;
+        }
+    }
+
     std::string full_path(save_directory + appid + folder + file);
     return file_size_(full_path);
 }
@@ -741,10 +879,12 @@ bool Local_Storage::file_delete(std::string folder, std::string file)
 
     std::string full_path(save_directory + appid + folder + file);
 #if defined(STEAM_WIN32)
-    return _wremove(utf8_decode(full_path).c_str()) == 0;
+    bool deleted = _wremove(utf8_decode(full_path).c_str()) == 0;
 #else
-    return remove(full_path.c_str()) == 0;
+    bool deleted = remove(full_path.c_str()) == 0;
 #endif
+    if (deleted) unindex_file(folder, file);
+    return deleted;
 }
 
 uint64_t Local_Storage::file_timestamp(std::string folder, std::string file)
@@ -754,16 +894,17 @@ uint64_t Local_Storage::file_timestamp(std::string folder, std::string file)
         folder.append(PATH_SEPARATOR);
     }
 
-    std::string full_path(save_directory + appid + folder + file);
+    {
+        std::lock_guard lock(folder_indexes_mtx);
+        auto index = get_folder_index(folder, false);
+        if (index) {
+            auto it = find_index_entry(*index, file_index_key(file));
+            return it != index->end() ? it->timestamp : 0;
+        }
+    }
 
-#if defined(STEAM_WIN32)
-    struct _stat buffer = {};
-    if (_wstat(utf8_decode(full_path).c_str(), &buffer) != 0) return 0;
-#else
-    struct stat buffer = {};
-    if (stat (full_path.c_str(), &buffer) != 0) return 0;
-#endif
-    return buffer.st_mtime;
+    std::string full_path(save_directory + appid + folder + file);
+    return file_timestamp_(full_path);
 }
 
 bool Local_Storage::iterate_file(std::string folder, int index, std::string &output_filename, int32 *output_size)
@@ -775,11 +916,15 @@ bool Local_Storage::iterate_file(std::string folder, int index, std::string &out
         folder.append(PATH_SEPARATOR);
     }
 
-    std::vector<struct File_Data> files = get_filenames_recursive(save_directory + appid + folder);
-    if (index < 0 || static_cast<size_t>(index) >= files.size()) return false;
+    std::string name{};
+    {
+        std::lock_guard lock(folder_indexes_mtx);
+        auto files = get_folder_index(folder, true);
+        if (index < 0 || static_cast<size_t>(index) >= files->size()) return false;
 
-    std::string name(desanitize_file_name(files[index].name));
-    if (output_size) *output_size = file_size(folder, name);
+        name = desanitize_file_name((*files)[index].name);
+        if (output_size) *output_size = static_cast<int32>((*files)[index].size);
+    }
 
 #if defined(STEAM_WIN32)
     name = replace_with(name, PATH_SEPARATOR, "/");
@@ -811,6 +956,14 @@ bool Local_Storage::update_save_filenames(std::string folder)
         }
     }
 
+    // index the folder once the names are fixed up, so the game's lookups never have to walk it
+    if (folder.size() && folder.back() != *PATH_SEPARATOR) {
+        folder.append(PATH_SEPARATOR);
+    }
+
+    std::lock_guard lock(folder_indexes_mtx);
+    folder_indexes.erase(folder);
+    get_folder_index(folder, true);
     return true;
 }
 
@@ -856,13 +1009,26 @@ bool Local_Storage::write_json_file(std::string folder, std::string const&file,
 
     create_directory(inv_path);
 
-    std::ofstream inventory_file(std::filesystem::u8path(full_path), std::ios::trunc | std::ios::out | std::ios::binary);
+    // write to a temp file then swap it with the old one, so a crash mid-write never leaves a truncated json behind
+    std::string tmp_path(full_path + ".tmp");
+    std::ofstream inventory_file(std::filesystem::u8path(tmp_path), std::ios::trunc | std::ios::out | std::ios::binary);
     if (inventory_file) {
         inventory_file << std::setw(2) << json;
-        return true;
+        inventory_file.close();
+
+        std::error_code ec{};
+        if (inventory_file) {
+            std::filesystem::rename(std::filesystem::u8path(tmp_path), std::filesystem::u8path(full_path), ec);
+            if (!ec) return true;
+        }
+
+        PRINT_DEBUG("Couldn't replace file '%s' with the new json", full_path.c_str());
+        std::filesystem::remove(std::filesystem::u8path(tmp_path), ec);
+        reset_LastError();
+        return false;
     }
 
-    PRINT_DEBUG("Couldn't open file '%s' to write json", full_path.c_str());
+    PRINT_DEBUG("Couldn't open file '%s' to write json", tmp_path.c_str());
 
     reset_LastError();
     return false;
@@ -29,6 +29,78 @@ static uint32_t upper_range_ips[MAX_BROADCASTS];
 #define USER_TIMEOUT 20.0
 
 #define MAX_UDP_SIZE 16384
+// max amount of datagrams received or sent with a single call
+#define UDP_BATCH_SIZE 32
+// unreliable packets kept for the next run when the socket's send buffer is full, older ones are dropped past this
+#define MAX_UDP_SEND_BACKLOG 1024
+
+// how long the dedicated I/O thread waits for socket activity before running the timers
+#define IO_THREAD_WAIT_MS 5
+// slots of the ring between the I/O thread and the callbacks, must be a power of 2
+#define RECEIVED_RING_SIZE 2048
+// the I/O thread leaves the data in the sockets once fewer slots than this are free
+// they are kept for the connect/disconnect notifications and what was already taken from a socket
+#define RECEIVED_RING_RESERVE 256
+
+// max amount of pending bytes in each direction of a TCP socket
+#define MAX_TCP_BUFFER_SIZE (64 * 1024 * 1024)
+// don't bother moving the data to the front of a TCP buffer for less than this
+#define MIN_TCP_BUFFER_COMPACT 4096
+// release the memory of an empty TCP buffer if it grew beyond this
+#define MAX_TCP_BUFFER_IDLE_CAPACITY (256 * 1024)
+
+size_t TCP_Buffer::size() const
+{
+    return storage.size() - read_offset;
+}
+
+bool TCP_Buffer::empty() const
+{
+    return size() == 0;
+}
+
+char *TCP_Buffer::data()
+{
+    return storage.data() + read_offset;
+}
+
+const char *TCP_Buffer::data() const
+{
+    return storage.data() + read_offset;
+}
+
+char *TCP_Buffer::append(size_t count)
+{
+    size_t old_size = storage.size();
+    storage.resize(old_size + count);
+    return storage.data() + old_size;
+}
+
+void TCP_Buffer::discard_back(size_t count)
+{
+    storage.resize(storage.size() - std::min(count, size()));
+}
+
+void TCP_Buffer::consume(size_t count)
+{
+    read_offset += std::min(count, size());
+    if (read_offset == storage.size()) {
+        clear();
+    } else if (read_offset >= MIN_TCP_BUFFER_COMPACT && read_offset >= storage.size() / 2) {
+        // the remaining data is smaller than what was consumed, so each byte is moved a bounded number of times
+        storage.erase(storage.begin(), storage.begin() + read_offset);
+        read_offset = 0;
+    }
+}
+
+void TCP_Buffer::clear()
+{
+    storage.clear();
+    read_offset = 0;
+    if (storage.capacity() > MAX_TCP_BUFFER_IDLE_CAPACITY) {
+        storage.shrink_to_fit();
+    }
+}
 
 #if defined(STEAM_WIN32)
 
@@ -327,6 +399,113 @@ static int receive_packet(sock_t sock, IP_PORT *ip_port, char *data, unsigned lo
     return -1;
 }
 
+// receive up to 'max_packets' datagrams, packet i is written at 'data + i * packet_size'
+// returns the number of received packets, 0 if nothing is pending
+static int receive_packets(sock_t sock, char *data, unsigned long packet_size, IP_PORT *ip_ports, int *lengths, int max_packets)
+{
+#if defined(__linux__)
+    struct mmsghdr msgs[UDP_BATCH_SIZE]{};
+    struct iovec iovecs[UDP_BATCH_SIZE]{};
+    struct sockaddr_in addrs[UDP_BATCH_SIZE]{};
+    max_packets = std::min(max_packets, UDP_BATCH_SIZE);
+
+    for (int i = 0; i < max_packets; ++i) {
+        iovecs[i].iov_base = data + i * packet_size;
+        iovecs[i].iov_len = packet_size;
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    }
+
+    int count = recvmmsg(sock, msgs, max_packets, MSG_DONTWAIT, nullptr);
+    if (count <= 0) return 0;
+
+    for (int i = 0; i < count; ++i) {
+        ip_ports[i].ip = addrs[i].sin_addr.s_addr;
+        ip_ports[i].port = addrs[i].sin_port;
+        lengths[i] = static_cast<int>(msgs[i].msg_len);
+    }
+
+    return count;
+#else
+    int count = 0;
+    while (count < max_packets) {
+        int len = receive_packet(sock, &ip_ports[count], data + count * packet_size, packet_size);
+        if (len < 0) break;
+
+        lengths[count] = len;
+        ++count;
+    }
+
+    return count;
+#endif
+}
+
+// send 'count' datagrams, packet i is 'lengths[i]' bytes at 'data[i]'
+// the socket's send buffer is full, the same datagram can be sent later
+static bool send_would_block()
+{
+#if defined(STEAM_WIN32)
+    int err = WSAGetLastError();
+    return WSAEWOULDBLOCK == err || WSAENOBUFS == err;
+#else
+    return EAGAIN == errno || EWOULDBLOCK == errno || ENOBUFS == errno;
+#endif
+}
+
+// returns how many datagrams were handled (sent, or skipped because they failed for good),
+// fewer than count if the socket's send buffer got full, the rest can be sent later
+static size_t send_packets_to(sock_t sock, const IP_PORT *ip_ports, char *const *data, const unsigned long *lengths, size_t count)
+{
+#if defined(__linux__)
+    struct mmsghdr msgs[UDP_BATCH_SIZE]{};
+    struct iovec iovecs[UDP_BATCH_SIZE]{};
+    struct sockaddr_in addrs[UDP_BATCH_SIZE]{};
+
+    for (size_t start = 0; start < count; start += UDP_BATCH_SIZE) {
+        unsigned int batch = static_cast<unsigned int>(std::min(count - start, (size_t)UDP_BATCH_SIZE));
+        for (unsigned int i = 0; i < batch; ++i) {
+            const IP_PORT &ip_port = ip_ports[start + i];
+            PRINT_DEBUG("send: %lu %hhu.%hhu.%hhu.%hhu:%hu", lengths[start + i], ((unsigned char *)&ip_port.ip)[0], ((unsigned char *)&ip_port.ip)[1], ((unsigned char *)&ip_port.ip)[2], ((unsigned char *)&ip_port.ip)[3], htons(ip_port.port));
+            addrs[i].sin_family = AF_INET;
+            addrs[i].sin_addr.s_addr = ip_port.ip;
+            addrs[i].sin_port = ip_port.port;
+            iovecs[i].iov_base = data[start + i];
+            iovecs[i].iov_len = lengths[start + i];
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        }
+
+        // sendmmsg() stops at the first failed datagram, skip it like a failed sendto() would
+        // unless the send buffer is full, then stop here and leave the rest to the caller
+        unsigned int sent = 0;
+        while (sent < batch) {
+            int ret = sendmmsg(sock, &msgs[sent], batch - sent, MSG_NOSIGNAL);
+            if (ret > 0) {
+                sent += ret;
+            } else if (send_would_block()) {
+                return start + sent;
+            } else {
+                ++sent;
+            }
+        }
+    }
+
+    return count;
+#else
+    for (size_t i = 0; i < count; ++i) {
+        if (send_packet_to(sock, ip_ports[i], data[i], lengths[i]) < 0 && send_would_block()) {
+            return i;
+        }
+    }
+
+    return count;
+#endif
+}
+
 static bool send_broadcasts(sock_t sock, uint16 port, char *data, unsigned long length, std::vector<IP_PORT> *custom_broadcasts)
 {
     static std::chrono::high_resolution_clock::time_point last_get_broadcast_info;
@@ -435,20 +614,29 @@ static void send_tcp_pending(struct TCP_Socket &socket)
     size_t buf_size = socket.send_buffer.size();
     if (buf_size == 0) return;
 
-    int len = send(socket.sock, &(socket.send_buffer[0]), static_cast<int>(buf_size), MSG_NOSIGNAL);
+    int len = send(socket.sock, socket.send_buffer.data(), static_cast<int>(buf_size), MSG_NOSIGNAL);
     if (len <= 0) return;
 
-    socket.send_buffer.erase(socket.send_buffer.begin(), socket.send_buffer.begin() + len);
+    socket.send_buffer.consume(len);
 }
 
-static void send_buffer_tcp(struct TCP_Socket &socket, Common_Message *msg)
+static bool send_buffer_tcp(struct TCP_Socket &socket, Common_Message *msg)
 {
-    uint32 size = static_cast<uint32>(msg->ByteSizeLong()), old_size = static_cast<uint32>(socket.send_buffer.size());
-    socket.send_buffer.resize(old_size + sizeof(uint32) + size);
-    memcpy(&(socket.send_buffer[old_size]), &size, sizeof(size));
-    msg->SerializeToArray(&(socket.send_buffer[old_size + sizeof(uint32)]), size);
+    uint32 size = static_cast<uint32>(msg->ByteSizeLong());
+    if (socket.send_buffer.size() + sizeof(uint32) + size > MAX_TCP_BUFFER_SIZE) {
+        // the peer expects every frame in order, drop the connection instead of leaving a gap in the stream
+        // like the receive side, Run() or the peer opens a new one
+        PRINT_DEBUG("TCP send buffer full, killing the connection, message of size %u, pending %zu", size, socket.send_buffer.size());
+        kill_tcp_socket(socket);
+        return false;
+    }
+
+    char *frame = socket.send_buffer.append(sizeof(uint32) + size);
+    memcpy(frame, &size, sizeof(size));
+    msg->SerializeToArray(frame + sizeof(uint32), size);
 
     send_tcp_pending(socket);
+    return true;
 }
 
 static unsigned long peek_buffer_tcp(struct TCP_Socket &socket)
@@ -456,7 +644,7 @@ static unsigned long peek_buffer_tcp(struct TCP_Socket &socket)
     uint32 length;
     if (socket.recv_buffer.size() < sizeof(length)) return 0;
 
-    memcpy(&length, &(socket.recv_buffer[0]), sizeof(length));
+    memcpy(&length, socket.recv_buffer.data(), sizeof(length));
     if (sizeof(length) + length > socket.recv_buffer.size()) return 0;
 
     return length;
@@ -469,25 +657,44 @@ static bool unbuffer_tcp(struct TCP_Socket &socket, Common_Message *msg)
         return false;
     }
 
-    if (msg->ParseFromArray(&(socket.recv_buffer[sizeof(uint32)]), l)) {
-        socket.recv_buffer.erase(socket.recv_buffer.begin(), socket.recv_buffer.begin() + sizeof(l) + l);
+    if (msg->ParseFromArray(socket.recv_buffer.data() + sizeof(uint32), l)) {
+        socket.recv_buffer.consume(sizeof(l) + l);
         return true;
     } else {
-        PRINT_DEBUG("BAD TCP DATA %u %zu %zu %hhu", l, socket.recv_buffer.size(), sizeof(uint32), *((char *)&(socket.recv_buffer[sizeof(uint32)])));
+        PRINT_DEBUG("BAD TCP DATA %u %zu %zu %hhu", l, socket.recv_buffer.size(), sizeof(uint32), *(socket.recv_buffer.data() + sizeof(uint32)));
         kill_tcp_socket(socket);
     }
 
     return false;
 }
 
-static bool recv_tcp(struct TCP_Socket &socket)
+static bool recv_tcp(struct TCP_Socket &socket, bool readiness_known = false)
 {
     if (is_socket_valid(socket.sock)) {
-        unsigned int size = receive_buffer_amount(socket.sock), old_size = static_cast<uint32>(socket.recv_buffer.size());
-        int len;
-        socket.recv_buffer.resize(old_size + size);
+        unsigned int size = receive_buffer_amount(socket.sock);
+        if (size == 0 && readiness_known) {
+            // readable without pending data means the peer closed the connection
+            // otherwise a poller would keep reporting this socket until the heartbeat timeout
+            char c;
+            if (recv(socket.sock, &c, 1, MSG_PEEK | MSG_NOSIGNAL) == 0) {
+                PRINT_DEBUG("TCP SOCKET CLOSED BY PEER");
+                kill_tcp_socket(socket);
+            }
+
+            return false;
+        }
+
         if (size > 0) {
-            len = recv(socket.sock, &(socket.recv_buffer[old_size]), size, MSG_NOSIGNAL);
+            if (socket.recv_buffer.size() + size > MAX_TCP_BUFFER_SIZE) {
+                // a single frame can't be bigger than the buffer, the peer is sending garbage
+                PRINT_DEBUG("TCP receive buffer full, pending %zu", socket.recv_buffer.size());
+                kill_tcp_socket(socket);
+                return false;
+            }
+
+            char *dest = socket.recv_buffer.append(size);
+            int len = recv(socket.sock, dest, size, MSG_NOSIGNAL);
+            socket.recv_buffer.discard_back(size - (len > 0 ? len : 0));
             socket.received_data = true;
             return true;
         }
@@ -512,6 +719,189 @@ static void socket_timeouts(struct TCP_Socket &socket, double extra_time)
     }
 }
 
+// hands all the watched sockets to the OS in a single call on each update
+class Poll_Network_Poller : public Network_Poller
+{
+    std::vector<sock_t> watched{};
+    std::unordered_set<sock_t> ready{};
+
+#if defined(STEAM_WIN32)
+    // select() fails the whole set if any socket in it was closed, check them one by one to find the bad ones
+    void select_one_by_one(size_t start, size_t end, std::vector<sock_t> &closed)
+    {
+        for (size_t i = start; i < end; ++i) {
+            fd_set read_set;
+            FD_ZERO(&read_set);
+            FD_SET(watched[i], &read_set);
+            timeval timeout{};
+            int ret = select(0, &read_set, nullptr, nullptr, &timeout);
+            if (ret == SOCKET_ERROR) {
+                closed.push_back(watched[i]);
+            } else if (ret > 0) {
+                ready.insert(watched[i]);
+            }
+        }
+    }
+#endif
+
+public:
+    void watch(sock_t sock) override
+    {
+        if (std::find(watched.begin(), watched.end(), sock) == watched.end()) {
+            watched.push_back(sock);
+        }
+    }
+
+    void update(int timeout_ms) override
+    {
+        ready.clear();
+        if (watched.empty()) {
+            if (timeout_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+            return;
+        }
+
+        std::vector<sock_t> closed{};
+#if defined(STEAM_WIN32)
+        // select() can only take FD_SETSIZE sockets per call, only the first call waits
+        for (size_t start = 0; start < watched.size(); start += FD_SETSIZE) {
+            size_t end = std::min(watched.size(), start + (size_t)FD_SETSIZE);
+            fd_set read_set;
+            FD_ZERO(&read_set);
+            for (size_t i = start; i < end; ++i) {
+                FD_SET(watched[i], &read_set);
+            }
+
+            timeval timeout{};
+            if (start == 0 && timeout_ms > 0) {
+                timeout.tv_sec = timeout_ms / 1000;
+                timeout.tv_usec = (timeout_ms % 1000) * 1000;
+            }
+
+            if (select(0, &read_set, nullptr, nullptr, &timeout) == SOCKET_ERROR) {
+                select_one_by_one(start, end, closed);
+                continue;
+            }
+
+            for (size_t i = start; i < end; ++i) {
+                if (FD_ISSET(watched[i], &read_set)) ready.insert(watched[i]);
+            }
+        }
+#else
+        std::vector<struct pollfd> fds(watched.size());
+        for (size_t i = 0; i < watched.size(); ++i) {
+            fds[i].fd = watched[i];
+            fds[i].events = POLLIN;
+        }
+
+        if (poll(&fds[0], static_cast<nfds_t>(fds.size()), timeout_ms) <= 0) return;
+
+        for (const auto &fd : fds) {
+            if (fd.revents & POLLNVAL) {
+                closed.push_back(fd.fd);
+            } else if (fd.revents & (POLLIN | POLLHUP | POLLERR)) {
+                ready.insert(fd.fd);
+            }
+        }
+#endif
+
+        for (auto sock : closed) {
+            watched.erase(std::remove(watched.begin(), watched.end(), sock), watched.end());
+        }
+    }
+
+    bool is_ready(sock_t sock) const override
+    {
+        return ready.count(sock) > 0;
+    }
+};
+
+#if defined(__linux__)
+// level-triggered epoll, the kernel only returns the sockets which are readable
+// closing a socket removes it from the epoll set automatically
+class Epoll_Network_Poller : public Network_Poller
+{
+    int epoll_fd = -1;
+    std::vector<struct epoll_event> events = std::vector<struct epoll_event>(64);
+    std::unordered_set<sock_t> ready{};
+
+public:
+    Epoll_Network_Poller()
+    {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    }
+
+    ~Epoll_Network_Poller()
+    {
+        if (epoll_fd >= 0) close(epoll_fd);
+    }
+
+    bool is_valid() const
+    {
+        return epoll_fd >= 0;
+    }
+
+    void watch(sock_t sock) override
+    {
+        struct epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = sock;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &ev) != 0 && errno != EEXIST) {
+            PRINT_DEBUG("epoll_ctl failed for socket %i, error %i", sock, errno);
+        }
+    }
+
+    void update(int timeout_ms) override
+    {
+        ready.clear();
+
+        int count;
+        while ((count = epoll_wait(epoll_fd, &events[0], static_cast<int>(events.size()), timeout_ms)) > 0) {
+            for (int i = 0; i < count; ++i) {
+                ready.insert(events[i].data.fd);
+            }
+
+            // the list was too small, level-triggered events are reported again so just grow and repeat
+            if (static_cast<size_t>(count) < events.size()) break;
+            events.resize(events.size() * 2);
+            timeout_ms = 0;
+        }
+    }
+
+    bool is_ready(sock_t sock) const override
+    {
+        return ready.count(sock) > 0;
+    }
+};
+#endif
+
+static Network_Poller *create_network_poller(Network_IO_Backend io_backend)
+{
+    switch (io_backend) {
+    case Network_IO_Backend::epoll:
+#if defined(__linux__)
+    {
+        auto epoll_poller = new Epoll_Network_Poller();
+        if (epoll_poller->is_valid()) {
+            PRINT_DEBUG("using epoll network backend");
+            return epoll_poller;
+        }
+
+        PRINT_DEBUG("epoll_create1 failed, error %i", errno);
+        delete epoll_poller;
+    }
+#endif
+        [[fallthrough]];
+
+    case Network_IO_Backend::poll:
+        PRINT_DEBUG("using poll network backend");
+        return new Poll_Network_Poller();
+
+    default:
+        PRINT_DEBUG("using sweep network backend");
+        return nullptr;
+    }
+}
+
 std::set<IP_PORT> Networking::resolve_ip(std::string dns)
 {
     run_at_startup();
@@ -564,6 +954,11 @@ void Networking::do_callbacks_message(Common_Message *msg)
         run_callbacks(CALLBACK_ID_LOBBY, msg);
     }
 
+    if (msg->has_lobby_delta()) {
+        PRINT_DEBUG("has_lobby_delta");
+        run_callbacks(CALLBACK_ID_LOBBY, msg);
+    }
+
     if (msg->has_gameserver()) {
         PRINT_DEBUG("has_gameserver");
         run_callbacks(CALLBACK_ID_GAMESERVER, msg);
@@ -625,7 +1020,7 @@ bool Networking::handle_tcp(Common_Message *msg, struct TCP_Socket &socket)
         }
     }
 
-    do_callbacks_message(msg);
+    deliver_message(msg);
     return true;
 }
 
@@ -692,6 +1087,7 @@ bool Networking::handle_announce(Common_Message *msg, IP_PORT ip_port)
     conn->tcp_ip_port = ip_port;
     conn->tcp_ip_port.port = htons(msg->announce().tcp_port());
     conn->appid = msg->announce().appid();
+    conn->features = msg->announce().features();
 
     for (int i = 0; i < msg->announce().ids_size(); ++i) {
         add_id_connection(conn, (uint64) msg->announce().ids(i));
@@ -766,9 +1162,24 @@ bool Networking::handle_low_level_udp(Common_Message *msg, IP_PORT ip_port)
     return false;
 }
 
+void Networking::watch_socket(sock_t sock)
+{
+    if (poller && is_socket_valid(sock)) {
+        poller->watch(sock);
+    }
+}
+
+bool Networking::socket_readable(sock_t sock)
+{
+    // without a poller each socket is queried directly
+    if (!poller) return true;
+
+    return poller->is_ready(sock);
+}
+
 #define NUM_TCP_WAITING 128
 
-Networking::Networking(CSteamID id, uint32 appid, uint16 port, std::set<IP_PORT> *custom_broadcasts, bool disable_sockets)
+Networking::Networking(CSteamID id, uint32 appid, uint16 port, std::set<IP_PORT> *custom_broadcasts, bool disable_sockets, Network_IO_Backend io_backend, bool dedicated_io_thread)
 {
     tcp_port = udp_port = port;
     own_ip = 0x7F000001;
@@ -862,16 +1273,35 @@ Networking::Networking(CSteamID id, uint32 appid, uint16 port, std::set<IP_PORT>
     if (is_socket_valid(udp_socket) && is_socket_valid(tcp_socket)) {
         PRINT_DEBUG("Networking initialized successfully on udp: %u tcp: %u", udp_port, tcp_port);
         enabled = true;
+
+        poller = create_network_poller(io_backend);
+        watch_socket(udp_socket);
+        watch_socket(tcp_socket);
     }
 
     PRINT_DEBUG("ADDED ID %llu", (uint64)id.ConvertToUint64());
     ids.push_back(id);
 
+    if (enabled && dedicated_io_thread) {
+        received_ring.reset(new Received_Message[RECEIVED_RING_SIZE]);
+        for (size_t i = 0; i < RECEIVED_RING_SIZE; ++i) {
+            received_ring[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        io_thread_enabled = true;
+        io_thread = std::thread(&Networking::io_thread_proc, this);
+    }
+
     reset_last_error();
 }
 
 Networking::~Networking()
 {
+    if (io_thread.joinable()) {
+        io_thread_stop = true;
+        io_thread.join();
+    }
+
     for (auto &c : connections) {
         kill_tcp_socket(c.tcp_socket_incoming);
         kill_tcp_socket(c.tcp_socket_outgoing);
@@ -884,6 +1314,11 @@ Networking::~Networking()
     kill_socket(udp_socket);
     kill_socket(tcp_socket);
 
+    if (poller) {
+        delete poller;
+        poller = nullptr;
+    }
+
     curl_global_cleanup();
 }
 
@@ -909,6 +1344,7 @@ Common_Message Networking::create_announce(bool request)
 
     announce->set_tcp_port(tcp_port);
     announce->set_appid(this->appid);
+    announce->set_features(Announce::FEATURE_LOBBY_DELTA);
     for (auto &id : ids) announce->add_ids(id.ConvertToUint64());
     Common_Message msg;
     msg.set_allocated_announce(announce);
@@ -932,7 +1368,195 @@ void Networking::send_announce_broadcasts()
     PRINT_DEBUG("sent broadcasts");
 }
 
+void Networking::deliver_message(Common_Message *msg)
+{
+    if (io_thread_enabled) {
+        queue_received(msg, false);
+    } else {
+        do_callbacks_message(msg);
+    }
+}
+
+bool Networking::queue_received(Common_Message *msg, bool user_status)
+{
+    if (user_status && received_overflow_used.load(std::memory_order_acquire)) {
+        // behind the ones already waiting there, so they're dispatched in order
+        std::lock_guard<std::mutex> lock(received_overflow_mutex);
+        if (!received_overflow.empty()) {
+            received_overflow.emplace_back().Swap(msg);
+            return true;
+        }
+    }
+
+    size_t pos = received_tail.load(std::memory_order_relaxed);
+    while (true) {
+        Received_Message &slot = received_ring[pos & (RECEIVED_RING_SIZE - 1)];
+        intptr_t diff = (intptr_t)slot.sequence.load(std::memory_order_acquire) - (intptr_t)pos;
+        if (diff == 0) {
+            if (received_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                // the slot keeps the previous message's memory, swap instead of allocating a new one
+                slot.msg.Swap(msg);
+                slot.user_status = user_status;
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            // the consumer didn't release this slot since the last lap, the ring is full
+            if (user_status) {
+                // losing a DISCONNECT would keep the peer around forever in the lobbies, P2P and friends
+                std::lock_guard<std::mutex> lock(received_overflow_mutex);
+                received_overflow.emplace_back().Swap(msg);
+                received_overflow_used.store(true, std::memory_order_release);
+                PRINT_DEBUG("received ring full, user status message kept in the overflow list");
+                return true;
+            }
+
+            uint64 dropped = ++received_dropped;
+            PRINT_DEBUG("received ring full, dropping message (%llu dropped so far)", dropped);
+            return false;
+        } else {
+            pos = received_tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool Networking::can_receive() const
+{
+    if (!io_thread_enabled) return true;
+
+    size_t used = received_tail.load(std::memory_order_relaxed) - received_head.load(std::memory_order_acquire);
+    return used + RECEIVED_RING_RESERVE < RECEIVED_RING_SIZE;
+}
+
+void Networking::dispatchReceived()
+{
+    if (!io_thread_enabled || received_dispatching) return;
+
+    // only what's queued now, a game polling in a loop must not be kept here by a busy sender
+    size_t head = received_head.load(std::memory_order_relaxed);
+    size_t end = received_tail.load(std::memory_order_acquire);
+    received_dispatching = true;
+    for (; head != end; ++head) {
+        Received_Message &slot = received_ring[head & (RECEIVED_RING_SIZE - 1)];
+        // claimed but not written yet, it's next in order so stop here
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1) break;
+
+        if (slot.user_status) {
+            run_callbacks(CALLBACK_ID_USER_STATUS, &slot.msg);
+        } else {
+            do_callbacks_message(&slot.msg);
+        }
+
+        slot.msg.Clear();
+        slot.sequence.store(head + RECEIVED_RING_SIZE, std::memory_order_release);
+        received_head.store(head + 1, std::memory_order_release);
+    }
+
+    // queued when the ring was full, after everything that was in it then
+    if (head == end && received_overflow_used.load(std::memory_order_acquire)) {
+        std::deque<Common_Message> overflow{};
+        {
+            std::lock_guard<std::mutex> lock(received_overflow_mutex);
+            overflow.swap(received_overflow);
+            received_overflow_used.store(false, std::memory_order_release);
+        }
+
+        for (auto &msg : overflow) {
+            run_callbacks(CALLBACK_ID_USER_STATUS, &msg);
+        }
+    }
+
+    received_dispatching = false;
+}
+
+void Networking::io_thread_proc()
+{
+    PRINT_DEBUG("network I/O thread started");
+    while (!io_thread_stop) {
+        if (poller && can_receive()) {
+            poller->update(IO_THREAD_WAIT_MS);
+        } else {
+            // no poller with the sweep backend, and while the ring is full the sockets
+            // stay readable since their data is left there, a poller would return right away
+            std::this_thread::sleep_for(std::chrono::milliseconds(IO_THREAD_WAIT_MS));
+        }
+
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        run_query();
+        run_io();
+    }
+    PRINT_DEBUG("network I/O thread stopped");
+}
+
+void Networking::run_query()
+{
+    if (!query_alive || !query_handler || !is_socket_valid(query_socket)) return;
+    if (!socket_readable(query_socket)) return;
+
+    IP_PORT ip_ports[UDP_BATCH_SIZE];
+    int lengths[UDP_BATCH_SIZE];
+    int count;
+
+    // the replies point into the cached responses, keep them alive until they're sent
+    std::vector<std::shared_ptr<const Source_Query::Packets>> responses{};
+    std::vector<IP_PORT> reply_ip_ports{};
+    std::vector<char *> reply_packets{};
+    std::vector<unsigned long> reply_lengths{};
+
+    PRINT_DEBUG("RECV Source Query");
+    if (udp_recv_data.empty()) {
+        udp_recv_data.resize(UDP_BATCH_SIZE * MAX_UDP_SIZE);
+    }
+
+    while ((count = receive_packets(query_socket, &udp_recv_data[0], MAX_UDP_SIZE, ip_ports, lengths, UDP_BATCH_SIZE)) > 0) {
+        for (int i = 0; i < count; ++i) {
+            auto response = query_handler->handle_source_query(&udp_recv_data[i * MAX_UDP_SIZE], lengths[i], ntohl(ip_ports[i].ip));
+            if (!response) continue;
+
+            for (auto &packet : *response) {
+                reply_ip_ports.push_back(ip_ports[i]);
+                reply_packets.push_back((char *)packet.data());
+                reply_lengths.push_back(static_cast<unsigned long>(packet.size()));
+            }
+
+            responses.emplace_back(std::move(response));
+        }
+
+        PRINT_DEBUG("sending %zu Source Query replies", reply_packets.size());
+        size_t sent = send_packets_to(query_socket, reply_ip_ports.data(), reply_packets.data(), reply_lengths.data(), reply_packets.size());
+        if (sent < reply_packets.size()) {
+            // the clients query again when they don't get a reply, no need to keep these
+            uint64 dropped = (udp_send_dropped += reply_packets.size() - sent);
+            PRINT_DEBUG("query socket send buffer full, dropped %zu replies (%llu UDP packets dropped so far)", reply_packets.size() - sent, dropped);
+        }
+        responses.clear();
+        reply_ip_ports.clear();
+        reply_packets.clear();
+        reply_lengths.clear();
+
+        if (count < UDP_BATCH_SIZE) break;
+    }
+}
+
 void Networking::Run()
+{
+    if (io_thread_enabled) {
+        // the I/O thread does the socket work, only deliver what it received
+        dispatchReceived();
+        reset_last_error();
+        return;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (poller) {
+        poller->update(0);
+    }
+
+    run_query();
+    run_io();
+}
+
+void Networking::run_io()
 {
     std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
     double time_extra = std::chrono::duration_cast<std::chrono::duration<double>>(now - last_run).count();
@@ -949,55 +1573,55 @@ void Networking::Run()
     }
 
     IP_PORT ip_port;
-    char data[MAX_UDP_SIZE];
     int len;
 
-    if (query_alive && is_socket_valid(query_socket)) {
-        PRINT_DEBUG("RECV Source Query");
-        Steam_Client* client = get_steam_client();
-        sockaddr_in addr;
-        addr.sin_family = AF_INET;
-
-        while ((len = receive_packet(query_socket, &ip_port, data, sizeof(data))) >= 0) {
-            PRINT_DEBUG("requesting Source Query server info from Steam_GameServer");
-            client->steam_gameserver->HandleIncomingPacket(data, len, htonl(ip_port.ip), htons(ip_port.port));
-            len = client->steam_gameserver->GetNextOutgoingPacket(data, sizeof(data), &ip_port.ip, &ip_port.port);
-
-            PRINT_DEBUG("sending Source Query server info");
-            addr.sin_addr.s_addr = htonl(ip_port.ip);
-            addr.sin_port        = htons(ip_port.port);
-            sendto(query_socket, data, len, 0, (sockaddr*)&addr, sizeof(addr));
-        }
-    }
+    // what didn't fit in the send buffer last time
+    flush_udp_packets();
 
     PRINT_DEBUG("RECV UDP");
-    while((len = receive_packet(udp_socket, &ip_port, data, sizeof(data))) >= 0) {
-        PRINT_DEBUG("recv %i %hhu.%hhu.%hhu.%hhu:%hu", len,
-            ((unsigned char *)&ip_port.ip)[0], ((unsigned char *)&ip_port.ip)[1], ((unsigned char *)&ip_port.ip)[2], ((unsigned char *)&ip_port.ip)[3], htons(ip_port.port));
-        Common_Message msg;
-        if (msg.ParseFromArray(data, len)) {
-            if (msg.source_id()) {
-                if (msg.has_announce()) {
-                    handle_announce(&msg, ip_port);
-                } else if (msg.has_low_level()) {
-                    handle_low_level_udp(&msg, ip_port);
-                } else {
-                    msg.set_source_ip(ntohl(ip_port.ip));
-                    msg.set_source_port(ntohs(ip_port.port));
-                    do_callbacks_message(&msg);
+    if (udp_recv_data.empty()) {
+        udp_recv_data.resize(UDP_BATCH_SIZE * MAX_UDP_SIZE);
+    }
+
+    IP_PORT udp_ip_ports[UDP_BATCH_SIZE];
+    int udp_lengths[UDP_BATCH_SIZE];
+    int udp_count = 0;
+    while (can_receive() && socket_readable(udp_socket) && (udp_count = receive_packets(udp_socket, &udp_recv_data[0], MAX_UDP_SIZE, udp_ip_ports, udp_lengths, UDP_BATCH_SIZE)) > 0) {
+        for (int i = 0; i < udp_count; ++i) {
+            ip_port = udp_ip_ports[i];
+            len = udp_lengths[i];
+            PRINT_DEBUG("recv %i %hhu.%hhu.%hhu.%hhu:%hu", len,
+                ((unsigned char *)&ip_port.ip)[0], ((unsigned char *)&ip_port.ip)[1], ((unsigned char *)&ip_port.ip)[2], ((unsigned char *)&ip_port.ip)[3], htons(ip_port.port));
+            Common_Message msg;
+            if (msg.ParseFromArray(&udp_recv_data[i * MAX_UDP_SIZE], len)) {
+                if (msg.source_id()) {
+                    if (msg.has_announce()) {
+                        handle_announce(&msg, ip_port);
+                    } else if (msg.has_low_level()) {
+                        handle_low_level_udp(&msg, ip_port);
+                    } else {
+                        msg.set_source_ip(ntohl(ip_port.ip));
+                        msg.set_source_port(ntohs(ip_port.port));
+                        deliver_message(&msg);
+                    }
                 }
             }
         }
+
+        // a partial batch means the socket was drained
+        if (udp_count < UDP_BATCH_SIZE) break;
     }
 
     PRINT_DEBUG("RECV LOCAL %zu", local_send.size());
-    std::vector<Common_Message> local_send_copy = local_send;
-    local_send.clear();
+    std::vector<Common_Message> local_send_copy{};
+    if (can_receive()) {
+        local_send_copy.swap(local_send);
+    }
 
     for (auto & m: local_send_copy) {
         m.set_source_ip(ntohl(own_ip));
         m.set_source_port(ntohs(udp_port));
-        do_callbacks_message(&m);
+        deliver_message(&m);
     }
 
     struct sockaddr_storage addr;
@@ -1008,7 +1632,7 @@ void Networking::Run()
 #endif
     sock_t sock;
     PRINT_DEBUG("ACCEPTING");
-    while (is_socket_valid(sock = static_cast<sock_t>(accept(tcp_socket, (struct sockaddr *)&addr, &addrlen)))) {
+    while (socket_readable(tcp_socket) && is_socket_valid(sock = static_cast<sock_t>(accept(tcp_socket, (struct sockaddr *)&addr, &addrlen)))) {
         PRINT_DEBUG("ACCEPT SOCKET %u", sock);
         struct sockaddr_storage addr;
     #if defined(STEAM_WIN32)
@@ -1026,6 +1650,7 @@ void Networking::Run()
             socket.sock = sock;
             socket.received_data = true;
             socket.last_heartbeat_received = std::chrono::high_resolution_clock::now();
+            watch_socket(sock);
             accepted.push_back(socket);
             PRINT_DEBUG("TCP ACCEPTED %u", sock);
         }
@@ -1035,7 +1660,7 @@ void Networking::Run()
     auto conn = std::begin(accepted);
     while (conn != std::end(accepted)) {
         bool deleted = false;
-        recv_tcp(*conn);
+        if (socket_readable(conn->sock)) recv_tcp(*conn, poller != nullptr);
         Common_Message msg;
         if (unbuffer_tcp(*conn, &msg)) {
             if (msg.source_id()) {
@@ -1078,6 +1703,7 @@ void Networking::Run()
                 PRINT_DEBUG("NEW SOCKET %u %u", sock, conn.tcp_socket_outgoing.sock);
                 disable_nagle(sock);
                 connect_socket(sock, conn.tcp_ip_port);
+                watch_socket(sock);
                 conn.tcp_socket_outgoing.sock = sock;
                 conn.tcp_socket_outgoing.last_heartbeat_received = std::chrono::high_resolution_clock::now();
                 Common_Message msg;
@@ -1087,8 +1713,10 @@ void Networking::Run()
         }
 
         PRINT_DEBUG("RUN SOCKET1 %u %u", conn.tcp_socket_outgoing.sock, conn.tcp_socket_incoming.sock);
-        recv_tcp(conn.tcp_socket_outgoing);
-        recv_tcp(conn.tcp_socket_incoming);
+        // when the ring is nearly full the data waits in the socket, TCP slows the sender down
+        bool receive = can_receive();
+        if (receive && socket_readable(conn.tcp_socket_outgoing.sock)) recv_tcp(conn.tcp_socket_outgoing, poller != nullptr);
+        if (receive && socket_readable(conn.tcp_socket_incoming.sock)) recv_tcp(conn.tcp_socket_incoming, poller != nullptr);
 
         if (conn.tcp_socket_incoming.received_data || conn.tcp_socket_outgoing.received_data) {
             if (!conn.connected) {
@@ -1120,14 +1748,14 @@ void Networking::Run()
 
         PRINT_DEBUG("RUN SOCKET3 %u %u", conn.tcp_socket_outgoing.sock, conn.tcp_socket_incoming.sock);
         Common_Message msg;
-        while (unbuffer_tcp(conn.tcp_socket_outgoing, &msg)) {
+        while (can_receive() && unbuffer_tcp(conn.tcp_socket_outgoing, &msg)) {
             PRINT_DEBUG("UNBUFFER SOCKET");
             msg.set_source_ip(ntohl(conn.tcp_ip_port.ip)); //TODO: get from tcp socket
             handle_tcp(&msg, conn.tcp_socket_outgoing);
             conn.last_received = std::chrono::high_resolution_clock::now();
         }
 
-        while (unbuffer_tcp(conn.tcp_socket_incoming, &msg)) {
+        while (can_receive() && unbuffer_tcp(conn.tcp_socket_incoming, &msg)) {
             PRINT_DEBUG("UNBUFFER SOCKET");
             msg.set_source_ip(ntohl(conn.tcp_ip_port.ip)); //TODO: get from tcp socket
             handle_tcp(&msg, conn.tcp_socket_incoming);
@@ -1168,6 +1796,7 @@ void Networking::Run()
 void Networking::addListenId(CSteamID id)
 {
     if (!enabled) return;
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     auto i = std::find(ids.begin(), ids.end(), id);
     if (i != ids.end()) {
         return;
@@ -1181,15 +1810,18 @@ void Networking::addListenId(CSteamID id)
 
 void Networking::setAppID(uint32 appid)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     this->appid = appid;
 }
 
 bool Networking::sendToIPPort(Common_Message *msg, uint32 ip, uint16 port, bool reliable)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     bool is_local_ip = ((ip >> 24) == 0x7F);
     uint32_t local_ip = getIP(ids.front());
     PRINT_DEBUG("%X %u %X", ip, is_local_ip, local_ip);
     //TODO: actually send to ip/port
+    udp_batching = true;
     for (auto &conn: connections) {
         if (ntohl(conn.tcp_ip_port.ip) == ip || (is_local_ip && ntohl(conn.tcp_ip_port.ip) == local_ip)) {
             for (auto &steam_id : conn.ids) {
@@ -1199,11 +1831,14 @@ bool Networking::sendToIPPort(Common_Message *msg, uint32 ip, uint16 port, bool
         }
     }
 
+    udp_batching = false;
+    flush_udp_packets();
     return true;
 }
 
 uint32 Networking::getIP(CSteamID id)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     Connection *conn = find_connection(id, this->appid);
     if (conn) {
         return ntohl(conn->tcp_ip_port.ip);
@@ -1212,9 +1847,71 @@ uint32 Networking::getIP(CSteamID id)
     return 0;
 }
 
+size_t Networking::getPendingSendBytes(CSteamID id)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    Connection *conn = find_connection(id, this->appid);
+    if (conn) {
+        return conn->tcp_socket_outgoing.send_buffer.size() + conn->tcp_socket_incoming.send_buffer.size();
+    }
+
+    return 0;
+}
+
+void Networking::queue_udp_packet(IP_PORT ip_port, Common_Message *msg, size_t size)
+{
+    size_t offset = udp_send_data.size();
+    udp_send_data.resize(offset + size);
+    msg->SerializeToArray(&udp_send_data[offset], static_cast<int>(size));
+    udp_send_offsets.push_back(offset);
+    udp_send_ip_ports.push_back(ip_port);
+}
+
+void Networking::flush_udp_packets()
+{
+    if (udp_send_offsets.empty()) return;
+
+    // the storage won't move anymore, build the list of packets
+    size_t count = udp_send_offsets.size();
+    udp_send_packets.resize(count);
+    udp_send_lengths.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        size_t end = (i + 1 < count) ? udp_send_offsets[i + 1] : udp_send_data.size();
+        udp_send_packets[i] = &udp_send_data[udp_send_offsets[i]];
+        udp_send_lengths[i] = static_cast<unsigned long>(end - udp_send_offsets[i]);
+    }
+
+    size_t sent = send_packets_to(udp_socket, &udp_send_ip_ports[0], &udp_send_packets[0], &udp_send_lengths[0], count);
+    if (sent < count) {
+        // the send buffer is full, keep the unsent tail for the next flush, but not forever
+        size_t keep_from = sent;
+        if (count - keep_from > MAX_UDP_SEND_BACKLOG) {
+            keep_from = count - MAX_UDP_SEND_BACKLOG;
+            uint64 dropped = (udp_send_dropped += keep_from - sent);
+            PRINT_DEBUG("UDP send backlog full, dropped %zu packets (%llu dropped so far)", keep_from - sent, dropped);
+        }
+
+        PRINT_DEBUG("UDP send buffer full, %zu packets left for later", count - keep_from);
+        size_t data_start = udp_send_offsets[keep_from];
+        udp_send_data.erase(udp_send_data.begin(), udp_send_data.begin() + data_start);
+        udp_send_offsets.erase(udp_send_offsets.begin(), udp_send_offsets.begin() + keep_from);
+        udp_send_ip_ports.erase(udp_send_ip_ports.begin(), udp_send_ip_ports.begin() + keep_from);
+        for (auto &offset : udp_send_offsets) {
+            offset -= data_start;
+        }
+        return;
+    }
+
+    // keep the capacity for the next packets
+    udp_send_data.clear();
+    udp_send_offsets.clear();
+    udp_send_ip_ports.clear();
+}
+
 bool Networking::sendTo(Common_Message *msg, bool reliable, Connection *conn)
 {
     if (!enabled) return false;
+    std::lock_guard<std::recursive_mutex> lock(mutex);
 
     size_t size = msg->ByteSizeLong();
     if (size >= MAX_UDP_SIZE) reliable = true; //too big for UDP
@@ -1237,16 +1934,13 @@ bool Networking::sendTo(Common_Message *msg, bool reliable, Connection *conn)
     if (!ret && conn) {
         if (reliable || !conn->udp_pinged) {
             if (conn->tcp_socket_incoming.received_data) {
-                send_buffer_tcp(conn->tcp_socket_incoming, msg);
-                ret = true;
+                ret = send_buffer_tcp(conn->tcp_socket_incoming, msg);
             } else if (conn->tcp_socket_outgoing.received_data) {
-                send_buffer_tcp(conn->tcp_socket_outgoing, msg);
-                ret = true;
+                ret = send_buffer_tcp(conn->tcp_socket_outgoing, msg);
             }
         } else {
-            std::vector<char> buffer(size, 0);
-            msg->SerializeToArray(&buffer[0], static_cast<int>(size));
-            send_packet_to(udp_socket, conn->udp_ip_port, &buffer[0], static_cast<unsigned long>(size));
+            queue_udp_packet(conn->udp_ip_port, msg, size);
+            if (!udp_batching) flush_udp_packets();
             ret = true;
         }
     }
@@ -1255,22 +1949,31 @@ bool Networking::sendTo(Common_Message *msg, bool reliable, Connection *conn)
     return ret;
 }
 
-bool Networking::sendToAllIndividuals(Common_Message *msg, bool reliable)
+bool Networking::sendToAllIndividuals(Common_Message *msg, bool reliable, uint32 features, Common_Message *fallback)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    udp_batching = true;
     for (auto &conn: connections) {
+        Common_Message *conn_msg = (conn.features & features) == features ? msg : fallback;
+        if (!conn_msg) continue;
+
         for (auto &steam_id : conn.ids) {
             if (steam_id.BIndividualAccount()) {
-                msg->set_dest_id(steam_id.ConvertToUint64());
-                sendTo(msg, reliable, &conn);
+                conn_msg->set_dest_id(steam_id.ConvertToUint64());
+                sendTo(conn_msg, reliable, &conn);
             }
         }
     }
 
+    udp_batching = false;
+    flush_udp_packets();
     return true;
 }
 
 bool Networking::sendToAllGameservers(Common_Message *msg, bool reliable)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    udp_batching = true;
     for (auto &conn: connections) {
         for (auto &steam_id : conn.ids) {
             if (steam_id.BGameServerAccount()) {
@@ -1280,11 +1983,15 @@ bool Networking::sendToAllGameservers(Common_Message *msg, bool reliable)
         }
     }
 
+    udp_batching = false;
+    flush_udp_packets();
     return true;
 }
 
 bool Networking::sendToAll(Common_Message *msg, bool reliable)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    udp_batching = true;
     for (auto &conn: connections) {
         for (auto &steam_id : conn.ids) {
             msg->set_dest_id(steam_id.ConvertToUint64());
@@ -1292,6 +1999,8 @@ bool Networking::sendToAll(Common_Message *msg, bool reliable)
         }
     }
 
+    udp_batching = false;
+    flush_udp_packets();
     return true;
 }
 
@@ -1322,6 +2031,11 @@ void Networking::run_callback_user(CSteamID steam_id, bool online, uint32 appid)
         msg.mutable_low_level()->set_type(Low_Level::DISCONNECT);
     }
 
+    if (io_thread_enabled) {
+        queue_received(&msg, true);
+        return;
+    }
+
     run_callbacks(CALLBACK_ID_USER_STATUS, &msg);
 }
 
@@ -1358,14 +2072,18 @@ void Networking::rmCallback(Callback_Ids id, CSteamID steam_id, void (*message_c
 
 uint32 Networking::getOwnIP()
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     return own_ip;
 }
 
-void Networking::startQuery(IP_PORT ip_port)
+void Networking::startQuery(IP_PORT ip_port, Source_Query *handler)
 {
     if (ip_port.port <= 1024)
         return;
 
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    query_handler = handler;
+
     if (!query_alive)
     {
         if (ip_port.port == MASTERSERVERUPDATERPORT_USEGAMESOCKETSHARE)
@@ -1401,6 +2119,7 @@ void Networking::startQuery(IP_PORT ip_port)
             if (res == 0)
             {
                 set_socket_nonblocking(query_socket);
+                watch_socket(query_socket);
                 break;
             }
 
@@ -1423,8 +2142,14 @@ void Networking::startQuery(IP_PORT ip_port)
 
 void Networking::shutDownQuery()
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     query_alive = false;
-    kill_socket(query_socket);
+    // the handler belongs to the game server, which might be deleted right after this
+    query_handler = nullptr;
+    if (is_socket_valid(query_socket)) {
+        kill_socket(query_socket);
+        query_socket = static_cast<sock_t>(-1);
+    }
 }
 
 bool Networking::isQueryAlive()
@@ -0,0 +1,203 @@
+/* Copyright (C) 2019 Mr Goldberg
+   This file is part of the Goldberg Emulator
+
+   The Goldberg Emulator is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   The Goldberg Emulator is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the Goldberg Emulator; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include "dll/networking_message.h"
+
+// released message objects kept around for reuse
+#define MESSAGE_POOL_MAX_FREE 256
+
+// payload buffers for AllocateMessage() come in power of 2 sizes starting at 1 << PAYLOAD_SLAB_MIN_SHIFT
+#define PAYLOAD_SLAB_MIN_SHIFT 8
+// no pooling above 1 << (PAYLOAD_SLAB_MIN_SHIFT + PAYLOAD_SLAB_CLASSES - 1) bytes (64 KiB)
+#define PAYLOAD_SLAB_CLASSES 9
+// free buffers kept per size class
+#define PAYLOAD_SLAB_MAX_FREE 64
+
+struct Owned_Networking_Message : public SteamNetworkingMessage_t {
+    std::string payload{}; // received data, moved in from the network
+    char *slab{}; // buffer for AllocateMessage()
+    int slab_class = -1; // -1 if the slab is too big for the pool
+    size_t payload_bytes{}; // accounted in bytes_outstanding
+};
+
+// message objects and payloads are released on whatever thread the game calls Release() from
+static std::mutex pool_mutex{};
+static std::vector<Owned_Networking_Message *> free_messages{};
+static std::vector<char *> free_slabs[PAYLOAD_SLAB_CLASSES]{};
+
+static std::atomic<uint64> messages_allocated{};
+static std::atomic<uint64> messages_released{};
+static std::atomic<uint64> payloads_moved{};
+static std::atomic<uint64> payloads_copied{};
+static std::atomic<uint64> payloads_allocated{};
+static std::atomic<uint64> pool_hits{};
+static std::atomic<uint64> pool_misses{};
+static std::atomic<uint64> bytes_outstanding{};
+
+static int slab_class_for(size_t size)
+{
+    for (int i = 0; i < PAYLOAD_SLAB_CLASSES; ++i) {
+        if (size <= ((size_t)1 << (PAYLOAD_SLAB_MIN_SHIFT + i))) return i;
+    }
+
+    return -1;
+}
+
+static void free_slab(char *slab, int slab_class)
+{
+    if (slab_class >= 0) {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        auto &pool = free_slabs[slab_class];
+        if (pool.size() < PAYLOAD_SLAB_MAX_FREE) {
+            pool.push_back(slab);
+            return;
+        }
+    }
+
+    delete[] slab;
+}
+
+static void free_owned_message_data(SteamNetworkingMessage_t *pMsg)
+{
+    Owned_Networking_Message *msg = static_cast<Owned_Networking_Message *>(pMsg);
+    // release the memory, clear() alone keeps the capacity
+    std::string().swap(msg->payload);
+    if (msg->slab) {
+        free_slab(msg->slab, msg->slab_class);
+        msg->slab = nullptr;
+        msg->slab_class = -1;
+    }
+
+    bytes_outstanding -= msg->payload_bytes;
+    msg->payload_bytes = 0;
+    msg->m_pData = nullptr;
+}
+
+static void release_owned_message(SteamNetworkingMessage_t *pMsg)
+{
+    // the game is allowed to replace the buffer and the free function
+    if (pMsg->m_pfnFreeData) pMsg->m_pfnFreeData(pMsg);
+
+    Owned_Networking_Message *msg = static_cast<Owned_Networking_Message *>(pMsg);
+    // our own buffers are still ours even if the game swapped in another one
+    if (msg->payload_bytes) free_owned_message_data(msg);
+    ++messages_released;
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (free_messages.size() < MESSAGE_POOL_MAX_FREE) {
+            free_messages.push_back(msg);
+            return;
+        }
+    }
+
+    delete msg;
+}
+
+static Owned_Networking_Message *new_owned_message()
+{
+    Owned_Networking_Message *msg = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (free_messages.size()) {
+            msg = free_messages.back();
+            free_messages.pop_back();
+        }
+    }
+
+    if (msg) {
+        // same state as a freshly created one
+        static_cast<SteamNetworkingMessage_t &>(*msg) = SteamNetworkingMessage_t{};
+        ++pool_hits;
+    } else {
+        msg = new Owned_Networking_Message();
+        ++pool_misses;
+    }
+
+    msg->m_pfnFreeData = &free_owned_message_data;
+    msg->m_pfnRelease = &release_owned_message;
+    ++messages_allocated;
+    return msg;
+}
+
+SteamNetworkingMessage_t *new_networking_message(std::string &&payload)
+{
+    Owned_Networking_Message *msg = new_owned_message();
+    const char *source = payload.data();
+    msg->payload = std::move(payload);
+    msg->m_pData = msg->payload.empty() ? nullptr : &msg->payload[0];
+    msg->m_cbSize = static_cast<int>(msg->payload.size());
+    msg->payload_bytes = msg->payload.size();
+    bytes_outstanding += msg->payload_bytes;
+    // the buffer only stays the same if it was really moved
+    if (msg->payload.empty() || msg->payload.data() == source) {
+        ++payloads_moved;
+    } else {
+        ++payloads_copied;
+    }
+    return msg;
+}
+
+SteamNetworkingMessage_t *new_networking_message(size_t size)
+{
+    Owned_Networking_Message *msg = new_owned_message();
+    if (size) {
+        int slab_class = slab_class_for(size);
+        char *slab = nullptr;
+        if (slab_class >= 0) {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            auto &pool = free_slabs[slab_class];
+            if (pool.size()) {
+                slab = pool.back();
+                pool.pop_back();
+            }
+        }
+
+        if (slab) {
+            ++pool_hits;
+        } else {
+            slab = new char[slab_class >= 0 ? ((size_t)1 << (PAYLOAD_SLAB_MIN_SHIFT + slab_class)) : size];
+            ++pool_misses;
+        }
+
+        // AllocateMessage() hands out zeroed memory
+        memset(slab, 0, size);
+        msg->slab = slab;
+        msg->slab_class = slab_class;
+        msg->m_pData = slab;
+        msg->payload_bytes = size;
+        bytes_outstanding += size;
+        ++payloads_allocated;
+    }
+
+    msg->m_cbSize = static_cast<int>(size);
+    return msg;
+}
+
+Networking_Message_Stats get_networking_message_stats()
+{
+    Networking_Message_Stats stats{};
+    stats.allocated = messages_allocated;
+    stats.released = messages_released;
+    stats.payloads_moved = payloads_moved;
+    stats.payloads_copied = payloads_copied;
+    stats.payloads_allocated = payloads_allocated;
+    stats.pool_hits = pool_hits;
+    stats.pool_misses = pool_misses;
+    stats.bytes_outstanding = bytes_outstanding;
+    return stats;
+}
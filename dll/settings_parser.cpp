@@ -1453,6 +1453,46 @@ static void parse_steam_game_stats_reports_dir(class Settings *settings_client,
     }
 }
 
+// main::connectivity::steamhttp_base_url_override
+static void parse_steamhttp_base_url_override(class Settings *settings_client, class Settings *settings_server)
+{
+    std::string line(common_helpers::string_strip(ini.GetValue("main::connectivity", "steamhttp_base_url_override", "")));
+    if (line.empty()) return;
+
+    std::string scheme(common_helpers::to_lower(line.substr(0, line.find("://"))));
+    if (line.find("://") == std::string::npos || (scheme != "http" && scheme != "https")) {
+        PRINT_DEBUG("ignoring invalid steamhttp base url override '%s', it must start with http:// or https://", line.c_str());
+        return;
+    }
+
+    // the path of each request is appended as is, it already starts with '/'
+    while (line.size() && line.back() == '/') line.pop_back();
+
+    PRINT_DEBUG("online steamhttp requests will be sent to '%s'", line.c_str());
+    settings_client->steamhttp_base_url_override = line;
+    settings_server->steamhttp_base_url_override = line;
+}
+
+// main::connectivity::network_io_backend
+static void parse_network_io_backend(class Settings *settings_client, class Settings *settings_server)
+{
+    std::string line(common_helpers::to_lower(common_helpers::string_strip(ini.GetValue("main::connectivity", "network_io_backend", ""))));
+    if (line.empty()) return;
+
+    Network_IO_Backend backend = Network_IO_Backend::sweep;
+    if (line == "poll") {
+        backend = Network_IO_Backend::poll;
+    } else if (line == "epoll") {
+        backend = Network_IO_Backend::epoll;
+    } else if (line != "sweep") {
+        PRINT_DEBUG("unknown network io backend '%s', using 'sweep'", line.c_str());
+    }
+
+    PRINT_DEBUG("network io backend: '%s'", line.c_str());
+    settings_client->network_io_backend = backend;
+    settings_server->network_io_backend = backend;
+}
+
 // mainly enable/disable features
 static void parse_simple_features(class Settings *settings_client, class Settings *settings_server)
 {
@@ -1472,6 +1512,14 @@ static void parse_simple_features(class Settings *settings_client, class Setting
     settings_client->immediate_gameserver_stats = ini.GetBoolValue("main::general", "immediate_gameserver_stats", settings_client->immediate_gameserver_stats);
     settings_server->immediate_gameserver_stats = ini.GetBoolValue("main::general", "immediate_gameserver_stats", settings_server->immediate_gameserver_stats);
 
+    {
+        long val_client = ini.GetLongValue("main::general", "gameserver_stats_sync_interval_ms", settings_client->gameserver_stats_sync_interval_ms);
+        settings_client->gameserver_stats_sync_interval_ms = static_cast<int>(std::max(val_client, 0L));
+
+        long val_server = ini.GetLongValue("main::general", "gameserver_stats_sync_interval_ms", settings_server->gameserver_stats_sync_interval_ms);
+        settings_server->gameserver_stats_sync_interval_ms = static_cast<int>(std::max(val_server, 0L));
+    }
+
     settings_client->matchmaking_server_details_via_source_query = ini.GetBoolValue("main::general", "matchmaking_server_details_via_source_query", settings_client->matchmaking_server_details_via_source_query);
     settings_server->matchmaking_server_details_via_source_query = ini.GetBoolValue("main::general", "matchmaking_server_details_via_source_query", settings_server->matchmaking_server_details_via_source_query);
 
@@ -1483,6 +1531,9 @@ static void parse_simple_features(class Settings *settings_client, class Setting
     settings_client->disable_networking = ini.GetBoolValue("main::connectivity", "disable_networking", settings_client->disable_networking);
     settings_server->disable_networking = ini.GetBoolValue("main::connectivity", "disable_networking", settings_server->disable_networking);
 
+    settings_client->network_io_thread = ini.GetBoolValue("main::connectivity", "network_io_thread", settings_client->network_io_thread);
+    settings_server->network_io_thread = ini.GetBoolValue("main::connectivity", "network_io_thread", settings_server->network_io_thread);
+
     settings_client->disable_sharing_stats_with_gameserver = ini.GetBoolValue("main::connectivity", "disable_sharing_stats_with_gameserver", settings_client->disable_sharing_stats_with_gameserver);
     settings_server->disable_sharing_stats_with_gameserver = ini.GetBoolValue("main::connectivity", "disable_sharing_stats_with_gameserver", settings_server->disable_sharing_stats_with_gameserver);
     
@@ -1816,6 +1867,8 @@ uint32 create_localstorage_settings(Settings **settings_client_out, Settings **s
     parse_overlay_general_config(settings_client, settings_server);
     load_overlay_appearance(settings_client, settings_server, local_storage);
     parse_steam_game_stats_reports_dir(settings_client, settings_server);
+    parse_network_io_backend(settings_client, settings_server);
+    parse_steamhttp_base_url_override(settings_client, settings_server);
 
     *settings_client_out = settings_client;
     *settings_server_out = settings_server;
@@ -20,7 +20,7 @@
 
 enum class source_query_magic : uint32_t {
     simple = 0xFFFFFFFFul,
-    multi  = 0xFFFFFFFEul, // <--- TODO ?
+    multi  = 0xFFFFFFFEul,
 };
 
 enum class source_query_header : uint8_t {
@@ -68,6 +68,13 @@ enum source_server_extra_flag : uint8_t {
     port      = 0x80,
 };
 
+// responses bigger than this are split, same limits as the Source engine
+#define SOURCE_QUERY_MAX_PACKET_SIZE 1400
+#define SOURCE_QUERY_SPLIT_PAYLOAD_SIZE 1248
+// the player list carries the time each player has been connected
+#define SOURCE_QUERY_PLAYERS_CACHE_MS 1000
+#define SOURCE_QUERY_CHALLENGE_ROTATE_SECONDS 30
+
 #if defined(STEAM_WIN32)
 static constexpr const source_server_env my_server_env = source_server_env::windows_os;
 #else
@@ -123,32 +130,139 @@ void serialize_response(std::vector <uint8_t>& buffer, char(&str)[N])
     serialize_response(buffer, reinterpret_cast<uint8_t const*>(str), N);
 }
 
-void get_challenge(std::vector<uint8_t> &challenge_buff)
+void get_challenge(std::vector<uint8_t> &challenge_buff, uint32_t challenge)
 {
-    // TODO: generate the challenge id
     serialize_response(challenge_buff, source_query_magic::simple);
     serialize_response(challenge_buff, source_response_header::A2S_CHALLENGE);
-    serialize_response(challenge_buff, static_cast<uint32_t>(0x00112233ul));
+    serialize_response(challenge_buff, challenge);
+}
+
+Source_Query::Source_Query()
+{
+    randombytes((char *)challenge_secret, sizeof(challenge_secret));
+    randombytes((char *)&split_response_id, sizeof(split_response_id));
+    challenge_rotated = std::chrono::steady_clock::now();
+}
+
+uint32_t Source_Query::make_challenge(uint32_t ip, uint32_t secret) const
+{
+    // splitmix64 finalizer, only has to be unpredictable without the secret
+    uint64_t x = (static_cast<uint64_t>(secret) << 32) | ip;
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+
+    uint32_t challenge = static_cast<uint32_t>(x);
+    // -1 is how clients ask for a challenge
+    if (challenge == 0xFFFFFFFFul) challenge = 0;
+    return challenge;
 }
 
-std::vector<uint8_t> Source_Query::handle_source_query(const void* buffer, size_t len, Gameserver const& gs)
+uint32_t Source_Query::current_challenge(uint32_t ip)
 {
-    std::vector<uint8_t> output_buffer{};
+    auto now = std::chrono::steady_clock::now();
+    if (now - challenge_rotated >= std::chrono::seconds(SOURCE_QUERY_CHALLENGE_ROTATE_SECONDS)) {
+        challenge_secret[1] = challenge_secret[0];
+        randombytes((char *)&challenge_secret[0], sizeof(challenge_secret[0]));
+        challenge_rotated = now;
+    }
+
+    return make_challenge(ip, challenge_secret[0]);
+}
 
+bool Source_Query::check_challenge(uint32_t ip, uint32_t challenge)
+{
+    return challenge == current_challenge(ip) || challenge == make_challenge(ip, challenge_secret[1]);
+}
+
+void Source_Query::store_response(Cached_Response &cache, uint32_t generation, std::vector<uint8_t> &&response)
+{
+    auto packets = std::make_shared<Packets>();
+    cache.packets = packets;
+    cache.generation = generation;
+    cache.built = std::chrono::steady_clock::now();
+    cache.valid = true;
+
+    if (response.size() <= SOURCE_QUERY_MAX_PACKET_SIZE) {
+        packets->emplace_back(std::move(response));
+        return;
+    }
+
+    size_t total = (response.size() + SOURCE_QUERY_SPLIT_PAYLOAD_SIZE - 1) / SOURCE_QUERY_SPLIT_PAYLOAD_SIZE;
+    if (total > 0xFF) {
+        PRINT_DEBUG("response of %zu bytes is too big to be split, dropping it", response.size());
+        return;
+    }
+
+    // the high bit of the id would mean the payload is bz2 compressed
+    uint32_t id = (split_response_id++) & 0x7FFFFFFFul;
+    for (size_t i = 0; i < total; ++i) {
+        size_t offset = i * SOURCE_QUERY_SPLIT_PAYLOAD_SIZE;
+        size_t size = std::min<size_t>(SOURCE_QUERY_SPLIT_PAYLOAD_SIZE, response.size() - offset);
+
+        auto &packet = packets->emplace_back();
+        packet.reserve(12 + size);
+        serialize_response(packet, source_query_magic::multi);
+        serialize_response(packet, id);
+        serialize_response(packet, static_cast<uint8_t>(total));
+        serialize_response(packet, static_cast<uint8_t>(i));
+        serialize_response(packet, static_cast<uint16_t>(SOURCE_QUERY_SPLIT_PAYLOAD_SIZE));
+        serialize_response(packet, response.data() + offset, size);
+    }
+
+    PRINT_DEBUG("split response of %zu bytes into %zu packets", response.size(), total);
+}
+
+void Source_Query::set_state(std::shared_ptr<Source_Query_State> new_state, uint8_t changed)
+{
+    if (changed & Cached_Response_Type::info) ++generation[0];
+    if (changed & Cached_Response_Type::players) ++generation[1];
+    if (changed & Cached_Response_Type::rules) ++generation[2];
+    std::copy(std::begin(generation), std::end(generation), std::begin(new_state->generation));
+
+    std::atomic_store(&state, std::shared_ptr<const Source_Query_State>(std::move(new_state)));
+}
+
+std::shared_ptr<const Source_Query::Packets> Source_Query::handle_source_query(const void* buffer, size_t len, uint32_t src_ip)
+{
     if (len < source_query_header_size) // its not at least 5 bytes long (0xFF 0xFF 0xFF 0xFF 0x??)
-        return output_buffer;
+        return nullptr;
 
-    source_query_data const& query = *reinterpret_cast<source_query_data const*>(buffer);
+    source_query_data query{};
+    memcpy(&query, buffer, std::min(len, sizeof(query)));
 
+    auto current_state = std::atomic_load(&state);
     // || gs.max_player_count() == 0
-    if (gs.offline() || query.magic != source_query_magic::simple) return output_buffer;
+    if (!current_state || current_state->server.offline() || query.magic != source_query_magic::simple) return nullptr;
+
+    Gameserver const& gs = current_state->server;
+    auto const& players = current_state->players;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    // challenge replies depend on the source so they are never cached
+    auto reply_challenge = [&]() {
+        auto packets = std::make_shared<Packets>(1);
+        get_challenge((*packets)[0], current_challenge(src_ip));
+        return packets;
+    };
 
     switch (query.header)
     {
     case source_query_header::A2S_INFO: {
         PRINT_DEBUG("got request for server info");
-        if (len >= a2s_query_info_size && !strncmp(query.a2s_info_payload, a2s_info_payload, a2s_info_payload_size)) {
-            std::vector<std::pair<CSteamID, Gameserver_Player_Info_t>> const& players = *get_steam_client()->steam_gameserver->get_players();
+        if (len < a2s_query_info_size || strncmp(query.a2s_info_payload, a2s_info_payload, a2s_info_payload_size)) return nullptr;
+
+        // newer clients append a challenge to the info request, older ones are still answered directly
+        if (len >= a2s_query_info_size + sizeof(uint32_t)) {
+            uint32_t challenge{};
+            memcpy(&challenge, reinterpret_cast<const uint8_t *>(buffer) + a2s_query_info_size, sizeof(challenge));
+            if (!check_challenge(src_ip, challenge)) return reply_challenge();
+        }
+
+        if (!info_cache.valid || info_cache.generation != current_state->generation[0]) {
+            std::vector<uint8_t> output_buffer{};
 
             serialize_response(output_buffer, source_query_magic::simple);
             serialize_response(output_buffer, source_response_header::A2S_INFO);
@@ -190,56 +304,64 @@ std::vector<uint8_t> Source_Query::handle_source_query(const void* buffer, size_
 
             if (flags & source_server_extra_flag::gameid) serialize_response(output_buffer, CGameID(gs.appid()).ToUint64());
 
+            store_response(info_cache, current_state->generation[0], std::move(output_buffer));
         }
+
+        return info_cache.packets;
     }
-    break;
 
     case source_query_header::A2S_PLAYER: {
         PRINT_DEBUG("got request for player info");
-        if (len >= a2s_query_challenge_size) {
-            if (query.challenge == 0xFFFFFFFFul) {
-                get_challenge(output_buffer);
-            } else if (query.challenge == 0x00112233ul) {
-                std::vector<std::pair<CSteamID, Gameserver_Player_Info_t>> const& players = *get_steam_client()->steam_gameserver->get_players();
-
-                serialize_response(output_buffer, source_query_magic::simple);
-                serialize_response(output_buffer, source_response_header::A2S_PLAYER);
-                serialize_response(output_buffer, static_cast<uint8_t>(players.size())); // num_players
-
-                for (unsigned i = 0; i < players.size(); ++i) {
-                    serialize_response(output_buffer, static_cast<uint8_t>(i)); // player index
-                    serialize_response(output_buffer, players[i].second.name); // player name
-                    serialize_response(output_buffer, players[i].second.score); // player score
-                    serialize_response(output_buffer, static_cast<float>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - players[i].second.join_time).count()));
-                }
+        if (len < a2s_query_challenge_size) return nullptr;
+        if (query.challenge == 0xFFFFFFFFul || !check_challenge(src_ip, query.challenge)) return reply_challenge();
+
+        auto now = std::chrono::steady_clock::now();
+        if (!players_cache.valid || players_cache.generation != current_state->generation[1] || now - players_cache.built >= std::chrono::milliseconds(SOURCE_QUERY_PLAYERS_CACHE_MS)) {
+            std::vector<uint8_t> output_buffer{};
+
+            serialize_response(output_buffer, source_query_magic::simple);
+            serialize_response(output_buffer, source_response_header::A2S_PLAYER);
+            serialize_response(output_buffer, static_cast<uint8_t>(players.size())); // num_players
+
+            for (unsigned i = 0; i < players.size(); ++i) {
+                serialize_response(output_buffer, static_cast<uint8_t>(i)); // player index
+                serialize_response(output_buffer, players[i].second.name); // player name
+                serialize_response(output_buffer, players[i].second.score); // player score
+                serialize_response(output_buffer, static_cast<float>(std::chrono::duration_cast<std::chrono::seconds>(now - players[i].second.join_time).count()));
             }
+
+            store_response(players_cache, current_state->generation[1], std::move(output_buffer));
         }
+
+        return players_cache.packets;
     }
-    break;
 
     case source_query_header::A2S_RULES: {
         PRINT_DEBUG("got request for rules info");
-        if (len >= a2s_query_challenge_size) {
-            if (query.challenge == 0xFFFFFFFFul) {
-                get_challenge(output_buffer);
-            } else if (query.challenge == 0x00112233ul) {
-                auto values = gs.values();
-
-                serialize_response(output_buffer, source_query_magic::simple);
-                serialize_response(output_buffer, source_response_header::A2S_RULES);
-                serialize_response(output_buffer, static_cast<uint16_t>(values.size()));
-
-                for (const auto &i : values) {
-                    serialize_response(output_buffer, i.first);
-                    serialize_response(output_buffer, i.second);
-                }
+        if (len < a2s_query_challenge_size) return nullptr;
+        if (query.challenge == 0xFFFFFFFFul || !check_challenge(src_ip, query.challenge)) return reply_challenge();
+
+        if (!rules_cache.valid || rules_cache.generation != current_state->generation[2]) {
+            std::vector<uint8_t> output_buffer{};
+            auto &values = gs.values();
+
+            serialize_response(output_buffer, source_query_magic::simple);
+            serialize_response(output_buffer, source_response_header::A2S_RULES);
+            serialize_response(output_buffer, static_cast<uint16_t>(values.size()));
+
+            for (const auto &i : values) {
+                serialize_response(output_buffer, i.first);
+                serialize_response(output_buffer, i.second);
             }
+
+            store_response(rules_cache, current_state->generation[2], std::move(output_buffer));
         }
+
+        return rules_cache.packets;
     }
-    break;
 
     default: PRINT_DEBUG("got unknown request"); break;
     }
 
-    return output_buffer;
+    return nullptr;
 }
@@ -0,0 +1,296 @@
+/* Copyright (C) 2019 Mr Goldberg
+   This file is part of the Goldberg Emulator
+
+   The Goldberg Emulator is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   The Goldberg Emulator is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the Goldberg Emulator; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include "dll/stats_store.h"
+#include "dll/local_storage.h"
+
+// journal layout:
+//   header: magic, u32 version
+//   records: u8 op, u16 name length, u16 value length, name, value, u32 FNV-1a of everything before it
+// loading stops at the first truncated or corrupted record, whatever came before it is kept
+#define STATS_JOURNAL_MAGIC "GBSJ"
+#define STATS_JOURNAL_VERSION 1
+#define STATS_JOURNAL_HEADER_SIZE 8
+#define STATS_JOURNAL_RECORD_OVERHEAD (1 + 2 + 2 + 4)
+#define STATS_JOURNAL_OP_SET 1
+
+// compact once the journal holds this many records per live stat (plus some slack for small sets)
+#define STATS_JOURNAL_COMPACT_FACTOR 4
+#define STATS_JOURNAL_COMPACT_SLACK 64
+
+// the largest stat value is the avgrate one: avg, count, session length
+#define STATS_MAX_VALUE_SIZE (sizeof(float) + sizeof(float) + sizeof(double))
+
+
+static uint32_t fnv1a(const char *data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void write_header(std::vector<char> &buffer)
+{
+    uint32_t version = STATS_JOURNAL_VERSION;
+    buffer.insert(buffer.end(), STATS_JOURNAL_MAGIC, STATS_JOURNAL_MAGIC + 4);
+    buffer.insert(buffer.end(), (const char *)&version, (const char *)&version + sizeof(version));
+}
+
+static void write_record(std::vector<char> &buffer, const std::string &name, const std::string &value)
+{
+    size_t start = buffer.size();
+    uint8_t op = STATS_JOURNAL_OP_SET;
+    uint16_t name_size = static_cast<uint16_t>(name.size());
+    uint16_t value_size = static_cast<uint16_t>(value.size());
+
+    buffer.push_back(static_cast<char>(op));
+    buffer.insert(buffer.end(), (const char *)&name_size, (const char *)&name_size + sizeof(name_size));
+    buffer.insert(buffer.end(), (const char *)&value_size, (const char *)&value_size + sizeof(value_size));
+    buffer.insert(buffer.end(), name.begin(), name.end());
+    buffer.insert(buffer.end(), value.begin(), value.end());
+
+    uint32_t checksum = fnv1a(&buffer[start], buffer.size() - start);
+    buffer.insert(buffer.end(), (const char *)&checksum, (const char *)&checksum + sizeof(checksum));
+}
+
+
+// returns false if the journal can't be read or was written by an unknown version
+bool Stats_Store::load_journal()
+{
+    std::ifstream file(std::filesystem::u8path(journal_path), std::ios::binary | std::ios::in);
+    if (!file.is_open()) return false;
+
+    std::vector<char> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+
+    uint32_t version = 0;
+    if (content.size() < STATS_JOURNAL_HEADER_SIZE || memcmp(content.data(), STATS_JOURNAL_MAGIC, 4) != 0) {
+        PRINT_DEBUG("invalid stats journal header, ignoring it");
+        return false;
+    }
+    memcpy(&version, content.data() + 4, sizeof(version));
+    if (version != STATS_JOURNAL_VERSION) {
+        PRINT_DEBUG("unknown stats journal version %u, ignoring it", version);
+        return false;
+    }
+
+    size_t offset = STATS_JOURNAL_HEADER_SIZE;
+    while (content.size() - offset >= STATS_JOURNAL_RECORD_OVERHEAD) {
+        const char *record = content.data() + offset;
+        uint16_t name_size = 0;
+        uint16_t value_size = 0;
+        memcpy(&name_size, record + 1, sizeof(name_size));
+        memcpy(&value_size, record + 3, sizeof(value_size));
+
+        size_t body_size = 1 + 2 + 2 + (size_t)name_size + value_size;
+        if (content.size() - offset < body_size + sizeof(uint32_t)) break;
+
+        uint32_t checksum = 0;
+        memcpy(&checksum, record + body_size, sizeof(checksum));
+        if (checksum != fnv1a(record, body_size) || record[0] != STATS_JOURNAL_OP_SET) break;
+
+        values[std::string(record + 5, name_size)] = std::string(record + 5 + name_size, value_size);
+        ++journal_records;
+        offset += body_size + sizeof(checksum);
+    }
+
+    PRINT_DEBUG("loaded %zu stats from %zu journal records", values.size(), journal_records);
+    if (offset != content.size()) {
+        // a torn write from a previous session, get rid of it so new records aren't appended after garbage
+        PRINT_DEBUG("stats journal has %zu trailing invalid bytes, compacting it", content.size() - offset);
+        compact();
+    }
+
+    return true;
+}
+
+void Stats_Store::migrate_stats_folder(const std::string &stats_folder)
+{
+    for (const auto &file : Local_Storage::get_filenames_path(stats_folder)) {
+        char data[STATS_MAX_VALUE_SIZE];
+        int read = Local_Storage::get_file_data(stats_folder + file, data, sizeof(data));
+        if (read != sizeof(int32) && read != (int)sizeof(data)) continue;
+
+        values[Local_Storage::desanitize_string(file)] = std::string(data, read);
+    }
+
+    PRINT_DEBUG("migrated %zu stats from '%s'", values.size(), stats_folder.c_str());
+}
+
+bool Stats_Store::backup_journal()
+{
+    std::error_code ec{};
+    std::string backup_path(journal_path + ".bak");
+    for (unsigned i = 1; std::filesystem::exists(std::filesystem::u8path(backup_path), ec); ++i) {
+        backup_path = journal_path + ".bak" + std::to_string(i);
+    }
+
+    std::filesystem::rename(std::filesystem::u8path(journal_path), std::filesystem::u8path(backup_path), ec);
+    if (ec) return false;
+
+    PRINT_DEBUG("moved the unreadable stats journal to '%s'", backup_path.c_str());
+    return true;
+}
+
+bool Stats_Store::append_records(const std::vector<char> &buffer, size_t count)
+{
+    std::ofstream file(std::filesystem::u8path(journal_path), std::ios::binary | std::ios::out | std::ios::app);
+    if (!file.is_open()) return false;
+
+    file.write(buffer.data(), buffer.size());
+    file.close();
+    if (!file) {
+        // part of the records might have made it, rewrite the whole thing next time
+        journal_records = std::numeric_limits<size_t>::max() / 2;
+        return false;
+    }
+
+    journal_records += count;
+    return true;
+}
+
+
+void Stats_Store::open(const std::string &save_folder)
+{
+    if (is_open()) flush();
+
+    values.clear();
+    dirty.clear();
+    journal_records = 0;
+    journal_path.clear();
+    if (save_folder.empty()) return;
+
+    journal_path = save_folder + journal_file;
+    std::error_code ec{};
+    if (!std::filesystem::exists(std::filesystem::u8path(journal_path), ec)) {
+        migrate_stats_folder(save_folder + Local_Storage::stats_storage_folder + PATH_SEPARATOR);
+        compact();
+        return;
+    }
+
+    if (!load_journal()) {
+        values.clear();
+        journal_records = 0;
+        // written by a newer build or damaged, keep it around instead of overwriting it
+        if (backup_journal()) {
+            compact();
+        } else {
+            PRINT_DEBUG("failed to back up the unreadable stats journal, stats won't be saved");
+            journal_path.clear();
+        }
+    }
+}
+
+bool Stats_Store::is_open() const
+{
+    return !journal_path.empty();
+}
+
+bool Stats_Store::get(const std::string &name, void *data, size_t size) const
+{
+    auto it = values.find(name);
+    // a prefix of the value is fine, GetStat(float) reads the average of the avgrate stats this way
+    if (values.end() == it || it->second.size() < size) return false;
+
+    memcpy(data, it->second.data(), size);
+    return true;
+}
+
+void Stats_Store::set(const std::string &name, const void *data, size_t size)
+{
+    if (name.size() > std::numeric_limits<uint16_t>::max()) return;
+
+    auto &value = values[name];
+    if (value.size() == size && memcmp(value.data(), data, size) == 0) return;
+
+    value.assign((const char *)data, size);
+    dirty.insert(name);
+}
+
+bool Stats_Store::has_pending_writes() const
+{
+    return !dirty.empty();
+}
+
+bool Stats_Store::flush()
+{
+    if (dirty.empty()) return true;
+    if (journal_path.empty()) {
+        dirty.clear();
+        return true;
+    }
+
+    if (journal_records + dirty.size() > values.size() * STATS_JOURNAL_COMPACT_FACTOR + STATS_JOURNAL_COMPACT_SLACK) {
+        return compact();
+    }
+
+    std::vector<char> buffer{};
+    for (const auto &name : dirty) {
+        write_record(buffer, name, values[name]);
+    }
+
+    if (!append_records(buffer, dirty.size())) {
+        PRINT_DEBUG("failed to append %zu records to the stats journal", dirty.size());
+        return false;
+    }
+
+    PRINT_DEBUG("flushed %zu stats", dirty.size());
+    dirty.clear();
+    return true;
+}
+
+bool Stats_Store::compact()
+{
+    if (journal_path.empty()) return true;
+
+    std::vector<char> buffer{};
+    write_header(buffer);
+    for (const auto &kv : values) {
+        write_record(buffer, kv.first, kv.second);
+    }
+
+    // write the new journal next to the old one then swap them, so a crash never leaves a half written one
+    std::string tmp_path(journal_path + ".tmp");
+    std::ofstream file(std::filesystem::u8path(tmp_path), std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        PRINT_DEBUG("failed to create '%s'", tmp_path.c_str());
+        return false;
+    }
+
+    file.write(buffer.data(), buffer.size());
+    file.close();
+    std::error_code ec{};
+    if (!file) {
+        std::filesystem::remove(std::filesystem::u8path(tmp_path), ec);
+        return false;
+    }
+
+    std::filesystem::rename(std::filesystem::u8path(tmp_path), std::filesystem::u8path(journal_path), ec);
+    if (ec) {
+        PRINT_DEBUG("failed to replace the stats journal: %s", ec.message().c_str());
+        std::filesystem::remove(std::filesystem::u8path(tmp_path), ec);
+        return false;
+    }
+
+    PRINT_DEBUG("compacted the stats journal to %zu records", values.size());
+    journal_records = values.size();
+    dirty.clear();
+    return true;
+}
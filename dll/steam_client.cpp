@@ -46,7 +46,7 @@ Steam_Client::Steam_Client()
         std::chrono::duration_cast<std::chrono::milliseconds>(initial_delay),
         std::chrono::duration_cast<std::chrono::milliseconds>(max_stall_ms)
     );
-    network = new Networking(settings_server->get_local_steam_id(), appid, settings_server->get_port(), &(settings_server->custom_broadcasts), settings_server->disable_networking);
+    network = new Networking(settings_server->get_local_steam_id(), appid, settings_server->get_port(), &(settings_server->custom_broadcasts), settings_server->disable_networking, settings_server->network_io_backend, settings_server->network_io_thread);
 
     run_every_runcb = new RunEveryRunCB();
 
@@ -102,7 +102,7 @@ Steam_Client::Steam_Client()
     steam_networking = new Steam_Networking(settings_client, network, callbacks_client, run_every_runcb);
     steam_remote_storage = new Steam_Remote_Storage(settings_client, ugc_bridge, local_storage, callback_results_client, callbacks_client, run_every_runcb);
     steam_screenshots = new Steam_Screenshots(local_storage, callbacks_client);
-    steam_http = new Steam_HTTP(settings_client, network, callback_results_client, callbacks_client);
+    steam_http = new Steam_HTTP(settings_client, network, callback_results_client, callbacks_client, run_every_runcb);
     steam_controller = new Steam_Controller(settings_client, callback_results_client, callbacks_client, run_every_runcb);
     steam_ugc = new Steam_UGC(settings_client, ugc_bridge, local_storage, callback_results_client, callbacks_client);
     steam_applist = new Steam_Applist();
@@ -116,7 +116,7 @@ Steam_Client::Steam_Client()
     steam_networking_sockets_serialized = new Steam_Networking_Sockets_Serialized(settings_client, network, callback_results_client, callbacks_client, run_every_runcb);
     steam_networking_messages = new Steam_Networking_Messages(settings_client, network, callback_results_client, callbacks_client, run_every_runcb);
     steam_game_coordinator = new Steam_Game_Coordinator(settings_client, network, callback_results_client, callbacks_client, run_every_runcb);
-    steam_networking_utils = new Steam_Networking_Utils(settings_client, network, callback_results_client, callbacks_client, run_every_runcb);
+    steam_networking_utils = new Steam_Networking_Utils(settings_client, network, callback_results_client, callbacks_client, run_every_runcb, steam_networking_sockets->get_shared_between_client_server());
     steam_unified_messages = new Steam_Unified_Messages(settings_client, network, callback_results_client, callbacks_client, run_every_runcb);
     steam_game_search = new Steam_Game_Search(settings_client, network, callback_results_client, callbacks_client, run_every_runcb);
     steam_parties = new Steam_Parties(settings_client, network, callback_results_client, callbacks_client, run_every_runcb);
@@ -136,7 +136,7 @@ Steam_Client::Steam_Client()
     steam_gameserver_utils = new Steam_Utils(settings_server, callback_results_server, callbacks_server, steam_overlay);
     steam_gameserverstats = new Steam_GameServerStats(settings_server, network, callback_results_server, callbacks_server, run_every_runcb);
     steam_gameserver_networking = new Steam_Networking(settings_server, network, callbacks_server, run_every_runcb);
-    steam_gameserver_http = new Steam_HTTP(settings_server, network, callback_results_server, callbacks_server);
+    steam_gameserver_http = new Steam_HTTP(settings_server, network, callback_results_server, callbacks_server, run_every_runcb);
     steam_gameserver_inventory = new Steam_Inventory(settings_server, callback_results_server, callbacks_server, run_every_runcb, local_storage);
     steam_gameserver_ugc = new Steam_UGC(settings_server, ugc_bridge, local_storage, callback_results_server, callbacks_server);
     steam_gameserver_apps = new Steam_Apps(settings_server, callback_results_server, callbacks_server);
@@ -262,6 +262,12 @@ void Steam_Client::clientShutdown()
     user_logged_in = false;
 }
 
+void Steam_Client::stopThreads()
+{
+    steam_networking_sockets->stop_nagle_thread();
+    steam_gameserver_networking_sockets->stop_nagle_thread();
+}
+
 void Steam_Client::setAppID(uint32 appid)
 {
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
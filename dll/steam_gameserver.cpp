@@ -16,7 +16,6 @@
    <http://www.gnu.org/licenses/>.  */
 
 #include "dll/steam_gameserver.h"
-#include "dll/source_query.h"
 
 #define SEND_SERVER_RATE 5.0
 
@@ -45,6 +44,8 @@ void Steam_GameServer::set_version(const char *pchVersionString)
         PRINT_DEBUG("not a number '%s'", pchVersionString);
     }
 
+    update_query_state(Source_Query::info);
+
 }
 
 
@@ -56,15 +57,36 @@ Steam_GameServer::Steam_GameServer(class Settings *settings, class Networking *n
     auth_manager = new Auth_Manager(settings, network, callbacks);
     
     server_data.set_id(settings->get_local_steam_id().ConvertToUint64());
+    update_query_state(Source_Query::all);
+    publish_query_state();
 }
 
 Steam_GameServer::~Steam_GameServer()
 {
+    // the networking (and its I/O thread) outlives this object, stop it from using source_query
+    network->shutDownQuery();
     delete auth_manager;
     auth_manager = nullptr;
 }
 
 
+void Steam_GameServer::update_query_state(uint8_t changed)
+{
+    // the setters can be called many times per frame, only one snapshot is made for all of them
+    query_state_changed |= changed;
+}
+
+void Steam_GameServer::publish_query_state()
+{
+    if (!query_state_changed) return;
+
+    auto state = std::make_shared<Source_Query_State>();
+    state->server = server_data;
+    state->players = players;
+    source_query.set_state(std::move(state), query_state_changed);
+    query_state_changed = 0;
+}
+
 std::vector<std::pair<CSteamID, Gameserver_Player_Info_t>>* Steam_GameServer::get_players()
 {
     return &players;
@@ -88,9 +110,10 @@ bool Steam_GameServer::InitGameServer( uint32 unIP, uint16 usGamePort, uint16 us
     server_data.set_port(usGamePort);
     server_data.set_query_port(usQueryPort);
     server_data.set_offline(false);
+    update_query_state(Source_Query::info);
 
     if (!settings->disable_source_query)
-        network->startQuery({ unIP, usQueryPort });
+        network->startQuery({ unIP, usQueryPort }, &source_query);
 
     if (!settings->get_local_game_id().AppID()) settings->set_game_id(CGameID(nGameAppId));
     //TODO: flags should be k_unServerFlag
@@ -112,6 +135,7 @@ void Steam_GameServer::SetProduct( const char *pszProduct )
     // pszGameDescription should be used instead of pszProduct for accurate information
     // Example: 'Counter-Strike: Source' instead of 'cstrike'
     server_data.set_product(pszProduct);
+    update_query_state(Source_Query::info);
 }
 
 
@@ -135,6 +159,7 @@ void Steam_GameServer::SetModDir( const char *pszModDir )
     PRINT_DEBUG("%s", pszModDir);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     server_data.set_mod_dir(pszModDir);
+    update_query_state(Source_Query::info);
 }
 
 
@@ -144,6 +169,7 @@ void Steam_GameServer::SetDedicatedServer( bool bDedicated )
     PRINT_DEBUG("%i", bDedicated);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     server_data.set_dedicated_server(bDedicated);
+    update_query_state(Source_Query::info);
 }
 
 
@@ -218,11 +244,17 @@ bool Steam_GameServer::BSecure()
     PRINT_DEBUG_ENTRY();
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     if (!policy_response_called) {
-      server_data.set_secure(0);
+      if (server_data.secure()) {
+        server_data.set_secure(0);
+        update_query_state(Source_Query::info);
+      }
       return false;
     }
     const bool res = !!(flags & k_unServerFlagSecure);
-    server_data.set_secure(res);
+    if (server_data.secure() != res) {
+      server_data.set_secure(res);
+      update_query_state(Source_Query::info);
+    }
     return res;
 }
  
@@ -255,6 +287,7 @@ void Steam_GameServer::SetMaxPlayerCount( int cPlayersMax )
     PRINT_DEBUG("%i", cPlayersMax);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     server_data.set_max_player_count(cPlayersMax);
+    update_query_state(Source_Query::info);
 }
 
 
@@ -264,6 +297,7 @@ void Steam_GameServer::SetBotPlayerCount( int cBotplayers )
     PRINT_DEBUG("%i", cBotplayers);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     server_data.set_bot_player_count(cBotplayers);
+    update_query_state(Source_Query::info);
 }
 
 
@@ -275,6 +309,7 @@ void Steam_GameServer::SetServerName( const char *pszServerName )
     PRINT_DEBUG("%s", pszServerName);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     server_data.set_server_name(pszServerName);
+    update_query_state(Source_Query::info);
 }
 
 
@@ -286,6 +321,7 @@ void Steam_GameServer::SetMapName( const char *pszMapName )
     PRINT_DEBUG("%s", pszMapName);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     server_data.set_map_name(pszMapName);
+    update_query_state(Source_Query::info);
 }
 
 
@@ -295,6 +331,7 @@ void Steam_GameServer::SetPasswordProtected( bool bPasswordProtected )
     PRINT_DEBUG("%i", bPasswordProtected);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     server_data.set_password_protected(bPasswordProtected);
+    update_query_state(Source_Query::info);
 }
 
 
@@ -305,6 +342,7 @@ void Steam_GameServer::SetSpectatorPort( uint16 unSpectatorPort )
     PRINT_DEBUG_ENTRY();
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     server_data.set_spectator_port(unSpectatorPort);
+    update_query_state(Source_Query::info);
 }
 
 
@@ -316,6 +354,7 @@ void Steam_GameServer::SetSpectatorServerName( const char *pszSpectatorServerNam
     PRINT_DEBUG("%s", pszSpectatorServerName);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     server_data.set_spectator_server_name(pszSpectatorServerName);
+    update_query_state(Source_Query::info);
 }
 
 
@@ -325,6 +364,7 @@ void Steam_GameServer::ClearAllKeyValues()
     PRINT_DEBUG_ENTRY();
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     server_data.clear_values();
+    update_query_state(Source_Query::rules);
 }
 
 
@@ -334,6 +374,7 @@ void Steam_GameServer::SetKeyValue( const char *pKey, const char *pValue )
     PRINT_DEBUG("%s %s", pKey, pValue);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     (*server_data.mutable_values())[std::string(pKey)] = std::string(pValue);
+    update_query_state(Source_Query::rules);
 }
 
 
@@ -399,6 +440,7 @@ bool Steam_GameServer::SendUserConnectAndAuthenticate( uint32 unIPClient, const
         infos.second.score = 0;
         infos.second.name = "unnamed";
         players.emplace_back(std::move(infos));
+        update_query_state(Source_Query::info | Source_Query::players);
     }
 
     return res;
@@ -426,6 +468,7 @@ CSteamID Steam_GameServer::CreateUnauthenticatedUserConnection()
     infos.second.score = 0;
     infos.second.name = "unnamed";
     players.emplace_back(std::move(infos));
+    update_query_state(Source_Query::info | Source_Query::players);
 
     return bot_id;
 }
@@ -447,6 +490,7 @@ void Steam_GameServer::SendUserDisconnect( CSteamID steamIDUser )
     if (player_it != players.end())
     {
         players.erase(player_it);
+        update_query_state(Source_Query::info | Source_Query::players);
     }
 
     auth_manager->endAuth(steamIDUser);
@@ -474,6 +518,7 @@ bool Steam_GameServer::BUpdateUserData( CSteamID steamIDUser, const char *pchPla
             player_it->second.name = pchPlayerName;
 
         player_it->second.score = uScore;
+        update_query_state(Source_Query::players);
         return true;
     }
     return false;
@@ -508,6 +553,7 @@ bool Steam_GameServer::BSetServerType( uint32 unServerFlags, uint32 unGameIP, ui
     server_data.set_port(unGamePort);
     server_data.set_query_port(usQueryPort);
     server_data.set_spectator_port(unSpectatorPort);
+    update_query_state(Source_Query::info);
     set_version(pchVersion);
 
     server_data.set_game_dir(pchGameDir ? pchGameDir : "");
@@ -537,6 +583,7 @@ void Steam_GameServer::UpdateServerStatus( int cPlayers, int cPlayersMax, int cB
     server_data.set_server_name(pchServerName);
     server_data.set_spectator_server_name(pSpectatorServerName);
     server_data.set_map_name(pchMapName);
+    update_query_state(Source_Query::info);
 }
 
 // This can be called if spectator goes away or comes back (passing 0 means there is no spectator server now).
@@ -599,6 +646,7 @@ EBeginAuthSessionResult Steam_GameServer::BeginAuthSession( const void *pAuthTic
     infos.second.score = 0;
     infos.second.name = "unnamed";
     players.emplace_back(std::move(infos));
+    update_query_state(Source_Query::info | Source_Query::players);
 
     return auth_manager->beginAuth(pAuthTicket, cbAuthTicket, steamID );
 }
@@ -618,6 +666,7 @@ void Steam_GameServer::EndAuthSession( CSteamID steamID )
     if (player_it != players.end())
     {
         players.erase(player_it);
+        update_query_state(Source_Query::info | Source_Query::players);
     }
 
     auth_manager->endAuth(steamID);
@@ -719,16 +768,20 @@ bool Steam_GameServer::HandleIncomingPacket( const void *pData, int cbData, uint
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     if (settings->disable_source_query) return true;
 
-    Gameserver_Outgoing_Packet packet;
-    packet.data = std::move(Source_Query::handle_source_query(pData, cbData, server_data));
-    if (packet.data.empty())
+    publish_query_state();
+    auto response = source_query.handle_source_query(pData, cbData, srcIP);
+    if (!response || response->empty())
         return false;
 
+    for (const auto &data : *response) {
+        Gameserver_Outgoing_Packet packet;
+        packet.data = data;
+        packet.ip = srcIP;
+        packet.port = srcPort;
 
-    packet.ip = srcIP;
-    packet.port = srcPort;
+        outgoing_packets.emplace_back(std::move(packet));
+    }
 
-    outgoing_packets.emplace_back(std::move(packet));
     return true;
 }
 
@@ -744,15 +797,16 @@ int Steam_GameServer::GetNextOutgoingPacket( void *pOut, int cbMaxOut, uint32 *p
     if (settings->disable_source_query) return 0;
     if (outgoing_packets.empty()) return 0;
 
+    // replies go out in the order the queries came in
     if (cbMaxOut > 0) {
-        if (outgoing_packets.back().data.size() < static_cast<size_t>(cbMaxOut)) {
-            cbMaxOut = static_cast<int>(outgoing_packets.back().data.size());
+        if (outgoing_packets.front().data.size() < static_cast<size_t>(cbMaxOut)) {
+            cbMaxOut = static_cast<int>(outgoing_packets.front().data.size());
         }
-        if (pOut) memcpy(pOut, outgoing_packets.back().data.data(), cbMaxOut);
+        if (pOut) memcpy(pOut, outgoing_packets.front().data.data(), cbMaxOut);
     }
-    if (pNetAdr) *pNetAdr = outgoing_packets.back().ip;
-    if (pPort) *pPort = outgoing_packets.back().port;
-    outgoing_packets.pop_back();
+    if (pNetAdr) *pNetAdr = outgoing_packets.front().ip;
+    if (pPort) *pPort = outgoing_packets.front().port;
+    outgoing_packets.pop_front();
     return cbMaxOut;
 }
 
@@ -854,13 +908,19 @@ void Steam_GameServer::RunCallbacks()
         PRINT_DEBUG("Sending Gameserver");
         Common_Message msg{};
         msg.set_source_id(settings->get_local_steam_id().ConvertToUint64());
-        server_data.set_appid(settings->get_local_game_id().AppID());
+        if (server_data.appid() != settings->get_local_game_id().AppID()) {
+            server_data.set_appid(settings->get_local_game_id().AppID());
+            update_query_state(Source_Query::info);
+        }
         msg.set_allocated_gameserver(new Gameserver(server_data));
         msg.mutable_gameserver()->set_num_players(auth_manager->countInboundAuth());
         network->sendToAllIndividuals(&msg, true);
         last_sent_server_info = std::chrono::high_resolution_clock::now();
     }
 
+    // the query socket answers from the last snapshot, at most a frame behind the setters
+    publish_query_state();
+
     if (temp_call_servers_disconnected) {
         PRINT_DEBUG("Gameserver is disconnected");
         SteamServersDisconnected_t data{};
@@ -50,14 +50,10 @@ Steam_GameServerStats::CachedStat* Steam_GameServerStats::find_stat(CSteamID ste
     auto it_data = all_users_data.find(steamIDUser.ConvertToUint64());
     if (all_users_data.end() == it_data) return {}; // no user
 
-    auto it_stat = std::find_if(
-        it_data->second.stats.begin(), it_data->second.stats.end(),
-        [&key](std::pair<const std::string, CachedStat> &item) {
-            const std::string &name = item.first;
-            return common_helpers::str_cmp_insensitive(key, name);
-        }
-    );
+    auto it_id = it_data->second.stat_ids.find(common_helpers::to_lower(key));
+    if (it_data->second.stat_ids.end() == it_id) return {}; // no stat
 
+    auto it_stat = it_data->second.stats.find(it_id->second);
     if (it_data->second.stats.end() == it_stat) return {}; // no stat
 
     return &it_stat->second;
@@ -68,19 +64,86 @@ Steam_GameServerStats::CachedAchievement* Steam_GameServerStats::find_ach(CSteam
     auto it_data = all_users_data.find(steamIDUser.ConvertToUint64());
     if (all_users_data.end() == it_data) return {}; // no user
 
-    auto it_ach = std::find_if(
-        it_data->second.achievements.begin(), it_data->second.achievements.end(),
-        [&key](std::pair<const std::string, CachedAchievement> &item) {
-            const std::string &name = item.first;
-            return common_helpers::str_cmp_insensitive(key, name);
-        }
-    );
+    auto it_id = it_data->second.achievement_ids.find(common_helpers::to_lower(key));
+    if (it_data->second.achievement_ids.end() == it_id) return {}; // no achievement
 
-    if (it_data->second.achievements.end() == it_ach) return {}; // no user
+    auto it_ach = it_data->second.achievements.find(it_id->second);
+    if (it_data->second.achievements.end() == it_ach) return {}; // no achievement
 
     return &it_ach->second;
 }
 
+void Steam_GameServerStats::queue_update(CSteamID steamIDUser, CachedStat *stat)
+{
+    if (stat->dirty) return; // already queued
+
+    auto &user = all_users_data[steamIDUser.ConvertToUint64()];
+    stat->dirty = true;
+    user.dirty_stats.push_back(stat->id);
+    if (!user.queued) {
+        user.queued = true;
+        dirty_users.push_back(steamIDUser.ConvertToUint64());
+    }
+}
+
+void Steam_GameServerStats::queue_update(CSteamID steamIDUser, CachedAchievement *ach)
+{
+    if (ach->dirty) return; // already queued
+
+    auto &user = all_users_data[steamIDUser.ConvertToUint64()];
+    ach->dirty = true;
+    user.dirty_achievements.push_back(ach->id);
+    if (!user.queued) {
+        user.queued = true;
+        dirty_users.push_back(steamIDUser.ConvertToUint64());
+    }
+}
+
+void Steam_GameServerStats::apply_user_stats(UserData &user, const GameServerStats_Messages::StatsDelta &delta)
+{
+    // learn the new ids first, the values below might use them
+    for (const auto &name : delta.stat_names()) {
+        user.stat_ids[common_helpers::to_lower(name.second)] = name.first;
+    }
+    for (const auto &name : delta.achievement_names()) {
+        user.achievement_ids[common_helpers::to_lower(name.second)] = name.first;
+    }
+
+    // the user's values win over whatever we didn't send yet
+    for (const auto &new_stat : delta.user_stats()) {
+        auto &current_stat = user.stats[new_stat.first];
+        current_stat.id = new_stat.first;
+        current_stat.dirty = false;
+        current_stat.stat = new_stat.second;
+    }
+    for (const auto &new_ach : delta.user_achievements()) {
+        auto &current_ach = user.achievements[new_ach.first];
+        current_ach.id = new_ach.first;
+        current_ach.dirty = false;
+        current_ach.ach = new_ach.second;
+    }
+}
+
+void Steam_GameServerStats::apply_user_stats(UserData &user, const GameServerStats_Messages::AllStats &all_stats)
+{
+    for (const auto &new_stat : all_stats.user_stats()) {
+        uint32 id = user.stat_ids.emplace(common_helpers::to_lower(new_stat.first), static_cast<uint32>(user.stat_ids.size())).first->second;
+        auto &current_stat = user.stats[id];
+        current_stat.id = id;
+        current_stat.name = new_stat.first;
+        current_stat.dirty = false;
+        current_stat.stat = new_stat.second;
+    }
+    for (const auto &new_ach : all_stats.user_achievements()) {
+        uint32 id = user.achievement_ids.emplace(common_helpers::to_lower(new_ach.first), static_cast<uint32>(user.achievement_ids.size())).first->second;
+        auto &current_ach = user.achievements[id];
+        current_ach.id = id;
+        current_ach.name = new_ach.first;
+        current_ach.dirty = false;
+        current_ach.ach = new_ach.second;
+    }
+}
+
 Steam_GameServerStats::Steam_GameServerStats(class Settings *settings, class Networking *network, class SteamCallResults *callback_results, class SteamCallBacks *callbacks, class RunEveryRunCB *run_every_runcb)
 {
     this->settings = settings;
@@ -136,6 +199,7 @@ SteamAPICall_t Steam_GameServerStats::RequestUserStats( CSteamID steamIDUser )
 
     auto initial_stats_msg = new GameServerStats_Messages::InitialAllStats();
     initial_stats_msg->set_steam_api_call(new_request.steamAPICall);
+    initial_stats_msg->set_supports_delta(true);
 
     auto gameserverstats_messages = new GameServerStats_Messages();
     gameserverstats_messages->set_type(GameServerStats_Messages::Request_AllUserStats);
@@ -219,8 +283,8 @@ bool Steam_GameServerStats::SetUserStat( CSteamID steamIDUser, const char *pchNa
     if (stat->stat.stat_type() != GameServerStats_Messages::StatInfo::STAT_TYPE_INT) return false;
     if (stat->stat.value_int() == nData) return true; // don't waste time
 
-    stat->dirty = true;
     stat->stat.set_value_int(nData);
+    queue_update(steamIDUser, stat);
 
     if (settings->immediate_gameserver_stats) collect_and_send_updated_user_stats();
 
@@ -240,8 +304,8 @@ bool Steam_GameServerStats::SetUserStat( CSteamID steamIDUser, const char *pchNa
     if (stat->stat.stat_type() == GameServerStats_Messages::StatInfo::STAT_TYPE_INT) return false;
     if (stat->stat.value_float() == fData) return true; // don't waste time
 
-    stat->dirty = true;
     stat->stat.set_value_float(fData); // we set the float field in case it's float or avg
+    queue_update(steamIDUser, stat);
 
     if (settings->immediate_gameserver_stats) collect_and_send_updated_user_stats();
     
@@ -266,7 +330,7 @@ bool Steam_GameServerStats::UpdateUserAvgRateStat( CSteamID steamIDUser, const c
         return true;
     }
 
-    stat->dirty = true;
+    queue_update(steamIDUser, stat);
 
     // https://protobuf.dev/reference/cpp/cpp-generated/#string
     // set_allocated_xxx() takes ownership of the allocated object, no need to delete
@@ -293,8 +357,8 @@ bool Steam_GameServerStats::SetUserAchievement( CSteamID steamIDUser, const char
     if (!ach) return false;
     if (ach->ach.achieved() == true) return true; // don't waste time
     
-    ach->dirty = true;
     ach->ach.set_achieved(true);
+    queue_update(steamIDUser, ach);
 
     if (settings->immediate_gameserver_stats) collect_and_send_updated_user_stats();
     
@@ -313,8 +377,8 @@ bool Steam_GameServerStats::ClearUserAchievement( CSteamID steamIDUser, const ch
     if (!ach) return false;
     if (ach->ach.achieved() == false) return true; // don't waste time
     
-    ach->dirty = true;
     ach->ach.set_achieved(false);
+    queue_update(steamIDUser, ach);
 
     if (settings->immediate_gameserver_stats) collect_and_send_updated_user_stats();
     
@@ -391,54 +455,63 @@ void Steam_GameServerStats::remove_timedout_userstats_requests()
 
 void Steam_GameServerStats::collect_and_send_updated_user_stats()
 {
-	std::map<uint64, UserData> updated_users_data{}; // new data to send
+    if (dirty_users.empty()) return;
 
-    // collect new data
-    for (auto &this_user : all_users_data) { // foreach user
-        uint64 user_steamid = this_user.first;
+    last_sync = std::chrono::high_resolution_clock::now();
+    for (uint64 user_steamid : dirty_users) {
+        auto it_user = all_users_data.find(user_steamid);
+        if (all_users_data.end() == it_user) continue; // disconnected
+
+        auto &user = it_user->second;
+        auto updated_stats_msg = new GameServerStats_Messages::StatsDelta();
 
         // collect changed stats
-        for (auto &user_stat : this_user.second.stats) {
-            if (user_stat.second.dirty) {
-                user_stat.second.dirty = false;
-                updated_users_data[user_steamid].stats[user_stat.first] = user_stat.second;
-                // clear this to avoid sending it to the user next time
-                if (user_stat.second.stat.has_value_avg()) user_stat.second.stat.clear_value_avg();
-            }
+        auto &updated_stats_map = *updated_stats_msg->mutable_user_stats();
+        for (uint32 id : user.dirty_stats) {
+            auto it_stat = user.stats.find(id);
+            // the user might have sent a newer value in the meantime
+            if (user.stats.end() == it_stat || !it_stat->second.dirty) continue;
+
+            it_stat->second.dirty = false;
+            updated_stats_map[id] = it_stat->second.stat;
+            // clear this to avoid sending it to the user next time
+            if (it_stat->second.stat.has_value_avg()) it_stat->second.stat.clear_value_avg();
         }
 
         // collect changed achievements
-        for (auto &user_ach : this_user.second.achievements) {
-            if (user_ach.second.dirty) {
-                user_ach.second.dirty = false;
-                updated_users_data[user_steamid].achievements[user_ach.first] = user_ach.second;
-            }
+        auto &updated_achs_map = *updated_stats_msg->mutable_user_achievements();
+        for (uint32 id : user.dirty_achievements) {
+            auto it_ach = user.achievements.find(id);
+            if (user.achievements.end() == it_ach || !it_ach->second.dirty) continue;
+
+            it_ach->second.dirty = false;
+            updated_achs_map[id] = it_ach->second.ach;
         }
-    }
 
-    // send new user stats
-    for (auto &user_new_data : updated_users_data) { // foreach user
-        uint64 user_steamid = user_new_data.first;
-        const auto &new_data = user_new_data.second;
-        auto updated_stats_msg = new GameServerStats_Messages::AllStats();
+        user.dirty_stats.clear();
+        user.dirty_achievements.clear();
+        user.queued = false;
 
-        // copy new stats
-        auto &updated_stats_map = *updated_stats_msg->mutable_user_stats();
-        for (auto &new_stat : new_data.stats) {
-            updated_stats_map[new_stat.first] = new_stat.second.stat;
-            
+        if (updated_stats_map.empty() && updated_achs_map.empty()) {
+            delete updated_stats_msg;
+            continue;
         }
 
-        // copy new achievements
-        auto &updated_achs_map = *updated_stats_msg->mutable_user_achievements();
-        for (auto &new_ach : new_data.achievements) {
-            updated_achs_map[new_ach.first] = new_ach.second.ach;
-            
-        }
-        
         auto gameserverstats_msg = new GameServerStats_Messages();
         gameserverstats_msg->set_type(GameServerStats_Messages::UpdateUserStatsFromServer);
-        gameserverstats_msg->set_allocated_update_user_stats(updated_stats_msg);
+        if (user.supports_delta) {
+            gameserverstats_msg->set_allocated_update_user_stats_delta(updated_stats_msg);
+        } else {
+            // older builds only understand names
+            auto all_stats_msg = new GameServerStats_Messages::AllStats();
+            for (const auto &stat : updated_stats_msg->user_stats()) {
+                (*all_stats_msg->mutable_user_stats())[user.stats[stat.first].name] = stat.second;
+            }
+            for (const auto &ach : updated_stats_msg->user_achievements()) {
+                (*all_stats_msg->mutable_user_achievements())[user.achievements[ach.first].name] = ach.second;
+            }
+            gameserverstats_msg->set_allocated_update_user_stats(all_stats_msg);
+        }
         
         Common_Message msg{};
         // https://protobuf.dev/reference/cpp/cpp-generated/#string
@@ -449,16 +522,20 @@ void Steam_GameServerStats::collect_and_send_updated_user_stats()
         network->sendTo(&msg, true);
 
         PRINT_DEBUG("server sent updated stats %llu: %zu stats, %zu achievements",
-            user_steamid, updated_stats_msg->user_stats().size(), updated_stats_msg->user_achievements().size()
+            user_steamid, updated_stats_map.size(), updated_achs_map.size()
         );
+        if (!user.supports_delta) delete updated_stats_msg;
     }
 
+    dirty_users.clear();
 }
 
 void Steam_GameServerStats::steam_run_callback()
 {
     remove_timedout_userstats_requests();
-    collect_and_send_updated_user_stats();
+    if (check_timedout(last_sync, settings->gameserver_stats_sync_interval_ms / 1000.0)) {
+        collect_and_send_updated_user_stats();
+    }
 }
 
 
@@ -471,8 +548,9 @@ void Steam_GameServerStats::network_callback_initial_stats(Common_Message *msg)
     uint64 user_steamid = msg->source_id();
 
     PRINT_DEBUG("player sent all their stats %llu", user_steamid);
-    if (!msg->gameserver_stats_messages().has_initial_user_stats() ||
-        !msg->gameserver_stats_messages().initial_user_stats().has_all_data()) {
+    if (!msg->gameserver_stats_messages().has_initial_user_stats() || (
+        !msg->gameserver_stats_messages().initial_user_stats().has_all_data() &&
+        !msg->gameserver_stats_messages().initial_user_stats().has_all_data_delta())) {
         PRINT_DEBUG("error empty msg");
         return;
     }
@@ -493,31 +571,30 @@ void Steam_GameServerStats::network_callback_initial_stats(Common_Message *msg)
     }
 
     // remove this pending request
+    SteamAPICall_t steam_api_call = it->steamAPICall;
     pending_RequestUserStats.erase(it);
     
-    // copy new stats
-    auto &current_stats = all_users_data[user_steamid].stats;
-    current_stats.clear();
-    for (const auto &new_stat : new_data.all_data().user_stats()) {
-        current_stats[new_stat.first].stat = new_stat.second;
-    }
-    
-    // copy new achievements
-    auto &current_achievements = all_users_data[user_steamid].achievements;
-    current_achievements.clear();
-    for (const auto &new_ach : new_data.all_data().user_achievements()) {
-        current_achievements[new_ach.first].ach = new_ach.second;
+    // start over, the user sent the full table of ids
+    auto &user = all_users_data[user_steamid];
+    bool queued = user.queued;
+    user = UserData{};
+    user.queued = queued;
+    if (new_data.has_all_data_delta()) {
+        user.supports_delta = true;
+        apply_user_stats(user, new_data.all_data_delta());
+    } else {
+        apply_user_stats(user, new_data.all_data());
     }
 
     GSStatsReceived_t data{};
     data.m_eResult = EResult::k_EResultOK;
     data.m_steamIDUser = user_steamid;
 
-    callback_results->addCallResult(it->steamAPICall, data.k_iCallback, &data, sizeof(data));
+    callback_results->addCallResult(steam_api_call, data.k_iCallback, &data, sizeof(data));
     callbacks->addCBResult(data.k_iCallback, &data, sizeof(data));
     
     PRINT_DEBUG("server got all player stats %llu: %zu stats, %zu achievements",
-        user_steamid, all_users_data[user_steamid].stats.size(), all_users_data[user_steamid].achievements.size()
+        user_steamid, user.stats.size(), user.achievements.size()
     );
 
     
@@ -529,31 +606,25 @@ void Steam_GameServerStats::network_callback_updated_stats(Common_Message *msg)
     uint64 user_steamid = msg->source_id();
 
     PRINT_DEBUG("player sent updated stats %llu", user_steamid);
-    if (!msg->gameserver_stats_messages().has_update_user_stats()) {
-        PRINT_DEBUG("error empty msg");
-        return;
-    }
-
-    auto &current_user_data = all_users_data[user_steamid];
-    auto &new_user_data =msg->gameserver_stats_messages().update_user_stats();
-
-    // update stats
-    for (auto &new_stat : new_user_data.user_stats()) {
-        auto &current_stat = current_user_data.stats[new_stat.first];
-        current_stat.dirty = false;
-        current_stat.stat = new_stat.second;
-    }
+    if (msg->gameserver_stats_messages().has_update_user_stats_delta()) {
+        auto &new_user_data = msg->gameserver_stats_messages().update_user_stats_delta();
+        auto &user = all_users_data[user_steamid];
+        user.supports_delta = true;
+        apply_user_stats(user, new_user_data);
+
+        PRINT_DEBUG("got updated user stats %llu: %zu stats, %zu achievements",
+            user_steamid, new_user_data.user_stats().size(), new_user_data.user_achievements().size()
+        );
+    } else if (msg->gameserver_stats_messages().has_update_user_stats()) {
+        auto &new_user_data = msg->gameserver_stats_messages().update_user_stats();
+        apply_user_stats(all_users_data[user_steamid], new_user_data);
 
-    // update achievements
-    for (auto &new_ach : new_user_data.user_achievements()) {
-        auto &current_ach = current_user_data.achievements[new_ach.first];
-        current_ach.dirty = false;
-        current_ach.ach = new_ach.second;
+        PRINT_DEBUG("got updated user stats (by name) %llu: %zu stats, %zu achievements",
+            user_steamid, new_user_data.user_stats().size(), new_user_data.user_achievements().size()
+        );
+    } else {
+        PRINT_DEBUG("error empty msg");
     }
-    
-    PRINT_DEBUG("got updated user stats %llu: %zu stats, %zu achievements",
-        user_steamid, new_user_data.user_stats().size(), new_user_data.user_achievements().size()
-    );
 }
 
 // only triggered when we have a message
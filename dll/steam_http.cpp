@@ -17,12 +17,72 @@
 
 #include "dll/steam_http.h"
 
-Steam_HTTP::Steam_HTTP(class Settings *settings, class Networking *network, class SteamCallResults *callback_results, class SteamCallBacks *callbacks)
+// max amount of online requests downloading at the same time, the rest wait in 'http_pending'
+#define HTTP_MAX_ACTIVE_TRANSFERS 8
+// max time the HTTP thread sleeps when there's no socket activity
+#define HTTP_THREAD_WAIT_MS 1000
+
+// replaces the scheme and host of 'url' with 'base_url' (no trailing '/'), the path and query are kept
+static std::string override_base_url(const std::string &url, const std::string &base_url)
+{
+    if (base_url.empty()) return url;
+
+    auto authority = url.find("://");
+    if (std::string::npos == authority) return url;
+
+    auto path = url.find_first_of("/?#", authority + 3);
+    if (std::string::npos == path) return base_url;
+    if (url[path] != '/') return base_url + "/" + url.substr(path);
+
+    return base_url + url.substr(path);
+}
+
+void Steam_HTTP::steam_run_every_runcb(void *object)
+{
+    // PRINT_DEBUG_ENTRY();
+
+    auto inst = (Steam_HTTP *)object;
+    inst->RunCallbacks();
+}
+
+Steam_HTTP::Steam_HTTP(class Settings *settings, class Networking *network, class SteamCallResults *callback_results, class SteamCallBacks *callbacks, class RunEveryRunCB *run_every_runcb)
 {
     this->settings = settings;
     this->network = network;
     this->callback_results = callback_results;
     this->callbacks = callbacks;
+    this->run_every_runcb = run_every_runcb;
+
+    this->run_every_runcb->add(&Steam_HTTP::steam_run_every_runcb, this);
+}
+
+Steam_HTTP::~Steam_HTTP()
+{
+    this->run_every_runcb->remove(&Steam_HTTP::steam_run_every_runcb, this);
+
+    if (http_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(http_mutex);
+            http_thread_stop = true;
+        }
+        curl_multi_wakeup(http_multi);
+        http_thread.join();
+    }
+
+    for (auto t : http_done) {
+        delete t;
+    }
+    http_done.clear();
+
+    for (auto t : http_streamed_done) {
+        delete t;
+    }
+    http_streamed_done.clear();
+
+    if (http_multi) {
+        curl_multi_cleanup(http_multi);
+        http_multi = nullptr;
+    }
 }
 
 Steam_Http_Request *Steam_HTTP::get_request(HTTPRequestHandle hRequest)
@@ -286,88 +346,57 @@ static int curl_debug_trace(
 }
 
 
-void Steam_HTTP::online_http_request(Steam_Http_Request *request, SteamAPICall_t call_res_id)
+void Steam_HTTP::send_request_completed(Steam_Http_Request *request, SteamAPICall_t call_res_id)
 {
-    PRINT_DEBUG("attempting to download from url: '%s', target filepath: '%s'",
-        request->url.c_str(), request->target_filepath.c_str());
-
-    const auto send_callresult = [=]() -> void {
-        struct HTTPRequestCompleted_t data{};
-        data.m_hRequest = request->handle;
-        data.m_ulContextValue = request->context_value;
-        data.m_unBodySize = static_cast<uint32>(request->response.size());
-        if (request->response.empty() && !settings->force_steamhttp_success) {
-            data.m_bRequestSuccessful = false;
-            data.m_eStatusCode = k_EHTTPStatusCode404NotFound;
-        } else {
-            data.m_bRequestSuccessful = true;
-            data.m_eStatusCode = k_EHTTPStatusCode200OK;
-        }
-
-        callback_results->addCallResult(call_res_id, data.k_iCallback, &data, sizeof(data));
-        callbacks->addCBResult(data.k_iCallback, &data, sizeof(data));
-    };
-
-    std::size_t filename_part = request->target_filepath.find_last_of("\\/");
-    std::string directory_path{};
-    std::string file_name{};
-    if (filename_part != std::string::npos) {
-        filename_part += 1; // point at filename, not the '/' or '\'
-        directory_path = request->target_filepath.substr(0, filename_part);
-        file_name = request->target_filepath.substr(filename_part);
+    struct HTTPRequestCompleted_t data{};
+    data.m_hRequest = request->handle;
+    data.m_ulContextValue = request->context_value;
+    data.m_unBodySize = static_cast<uint32>(request->response.size());
+    if (request->response.empty() && !settings->force_steamhttp_success) {
+        data.m_bRequestSuccessful = false;
+        data.m_eStatusCode = k_EHTTPStatusCode404NotFound;
     } else {
-        directory_path = ".";
-        file_name = request->target_filepath;
+        data.m_bRequestSuccessful = true;
+        data.m_eStatusCode = k_EHTTPStatusCode200OK;
     }
-    PRINT_DEBUG("directory: '%s', filename '%s'", directory_path.c_str(), file_name.c_str());
-    Local_Storage::store_file_data(directory_path, file_name, (char *)"", sizeof("")); // create empty file
 
-    FILE *hfile = nullptr;
+    callback_results->addCallResult(call_res_id, data.k_iCallback, &data, sizeof(data));
+    callbacks->addCBResult(data.k_iCallback, &data, sizeof(data));
+}
 
-    {
-        const auto fsp = std::filesystem::u8path(request->target_filepath);
-#if defined(__WINDOWS__)
-        // TODO use "\\?\" to solve max path problem
-        // https://learn.microsoft.com/en-us/windows/win32/fileio/maximum-file-path-limitation
-        // note that this bypasses the NT object manager, note from above link:
-        // "File I/O functions in the Windows API convert "/" to "\" as part of converting the name to an NT-style name, except when using the "\\?\" prefix"
-        hfile = _wfopen(fsp.c_str(), L"wb");
-#else
-        hfile = std::fopen(fsp.c_str(), "wb");
-#endif
-    }
+// sets up the curl handle of an online request, the transfer is started later by the HTTP thread
+Steam_Http_Transfer *Steam_HTTP::create_transfer(Steam_Http_Request *request, SteamAPICall_t call_res_id)
+{
+    PRINT_DEBUG("attempting to download from url: '%s', target filepath: '%s'",
+        request->url.c_str(), request->target_filepath.c_str());
 
-    if (!hfile) {
-        PRINT_DEBUG("failed to open file for writing");
-        send_callresult();
-        return;
-    }
     CURL *chttp = curl_easy_init();
     if (!chttp) {
-        fclose(hfile);
         PRINT_DEBUG("curl_easy_init() failed");
-        send_callresult();
-        return;
+        return nullptr;
     }
 
+    Steam_Http_Transfer *transfer = new Steam_Http_Transfer();
+    transfer->handle = request->handle;
+    transfer->call_res_id = call_res_id;
+    transfer->streaming = request->streaming;
+    transfer->curl = chttp;
+    transfer->target_filepath = request->target_filepath;
+    transfer->url = override_base_url(request->url, settings->steamhttp_base_url_override);
+    if (transfer->url != request->url) PRINT_DEBUG("url overridden to '%s'", transfer->url.c_str());
+
 #ifndef EMU_RELEASE_BUILD
     curl_easy_setopt(chttp, CURLOPT_DEBUGFUNCTION, curl_debug_trace);
     curl_easy_setopt(chttp, CURLOPT_VERBOSE, 1L);
 #endif
     
     // headers
-    std::vector<std::string> headers{};
+    struct curl_slist *headers_list = nullptr;
     for (const auto &hdr : request->headers) {
         std::string new_header = hdr.first + ": " + hdr.second;
         PRINT_DEBUG("CURL header: '%s'", new_header.c_str());
-        headers.push_back(new_header);
+        headers_list = curl_slist_append(headers_list, new_header.c_str());
     }
-
-    struct curl_slist *headers_list = nullptr;
-    for (const auto &hrd : headers) {
-        headers_list = curl_slist_append(headers_list, hrd.c_str());
-    }
-    curl_easy_setopt(chttp, CURLOPT_HTTPHEADER, headers_list);
     
     // request method
     switch (request->request_method)
@@ -414,9 +443,16 @@ void Steam_HTTP::online_http_request(Steam_Http_Request *request, SteamAPICall_t
     default:
         break;
     }
+
+    transfer->headers_list = headers_list;
+    curl_easy_setopt(chttp, CURLOPT_HTTPHEADER, headers_list);
     
     curl_easy_setopt(chttp, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(chttp, CURLOPT_WRITEDATA, (void *)hfile);
+    curl_easy_setopt(chttp, CURLOPT_WRITEFUNCTION, &Steam_HTTP::transfer_write);
+    curl_easy_setopt(chttp, CURLOPT_WRITEDATA, (void *)transfer);
+    curl_easy_setopt(chttp, CURLOPT_HEADERFUNCTION, &Steam_HTTP::transfer_header);
+    curl_easy_setopt(chttp, CURLOPT_HEADERDATA, (void *)transfer);
+    curl_easy_setopt(chttp, CURLOPT_PRIVATE, (void *)transfer);
     curl_easy_setopt(chttp, CURLOPT_TIMEOUT, request->timeout_sec);
     curl_easy_setopt(chttp, CURLOPT_NOSIGNAL, 1L);
     curl_easy_setopt(chttp, CURLOPT_USE_SSL, request->requires_valid_ssl ? CURLUSESSL_TRY : CURLUSESSL_NONE);
@@ -436,37 +472,339 @@ void Steam_HTTP::online_http_request(Steam_Http_Request *request, SteamAPICall_t
         }
         if (post_data.size()) post_data = post_data.substr(0, post_data.size() - 1); // remove the last "&"
         if (request->request_method == EHTTPMethod::k_EHTTPMethodGET) {
-            request->url += "?" + post_data;
-            PRINT_DEBUG("GET URL with params (url-encoded): '%s'", request->url.c_str());
+            transfer->url += "?" + post_data;
+            PRINT_DEBUG("GET URL with params (url-encoded): '%s'", transfer->url.c_str());
         } else {
             PRINT_DEBUG("POST form data (url-encoded): '%s'", post_data.c_str());
-            curl_easy_setopt(chttp, CURLOPT_POSTFIELDS, post_data.c_str());
+            curl_easy_setopt(chttp, CURLOPT_POSTFIELDSIZE, (long)post_data.size());
+            curl_easy_setopt(chttp, CURLOPT_COPYPOSTFIELDS, post_data.c_str());
         }
     } else if (request->post_raw.size()) {
         PRINT_DEBUG("POST form data (raw): '%s'", request->post_raw.c_str());
-        curl_easy_setopt(chttp, CURLOPT_POSTFIELDS, request->post_raw.c_str());
+        curl_easy_setopt(chttp, CURLOPT_POSTFIELDSIZE, (long)request->post_raw.size());
+        curl_easy_setopt(chttp, CURLOPT_COPYPOSTFIELDS, request->post_raw.c_str());
     }
 
-    curl_easy_setopt(chttp, CURLOPT_URL, request->url.c_str());
-    
-    CURLcode res_curl = curl_easy_perform(chttp);
-    curl_slist_free_all(headers_list);
-    curl_easy_cleanup(chttp);
+    curl_easy_setopt(chttp, CURLOPT_URL, transfer->url.c_str());
+    return transfer;
+}
 
-    fclose(hfile);
-    headers.clear();
+// called by curl on the HTTP thread
+size_t Steam_HTTP::transfer_write(char *data, size_t size, size_t count, void *object)
+{
+    Steam_Http_Transfer *transfer = (Steam_Http_Transfer *)object;
+    size_t bytes = size * count;
+    if (transfer->hfile && bytes) {
+        fwrite(data, 1, bytes, transfer->hfile);
+    }
 
-    PRINT_DEBUG("CURL error code for '%s' [%i = '%s'] (OK == 0)", request->url.c_str(), (int)res_curl, curl_easy_strerror(res_curl));
-    
-    unsigned int file_size = file_size_(request->target_filepath);
-    if (file_size) {
-        request->response.resize(static_cast<size_t>(file_size));
-        long long read = Local_Storage::get_file_data(request->target_filepath, (char *)&request->response[0], file_size);
-        if (read < 0) read = 0;
-        request->response.resize(static_cast<size_t>(read));
+    transfer->body.append(data, bytes);
+    return bytes;
+}
+
+// called by curl on the HTTP thread for each header line, an empty line ends the headers of a response
+size_t Steam_HTTP::transfer_header(char *data, size_t size, size_t count, void *object)
+{
+    Steam_Http_Transfer *transfer = (Steam_Http_Transfer *)object;
+    size_t bytes = size * count;
+    std::string line(data, bytes);
+
+    if (line != "\r\n" && line != "\n") {
+        // curl follows redirects, their headers aren't the ones of the response
+        if (common_helpers::starts_with_i(line, "location:")) transfer->redirecting = true;
+        return bytes;
+    }
+
+    long code = 0;
+    curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &code);
+    bool interim = code >= 100 && code < 200;
+    bool redirect = code >= 300 && code < 400 && transfer->redirecting;
+    transfer->redirecting = false;
+    if (!interim && !redirect) transfer->headers_done = true;
+
+    return bytes;
+}
+
+// opens the target file and hands the transfer to curl, runs on the HTTP thread
+bool Steam_HTTP::start_transfer(Steam_Http_Transfer *transfer)
+{
+    std::size_t filename_part = transfer->target_filepath.find_last_of("\\/");
+    std::string directory_path{};
+    std::string file_name{};
+    if (filename_part != std::string::npos) {
+        filename_part += 1; // point at filename, not the '/' or '\'
+        directory_path = transfer->target_filepath.substr(0, filename_part);
+        file_name = transfer->target_filepath.substr(filename_part);
+    } else {
+        directory_path = ".";
+        file_name = transfer->target_filepath;
+    }
+    PRINT_DEBUG("directory: '%s', filename '%s'", directory_path.c_str(), file_name.c_str());
+    Local_Storage::store_file_data(directory_path, file_name, (char *)"", sizeof("")); // create empty file
+
+    {
+        const auto fsp = std::filesystem::u8path(transfer->target_filepath);
+#if defined(__WINDOWS__)
+        // TODO use "\\?\" to solve max path problem
+        // https://learn.microsoft.com/en-us/windows/win32/fileio/maximum-file-path-limitation
+        // note that this bypasses the NT object manager, note from above link:
+        // "File I/O functions in the Windows API convert "/" to "\" as part of converting the name to an NT-style name, except when using the "\\?\" prefix"
+        transfer->hfile = _wfopen(fsp.c_str(), L"wb");
+#else
+        transfer->hfile = std::fopen(fsp.c_str(), "wb");
+#endif
+    }
+
+    if (!transfer->hfile) {
+        PRINT_DEBUG("failed to open file for writing");
+        transfer->result = CURLE_WRITE_ERROR;
+        return false;
+    }
+
+    CURLMcode res = curl_multi_add_handle(http_multi, transfer->curl);
+    if (res != CURLM_OK) {
+        PRINT_DEBUG("curl_multi_add_handle() failed %i", (int)res);
+        transfer->result = CURLE_FAILED_INIT;
+        return false;
+    }
+
+    return true;
+}
+
+// frees the curl resources of a transfer, the result stays
+void Steam_HTTP::end_transfer(Steam_Http_Transfer *transfer)
+{
+    if (transfer->hfile) {
+        fclose(transfer->hfile);
+        transfer->hfile = nullptr;
+    }
+
+    if (transfer->curl) {
+        curl_easy_cleanup(transfer->curl);
+        transfer->curl = nullptr;
+    }
+
+    if (transfer->headers_list) {
+        curl_slist_free_all(transfer->headers_list);
+        transfer->headers_list = nullptr;
+    }
+}
+
+void Steam_HTTP::http_thread_proc()
+{
+    PRINT_DEBUG("HTTP thread started");
+    std::vector<Steam_Http_Transfer *> to_start{};
+    std::vector<Steam_Http_Transfer *> finished{};
+
+    std::unique_lock<std::mutex> lock(http_mutex);
+    while (!http_thread_stop) {
+        // drop the released requests
+        for (auto it = http_active.begin(); it != http_active.end();) {
+            Steam_Http_Transfer *transfer = *it;
+            if (transfer->cancelled) {
+                PRINT_DEBUG("cancelled transfer %u", transfer->handle);
+                curl_multi_remove_handle(http_multi, transfer->curl);
+                end_transfer(transfer);
+                delete transfer;
+                it = http_active.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        while (http_active.size() < HTTP_MAX_ACTIVE_TRANSFERS && http_pending.size()) {
+            Steam_Http_Transfer *transfer = http_pending.front();
+            http_pending.pop_front();
+            if (transfer->cancelled) {
+                end_transfer(transfer);
+                delete transfer;
+                continue;
+            }
+
+            // active before the lock is released, so ReleaseHTTPRequest() can always find it
+            http_active.push_back(transfer);
+            to_start.push_back(transfer);
+        }
+
+        lock.unlock();
+
+        for (auto transfer : to_start) {
+            if (!start_transfer(transfer)) {
+                end_transfer(transfer);
+                finished.push_back(transfer);
+            }
+        }
+
+        int running = 0;
+        curl_multi_perform(http_multi, &running);
+
+        CURLMsg *msg;
+        int msgs_left = 0;
+        while ((msg = curl_multi_info_read(http_multi, &msgs_left))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+
+            Steam_Http_Transfer *transfer = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&transfer);
+            transfer->result = msg->data.result;
+            PRINT_DEBUG("CURL error code for '%s' [%i = '%s'] (OK == 0)", transfer->url.c_str(), (int)transfer->result, curl_easy_strerror(transfer->result));
+            curl_multi_remove_handle(http_multi, transfer->curl);
+            end_transfer(transfer);
+            finished.push_back(transfer);
+        }
+
+        lock.lock();
+        to_start.clear();
+
+        for (auto transfer : finished) {
+            if (transfer->streaming && transfer->headers_done && !transfer->headers_reported && !transfer->cancelled) {
+                transfer->headers_reported = true;
+                http_headers_received.push_back(transfer->handle);
+            }
+
+            auto active = std::find(http_active.begin(), http_active.end(), transfer);
+            if (active != http_active.end()) http_active.erase(active);
+
+            if (transfer->cancelled) {
+                delete transfer;
+            } else {
+                http_done.push_back(transfer);
+            }
+        }
+        finished.clear();
+
+        // streaming requests get their data as soon as it arrives
+        for (auto transfer : http_active) {
+            if (transfer->streaming && transfer->headers_done && !transfer->headers_reported) {
+                transfer->headers_reported = true;
+                http_headers_received.push_back(transfer->handle);
+            }
+
+            if (transfer->streaming && transfer->body.size()) {
+                http_stream_data.emplace_back(transfer->handle, std::move(transfer->body));
+                transfer->body.clear();
+            }
+        }
+
+        if (http_pending.size() && http_active.size() < HTTP_MAX_ACTIVE_TRANSFERS) continue;
+
+        lock.unlock();
+        curl_multi_poll(http_multi, nullptr, 0, HTTP_THREAD_WAIT_MS, nullptr);
+        lock.lock();
+    }
+
+    for (auto transfer : http_active) {
+        curl_multi_remove_handle(http_multi, transfer->curl);
+        end_transfer(transfer);
+        delete transfer;
+    }
+    http_active.clear();
+
+    for (auto transfer : http_pending) {
+        end_transfer(transfer);
+        delete transfer;
+    }
+    http_pending.clear();
+
+    PRINT_DEBUG("HTTP thread stopped");
+}
+
+void Steam_HTTP::queue_online_request(Steam_Http_Request *request, SteamAPICall_t call_res_id)
+{
+    Steam_Http_Transfer *transfer = create_transfer(request, call_res_id);
+    if (!transfer) {
+        send_request_completed(request, call_res_id);
+        return;
+    }
+
+    if (!http_thread.joinable()) {
+        http_multi = curl_multi_init();
+        if (!http_multi) {
+            PRINT_DEBUG("curl_multi_init() failed");
+            end_transfer(transfer);
+            delete transfer;
+            send_request_completed(request, call_res_id);
+            return;
+        }
+
+        http_thread = std::thread(&Steam_HTTP::http_thread_proc, this);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(http_mutex);
+        http_pending.push_back(transfer);
+    }
+    curl_multi_wakeup(http_multi);
+}
+
+void Steam_HTTP::RunCallbacks()
+{
+    std::vector<Steam_Http_Transfer *> done{};
+    std::vector<std::pair<HTTPRequestHandle, std::string>> stream_data{};
+    std::vector<HTTPRequestHandle> headers_received{};
+    // the call result of an online request was reserved when it was sent, it runs as soon as it's set,
+    // the headers and data are posted without a delay and the streaming requests complete one frame later
+    // so the game gets all of their data before the completion
+    std::vector<Steam_Http_Transfer *> streamed_done{};
+    streamed_done.swap(http_streamed_done);
+    {
+        std::lock_guard<std::mutex> lock(http_mutex);
+        // the headers and data must be handled first, they were received before the transfers ended
+        headers_received.swap(http_headers_received);
+        stream_data.swap(http_stream_data);
+        done.swap(http_done);
+    }
+
+    for (auto handle : headers_received) {
+        Steam_Http_Request *request = get_request(handle);
+        if (!request || request->headers_received) continue;
+
+        request->headers_received = true;
+        HTTPRequestHeadersReceived_t data{};
+        data.m_hRequest = request->handle;
+        data.m_ulContextValue = request->context_value;
+        callbacks->addCBResult(data.k_iCallback, &data, sizeof(data), 0.0);
+    }
+
+    const auto send_data_received = [this](Steam_Http_Request *request, std::string &&chunk) {
+        HTTPRequestDataReceived_t data{};
+        data.m_hRequest = request->handle;
+        data.m_ulContextValue = request->context_value;
+        data.m_cOffset = static_cast<uint32>(request->response.size());
+        data.m_cBytesReceived = static_cast<uint32>(chunk.size());
+        request->response.append(chunk);
+        callbacks->addCBResult(data.k_iCallback, &data, sizeof(data), 0.0);
+    };
+
+    for (auto &chunk : stream_data) {
+        Steam_Http_Request *request = get_request(chunk.first);
+        if (!request) continue;
+
+        send_data_received(request, std::move(chunk.second));
+    }
+
+    for (auto transfer : streamed_done) {
+        Steam_Http_Request *request = get_request(transfer->handle);
+        if (request) send_request_completed(request, transfer->call_res_id);
+
+        delete transfer;
+    }
+
+    for (auto transfer : done) {
+        Steam_Http_Request *request = get_request(transfer->handle);
+        if (request) {
+            request->timed_out = transfer->result == CURLE_OPERATION_TIMEDOUT;
+            if (transfer->streaming) {
+                if (transfer->body.size()) send_data_received(request, std::move(transfer->body));
+                http_streamed_done.push_back(transfer);
+                continue;
+            }
+
+            request->response = std::move(transfer->body);
+            send_request_completed(request, transfer->call_res_id);
+        }
+
+        delete transfer;
     }
-    
-    send_callresult();
 }
 
 // Sends the HTTP request, will return false on a bad handle, otherwise use SteamCallHandle to wait on
@@ -479,11 +817,18 @@ bool Steam_HTTP::SendHTTPRequest( HTTPRequestHandle hRequest, SteamAPICall_t *pC
     PRINT_DEBUG("%u %p", hRequest, pCallHandle);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
 
+    return send_request(hRequest, pCallHandle, false);
+}
+
+bool Steam_HTTP::send_request(HTTPRequestHandle hRequest, SteamAPICall_t *pCallHandle, bool streaming)
+{
     Steam_Http_Request *request = get_request(hRequest);
     if (!request) {
         return false;
     }
 
+    request->sent = true;
+    request->streaming = streaming;
     switch (request->protocol)
     {
     case Steam_Http_Request::Protocol_t::Web: {
@@ -493,8 +838,24 @@ bool Steam_HTTP::SendHTTPRequest( HTTPRequestHandle hRequest, SteamAPICall_t *pC
             auto call_res_id = callback_results->reserveCallResult();
             if (pCallHandle) *pCallHandle = call_res_id;
 
-            std::thread(&Steam_HTTP::online_http_request, this, request, call_res_id).detach();
+            queue_online_request(request, call_res_id);
         } else {
+            if (streaming && request->response.size()) {
+                // local responses are available right away
+                request->headers_received = true;
+                HTTPRequestHeadersReceived_t headers_data{};
+                headers_data.m_hRequest = request->handle;
+                headers_data.m_ulContextValue = request->context_value;
+                callbacks->addCBResult(headers_data.k_iCallback, &headers_data, sizeof(headers_data), 0.1);
+
+                HTTPRequestDataReceived_t received_data{};
+                received_data.m_hRequest = request->handle;
+                received_data.m_ulContextValue = request->context_value;
+                received_data.m_cOffset = 0;
+                received_data.m_cBytesReceived = static_cast<uint32>(request->response.size());
+                callbacks->addCBResult(received_data.k_iCallback, &received_data, sizeof(received_data), 0.1);
+            }
+
             struct HTTPRequestCompleted_t data{};
             data.m_hRequest = request->handle;
             data.m_ulContextValue = request->context_value;
@@ -564,15 +925,14 @@ bool Steam_HTTP::SendHTTPRequest( HTTPRequestHandle hRequest, SteamAPICall_t *pC
 // HTTPRequestDataReceived_t callbacks while streaming.
 bool Steam_HTTP::SendHTTPRequestAndStreamResponse( HTTPRequestHandle hRequest, SteamAPICall_t *pCallHandle )
 {
-    // TODO this function triggers 3 callbacks:
     // https://partner.steamgames.com/doc/api/ISteamHTTP#SendHTTPRequestAndStreamResponse
     // Triggers a HTTPRequestDataReceived_t callback.
     // Triggers a HTTPRequestHeadersReceived_t callback.
     // Triggers a HTTPRequestCompleted_t callback. 
-    PRINT_DEBUG_TODO();
+    PRINT_DEBUG("%u %p", hRequest, pCallHandle);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
 
-    return SendHTTPRequest(hRequest, pCallHandle);
+    return send_request(hRequest, pCallHandle, true);
 }
 
 
@@ -580,14 +940,22 @@ bool Steam_HTTP::SendHTTPRequestAndStreamResponse( HTTPRequestHandle hRequest, S
 // the specified request to the tail of the queue.  Returns false on invalid handle, or if the request is not yet sent.
 bool Steam_HTTP::DeferHTTPRequest( HTTPRequestHandle hRequest )
 {
-    PRINT_DEBUG_ENTRY();
+    PRINT_DEBUG("%u", hRequest);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
 
     Steam_Http_Request *request = get_request(hRequest);
-    if (!request) {
+    if (!request || !request->sent) {
         return false;
     }
 
+    std::lock_guard<std::mutex> http_lock(http_mutex);
+    auto transfer = std::find_if(http_pending.begin(), http_pending.end(), [hRequest](Steam_Http_Transfer *item) { return item->handle == hRequest; });
+    if (transfer != http_pending.end()) {
+        Steam_Http_Transfer *deferred = *transfer;
+        http_pending.erase(transfer);
+        http_pending.push_back(deferred);
+    }
+
     return true;
 }
 
@@ -600,10 +968,18 @@ bool Steam_HTTP::PrioritizeHTTPRequest( HTTPRequestHandle hRequest )
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
 
     Steam_Http_Request *request = get_request(hRequest);
-    if (!request) {
+    if (!request || !request->sent) {
         return false;
     }
 
+    std::lock_guard<std::mutex> http_lock(http_mutex);
+    auto transfer = std::find_if(http_pending.begin(), http_pending.end(), [hRequest](Steam_Http_Transfer *item) { return item->handle == hRequest; });
+    if (transfer != http_pending.end()) {
+        Steam_Http_Transfer *prioritized = *transfer;
+        http_pending.erase(transfer);
+        http_pending.push_front(prioritized);
+    }
+
     return true;
 }
 
@@ -732,6 +1108,18 @@ bool Steam_HTTP::ReleaseHTTPRequest( HTTPRequestHandle hRequest )
     auto c = std::begin(requests);
     while (c != std::end(requests)) {
         if (c->handle == hRequest) {
+            if (c->sent) {
+                // stop the download if it's still running
+                std::lock_guard<std::mutex> http_lock(http_mutex);
+                for (auto transfer : http_pending) {
+                    if (transfer->handle == hRequest) transfer->cancelled = true;
+                }
+                for (auto transfer : http_active) {
+                    if (transfer->handle == hRequest) transfer->cancelled = true;
+                }
+                if (http_multi) curl_multi_wakeup(http_multi);
+            }
+
             c = requests.erase(c);
             return true;
         } else {
@@ -899,6 +1287,6 @@ bool Steam_HTTP::GetHTTPRequestWasTimedOut( HTTPRequestHandle hRequest, bool *pb
         return false;
     }
 
-    if (pbWasTimedOut) *pbWasTimedOut = false;
+    if (pbWasTimedOut) *pbWasTimedOut = request->timed_out;
     return true;
 }
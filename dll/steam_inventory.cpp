@@ -62,11 +62,14 @@ void Steam_Inventory::read_items_db()
 {
     std::string items_db_path = Local_Storage::get_game_settings_path() + items_user_file;
     PRINT_DEBUG("file path: %s", items_db_path.c_str());
+    nlohmann::json defined_items = nlohmann::json::object();
     local_storage->load_json(items_db_path, defined_items);
+    inventory_store.load_definitions(defined_items);
 }
 
 void Steam_Inventory::read_inventory_db()
 {
+    nlohmann::json user_items = nlohmann::json::object();
     // If we havn't got any inventory
     if (!local_storage->load_json_file("", items_user_file, user_items))
     {
@@ -75,6 +78,8 @@ void Steam_Inventory::read_inventory_db()
         PRINT_DEBUG("items file path: %s", items_db_path.c_str());
         local_storage->load_json(items_db_path, user_items);
     }
+
+    inventory_store.load_inventory(user_items);
 }
 
 
@@ -94,9 +99,6 @@ Steam_Inventory::Steam_Inventory(class Settings *settings, class SteamCallResult
     run_every_runcb(run_every_runcb),
     local_storage(local_storage),
 
-    defined_items(nlohmann::json::object()),
-    user_items(nlohmann::json::object()),
-
     inventory_loaded(false),
     call_definition_update(false),
     item_definitions_loaded(false)
@@ -151,6 +153,14 @@ bool Steam_Inventory::GetResultItems( SteamInventoryResult_t resultHandle,
     if (!request->result_done()) return false;
     if (!inventory_loaded) return false;
 
+    const auto &items = inventory_store.get_items();
+    auto fill_item = [](SteamItemDetails_t *item_details, const Inventory_Store::Inventory_Item &item) {
+        item_details->m_itemId = item.id;
+        item_details->m_iDefinition = item.definition;
+        item_details->m_unQuantity = static_cast<uint16>(std::min<uint32>(item.quantity, std::numeric_limits<uint16>::max()));
+        item_details->m_unFlags = k_ESteamItemNoTrade;
+    };
+
     if (pOutItemsArray != nullptr)
     {
         SteamItemDetails_t *items_array_base = pOutItemsArray;
@@ -158,38 +168,16 @@ bool Steam_Inventory::GetResultItems( SteamInventoryResult_t resultHandle,
 
         if (request->full_query) {
             // We end if we reached the end of items or the end of buffer
-            for( auto i = user_items.begin(); i != user_items.end() && max_items; ++i, --max_items )
-            {
-                pOutItemsArray->m_iDefinition = std::stoi(i.key());
-                pOutItemsArray->m_itemId = pOutItemsArray->m_iDefinition;
-                try
-                {
-                    pOutItemsArray->m_unQuantity = i->value("quantity", static_cast<uint16>(0));
-                }
-                catch (...)
-                {
-                    pOutItemsArray->m_unQuantity = 0;
-                }
-                pOutItemsArray->m_unFlags = k_ESteamItemNoTrade;
+            for (auto i = items.begin(); i != items.end() && max_items; ++i, --max_items) {
+                fill_item(pOutItemsArray, *i);
                 ++pOutItemsArray;
             }
         } else {
             for (auto &itemid : request->instance_ids) {
                 if (!max_items) break;
-                auto it = user_items.find(std::to_string(itemid));
-                if (it != user_items.end()) {
-                    pOutItemsArray->m_iDefinition = static_cast<int32>(itemid);
-                    pOutItemsArray->m_itemId = itemid;
-
-                    try
-                    {
-                        pOutItemsArray->m_unQuantity = it->value("quantity", static_cast<uint16>(0));
-                    }
-                    catch (...)
-                    {
-                        pOutItemsArray->m_unQuantity = 0;
-                    }
-                    pOutItemsArray->m_unFlags = k_ESteamItemNoTrade;
+                auto item = inventory_store.find_item(itemid);
+                if (item) {
+                    fill_item(pOutItemsArray, *item);
                     ++pOutItemsArray;
                     --max_items;
                 }
@@ -201,9 +189,9 @@ bool Steam_Inventory::GetResultItems( SteamInventoryResult_t resultHandle,
     else if (punOutItemsArraySize != nullptr)
     {
         if (request->full_query) {
-            *punOutItemsArraySize = static_cast<uint32>(user_items.size());
+            *punOutItemsArraySize = static_cast<uint32>(items.size());
         } else {
-            *punOutItemsArraySize = static_cast<uint32>(std::count_if(request->instance_ids.begin(), request->instance_ids.end(), [this](SteamItemInstanceID_t item_id){ return user_items.find(std::to_string(item_id)) != user_items.end();}));
+            *punOutItemsArraySize = static_cast<uint32>(std::count_if(request->instance_ids.begin(), request->instance_ids.end(), [this](SteamItemInstanceID_t item_id){ return inventory_store.find_item(item_id) != nullptr; }));
         }
     }
 
@@ -474,24 +462,14 @@ bool Steam_Inventory::ConsumeItem( SteamInventoryResult_t *pResultHandle, SteamI
     PRINT_DEBUG("%llu %u", itemConsume, unQuantity);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
 
-    auto it = user_items.find(std::to_string(itemConsume));
-    if (it != user_items.end()) {
-        try
-        {
-            uint32 current = it->get<int>();
-            PRINT_DEBUG("previous %u", current);
-            if (current < unQuantity) unQuantity = current;
-            uint32 result = current - unQuantity;
-            if (result == 0) {
-                user_items.erase(it);
-            } else {
-                *it = result;
-            }
-        }
-        catch (...) {}
+    auto item = inventory_store.find_item(itemConsume);
+    if (!item) return false;
 
-    } else {
-        return false;
+    PRINT_DEBUG("previous %u", item->quantity);
+    if (item->quantity < unQuantity) unQuantity = item->quantity;
+    item->quantity -= unQuantity;
+    if (item->quantity == 0) {
+        inventory_store.remove_item(itemConsume);
     }
 
     struct Steam_Inventory_Requests* request = new_inventory_result(false, &itemConsume, 1);
@@ -632,17 +610,18 @@ bool Steam_Inventory::GetItemDefinitionIDs(
     if (!item_definitions_loaded)
         return false;
 
+    const auto &definitions = inventory_store.get_definitions();
     if (pItemDefIDs == nullptr || *punItemDefIDsArraySize == 0)
     {
-        *punItemDefIDsArraySize = static_cast<uint32>(defined_items.size());
+        *punItemDefIDsArraySize = static_cast<uint32>(definitions.size());
         return true;
     }
 
-    if (*punItemDefIDsArraySize < static_cast<uint32>(defined_items.size()))
+    if (*punItemDefIDsArraySize < static_cast<uint32>(definitions.size()))
         return false;
 
-    for (auto i = defined_items.begin(); i != defined_items.end(); ++i)
-        *pItemDefIDs++ = std::stoi(i.key());
+    for (const auto &definition : definitions)
+        *pItemDefIDs++ = definition.id;
 
     return true;
 }
@@ -663,92 +642,56 @@ bool Steam_Inventory::GetItemDefinitionProperty( SteamItemDef_t iDefinition, con
     PRINT_DEBUG("%i %s", iDefinition, pchPropertyName);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
 
-    auto item = defined_items.find(std::to_string(iDefinition));
-    if (item != defined_items.end())
+    const Inventory_Store::Item_Definition *definition = inventory_store.find_definition(iDefinition);
+    if (!definition) return false;
+
+    // Should I check for punValueBufferSizeOut == nullptr ?
+    std::string names{};
+    std::string_view val{};
+    if (pchPropertyName != nullptr)
     {
-        if (pchPropertyName != nullptr)
+        // Try to get the property
+        const Inventory_Store::Item_Property *property = inventory_store.find_property(*definition, pchPropertyName);
+        // Property not found
+        if (!property)
         {
-            // Should I check for punValueBufferSizeOut == nullptr ?
-            // Try to get the property
-            auto attr = item.value().find(pchPropertyName);
-            if (attr != item.value().end())
-            {
-                std::string val;
-                try
-                {
-                    val = attr.value().get<std::string>();
-                }
-                catch (...)
-                {
-                    pchPropertyName = "";
-                    *punValueBufferSizeOut = 0;
-                    PRINT_DEBUG("  Error, item: %d, attr: %s is not a string!", iDefinition, pchPropertyName);
-                    return true;
-                }
-                if (pchValueBuffer != nullptr)
-                {
-                    // copy what we can
-                    strncpy(pchValueBuffer, val.c_str(), *punValueBufferSizeOut);
-                    *punValueBufferSizeOut = std::min(static_cast<uint32>(val.length() + 1), *punValueBufferSizeOut);
-                }
-                else
-                {
-                    // Set punValueBufferSizeOut to the property size
-                    *punValueBufferSizeOut = static_cast<uint32>(val.length()) + 1;
-                }
-
-                if (pchValueBuffer != nullptr)
-                {
-                    // Make sure we have a null terminator
-                    pchValueBuffer[*punValueBufferSizeOut-1] = '\0';
-                }
-            }
-            // Property not found
-            else
-            {
-                *punValueBufferSizeOut = 0;
-                PRINT_DEBUG("  Attr %s not found for item %d", pchPropertyName, iDefinition);
-                return false;
-            }
+            *punValueBufferSizeOut = 0;
+            PRINT_DEBUG("  Attr %s not found for item %d", pchPropertyName, iDefinition);
+            return false;
         }
-        else // Pass a NULL pointer for pchPropertyName to get a comma - separated list of available property names.
+
+        if (!property->is_string)
         {
-            // If pchValueBuffer is NULL, *punValueBufferSize will contain the suggested buffer size
-            if (pchValueBuffer == nullptr)
-            {
-                // Should I check for punValueBufferSizeOut == nullptr ?
-                *punValueBufferSizeOut = 0;
-                for (auto i = item.value().begin(); i != item.value().end(); ++i)
-                    *punValueBufferSizeOut += static_cast<uint32>(i.key().length()) + 1; // Size of key + comma, and the last is not a comma but null char
-            }
-            else
-            {
-                // strncat always add the null terminator, so remove 1 to the string length
-                uint32_t len = *punValueBufferSizeOut-1;
-                *punValueBufferSizeOut = 0;
-                memset(pchValueBuffer, 0, len);
-                for( auto i = item.value().begin(); i != item.value().end() && len > 0; ++i )
-                {
-                    strncat(pchValueBuffer, i.key().c_str(), len);
-                    // Count how many chars we copied
-                    // Either the string length or the buffer size if its too small
-                    uint32 x = std::min(len, static_cast<uint32>(i.key().length()));
-                    *punValueBufferSizeOut += x;
-                    len -= x;
-
-                    if (len && std::distance(i, item.value().end()) != 1) // If this is not the last item, add a comma
-                        strncat(pchValueBuffer, ",", len--);
-
-                    // Always add 1, its a comma or the null terminator
-                    ++*punValueBufferSizeOut;
-                }
-            }
+            *punValueBufferSizeOut = 0;
+            PRINT_DEBUG("  Error, item: %d, attr: %s is not a string!", iDefinition, pchPropertyName);
+            return true;
         }
 
-        return true;
+        val = inventory_store.get_property_value(*property);
+    }
+    else // Pass a NULL pointer for pchPropertyName to get a comma - separated list of available property names.
+    {
+        names = inventory_store.get_property_names(*definition);
+        val = names;
     }
 
-    return false;
+    if (pchValueBuffer != nullptr)
+    {
+        if (*punValueBufferSizeOut == 0) return true;
+
+        // copy what we can, and make sure we have a null terminator
+        uint32 len = std::min(static_cast<uint32>(val.size()), *punValueBufferSizeOut - 1);
+        memcpy(pchValueBuffer, val.data(), len);
+        pchValueBuffer[len] = '\0';
+        *punValueBufferSizeOut = len + 1;
+    }
+    else
+    {
+        // If pchValueBuffer is NULL, *punValueBufferSize will contain the suggested buffer size
+        *punValueBufferSizeOut = static_cast<uint32>(val.size()) + 1;
+    }
+
+    return true;
 }
 
 
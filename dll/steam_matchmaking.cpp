@@ -18,6 +18,10 @@
 #include "dll/steam_matchmaking.h"
 
 #define SEND_LOBBY_RATE 5.0
+// lobbies are sent whole at this rate, otherwise only the changes are sent
+#define SEND_FULL_LOBBY_RATE 30.0
+// min time between requests for the whole lobby
+#define LOBBY_SYNC_REQUEST_RATE 1.0
 
 #define PENDING_JOIN_TIMEOUT 10.0
 #define REQUEST_LOBBY_DATA_TIMEOUT 6.0
@@ -61,15 +65,223 @@ void Steam_Matchmaking::send_lobby_data()
         PRINT_DEBUG("lobbies %zu", lobbies.size());
     }
 
+    bool full = check_timedout(last_full_sent_lobbies, SEND_FULL_LOBBY_RATE);
+    if (full) last_full_sent_lobbies = std::chrono::high_resolution_clock::now();
+
+    std::set<uint64> sent{};
     for(auto & l: lobbies) {
         if (get_lobby_member(&l, settings->get_local_steam_id()) && l.owner() == settings->get_local_steam_id().ConvertToUint64() && !l.deleted()) {
             PRINT_DEBUG("lobby " "%" PRIu64 "", l.room_id());
-            Common_Message msg = Common_Message();
-            msg.set_source_id(settings->get_local_steam_id().ConvertToUint64());
-            msg.set_allocated_lobby(new Lobby(l));
-            network->sendToAllIndividuals(&msg, true);
+            // the unchanged lobbies are still announced, it's how the other peers find them
+            send_lobby_state(&l, full, true);
+            sent.insert(l.room_id());
         }
     }
+
+    // forget the lobbies we don't own anymore
+    auto r = replicated_lobbies.begin();
+    while (r != replicated_lobbies.end()) {
+        if (!sent.count(r->first)) {
+            r = replicated_lobbies.erase(r);
+        } else {
+            ++r;
+        }
+    }
+}
+
+static bool lobby_values_equal(const ::google::protobuf::Map<std::string, std::string> &a, const ::google::protobuf::Map<std::string, std::string> &b)
+{
+    if (a.size() != b.size()) return false;
+
+    for (auto & v : a) {
+        auto other = b.find(v.first);
+        if (other == b.end() || other->second != v.second) return false;
+    }
+
+    return true;
+}
+
+static const Lobby_Member *find_lobby_member(const Lobby &lobby, uint64 id)
+{
+    for (auto & m : lobby.members()) {
+        if (m.id() == id) return &m;
+    }
+
+    return nullptr;
+}
+
+// fills 'delta' with the changes from 'old_state' to 'new_state', returns false if nothing changed
+static bool make_lobby_delta(const Lobby &old_state, const Lobby &new_state, Lobby_Delta *delta)
+{
+    bool changed = false;
+    Lobby *lobby = delta->mutable_lobby();
+    lobby->set_room_id(new_state.room_id());
+    lobby->set_owner(new_state.owner());
+    *lobby->mutable_gameserver() = new_state.gameserver();
+    lobby->set_member_limit(new_state.member_limit());
+    lobby->set_type(new_state.type());
+    lobby->set_joinable(new_state.joinable());
+    lobby->set_appid(new_state.appid());
+    lobby->set_deleted(new_state.deleted());
+    lobby->set_time_deleted(new_state.time_deleted());
+
+    if (old_state.owner() != new_state.owner() ||
+        !protobuf_message_equal(old_state.gameserver(), new_state.gameserver()) ||
+        old_state.member_limit() != new_state.member_limit() ||
+        old_state.type() != new_state.type() ||
+        old_state.joinable() != new_state.joinable() ||
+        old_state.appid() != new_state.appid() ||
+        old_state.deleted() != new_state.deleted() ||
+        old_state.time_deleted() != new_state.time_deleted()) {
+        changed = true;
+    }
+
+    for (auto & v : new_state.values()) {
+        auto old_value = old_state.values().find(v.first);
+        if (old_value == old_state.values().end() || old_value->second != v.second) {
+            (*lobby->mutable_values())[v.first] = v.second;
+            changed = true;
+        }
+    }
+
+    for (auto & v : old_state.values()) {
+        if (!new_state.values().count(v.first)) {
+            delta->add_removed_values(v.first);
+            changed = true;
+        }
+    }
+
+    for (auto & m : new_state.members()) {
+        const Lobby_Member *old_member = find_lobby_member(old_state, m.id());
+        if (!old_member || !lobby_values_equal(old_member->values(), m.values())) {
+            *lobby->add_members() = m;
+            changed = true;
+        }
+    }
+
+    for (auto & m : old_state.members()) {
+        if (!find_lobby_member(new_state, m.id())) {
+            delta->add_removed_members(m.id());
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+static void apply_lobby_delta(Lobby &state, const Lobby_Delta &delta)
+{
+    const Lobby &changes = delta.lobby();
+    state.set_owner(changes.owner());
+    *state.mutable_gameserver() = changes.gameserver();
+    state.set_member_limit(changes.member_limit());
+    state.set_type(changes.type());
+    state.set_joinable(changes.joinable());
+    state.set_appid(changes.appid());
+    state.set_deleted(changes.deleted());
+    state.set_time_deleted(changes.time_deleted());
+    state.set_version(changes.version());
+
+    for (auto & v : changes.values()) {
+        (*state.mutable_values())[v.first] = v.second;
+    }
+
+    for (auto & k : delta.removed_values()) {
+        state.mutable_values()->erase(k);
+    }
+
+    for (auto & m : changes.members()) {
+        auto member = std::find_if(state.mutable_members()->begin(), state.mutable_members()->end(), [&m](Lobby_Member const& item) { return item.id() == m.id(); });
+        if (member != state.mutable_members()->end()) {
+            *member = m;
+        } else {
+            *state.add_members() = m;
+        }
+    }
+
+    for (auto id : delta.removed_members()) {
+        auto member = std::find_if(state.mutable_members()->begin(), state.mutable_members()->end(), [id](Lobby_Member const& item) { return item.id() == id; });
+        if (member != state.mutable_members()->end()) {
+            state.mutable_members()->erase(member);
+        }
+    }
+}
+
+// sends an owned lobby to the other peers, or only to 'dest' if it's valid
+// only the changes since the last send are sent unless 'full' is set
+void Steam_Matchmaking::send_lobby_state(Lobby *lobby, bool full, bool send_unchanged, CSteamID dest)
+{
+    Lobby_Delta *delta = new Lobby_Delta();
+    auto replicated = replicated_lobbies.find(lobby->room_id());
+    uint64 base_version = lobby->version();
+    bool changed = true;
+    if (replicated != replicated_lobbies.end()) {
+        base_version = replicated->second.version();
+        changed = make_lobby_delta(replicated->second, *lobby, delta);
+        // the lobby got a version we didn't send ourselves (ex: from another owner in between),
+        // the peers may not have the state this delta is based on
+        if (base_version != lobby->version()) {
+            full = true;
+            base_version = std::max<uint64>(base_version, lobby->version());
+            // even without content changes, or the next sends would all be full snapshots again
+            changed = true;
+        }
+    } else {
+        full = true;
+    }
+
+    if (changed) {
+        lobby->set_version(base_version + 1);
+        replicated_lobbies[lobby->room_id()] = *lobby;
+    }
+
+    Common_Message msg = Common_Message();
+    msg.set_source_id(settings->get_local_steam_id().ConvertToUint64());
+    // peers running older builds don't understand deltas, they get the whole lobby like before
+    Common_Message full_msg = Common_Message();
+    if (full) {
+        delete delta;
+        msg.set_allocated_lobby(new Lobby(*lobby));
+    } else {
+        if (!changed && !send_unchanged) {
+            delete delta;
+            return;
+        }
+
+        delta->set_room_id(lobby->room_id());
+        delta->set_base_version(base_version);
+        delta->mutable_lobby()->set_version(lobby->version());
+        msg.set_allocated_lobby_delta(delta);
+
+        full_msg.set_source_id(settings->get_local_steam_id().ConvertToUint64());
+        full_msg.set_allocated_lobby(new Lobby(*lobby));
+    }
+
+    if (dest.IsValid()) {
+        msg.set_dest_id(dest.ConvertToUint64());
+        network->sendTo(&msg, true);
+    } else if (full) {
+        network->sendToAllIndividuals(&msg, true);
+    } else {
+        network->sendToAllIndividuals(&msg, true, Announce::FEATURE_LOBBY_DELTA, &full_msg);
+    }
+}
+
+void Steam_Matchmaking::request_lobby_sync(uint64 room_id, uint64 owner)
+{
+    auto requested = lobby_sync_requests.find(room_id);
+    if (requested != lobby_sync_requests.end() && !check_timedout(requested->second, LOBBY_SYNC_REQUEST_RATE)) return;
+
+    PRINT_DEBUG("requesting lobby " "%" PRIu64 " from " "%" PRIu64 "", room_id, owner);
+    lobby_sync_requests[room_id] = std::chrono::high_resolution_clock::now();
+
+    Common_Message msg = Common_Message();
+    msg.set_source_id(settings->get_local_steam_id().ConvertToUint64());
+    msg.set_dest_id(owner);
+    Lobby_Messages *message = msg.mutable_lobby_messages();
+    message->set_id(room_id);
+    message->set_type(Lobby_Messages::SYNC_REQUEST);
+    network->sendTo(&msg, true);
 }
 
 void Steam_Matchmaking::trigger_lobby_dataupdate(CSteamID lobby, CSteamID member, bool success, double cb_timeout, bool send_changed_lobby)
@@ -92,10 +304,7 @@ void Steam_Matchmaking::trigger_lobby_dataupdate(CSteamID lobby, CSteamID member
     if (l && l->owner() == settings->get_local_steam_id().ConvertToUint64()) {
         if (send_changed_lobby) {
             PRINT_DEBUG("resending new data");
-            Common_Message msg = Common_Message();
-            msg.set_source_id(settings->get_local_steam_id().ConvertToUint64());
-            msg.set_allocated_lobby(new Lobby(*l));
-            network->sendToAllIndividuals(&msg, true);
+            send_lobby_state(l, false, false);
         }
     }
 }
@@ -179,6 +388,8 @@ bool Steam_Matchmaking::change_owner(Lobby *lobby, CSteamID new_owner)
     message->set_type(Lobby_Messages::CHANGE_OWNER);
     message->set_idata(new_owner.ConvertToUint64());
     lobby->set_owner(new_owner.ConvertToUint64());
+    // the new owner replicates it from now on, if we get it back the next send must be a full one
+    replicated_lobbies.erase(lobby->room_id());
     send_owner_packet((uint64)lobby->room_id(), message);
     trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)lobby->room_id(), true);
     return true;
@@ -475,11 +686,16 @@ SteamAPICall_t Steam_Matchmaking::RequestLobbyList()
 
     filtered_lobbies.clear();
     lobby_last_search = std::chrono::high_resolution_clock::now();
-    filter_values_copy = filter_values;
+    filter_values_copy = std::move(filter_values);
+    near_filter_values_copy = std::move(near_filter_values);
+    filter_slots_available_copy = filter_slots_available;
     filter_max_results_copy = filter_max_results;
     filter_values.clear();
+    near_filter_values.clear();
+    filter_slots_available = 0;
     filter_max_results = FILTER_MAX_DEFAULT;
     searching = true;
+    searched_once = false;
     if (search_call_api_id) callback_results->rmCallBack(search_call_api_id, NULL);
     search_call_api_id = callback_results->reserveCallResult();
     
@@ -527,9 +743,13 @@ void Steam_Matchmaking::AddRequestLobbyListNumericalFilter( const char *pchKeyTo
 void Steam_Matchmaking::AddRequestLobbyListNearValueFilter( const char *pchKeyToMatch, int nValueToBeCloseTo )
 {
     PRINT_DEBUG("'%s'==%u", pchKeyToMatch, nValueToBeCloseTo);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    if (!pchKeyToMatch) return;
 
-    
+    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    struct Near_Filter_Values nfv;
+    nfv.key = std::string(pchKeyToMatch);
+    nfv.value = nValueToBeCloseTo;
+    near_filter_values.push_back(nfv);
 }
 
 // returns only lobbies with the specified number of slots available
@@ -537,8 +757,7 @@ void Steam_Matchmaking::AddRequestLobbyListFilterSlotsAvailable( int nSlotsAvail
 {
     PRINT_DEBUG("%i", nSlotsAvailable);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
-
-    
+    filter_slots_available = nSlotsAvailable;
 }
 
 // sets the distance for which we should search for lobbies (based on users IP address to location map on the Steam backed)
@@ -580,9 +799,9 @@ void Steam_Matchmaking::AddRequestLobbyListNumericalFilter( const char *pchKeyTo
 
 void Steam_Matchmaking::AddRequestLobbyListSlotsAvailableFilter()
 {
-    PRINT_DEBUG_TODO();
+    PRINT_DEBUG_ENTRY();
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
-
+    filter_slots_available = 1;
 }
 
 // returns the CSteamID of a lobby, as retrieved by a RequestLobbyList call
@@ -831,6 +1050,8 @@ bool Steam_Matchmaking::SetLobbyData( CSteamID steamIDLobby, const char *pchKey,
             if (result->second == std::string(pchValue)) changed = false;
             (*lobby->mutable_values())[result->first] = pchValue;
         }
+
+        if (changed) index_lobby(*lobby);
     }
 
     if (changed)
@@ -897,6 +1118,7 @@ bool Steam_Matchmaking::DeleteLobbyData( CSteamID steamIDLobby, const char *pchK
     }
 
     lobby->mutable_values()->erase(pchKey);
+    index_lobby(*lobby);
     trigger_lobby_dataupdate(steamIDLobby, steamIDLobby, true);
     
     return true;
@@ -1323,6 +1545,9 @@ void Steam_Matchmaking::remove_lobbies()
         if (g->members().size() == 0 || (g->deleted() && (g->time_deleted() + LOBBY_DELETED_TIMEOUT < current_time))) {
             PRINT_DEBUG("LOBBY " "%" PRIu64 "", g->room_id());
             self_lobby_member_data.erase(g->room_id());
+            replicated_lobbies.erase(g->room_id());
+            lobby_sync_requests.erase(g->room_id());
+            unindex_lobby(g->room_id());
             g = lobbies.erase(g);
         } else {
             ++g;
@@ -1345,6 +1570,7 @@ void Steam_Matchmaking::create_pending_lobbies()
             lobby.set_appid(settings->get_local_game_id().AppID());
             add_member_to_lobby(&lobby, settings->get_local_steam_id());
             lobbies.push_back(lobby);
+            index_lobby(lobby);
 
             if (settings->disable_lobby_creation) {
                 LobbyCreated_t data;
@@ -1382,6 +1608,236 @@ void Steam_Matchmaking::create_pending_lobbies()
     }
 }
 
+static bool lobby_value_to_number(const std::string &value, long long &number)
+{
+    //TODO: check if this is how real steam behaves
+    if (value.empty()) {
+        number = 0;
+        return true;
+    }
+
+    errno = 0;
+    char *end = nullptr;
+    number = std::strtoll(value.c_str(), &end, 0);
+    return end != value.c_str() && errno != ERANGE;
+}
+
+template<typename T>
+static bool lobby_compare(const T &lobby_value, const T &filter_value, ELobbyComparison eComparisonType)
+{
+    switch (eComparisonType) {
+    case k_ELobbyComparisonEqualToOrLessThan: return lobby_value <= filter_value;
+    case k_ELobbyComparisonLessThan: return lobby_value < filter_value;
+    case k_ELobbyComparisonEqual: return lobby_value == filter_value;
+    case k_ELobbyComparisonGreaterThan: return lobby_value > filter_value;
+    case k_ELobbyComparisonEqualToOrGreaterThan: return lobby_value >= filter_value;
+    case k_ELobbyComparisonNotEqual: return lobby_value != filter_value;
+    }
+
+    PRINT_DEBUG("unknown compare type %i", (int)eComparisonType);
+    return true;
+}
+
+static void lobby_index_add(Lobby_Index_Key &key, const Lobby_Index_Value &value, uint64 room_id)
+{
+    key.strings[value.value].insert(room_id);
+    if (value.is_number) {
+        key.numbers.emplace(value.number, room_id);
+    } else {
+        key.not_numbers.insert(room_id);
+    }
+}
+
+static void lobby_index_remove(Lobby_Index_Key &key, const Lobby_Index_Value &value, uint64 room_id)
+{
+    auto lobbies = key.strings.find(value.value);
+    if (lobbies != key.strings.end()) {
+        lobbies->second.erase(room_id);
+        if (lobbies->second.empty()) key.strings.erase(lobbies);
+    }
+
+    if (value.is_number) {
+        key.numbers.erase(std::make_pair(value.number, room_id));
+    } else {
+        key.not_numbers.erase(room_id);
+    }
+}
+
+void Steam_Matchmaking::index_lobby(const Lobby &lobby)
+{
+    uint64 room_id = (uint64)lobby.room_id();
+    std::map<std::string, Lobby_Index_Value> values{};
+    for (auto & v : lobby.values()) {
+        // only one value per key, whatever its case
+        auto value = values.emplace(common_helpers::to_lower(v.first), Lobby_Index_Value{});
+        if (!value.second) continue;
+
+        value.first->second.value = v.second;
+        value.first->second.is_number = lobby_value_to_number(v.second, value.first->second.number);
+    }
+
+    // only touch the keys whose value changed
+    auto &indexed = lobby_indexed_values[room_id];
+    for (auto & old : indexed) {
+        auto now = values.find(old.first);
+        if (now != values.end() && now->second.value == old.second.value) continue;
+
+        auto key = lobby_index.find(old.first);
+        if (key == lobby_index.end()) continue;
+        lobby_index_remove(key->second, old.second, room_id);
+        if (key->second.strings.empty()) lobby_index.erase(key);
+    }
+
+    for (auto & v : values) {
+        auto old = indexed.find(v.first);
+        if (old != indexed.end() && old->second.value == v.second.value) continue;
+
+        lobby_index_add(lobby_index[v.first], v.second, room_id);
+    }
+
+    indexed = std::move(values);
+}
+
+void Steam_Matchmaking::unindex_lobby(uint64 room_id)
+{
+    auto indexed = lobby_indexed_values.find(room_id);
+    if (indexed == lobby_indexed_values.end()) return;
+
+    for (auto & old : indexed->second) {
+        auto key = lobby_index.find(old.first);
+        if (key == lobby_index.end()) continue;
+        lobby_index_remove(key->second, old.second, room_id);
+        if (key->second.strings.empty()) lobby_index.erase(key);
+    }
+
+    lobby_indexed_values.erase(indexed);
+}
+
+// fills filtered_lobbies with the lobbies matching the filters of the current search
+// each filter is a lookup or a range query on the lobby index, the lobbies themselves are only
+// checked for their type, joinability and free slots
+void Steam_Matchmaking::search_lobbies()
+{
+    PRINT_DEBUG("for lobbies %zu, filters: %zu, near filters: %zu, slots: %i", lobbies.size(), filter_values_copy.size(), near_filter_values_copy.size(), filter_slots_available_copy);
+    filtered_lobbies.clear();
+
+    // how many equality filters each lobby passed, a missing key never passes them
+    std::unordered_map<uint64, size_t> equal_passed{};
+    size_t equal_filters = 0;
+    // lobbies failing any other filter, a missing key passes them
+    std::unordered_set<uint64> failed{};
+    for (auto & f : filter_values_copy) {
+        PRINT_DEBUG("'%s':'%s'/%i %u %i", f.key.c_str(), f.value_string.c_str(), f.value_int, f.is_int, f.eComparisonType);
+        auto key = lobby_index.find(common_helpers::to_lower(f.key));
+        if (f.eComparisonType == k_ELobbyComparisonEqual) {
+            ++equal_filters;
+            if (key == lobby_index.end()) continue;
+
+            if (!f.is_int) {
+                auto matches = key->second.strings.find(f.value_string);
+                if (matches != key->second.strings.end()) {
+                    for (auto id : matches->second) ++equal_passed[id];
+                }
+            } else {
+                auto &numbers = key->second.numbers;
+                long long value = f.value_int;
+                auto from = numbers.lower_bound(std::make_pair(value, (uint64)0));
+                auto to = numbers.upper_bound(std::make_pair(value, (uint64)UINT64_MAX));
+                for (; from != to; ++from) ++equal_passed[from->second];
+            }
+
+            continue;
+        }
+
+        if (key == lobby_index.end()) continue;
+
+        if (!f.is_int) {
+            // one comparison per distinct value
+            for (auto & v : key->second.strings) {
+                if (!lobby_compare(v.first, f.value_string, f.eComparisonType)) failed.insert(v.second.begin(), v.second.end());
+            }
+        } else {
+            auto &numbers = key->second.numbers;
+            long long value = f.value_int;
+            auto lower = numbers.lower_bound(std::make_pair(value, (uint64)0));
+            auto upper = numbers.upper_bound(std::make_pair(value, (uint64)UINT64_MAX));
+            auto fail_range = [&failed](decltype(lower) from, decltype(lower) to) {
+                for (; from != to; ++from) failed.insert(from->second);
+            };
+
+            switch (f.eComparisonType) {
+            case k_ELobbyComparisonEqualToOrLessThan: fail_range(upper, numbers.end()); break;
+            case k_ELobbyComparisonLessThan: fail_range(lower, numbers.end()); break;
+            case k_ELobbyComparisonGreaterThan: fail_range(numbers.begin(), upper); break;
+            case k_ELobbyComparisonEqualToOrGreaterThan: fail_range(numbers.begin(), lower); break;
+            case k_ELobbyComparisonNotEqual: fail_range(lower, upper); break;
+            default: PRINT_DEBUG("unknown compare type (int) %i", (int)f.eComparisonType); break;
+            }
+
+            failed.insert(key->second.not_numbers.begin(), key->second.not_numbers.end());
+        }
+    }
+
+    std::vector<uint64> results{};
+    for (auto & l : lobbies) {
+        uint64 room_id = (uint64)l.room_id();
+        if (equal_filters) {
+            auto passed = equal_passed.find(room_id);
+            if (passed == equal_passed.end() || passed->second != equal_filters) continue;
+        }
+
+        if (failed.count(room_id)) continue;
+
+        bool use = l.joinable() && (l.type() == k_ELobbyTypePublic || l.type() == k_ELobbyTypeInvisible || l.type() == k_ELobbyTypeFriendsOnly) && !l.deleted();
+        if (use && filter_slots_available_copy > 0) {
+            int slots = static_cast<int>(l.member_limit()) - l.members_size();
+            use = slots >= filter_slots_available_copy;
+        }
+
+        if (use) results.push_back(room_id);
+    }
+
+    if (near_filter_values_copy.size()) {
+        // distance to the value of each near filter, lobbies without the key (or a number) go last
+        std::vector<std::string> near_keys{};
+        for (auto & n : near_filter_values_copy) {
+            near_keys.push_back(common_helpers::to_lower(n.key));
+        }
+
+        std::unordered_map<uint64, std::vector<unsigned long long>> distances{};
+        for (auto id : results) {
+            auto &lobby_distances = distances[id];
+            auto &values = lobby_indexed_values[id];
+            for (size_t n = 0; n < near_keys.size(); ++n) {
+                auto v = values.find(near_keys[n]);
+                long long value = near_filter_values_copy[n].value;
+                if (v == values.end() || !v->second.is_number) {
+                    lobby_distances.push_back(ULLONG_MAX);
+                } else {
+                    long long number = v->second.number;
+                    lobby_distances.push_back(number >= value
+                        ? (unsigned long long)number - (unsigned long long)value
+                        : (unsigned long long)value - (unsigned long long)number);
+                }
+            }
+        }
+
+        // early filters take precedence
+        std::stable_sort(results.begin(), results.end(), [&distances](uint64 a, uint64 b) {
+            return distances[a] < distances[b];
+        });
+    }
+
+    if (filter_max_results_copy >= 0 && results.size() > static_cast<size_t>(filter_max_results_copy)) {
+        results.resize(filter_max_results_copy);
+    }
+
+    for (auto id : results) {
+        PRINT_DEBUG("Lobby " "%" PRIu64 " use", id);
+        filtered_lobbies.push_back(id);
+    }
+}
+
 void Steam_Matchmaking::run_background()
 {
     remove_lobbies();
@@ -1398,85 +1854,23 @@ void Steam_Matchmaking::RunCallbacks()
     run_background();
 
     if (searching) {
-        PRINT_DEBUG("for lobbies %zu", lobbies.size());
-        for(auto & l: lobbies) {
-            bool use = l.joinable() && (l.type() == k_ELobbyTypePublic || l.type() == k_ELobbyTypeInvisible || l.type() == k_ELobbyTypeFriendsOnly) && !l.deleted();
-            PRINT_DEBUG("use lobby: %u, filters: %zu, joinable: %u, type: %u, deleted: %u", use, filter_values_copy.size(), l.joinable(), l.type(), l.deleted());
-            for (auto & f : filter_values_copy) {
-                PRINT_DEBUG("'%s':'%s'/%i %u %i", f.key.c_str(), f.value_string.c_str(), f.value_int, f.is_int, f.eComparisonType);
-                auto value = caseinsensitive_find(l.values(), f.key);
-                if (value != l.values().end()) {
-                    //TODO: eComparisonType
-                    if (!f.is_int) {
-                        PRINT_DEBUG("Compare Values %s %s", value->second.c_str(), f.value_string.c_str());
-                        if (f.eComparisonType == k_ELobbyComparisonEqual) {
-                            if (value->second == f.value_string) {
-                                PRINT_DEBUG("Equal (non-int)");
-                                //use = use;
-                            } else {
-                                PRINT_DEBUG("Not Equal (non-int)");
-                                use = false;
-                            }
-                        } else {
-                            PRINT_DEBUG("TODO UNSUPPORTED compare type (non-int) %i", (int)f.eComparisonType);
-                        }
-                    } else {
-                        try {
-                            PRINT_DEBUG("%s", value->second.c_str());
-                            int compare_to = 0;
-                            //TODO: check if this is how real steam behaves
-                            if (value->second.size()) {
-                                compare_to = static_cast<int>(std::stoll(value->second, 0, 0));
-                            }
-                            PRINT_DEBUG("Compare Values %i %i", compare_to, f.value_int);
-                            if (f.eComparisonType == k_ELobbyComparisonEqual) {
-                                if (compare_to == f.value_int) {
-                                    PRINT_DEBUG("Equal (int)");
-                                    //use = use;
-                                } else {
-                                    PRINT_DEBUG("Not Equal (int)");
-                                    use = false;
-                                }
-                            } else {
-                                PRINT_DEBUG("TODO UNSUPPORTED compare type (int) %i", (int)f.eComparisonType);
-                            }
-                        } catch (...) {
-                            //Same case as if the key is not in the lobby?
-                            use = false;
-                        }
-                        //TODO: add more comparisons
-                    }
-                } else {
-                    PRINT_DEBUG("Compare Key not in lobby");
-                    if (f.eComparisonType == k_ELobbyComparisonEqual) {
-                        //If the key is not in the lobby do we take it into account?
-                        use = false;
-                    }
-                }
-            }
-
-            PRINT_DEBUG("Lobby " "%" PRIu64 " use %u", l.room_id(), use);
-            if (use) PUSH_BACK_IF_NOT_IN(filtered_lobbies, (uint64)l.room_id());
-            if (filtered_lobbies.size() >= static_cast<size_t>(filter_max_results_copy)) {
-                PRINT_DEBUG("returning lobby search results, count=%zu", filtered_lobbies.size());
-                searching = false;
-                LobbyMatchList_t data{};
-                data.m_nLobbiesMatching = static_cast<uint32>(filtered_lobbies.size());
-                callback_results->addCallResult(search_call_api_id, data.k_iCallback, &data, sizeof(data));
-                callbacks->addCBResult(data.k_iCallback, &data, sizeof(data));
-                search_call_api_id = 0;
-            }
+        bool timed_out = check_timedout(lobby_last_search, LOBBY_SEARCH_TIMEOUT);
+        // lobbies from the network keep arriving until the timeout, so search once right away
+        // in case there are already enough results, then one last time when the search ends
+        if (!searched_once || timed_out) {
+            search_lobbies();
+            searched_once = true;
         }
-    }
 
-    if (searching && check_timedout(lobby_last_search, LOBBY_SEARCH_TIMEOUT)) {
-        PRINT_DEBUG("LOBBY_SEARCH_TIMEOUT %zu", filtered_lobbies.size());
-        LobbyMatchList_t data{};
-        data.m_nLobbiesMatching = static_cast<uint32>(filtered_lobbies.size());
-        callback_results->addCallResult(search_call_api_id, data.k_iCallback, &data, sizeof(data));
-        callbacks->addCBResult(data.k_iCallback, &data, sizeof(data));
-        searching = false;
-        search_call_api_id = 0;
+        if (timed_out || filtered_lobbies.size() >= static_cast<size_t>(filter_max_results_copy)) {
+            PRINT_DEBUG("returning lobby search results, count=%zu, timed out=%i", filtered_lobbies.size(), (int)timed_out);
+            LobbyMatchList_t data{};
+            data.m_nLobbiesMatching = static_cast<uint32>(filtered_lobbies.size());
+            callback_results->addCallResult(search_call_api_id, data.k_iCallback, &data, sizeof(data));
+            callbacks->addCBResult(data.k_iCallback, &data, sizeof(data));
+            searching = false;
+            search_call_api_id = 0;
+        }
     }
 
     auto g = std::begin(pending_joins);
@@ -1546,90 +1940,119 @@ void Steam_Matchmaking::RunCallbacks()
 
 
 
-void Steam_Matchmaking::Callback(Common_Message *msg)
+// applies the whole lobby state received from its owner, and triggers the callbacks for what changed
+void Steam_Matchmaking::on_lobby_state(Lobby *state)
 {
-    if (msg->has_lobby()) {
-        PRINT_DEBUG("GOT A LOBBY appid: %u " "%" PRIu64 "", msg->lobby().appid(), msg->lobby().owner());
-        if (msg->lobby().owner() != settings->get_local_steam_id().ConvertToUint64() && msg->lobby().appid() == settings->get_local_game_id().AppID()) {
-            Lobby *lobby = get_lobby((uint64)msg->lobby().room_id());
-            if (!lobby) {
-                size_t old_size = lobbies.size();
-                lobbies.resize(old_size + 1);
-                lobbies[old_size].set_room_id(msg->lobby().room_id());
-                lobby = &(lobbies[old_size]);
-            }
+    // someone else owns this lobby now, our replica (if we ever owned it) is stale
+    replicated_lobbies.erase(state->room_id());
 
-            if (!lobby->deleted()) {
-                if (!protobuf_message_equal(*lobby, msg->lobby())) {
-                    bool we_are_in_lobby = !!get_lobby_member(lobby, settings->get_local_steam_id());
-                    if (we_are_in_lobby) trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)lobby->room_id(), true);
+    Lobby *lobby = get_lobby((uint64)state->room_id());
+    if (!lobby) {
+        size_t old_size = lobbies.size();
+        lobbies.resize(old_size + 1);
+        lobbies[old_size].set_room_id(state->room_id());
+        lobby = &(lobbies[old_size]);
+    }
+
+    if (!lobby->deleted()) {
+        if (!protobuf_message_equal(*lobby, *state)) {
+            bool we_are_in_lobby = !!get_lobby_member(lobby, settings->get_local_steam_id());
+            if (we_are_in_lobby) trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)lobby->room_id(), true);
 
-                    for (auto & m : lobby->members()) {
-                        int count = 0;
-                        Lobby_Member *member = get_lobby_member(msg->mutable_lobby(), (uint64)m.id());
+            for (auto & m : lobby->members()) {
+                int count = 0;
+                Lobby_Member *member = get_lobby_member(state, (uint64)m.id());
 
-                        if (we_are_in_lobby) {
-                            if (!member) {
-                                trigger_lobby_member_join_leave((uint64)lobby->room_id(), (uint64)m.id(), true, true, 0.2);
-                            } else if (!protobuf_message_equal(*member, m)) {
-                                trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)m.id(), true);
-                            }
-                        }
+                if (we_are_in_lobby) {
+                    if (!member) {
+                        trigger_lobby_member_join_leave((uint64)lobby->room_id(), (uint64)m.id(), true, true, 0.2);
+                    } else if (!protobuf_message_equal(*member, m)) {
+                        trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)m.id(), true);
                     }
+                }
+            }
 
-                    bool joined = false;
-                    for (auto & m : msg->lobby().members()) {
-                        Lobby_Member *member = get_lobby_member(lobby, (uint64)m.id());
-                        if (!member) {
-                            if (m.id() == settings->get_local_steam_id().ConvertToUint64()) {
-                                CSteamID id((uint64)lobby->room_id());
-                                auto pd = pending_joins.begin();
-                                while (pd != pending_joins.end()) {
-                                    if (pd->lobby_id == id) {
-                                        bool success = true;
-                                        LobbyEnter_t data;
-                                        data.m_ulSteamIDLobby = lobby->room_id();
-                                        data.m_rgfChatPermissions = 0; //Unused - Always 0
-                                        data.m_bLocked = false;
-                                        data.m_EChatRoomEnterResponse = success ? k_EChatRoomEnterResponseSuccess : k_EChatRoomEnterResponseError;
-                                        callback_results->addCallResult(pd->api_id, data.k_iCallback, &data, sizeof(data));
-                                        callbacks->addCBResult(data.k_iCallback, &data, sizeof(data));
-                                        pd = pending_joins.erase(pd);
-                                        joined = true;
-                                    } else {
-                                        ++pd;
-                                    }
-                                }
-                                if (joined) {
-                                    on_self_enter_leave_lobby((uint64)lobby->room_id(), lobby->type(), false);
-                                    trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)lobby->room_id(), true);
-                                }
+            bool joined = false;
+            for (auto & m : state->members()) {
+                Lobby_Member *member = get_lobby_member(lobby, (uint64)m.id());
+                if (!member) {
+                    if (m.id() == settings->get_local_steam_id().ConvertToUint64()) {
+                        CSteamID id((uint64)lobby->room_id());
+                        auto pd = pending_joins.begin();
+                        while (pd != pending_joins.end()) {
+                            if (pd->lobby_id == id) {
+                                bool success = true;
+                                LobbyEnter_t data;
+                                data.m_ulSteamIDLobby = lobby->room_id();
+                                data.m_rgfChatPermissions = 0; //Unused - Always 0
+                                data.m_bLocked = false;
+                                data.m_EChatRoomEnterResponse = success ? k_EChatRoomEnterResponseSuccess : k_EChatRoomEnterResponseError;
+                                callback_results->addCallResult(pd->api_id, data.k_iCallback, &data, sizeof(data));
+                                callbacks->addCBResult(data.k_iCallback, &data, sizeof(data));
+                                pd = pending_joins.erase(pd);
+                                joined = true;
                             } else {
-                                if (we_are_in_lobby) trigger_lobby_member_join_leave((uint64)lobby->room_id(), (uint64)m.id(), false, true);
+                                ++pd;
                             }
                         }
+                        if (joined) {
+                            on_self_enter_leave_lobby((uint64)lobby->room_id(), lobby->type(), false);
+                            trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)lobby->room_id(), true);
+                        }
+                    } else {
+                        if (we_are_in_lobby) trigger_lobby_member_join_leave((uint64)lobby->room_id(), (uint64)m.id(), false, true);
                     }
+                }
+            }
 
-                    if (joined) {
-                        for (auto & m : msg->lobby().members()) {
-                            if (m.id() != settings->get_local_steam_id().ConvertToUint64()) {
-                                //TODO: is this good?
-                                //trigger_lobby_member_join_leave((uint64)lobby->room_id(), (uint64)m.id(), false, true);
-                                if (m.values().size()) {
-                                    //TODO: check if this is what steam does
-                                    //trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)m.id(), true);
-                                }
-                            }
+            if (joined) {
+                for (auto & m : state->members()) {
+                    if (m.id() != settings->get_local_steam_id().ConvertToUint64()) {
+                        //TODO: is this good?
+                        //trigger_lobby_member_join_leave((uint64)lobby->room_id(), (uint64)m.id(), false, true);
+                        if (m.values().size()) {
+                            //TODO: check if this is what steam does
+                            //trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)m.id(), true);
                         }
                     }
+                }
+            }
 
-                    if ((joined && msg->lobby().gameserver().num_update()) || (we_are_in_lobby && (lobby->gameserver().num_update() != msg->lobby().gameserver().num_update()))) {
-                        send_gameservercreated_cb(lobby->room_id(), msg->lobby().gameserver().id(), msg->lobby().gameserver().ip(), msg->lobby().gameserver().port());
-                        trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)lobby->room_id(), true);
-                    }
+            if ((joined && state->gameserver().num_update()) || (we_are_in_lobby && (lobby->gameserver().num_update() != state->gameserver().num_update()))) {
+                send_gameservercreated_cb(lobby->room_id(), state->gameserver().id(), state->gameserver().ip(), state->gameserver().port());
+                trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)lobby->room_id(), true);
+            }
 
-                    *lobby = msg->lobby();
-                }
+            *lobby = *state;
+            index_lobby(*lobby);
+        }
+    }
+}
+
+void Steam_Matchmaking::Callback(Common_Message *msg)
+{
+    if (msg->has_lobby()) {
+        PRINT_DEBUG("GOT A LOBBY appid: %u " "%" PRIu64 "", msg->lobby().appid(), msg->lobby().owner());
+        if (msg->lobby().owner() != settings->get_local_steam_id().ConvertToUint64() && msg->lobby().appid() == settings->get_local_game_id().AppID()) {
+            // the whole lobby answers any sync we asked for
+            lobby_sync_requests.erase(msg->lobby().room_id());
+            on_lobby_state(msg->mutable_lobby());
+        }
+    }
+
+    if (msg->has_lobby_delta()) {
+        const Lobby_Delta &delta = msg->lobby_delta();
+        PRINT_DEBUG("GOT A LOBBY DELTA " "%" PRIu64 " version %llu -> %llu", delta.room_id(), (uint64)delta.base_version(), (uint64)delta.lobby().version());
+        if (delta.lobby().owner() != settings->get_local_steam_id().ConvertToUint64() && delta.lobby().appid() == settings->get_local_game_id().AppID()) {
+            Lobby *lobby = get_lobby((uint64)delta.room_id());
+            if (!lobby || lobby->version() != delta.base_version()) {
+                // we never got the state these changes are based on
+                if (!lobby || !lobby->deleted()) request_lobby_sync(delta.room_id(), (uint64)msg->source_id());
+            } else if (delta.base_version() != delta.lobby().version()) {
+                Lobby state = *lobby;
+                state.set_room_id(delta.room_id());
+                apply_lobby_delta(state, delta);
+                on_lobby_state(&state);
             }
         }
     }
@@ -1665,6 +2088,13 @@ void Steam_Matchmaking::Callback(Common_Message *msg)
                         trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)member->id(), true);
                     }
                 }
+
+                if (msg->lobby_messages().type() == Lobby_Messages::SYNC_REQUEST) {
+                    PRINT_DEBUG("LOBBY MESSAGE: SYNC_REQUEST from=%llu", (uint64)msg->source_id());
+                    // get everyone else up to date first, the whole lobby sent to this peer doesn't count as a change
+                    send_lobby_state(lobby, false, false);
+                    send_lobby_state(lobby, true, true, (uint64)msg->source_id());
+                }
             }
 
             if (msg->lobby_messages().type() == Lobby_Messages::LEAVE) {
@@ -1676,6 +2106,7 @@ void Steam_Matchmaking::Callback(Common_Message *msg)
             if (msg->lobby_messages().type() == Lobby_Messages::CHANGE_OWNER) {
                 PRINT_DEBUG("LOBBY MESSAGE: CHANGE OWNER");
                 lobby->set_owner(msg->lobby_messages().idata());
+                replicated_lobbies.erase(lobby->room_id());
                 if (we_are_in_lobby) trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)lobby->room_id(), true);
             }
 
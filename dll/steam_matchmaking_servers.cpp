@@ -19,6 +19,8 @@
 
 #define SERVER_TIMEOUT 10.0
 #define DIRECT_IP_DELAY 0.05
+// servers that show up within this time after a request are still reported to it
+#define REQUEST_REFRESH_TIME 1.0
 
 
 static HServerQuery new_server_query()
@@ -31,6 +33,157 @@ static HServerQuery new_server_query()
 }
 
 
+using Server_Filters = std::vector<std::pair<std::string, std::string>>;
+
+static std::vector<std::string_view> split_filter_list(std::string_view list)
+{
+    std::vector<std::string_view> items{};
+    while (list.size()) {
+        size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        if (item.size()) items.push_back(item);
+        if (comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+
+    return items;
+}
+
+// 'mode' is 0 for all of them, 1 for any of them, 2 for none of them
+static bool filter_list_match(std::string_view server_list, std::string_view filter_list, int mode)
+{
+    auto server_items = split_filter_list(server_list);
+    for (auto item : split_filter_list(filter_list)) {
+        bool found = std::find(server_items.begin(), server_items.end(), item) != server_items.end();
+        if (mode == 0 && !found) return false;
+        if (mode == 1 && found) return true;
+        if (mode == 2 && found) return false;
+    }
+
+    return mode != 1;
+}
+
+// case insensitive, '*' matches any sequence
+static bool filter_wildcard_match(std::string_view str, std::string_view pattern)
+{
+    size_t s = 0, p = 0, star = std::string_view::npos, star_s = 0;
+    while (s < str.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            star_s = s;
+        } else if (p < pattern.size() && std::tolower((unsigned char)pattern[p]) == std::tolower((unsigned char)str[s])) {
+            ++p;
+            ++s;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            s = ++star_s;
+        } else {
+            return false;
+        }
+    }
+
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+// "ip" or "ip:port", ip in host order
+static bool filter_addr_match(const std::string &filter, uint32 ip, uint16 port)
+{
+    unsigned int byte3{}, byte2{}, byte1{}, byte0{}, filter_port{};
+    int count = sscanf(filter.c_str(), "%u.%u.%u.%u:%u", &byte3, &byte2, &byte1, &byte0, &filter_port);
+    if (count < 4) return false;
+
+    uint32 filter_ip = (byte3 << 24) + (byte2 << 16) + (byte1 << 8) + byte0;
+    return filter_ip == ip && (count < 5 || filter_port == port);
+}
+
+// std::nullopt when the filter needs the source query details and they aren't known yet
+static std::optional<bool> filter_key_match(const Gameserver &server, bool has_details, const std::string &key, const std::string &value)
+{
+    uint16 query_port = server.query_port() == 0xFFFF ? server.port() : server.query_port();
+
+    // the servers from the lists and from friends only know their address until they're queried
+    if (key == "addr") return filter_addr_match(value, server.ip(), query_port);
+    if (key == "gameaddr") return filter_addr_match(value, server.ip(), server.port());
+    if (key == "appid") return server.appid() == std::strtoul(value.c_str(), nullptr, 10);
+    if (key == "napp") return server.appid() != std::strtoul(value.c_str(), nullptr, 10);
+    if (!has_details) return std::nullopt;
+
+    if (key == "map") return common_helpers::str_cmp_insensitive(server.map_name(), value);
+    if (key == "gamedir") return common_helpers::str_cmp_insensitive(server.mod_dir(), value);
+    if (key == "dedicated") return server.dedicated_server();
+    if (key == "secure") return server.secure();
+    // "full" and "empty" are the master server names, they keep the servers that are not full/empty
+    if (key == "notfull" || key == "full") return server.num_players() < server.max_player_count();
+    if (key == "hasplayers" || key == "empty") return server.num_players() > 0;
+    if (key == "noplayers") return server.num_players() == 0;
+    if (key == "password") return server.password_protected() == (value != "0");
+    if (key == "gametagsand" || key == "gametype") return filter_list_match(server.tags(), value, 0);
+    if (key == "gametagsnor") return filter_list_match(server.tags(), value, 2);
+    if (key == "gamedataand" || key == "gamedata") return filter_list_match(server.gamedata(), value, 0);
+    if (key == "gamedataor") return filter_list_match(server.gamedata(), value, 1);
+    if (key == "gamedatanor") return filter_list_match(server.gamedata(), value, 2);
+    if (key == "name_match") return filter_wildcard_match(server.server_name(), value);
+    if (key == "version_match") return filter_wildcard_match(std::to_string(server.version()), value);
+
+    // "linux" and the rest, the server doesn't tell us enough to check them
+    PRINT_DEBUG("unsupported filter '%s'='%s'", key.c_str(), value.c_str());
+    return true;
+}
+
+// evaluates the expression at 'pos' and moves past it, the boolean operators
+// take the next N key/value pairs as their operands (prefix notation)
+// an unknown operand only decides the result when the known ones don't
+static std::optional<bool> filter_expression_match(const Gameserver &server, bool has_details, const Server_Filters &filters, size_t &pos)
+{
+    const auto &[key, value] = filters[pos++];
+    bool is_and = key == "and", is_or = key == "or", is_nand = key == "nand", is_nor = key == "nor";
+    if (!is_and && !is_or && !is_nand && !is_nor) return filter_key_match(server, has_details, key, value);
+
+    size_t end = std::min(filters.size(), pos + std::strtoul(value.c_str(), nullptr, 10));
+    bool result = is_and || is_nand;
+    bool unknown = false;
+    while (pos < end) {
+        std::optional<bool> operand = filter_expression_match(server, has_details, filters, pos);
+        if (!operand.has_value()) unknown = true;
+        else result = (is_and || is_nand) ? (result && *operand) : (result || *operand);
+    }
+
+    // a false operand decides "and", a true one decides "or"
+    if (unknown && result == (is_and || is_nand)) return std::nullopt;
+    return (is_nand || is_nor) ? !result : result;
+}
+
+// servers without details pass unless a filter on their address rejects them
+static bool server_filters_match(const Gameserver &server, bool has_details, const Server_Filters &filters)
+{
+    size_t pos = 0;
+    while (pos < filters.size()) {
+        if (!filter_expression_match(server, has_details, filters, pos).value_or(true)) return false;
+    }
+
+    return true;
+}
+
+static Server_Filters copy_server_filters(MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters)
+{
+    Server_Filters filters{};
+    if (!ppchFilters || !*ppchFilters) return filters;
+
+    // like the steam client, this points to a pointer to a contiguous array of pairs
+    const MatchMakingKeyValuePair_t *pairs = *ppchFilters;
+    for (uint32 i = 0; i < nFilters; ++i) {
+        auto &filter = filters.emplace_back(
+            std::string(pairs[i].m_szKey, strnlen(pairs[i].m_szKey, sizeof(pairs[i].m_szKey))),
+            std::string(pairs[i].m_szValue, strnlen(pairs[i].m_szValue, sizeof(pairs[i].m_szValue)))
+        );
+        PRINT_DEBUG("  filter '%s'='%s'", filter.first.c_str(), filter.second.c_str());
+    }
+
+    return filters;
+}
+
+
 void Steam_Matchmaking_Servers::network_callback(void *object, Common_Message *msg)
 {
     // PRINT_DEBUG_ENTRY();
@@ -55,9 +208,78 @@ Steam_Matchmaking_Servers::~Steam_Matchmaking_Servers()
 }
 
 
-HServerListRequest Steam_Matchmaking_Servers::RequestServerList(AppId_t iApp, ISteamMatchmakingServerListResponse *pRequestServersResponse, EMatchMakingType type)
+uint64 Steam_Matchmaking_Servers::list_server_key(EMatchMakingType type, uint32 ip, uint16 port)
+{
+    // gameserver steam ids always have the universe bits set, these never collide with them
+    return ((uint64)type << 48) | ((uint64)ip << 16) | port;
+}
+
+Steam_Matchmaking_Request *Steam_Matchmaking_Servers::find_request(HServerListRequest id)
+{
+    auto r = std::find_if(requests.begin(), requests.end(), [id](const Steam_Matchmaking_Request &item) { return item.id == id; });
+    if (requests.end() == r) return nullptr;
+    return &*r;
+}
+
+bool Steam_Matchmaking_Servers::request_wants_server(const Steam_Matchmaking_Request &request, const Steam_Matchmaking_Servers_Gameserver &g) const
+{
+    if (g.server->appid() != request.appid) return false;
+    if (g.type != request.type && !settings->matchmaking_server_list_always_lan_type) return false;
+
+    return server_filters_match(*g.server, g.details_known, request.filters);
+}
+
+void Steam_Matchmaking_Servers::offer_server(Steam_Matchmaking_Request &request, uint64 key, const Steam_Matchmaking_Servers_Gameserver &g)
+{
+    auto known = request.gameservers_index.find(key);
+    if (known != request.gameservers_index.end()) {
+        // already listed, GetServerDetails() returns the latest data
+        request.gameservers_filtered[known->second] = g.server;
+        return;
+    }
+
+    if (request.refresh_only || !request_wants_server(request, g)) return;
+
+    PRINT_DEBUG("server found for request %p", request.id);
+    size_t index = request.gameservers_filtered.size();
+    request.gameservers_filtered.push_back(g.server);
+    request.gameservers_keys.push_back(key);
+    request.gameservers_rejected.push_back(false);
+    request.gameservers_index[key] = index;
+    request.pending_responses.push_back(index);
+}
+
+void Steam_Matchmaking_Servers::server_queried(Steam_Matchmaking_Request &request, size_t index, const Gameserver &queried)
+{
+    auto server = std::make_shared<const Gameserver>(queried);
+    request.gameservers_filtered[index] = server;
+
+    uint64 key = request.gameservers_keys[index];
+    auto g = gameservers.find(key);
+    if (g != gameservers.end() && !g->second.details_known) {
+        g->second.server = server;
+        g->second.details_known = true;
+        server_updated(key, g->second);
+    }
+
+    if (!server_filters_match(*server, true, request.filters)) {
+        PRINT_DEBUG("server %zu of request %p doesn't match the filters", index, request.id);
+        request.gameservers_rejected[index] = true;
+    }
+}
+
+void Steam_Matchmaking_Servers::server_updated(uint64 key, const Steam_Matchmaking_Servers_Gameserver &g)
 {
-    PRINT_DEBUG("%u %p, %i", iApp, pRequestServersResponse, (int)type);
+    for (auto &r : requests) {
+        // requests that didn't check the existing servers yet will see this one when they do
+        if (r.cancelled || r.completed || !r.scanned) continue;
+        offer_server(r, key, g);
+    }
+}
+
+HServerListRequest Steam_Matchmaking_Servers::RequestServerList(AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse *pRequestServersResponse, EMatchMakingType type)
+{
+    PRINT_DEBUG("%u %p, %i, %u filters", iApp, pRequestServersResponse, (int)type, nFilters);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
 
     static unsigned server_list_request = 0;
@@ -79,6 +301,8 @@ HServerListRequest Steam_Matchmaking_Servers::RequestServerList(AppId_t iApp, IS
     request.completed = false;
     request.type = type;
     request.id = id;
+    request.filters = copy_server_filters(ppchFilters, nFilters);
+    request.refresh_started = std::chrono::high_resolution_clock::now();
     requests.push_back(request);
     PRINT_DEBUG("pushed new request with id: %p", request.id);
 
@@ -87,17 +311,19 @@ HServerListRequest Steam_Matchmaking_Servers::RequestServerList(AppId_t iApp, IS
     if (type == eFriendsServer) {
         for (auto &g : gameservers_friends) {
             if (g.source_id != settings->get_local_steam_id().ConvertToUint64()) {
-                Gameserver server{};
-                server.set_ip(g.ip);
-                server.set_port(g.port);
-                server.set_query_port(g.port);
-                server.set_appid(iApp);
-
-                struct Steam_Matchmaking_Servers_Gameserver g2{};
+                auto server = std::make_shared<Gameserver>();
+                server->set_ip(g.ip);
+                server->set_port(g.port);
+                server->set_query_port(g.port);
+                server->set_appid(iApp);
+
+                uint64 key = list_server_key(type, g.ip, g.port);
+                struct Steam_Matchmaking_Servers_Gameserver &g2 = gameservers[key];
                 g2.last_recv = std::chrono::high_resolution_clock::now();
-                g2.server = server;
+                // keep what an earlier query found out about it
+                if (!g2.details_known) g2.server = std::move(server);
                 g2.type = type;
-                gameservers.push_back(g2);
+                server_updated(key, g2);
                 PRINT_DEBUG("  eFriendsServer SERVER ADDED");
             }
         }
@@ -149,17 +375,19 @@ HServerListRequest Steam_Matchmaking_Servers::RequestServerList(AppId_t iApp, IS
             continue;
         }
 
-        Gameserver server{};
-        server.set_ip(ip_int);
-        server.set_port(port_int);
-        server.set_query_port(port_int);
-        server.set_appid(iApp);
+        auto server = std::make_shared<Gameserver>();
+        server->set_ip(ip_int);
+        server->set_port(port_int);
+        server->set_query_port(port_int);
+        server->set_appid(iApp);
 
-        struct Steam_Matchmaking_Servers_Gameserver g{};
+        uint64 key = list_server_key(type, ip_int, port_int);
+        struct Steam_Matchmaking_Servers_Gameserver &g = gameservers[key];
         g.last_recv = std::chrono::high_resolution_clock::now();
-        g.server = server;
+        // keep what an earlier query found out about it
+        if (!g.details_known) g.server = std::move(server);
         g.type = type;
-        gameservers.push_back(g);
+        server_updated(key, g);
         PRINT_DEBUG("  SERVER ADDED %i", (int)g.type);
 
         list_ip = "";
@@ -174,42 +402,42 @@ HServerListRequest Steam_Matchmaking_Servers::RequestServerList(AppId_t iApp, IS
 HServerListRequest Steam_Matchmaking_Servers::RequestInternetServerList( AppId_t iApp, STEAM_ARRAY_COUNT(nFilters) MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse *pRequestServersResponse )
 {
     PRINT_DEBUG_ENTRY();
-    return RequestServerList(iApp, pRequestServersResponse, eInternetServer);
+    return RequestServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eInternetServer);
 }
 
 HServerListRequest Steam_Matchmaking_Servers::RequestLANServerList( AppId_t iApp, ISteamMatchmakingServerListResponse *pRequestServersResponse )
 {
     PRINT_DEBUG_ENTRY();
-    return RequestServerList(iApp, pRequestServersResponse, eLANServer);
+    return RequestServerList(iApp, nullptr, 0, pRequestServersResponse, eLANServer);
 }
 
 HServerListRequest Steam_Matchmaking_Servers::RequestFriendsServerList( AppId_t iApp, STEAM_ARRAY_COUNT(nFilters) MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse *pRequestServersResponse )
 {
     PRINT_DEBUG_ENTRY();
-    return RequestServerList(iApp, pRequestServersResponse, eFriendsServer);
+    return RequestServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eFriendsServer);
 }
 
 HServerListRequest Steam_Matchmaking_Servers::RequestFavoritesServerList( AppId_t iApp, STEAM_ARRAY_COUNT(nFilters) MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse *pRequestServersResponse )
 {
     PRINT_DEBUG_ENTRY();
-    return RequestServerList(iApp, pRequestServersResponse, eFavoritesServer);
+    return RequestServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eFavoritesServer);
 }
 
 HServerListRequest Steam_Matchmaking_Servers::RequestHistoryServerList( AppId_t iApp, STEAM_ARRAY_COUNT(nFilters) MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse *pRequestServersResponse )
 {
     PRINT_DEBUG_ENTRY();
-    return RequestServerList(iApp, pRequestServersResponse, eHistoryServer);
+    return RequestServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eHistoryServer);
 }
 
 HServerListRequest Steam_Matchmaking_Servers::RequestSpectatorServerList( AppId_t iApp, STEAM_ARRAY_COUNT(nFilters) MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse *pRequestServersResponse )
 {
     PRINT_DEBUG_ENTRY();
-    return RequestServerList(iApp, pRequestServersResponse, eSpectatorServer);
+    return RequestServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eSpectatorServer);
 }
 
 // old server list request
 
-void Steam_Matchmaking_Servers::RequestOldServerList(AppId_t iApp, ISteamMatchmakingServerListResponse001 *pRequestServersResponse, EMatchMakingType type)
+void Steam_Matchmaking_Servers::RequestOldServerList(AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse001 *pRequestServersResponse, EMatchMakingType type)
 {
     PRINT_DEBUG("%u", iApp);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
@@ -230,6 +458,8 @@ void Steam_Matchmaking_Servers::RequestOldServerList(AppId_t iApp, ISteamMatchma
     request.completed = false;
     request.type = type;
     request.id = (void *)type;
+    request.filters = copy_server_filters(ppchFilters, nFilters);
+    request.refresh_started = std::chrono::high_resolution_clock::now();
     requests.push_back(request);
     PRINT_DEBUG("pushed new request with id: %p", request.id);
 }
@@ -237,43 +467,37 @@ void Steam_Matchmaking_Servers::RequestOldServerList(AppId_t iApp, ISteamMatchma
 void Steam_Matchmaking_Servers::RequestInternetServerList( AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse001 *pRequestServersResponse )
 {
     PRINT_DEBUG("old");
-    //TODO
-    RequestOldServerList(iApp, pRequestServersResponse, eInternetServer);
+    RequestOldServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eInternetServer);
 }
 
 void Steam_Matchmaking_Servers::RequestLANServerList( AppId_t iApp, ISteamMatchmakingServerListResponse001 *pRequestServersResponse )
 {
     PRINT_DEBUG("old");
-    //TODO
-    RequestOldServerList(iApp, pRequestServersResponse, eLANServer);
+    RequestOldServerList(iApp, nullptr, 0, pRequestServersResponse, eLANServer);
 }
 
 void Steam_Matchmaking_Servers::RequestFriendsServerList( AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse001 *pRequestServersResponse )
 {
     PRINT_DEBUG("old");
-    //TODO
-    RequestOldServerList(iApp, pRequestServersResponse, eFriendsServer);
+    RequestOldServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eFriendsServer);
 }
 
 void Steam_Matchmaking_Servers::RequestFavoritesServerList( AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse001 *pRequestServersResponse )
 {
     PRINT_DEBUG("old");
-    //TODO
-    RequestOldServerList(iApp, pRequestServersResponse, eFavoritesServer);
+    RequestOldServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eFavoritesServer);
 }
 
 void Steam_Matchmaking_Servers::RequestHistoryServerList( AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse001 *pRequestServersResponse )
 {
     PRINT_DEBUG("old");
-    //TODO
-    RequestOldServerList(iApp, pRequestServersResponse, eHistoryServer);
+    RequestOldServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eHistoryServer);
 }
 
 void Steam_Matchmaking_Servers::RequestSpectatorServerList( AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse001 *pRequestServersResponse )
 {
     PRINT_DEBUG("old");
-    //TODO
-    RequestOldServerList(iApp, pRequestServersResponse, eSpectatorServer);
+    RequestOldServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eSpectatorServer);
 }
 
 
@@ -377,26 +601,18 @@ gameserveritem_t *Steam_Matchmaking_Servers::GetServerDetails( HServerListReques
     PRINT_DEBUG("%p %i", hRequest, iServer);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
 
-    std::vector <struct Steam_Matchmaking_Servers_Gameserver> gameservers_filtered;
-    auto g = std::begin(requests);
-    while (g != std::end(requests)) {
-        PRINT_DEBUG("  equal? %p %p", hRequest, g->id);
-        if (g->id == hRequest) {
-            gameservers_filtered = g->gameservers_filtered;
-            PRINT_DEBUG("  found %zu", gameservers_filtered.size());
-            break;
-        }
-
-        ++g;
-    }
+    Steam_Matchmaking_Request *request = find_request(hRequest);
+    if (!request) return NULL;
 
-    if (iServer < 0 || static_cast<size_t>(iServer) >= gameservers_filtered.size()) {
+    PRINT_DEBUG("  found %zu", request->gameservers_filtered.size());
+    if (iServer < 0 || static_cast<size_t>(iServer) >= request->gameservers_filtered.size()) {
         return NULL;
     }
 
-    Gameserver *gs = &gameservers_filtered[iServer].server;
+    // server_details() fills in what the source query returns
+    Gameserver gs = *request->gameservers_filtered[iServer];
     auto &server = requests_from_GetServerDetails.create(std::chrono::hours(1));
-    server_details(gs, &server);
+    if (server_details(&gs, &server)) server_queried(*request, static_cast<size_t>(iServer), gs);
     PRINT_DEBUG("  Returned server details");
     return &server;
 }
@@ -431,6 +647,19 @@ void Steam_Matchmaking_Servers::CancelQuery( HServerListRequest hRequest )
 void Steam_Matchmaking_Servers::RefreshQuery( HServerListRequest hRequest )
 {
     PRINT_DEBUG("%p", hRequest);
+    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    Steam_Matchmaking_Request *request = find_request(hRequest);
+    if (!request || request->released) return;
+
+    request->cancelled = false;
+    request->completed = false;
+    request->refresh_only = true;
+    request->refresh_started = std::chrono::high_resolution_clock::now();
+    request->pending_responses.clear();
+    for (size_t i = 0; i < request->gameservers_filtered.size(); ++i) {
+        if (request->gameservers_rejected[i]) continue;
+        request->pending_responses.push_back(i);
+    }
 }
  
 
@@ -438,7 +667,9 @@ void Steam_Matchmaking_Servers::RefreshQuery( HServerListRequest hRequest )
 bool Steam_Matchmaking_Servers::IsRefreshing( HServerListRequest hRequest )
 {
     PRINT_DEBUG("%p", hRequest);
-    return false;
+    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    Steam_Matchmaking_Request *request = find_request(hRequest);
+    return request && !request->cancelled && !request->completed;
 }
  
 
@@ -448,15 +679,8 @@ int Steam_Matchmaking_Servers::GetServerCount( HServerListRequest hRequest )
     PRINT_DEBUG("%p", hRequest);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     int size = 0;
-    auto g = std::begin(requests);
-    while (g != std::end(requests)) {
-        if (g->id == hRequest) {
-            size = static_cast<int>(g->gameservers_filtered.size());
-            break;
-        }
-
-        ++g;
-    }
+    Steam_Matchmaking_Request *request = find_request(hRequest);
+    if (request) size = static_cast<int>(request->gameservers_filtered.size());
 
     PRINT_DEBUG("final count = %i", size);
     return size;
@@ -466,8 +690,15 @@ int Steam_Matchmaking_Servers::GetServerCount( HServerListRequest hRequest )
 // Refresh a single server inside of a query (rather than all the servers )
 void Steam_Matchmaking_Servers::RefreshServer( HServerListRequest hRequest, int iServer )
 {
-    PRINT_DEBUG("%p", hRequest);
-    //TODO
+    PRINT_DEBUG("%p %i", hRequest, iServer);
+    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    Steam_Matchmaking_Request *request = find_request(hRequest);
+    if (!request || request->cancelled) return;
+    if (iServer < 0 || static_cast<size_t>(iServer) >= request->gameservers_filtered.size()) return;
+    if (request->gameservers_rejected[iServer]) return;
+
+    // only ServerResponded() is called again, there's no RefreshComplete() for a single server
+    request->pending_responses.push_back(static_cast<size_t>(iServer));
 }
 
 
@@ -584,12 +815,14 @@ void Steam_Matchmaking_Servers::CancelServerQuery( HServerQuery hServerQuery )
 
 
 
-void Steam_Matchmaking_Servers::server_details(Gameserver *g, gameserveritem_t *server)
+// returns true when the source query answered and filled in the details
+bool Steam_Matchmaking_Servers::server_details(Gameserver *g, gameserveritem_t *server)
 {
     PRINT_DEBUG_ENTRY();
     constexpr const static int MIN_LATENCY = 2;
 
     int latency = MIN_LATENCY;
+    bool queried = false;
 
     if (settings->matchmaking_server_details_via_source_query && !(g->ip() < 0) && !(g->query_port() < 0)) {
         unsigned char ip[4]{};
@@ -646,6 +879,7 @@ void Steam_Matchmaking_Servers::server_details(Gameserver *g, gameserveritem_t *
                 else g->set_appid(ssq_a2s_info->id);
                 
                 g->set_offline(false);
+                queried = true;
             } else {
                 PRINT_DEBUG("  ssq server info failed: %s", ssq_server_emsg(ssq));
             }
@@ -692,6 +926,7 @@ void Steam_Matchmaking_Servers::server_details(Gameserver *g, gameserveritem_t *
     g->tags().copy(server->m_szGameTags, sizeof(server->m_szGameTags) - 1);
 
     PRINT_DEBUG("  " "%" PRIu64 "", g->id());
+    return queried;
 }
 
 void Steam_Matchmaking_Servers::server_details_players(Gameserver *g, Steam_Matchmaking_Servers_Direct_IP_Request *r)
@@ -800,7 +1035,7 @@ void Steam_Matchmaking_Servers::RunCallbacks()
     {
         auto g = std::begin(gameservers);
         while (g != std::end(gameservers)) {
-            if (check_timedout(g->last_recv, SERVER_TIMEOUT)) {
+            if (check_timedout(g->second.last_recv, SERVER_TIMEOUT)) {
                 g = gameservers.erase(g);
                 PRINT_DEBUG("SERVER REMOVED, TIMEOUT");
             } else {
@@ -809,59 +1044,61 @@ void Steam_Matchmaking_Servers::RunCallbacks()
         }
     }
 
-    if (requests.size() || gameservers.size()) {
-        PRINT_DEBUG("requests count = %zu, servers count = %zu", requests.size(), gameservers.size());
-    }
-
+    // what to tell each listener, the callbacks can create or release requests so they're called afterwards
+    struct Request_Notification {
+        HServerListRequest id{};
+        ISteamMatchmakingServerListResponse *callbacks{};
+        ISteamMatchmakingServerListResponse001 *old_callbacks{};
+        std::vector<size_t> responded{};
+        bool complete{};
+        bool has_servers{};
+    };
+
+    std::vector<Request_Notification> notifications{};
     for (auto &r : requests) {
-        if (r.cancelled || r.completed) continue;
-
-        r.gameservers_filtered.clear();
-        for (auto &g : gameservers) {
-            PRINT_DEBUG("%u==%u | %i==%i", g.server.appid(), r.appid, (int)g.type, (int)r.type);
-            if ((g.server.appid() == r.appid) && (g.type == r.type || settings->matchmaking_server_list_always_lan_type)) {
-                PRINT_DEBUG("server found");
-                r.gameservers_filtered.push_back(g);
+        if (r.cancelled) continue;
+
+        if (!r.scanned && !r.completed) {
+            r.scanned = true;
+            for (auto &g : gameservers) {
+                offer_server(r, g.first, g.second);
             }
+
+            PRINT_DEBUG("request %p: %zu servers, %zu in the table", r.id, r.gameservers_filtered.size(), gameservers.size());
         }
-    }
 
-    std::vector <struct Steam_Matchmaking_Request> requests_temp(requests);
-    for (auto &r : requests) {
-        r.completed = true;
+        bool complete = !r.completed && check_timedout(r.refresh_started, REQUEST_REFRESH_TIME);
+        if (r.pending_responses.empty() && !complete) continue;
+
+        auto &notification = notifications.emplace_back();
+        notification.id = r.id;
+        notification.callbacks = r.callbacks;
+        notification.old_callbacks = r.old_callbacks;
+        notification.responded.swap(r.pending_responses);
+        notification.complete = complete;
+        notification.has_servers = !r.gameservers_filtered.empty();
+        if (complete) r.completed = true;
     }
 
-    for (auto &r : requests_temp) {
-        if (r.cancelled || r.completed) continue;
-        int i = 0;
+    for (auto &n : notifications) {
+        for (size_t i : n.responded) {
+            // a previous callback may have cancelled it
+            Steam_Matchmaking_Request *request = find_request(n.id);
+            if (!request || request->cancelled) break;
 
-        if (r.callbacks) {
-            for (auto &g : r.gameservers_filtered) {
-                PRINT_DEBUG("server responded cb %p", r.id);
-                r.callbacks->ServerResponded(r.id, i);
-                ++i;
-            }
-
-            if (i) {
-                r.callbacks->RefreshComplete(r.id, eServerResponded);
-            } else {
-                r.callbacks->RefreshComplete(r.id, eNoServersListedOnMasterServer);
-            }
+            PRINT_DEBUG("server responded cb %p %zu", n.id, i);
+            if (n.callbacks) n.callbacks->ServerResponded(n.id, static_cast<int>(i));
+            if (n.old_callbacks) n.old_callbacks->ServerResponded(static_cast<int>(i));
         }
 
-        if (r.old_callbacks) {
-            for (auto &g : r.gameservers_filtered) {
-                PRINT_DEBUG("REQUESTS server responded cb %p", r.id);
-                r.old_callbacks->ServerResponded(i);
-                ++i;
-            }
+        if (!n.complete) continue;
 
-            if (i) {
-                r.old_callbacks->RefreshComplete(eServerResponded);
-            } else {
-                r.old_callbacks->RefreshComplete(eNoServersListedOnMasterServer);
-            }
-        }
+        Steam_Matchmaking_Request *request = find_request(n.id);
+        if (!request || request->cancelled) continue;
+
+        EMatchMakingServerResponse response = n.has_servers ? eServerResponded : eNoServersListedOnMasterServer;
+        if (n.callbacks) n.callbacks->RefreshComplete(n.id, response);
+        if (n.old_callbacks) n.old_callbacks->RefreshComplete(response);
     }
 
     std::vector <struct Steam_Matchmaking_Servers_Direct_IP_Request> direct_ip_requests_temp;
@@ -877,29 +1114,32 @@ void Steam_Matchmaking_Servers::RunCallbacks()
 
     for (auto &r : direct_ip_requests_temp) {
         PRINT_DEBUG("request: %u:%hu", r.ip, r.port);
-        for (auto &g : gameservers) {
-            PRINT_DEBUG("%u:%u", g.server.ip(), g.server.query_port());
-            uint16 query_port = g.server.query_port();
+        for (auto &entry : gameservers) {
+            auto &g = entry.second;
+            PRINT_DEBUG("%u:%u", g.server->ip(), g.server->query_port());
+            uint16 query_port = g.server->query_port();
             if (query_port == 0xFFFF) {
-                query_port = g.server.port();
+                query_port = g.server->port();
             }
 
-            if (query_port == r.port && g.server.ip() == r.ip) {
+            if (query_port == r.port && g.server->ip() == r.ip) {
+                // the details functions fill in what the source query returns
+                Gameserver server_data = *g.server;
                 if (r.rules_response) {
-                    server_details_rules(&(g.server), &r);
+                    server_details_rules(&server_data, &r);
                     r.rules_response->RulesRefreshComplete();
                     r.rules_response = NULL;
                 }
 
                 if (r.players_response) {
-                    server_details_players(&(g.server), &r);
+                    server_details_players(&server_data, &r);
                     r.players_response->PlayersRefreshComplete();
                     r.players_response = NULL;
                 }
 
                 if (r.ping_response) {
                     gameserveritem_t server{};
-                    server_details(&(g.server), &server);
+                    server_details(&server_data, &server);
                     r.ping_response->ServerResponded(server);
                     r.ping_response = NULL;
                 }
@@ -918,34 +1158,27 @@ void Steam_Matchmaking_Servers::Callback(Common_Message *msg)
 {
     if (msg->has_gameserver() && msg->gameserver().type() != eFriendsServer) {
         PRINT_DEBUG("got SERVER " "%" PRIu64 ", offline:%u", msg->gameserver().id(), msg->gameserver().offline());
+        uint64 key = msg->gameserver().id();
         if (msg->gameserver().offline()) {
-            for (auto &g : gameservers) {
-                if (g.server.id() == msg->gameserver().id()) {
-                    g.last_recv = std::chrono::high_resolution_clock::time_point();
-                    g.type = eLANServer;
-                }
+            auto g = gameservers.find(key);
+            if (g != gameservers.end()) {
+                g->second.last_recv = std::chrono::high_resolution_clock::time_point();
+                g->second.type = eLANServer;
             }
         } else {
-            bool already = false;
-            for (auto &g : gameservers) {
-                if (g.server.id() == msg->gameserver().id()) {
-                    g.last_recv = std::chrono::high_resolution_clock::now();
-                    g.server = msg->gameserver();
-                    g.server.set_ip(msg->source_ip());
-                    g.type = eLANServer;
-                    already = true;
-                }
-            }
-
-            if (!already) {
-                struct Steam_Matchmaking_Servers_Gameserver g{};
-                g.last_recv = std::chrono::high_resolution_clock::now();
-                g.server = msg->gameserver();
-                g.server.set_ip(msg->source_ip());
-                g.type = eLANServer;
-                gameservers.push_back(g);
+            auto g = gameservers.find(key);
+            if (g == gameservers.end()) {
+                g = gameservers.emplace(key, Steam_Matchmaking_Servers_Gameserver{}).first;
                 PRINT_DEBUG("  eLANServer SERVER ADDED");
             }
+
+            auto server = std::make_shared<Gameserver>(msg->gameserver());
+            server->set_ip(msg->source_ip());
+            g->second.last_recv = std::chrono::high_resolution_clock::now();
+            g->second.server = std::move(server);
+            g->second.type = eLANServer;
+            g->second.details_known = true;
+            server_updated(key, g->second);
         }
     }
 
@@ -31,51 +31,40 @@
 bool Steam_Networking::connection_exists(CSteamID id)
 {
     std::lock_guard<std::recursive_mutex> lock(connections_edit_mutex);
-    return std::find_if(connections.begin(), connections.end(), [&id](struct Steam_Networking_Connection const& conn) { return conn.remote == id;}) != connections.end();
+    return connections.count(id.ConvertToUint64()) > 0;
 }
 
 struct Steam_Networking_Connection* Steam_Networking::get_or_create_connection(CSteamID id)
 {
     std::lock_guard<std::recursive_mutex> lock(connections_edit_mutex);
-    auto conn = std::find_if(connections.begin(), connections.end(), [&id](struct Steam_Networking_Connection const& conn) { return conn.remote == id;});
+    auto [conn, created] = connections.try_emplace(id.ConvertToUint64());
+    if (created) {
+        conn->second.remote = id;
 
-    if (connections.end() == conn) {
-        struct Steam_Networking_Connection connection;
-        connection.remote = id;
-        connections.push_back(connection);
-        return &(connections[connections.size() - 1]);
-    } else {
-        return &(*conn);
+        // whatever this peer sent before the connection was made is now readable
+        std::lock_guard<std::recursive_mutex> lock(messages_mutex);
+        auto pending = pending_messages.find(id.ConvertToUint64());
+        if (pending != pending_messages.end()) {
+            for (auto &msg : pending->second) {
+                int channel = msg.network().channel();
+                channel_messages[channel].push_back(std::move(msg));
+            }
+            pending_messages.erase(pending);
+        }
     }
+
+    return &conn->second;
 }
 
 void Steam_Networking::remove_connection(CSteamID id)
 {
     {
         std::lock_guard<std::recursive_mutex> lock(connections_edit_mutex);
-        auto conn = std::begin(connections);
-        while (conn != std::end(connections)) {
-            if (conn->remote == id) {
-
-                conn = connections.erase(conn);
-            } else {
-                ++conn;
-            }
-        }
+        connections.erase(id.ConvertToUint64());
     }
 
     //pretty sure steam also clears the entire queue of messages for that connection
-    {
-        std::lock_guard<std::recursive_mutex> lock(messages_mutex);
-        auto msg = std::begin(messages);
-        while (msg != std::end(messages)) {
-            if (msg->source_id() == id.ConvertToUint64()) {
-                msg = messages.erase(msg);
-            } else {
-                ++msg;
-            }
-        }
-    }
+    drop_peer_messages(id.ConvertToUint64());
 
     {
         auto msg = std::begin(unprocessed_messages);
@@ -89,6 +78,41 @@ void Steam_Networking::remove_connection(CSteamID id)
     }
 }
 
+void Steam_Networking::queue_processed_message(Common_Message &&msg)
+{
+    std::lock_guard<std::recursive_mutex> lock(messages_mutex);
+    if (connection_exists((uint64)msg.source_id())) {
+        int channel = msg.network().channel();
+        channel_messages[channel].push_back(std::move(msg));
+    } else {
+        pending_messages[msg.source_id()].push_back(std::move(msg));
+    }
+}
+
+void Steam_Networking::drop_peer_messages(uint64 id)
+{
+    std::lock_guard<std::recursive_mutex> lock(messages_mutex);
+    pending_messages.erase(id);
+
+    for (auto chan = channel_messages.begin(); chan != channel_messages.end(); ) {
+        auto &queue = chan->second;
+        queue.erase(std::remove_if(queue.begin(), queue.end(), [id](const Common_Message &msg){ return msg.source_id() == id; }), queue.end());
+        if (queue.empty()) {
+            chan = channel_messages.erase(chan);
+        } else {
+            ++chan;
+        }
+    }
+}
+
+Common_Message *Steam_Networking::front_message(int channel)
+{
+    auto chan = channel_messages.find(channel);
+    if (chan == channel_messages.end() || chan->second.empty()) return nullptr;
+
+    return &chan->second.front();
+}
+
 SNetSocket_t Steam_Networking::create_connection_socket(CSteamID target, int nVirtualPort, uint32 nIP, uint16 nPort, SNetListenSocket_t id, enum steam_socket_connection_status status, SNetSocket_t other_id)
 {
     static SNetSocket_t socket_number = 0;
@@ -192,7 +216,7 @@ Steam_Networking::Steam_Networking(class Settings *settings, class Networking *n
     this->network->setCallback(CALLBACK_ID_USER_STATUS, settings->get_local_steam_id(), &Steam_Networking::steam_networking_callback, this);
     this->run_every_runcb->add(&Steam_Networking::steam_networking_run_every_runcp, this);
 
-    PRINT_DEBUG("user id %llu messages: %p", settings->get_local_steam_id().ConvertToUint64(), &messages);
+    PRINT_DEBUG("user id %llu messages: %p", settings->get_local_steam_id().ConvertToUint64(), &channel_messages);
 }
 
 Steam_Networking::~Steam_Networking()
@@ -260,14 +284,12 @@ bool Steam_Networking::IsP2PPacketAvailable( uint32 *pcubMsgSize, int nChannel)
     //this->network->Run();
     //RunCallbacks();
 
-    PRINT_DEBUG("Messages %zu %p", messages.size(), &messages);
-    for (auto &msg : messages) {
-        if (connection_exists((uint64)msg.source_id()) && msg.mutable_network()->channel() == nChannel && msg.network().processed()) {
-            uint32 size = static_cast<uint32>(msg.mutable_network()->data().size());
-            if (pcubMsgSize) *pcubMsgSize = size;
-            PRINT_DEBUG("available with size: %u", size);
-            return true;
-        }
+    Common_Message *msg = front_message(nChannel);
+    if (msg) {
+        uint32 size = static_cast<uint32>(msg->network().data().size());
+        if (pcubMsgSize) *pcubMsgSize = size;
+        PRINT_DEBUG("available with size: %u", size);
+        return true;
     }
 
     PRINT_DEBUG("(not available)");
@@ -294,26 +316,20 @@ bool Steam_Networking::ReadP2PPacket( void *pubDest, uint32 cubDest, uint32 *pcu
     //this->network->Run();
     //RunCallbacks();
 
-    bool read = false;
-    PRINT_DEBUG("Number messages %zu", messages.size());
-    auto msg = std::begin(messages);
-    while (msg != std::end(messages)) {
-        if (connection_exists((uint64)msg->source_id()) && msg->network().channel() == nChannel && msg->network().processed()) {
-            uint32 msg_size = static_cast<uint32>(msg->network().data().size());
-            if (msg_size > cubDest) msg_size = cubDest;
-            if (pcubMsgSize) *pcubMsgSize = msg_size;
-            memcpy(pubDest, msg->network().data().data(), msg_size);
-
-            PRINT_DEBUG("%s",
-                common_helpers::uint8_vector_to_hex_string(std::vector<uint8_t>((uint8_t*)pubDest, (uint8_t*)pubDest + msg_size)).c_str());
-            
-            *psteamIDRemote = CSteamID((uint64)msg->source_id());
-            PRINT_DEBUG("len %u channel: %u from: " "%" PRIu64 "", msg_size, nChannel, msg->source_id());
-            msg = messages.erase(msg);
-            return true;
-        }
+    Common_Message *msg = front_message(nChannel);
+    if (msg) {
+        uint32 msg_size = static_cast<uint32>(msg->network().data().size());
+        if (msg_size > cubDest) msg_size = cubDest;
+        if (pcubMsgSize) *pcubMsgSize = msg_size;
+        memcpy(pubDest, msg->network().data().data(), msg_size);
 
-        ++msg;
+        PRINT_DEBUG("%s",
+            common_helpers::uint8_vector_to_hex_string(std::vector<uint8_t>((uint8_t*)pubDest, (uint8_t*)pubDest + msg_size)).c_str());
+        
+        *psteamIDRemote = CSteamID((uint64)msg->source_id());
+        PRINT_DEBUG("len %u channel: %u from: " "%" PRIu64 "", msg_size, nChannel, msg->source_id());
+        channel_messages[nChannel].pop_front();
+        return true;
     }
 
     if (pcubMsgSize) *pcubMsgSize = 0;
@@ -792,26 +808,22 @@ void Steam_Networking::RunCallbacks()
 
             msg->mutable_network()->set_processed(true);
             msg->mutable_network()->set_time_processed(current_time);
-            messages.push_back(*msg);
+            queue_processed_message(std::move(*msg));
             msg = unprocessed_messages.erase(msg);
         }
     }
 
-    auto msg = std::begin(messages);
-    while (msg != std::end(messages)) {
-        bool deleted = false;
-        if (msg->network().processed()) {
-            if (!connection_exists((uint64)msg->source_id())) {
-                if (msg->network().time_processed() + ORPHANED_PACKET_TIMEOUT < current_time) {
-                    deleted = true;
-                }
-            }
+    // messages are queued in the order they were processed, so only the oldest ones can be expired
+    for (auto pending = pending_messages.begin(); pending != pending_messages.end(); ) {
+        auto &queue = pending->second;
+        while (!queue.empty() && queue.front().network().time_processed() + ORPHANED_PACKET_TIMEOUT < current_time) {
+            queue.pop_front();
         }
 
-        if (deleted) {
-            msg = messages.erase(msg);
+        if (queue.empty()) {
+            pending = pending_messages.erase(pending);
         } else {
-            ++msg;
+            ++pending;
         }
     }
 
@@ -853,7 +865,7 @@ void Steam_Networking::Callback(Common_Message *msg)
 {
     if (msg->has_network()) {
         PRINT_DEBUG("got msg from: " "%" PRIu64 " to: " "%" PRIu64 " size %zu type %u | messages %p: %zu",
-            msg->source_id(), msg->dest_id(), msg->network().data().size(), msg->network().type(), &messages, messages.size()
+            msg->source_id(), msg->dest_id(), msg->network().data().size(), msg->network().type(), &channel_messages, channel_messages.size()
         );
         PRINT_DEBUG("msg data: '%s'",
             common_helpers::uint8_vector_to_hex_string(std::vector<uint8_t>(msg->network().data().begin(), msg->network().data().end())).c_str());
@@ -863,16 +875,8 @@ void Steam_Networking::Callback(Common_Message *msg)
         }
 
         if (msg->network().type() == Network_pb::NEW_CONNECTION) {
-            std::lock_guard<std::recursive_mutex> lock(messages_mutex);
-            auto msg_temp = std::begin(messages);
-            while (msg_temp != std::end(messages)) {
-                //only delete processed to handle unreliable message arriving at the same time.
-                if (msg_temp->source_id() == msg->source_id() && msg_temp->network().processed()) {
-                    msg_temp = messages.erase(msg_temp);
-                } else {
-                    ++msg_temp;
-                }
-            }
+            //only delete processed to handle unreliable message arriving at the same time.
+            drop_peer_messages(msg->source_id());
         }
     }
 
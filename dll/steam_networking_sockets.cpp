@@ -17,6 +17,14 @@
 
 #include "dll/steam_networking_sockets.h"
 
+// same as the default k_ESteamNetworkingConfig_NagleTime
+#define SEND_NAGLE_TIME_US 5000
+// a batch bigger than this is sent right away instead of waiting for the Nagle timer
+#define SEND_BATCH_MAX_BYTES (64 * 1024)
+// reliable data allowed to wait in the network layer for a peer, anything beyond
+// that stays in the connection lanes so they can be scheduled by priority
+#define SEND_WINDOW_BYTES (64 * 1024)
+
 
 void Steam_Networking_Sockets::steam_callback(void *object, Common_Message *msg)
 {
@@ -39,38 +47,31 @@ SteamNetworkingMessage_t* Steam_Networking_Sockets::get_steam_message_connection
     auto connect_socket = sbcs->connect_sockets.find(hConn);
     if (connect_socket == sbcs->connect_sockets.end()) return NULL;
     if (connect_socket->second.data.empty()) return NULL;
-    SteamNetworkingMessage_t *pMsg = new SteamNetworkingMessage_t();
-    unsigned long size = static_cast<unsigned long>(connect_socket->second.data.top().data().size());
-    pMsg->m_pData = malloc(size);
-    pMsg->m_cbSize = size;
-    memcpy(pMsg->m_pData, connect_socket->second.data.top().data().data(), size);
+    auto &data = connect_socket->second.data;
+    std::pop_heap(data.begin(), data.end(), Connect_Socket::compare_snm_for_queue{});
+    Networking_Sockets received = std::move(data.back());
+    data.pop_back();
+
+    SteamNetworkingMessage_t *pMsg = new_networking_message(std::move(*received.mutable_data()));
+    int size = pMsg->m_cbSize;
     pMsg->m_conn = hConn;
     pMsg->m_identityPeer = connect_socket->second.remote_identity;
     pMsg->m_nConnUserData = connect_socket->second.user_data;
     pMsg->m_usecTimeReceived = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - created).count();
     //TODO: check where messagenumber starts
-    pMsg->m_nMessageNumber = connect_socket->second.data.top().message_number();
+    pMsg->m_nMessageNumber = received.message_number();
 
-    pMsg->m_pfnFreeData = &free_steam_message_data;
-    pMsg->m_pfnRelease = &delete_steam_message;
     pMsg->m_nChannel = 0;
-    connect_socket->second.data.pop();
-    PRINT_DEBUG("get_steam_message_connection %u %lu, %llu", hConn, size, pMsg->m_nMessageNumber);
+#ifndef EMU_RELEASE_BUILD
+    auto stats = get_networking_message_stats();
+    PRINT_DEBUG(
+        "get_steam_message_connection %u %i, %llu (messages allocated %llu, released %llu, payloads moved %llu, copied %llu, allocated %llu, pool hits %llu, misses %llu, bytes outstanding %llu)",
+        hConn, size, pMsg->m_nMessageNumber, stats.allocated, stats.released, stats.payloads_moved, stats.payloads_copied, stats.payloads_allocated, stats.pool_hits, stats.pool_misses, stats.bytes_outstanding
+    );
+#endif
     return pMsg;
 }
 
-void Steam_Networking_Sockets::free_steam_message_data(SteamNetworkingMessage_t *pMsg)
-{
-    free(pMsg->m_pData);
-    pMsg->m_pData = NULL;
-}
-
-void Steam_Networking_Sockets::delete_steam_message(SteamNetworkingMessage_t *pMsg)
-{
-    if (pMsg->m_pfnFreeData) pMsg->m_pfnFreeData(pMsg);
-    delete pMsg;
-}
-
 unsigned long Steam_Networking_Sockets::get_socket_id()
 {
     static unsigned long socket_id;
@@ -131,6 +132,7 @@ bool Steam_Networking_Sockets::send_packet_new_connection(HSteamNetConnection m_
     msg.mutable_networking_sockets()->set_real_port(connect_socket->second.real_port);
     msg.mutable_networking_sockets()->set_connection_id_from(connect_socket->first);
     msg.mutable_networking_sockets()->set_connection_id(connect_socket->second.remote_id);
+    msg.mutable_networking_sockets()->set_features(Networking_Sockets::FEATURE_BATCH);
 
     uint64_t steam_id = connect_socket->second.remote_identity.GetSteamID64();
     if (steam_id) {
@@ -146,11 +148,257 @@ bool Steam_Networking_Sockets::send_packet_new_connection(HSteamNetConnection m_
     return false;
 }
 
+size_t Steam_Networking_Sockets::get_network_backlog(const Connect_Socket &connect_socket)
+{
+    uint64 steam_id = connect_socket.remote_identity.GetSteamID64();
+    if (!steam_id) return 0;
+
+    return network->getPendingSendBytes((uint64)steam_id);
+}
+
+EResult Steam_Networking_Sockets::queue_message(std::map<HSteamNetConnection, Connect_Socket>::iterator connect_socket, const void *pData, uint32 cbData, int nSendFlags, uint16 lane, int64 *pOutMessageNumber)
+{
+    Connect_Socket &sock = connect_socket->second;
+    if (sock.status == CONNECT_SOCKET_CLOSED) return k_EResultNoConnection;
+    if (sock.status == CONNECT_SOCKET_TIMEDOUT) return k_EResultNoConnection;
+    if (sock.status != CONNECT_SOCKET_CONNECTED && sock.status != CONNECT_SOCKET_CONNECTING) return k_EResultInvalidState;
+    if (lane >= sock.send_lanes.size()) return k_EResultInvalidParam;
+    if (cbData > k_cbMaxSteamNetworkingSocketsMessageSizeSend) return k_EResultInvalidParam;
+
+    bool reliable = !!(nSendFlags & k_nSteamNetworkingSend_Reliable);
+    size_t backlog = get_network_backlog(sock);
+    if (nSendFlags & k_nSteamNetworkingSend_NoDelay) {
+        // drop it if it can't go out right now instead of queueing it
+        if (sock.status != CONNECT_SOCKET_CONNECTED) return k_EResultIgnored;
+        if (reliable && backlog >= SEND_WINDOW_BYTES) return k_EResultIgnored;
+    }
+
+    size_t limit = static_cast<size_t>(sock.send_buffer_size > 0 ? sock.send_buffer_size : sbcs->send_buffer_size);
+    if (sock.send_queued_bytes + backlog + cbData > limit) {
+        PRINT_DEBUG("send buffer full on connection %u, queued %zu, network %zu, limit %zu", connect_socket->first, sock.send_queued_bytes, backlog, limit);
+        return k_EResultLimitExceeded;
+    }
+
+    Send_Lane &send_lane = sock.send_lanes[lane];
+    // an idle lane doesn't get to catch up on the bandwidth it didn't use
+    if (send_lane.queue.empty()) send_lane.virtual_time = std::max(send_lane.virtual_time, sock.send_virtual_clock);
+
+    Queued_Send_Message &queued = send_lane.queue.emplace_back();
+    // this is the only copy of the payload before the batch is serialized
+    queued.data.assign((const char *)pData, cbData);
+    queued.message_number = sock.packet_send_counter;
+    queued.reliable = reliable;
+    queued.queued = std::chrono::steady_clock::now();
+    sock.packet_send_counter += 1;
+
+    send_lane.pending_bytes[reliable] += cbData;
+    sock.send_queued_bytes += cbData;
+
+    if (pOutMessageNumber) *pOutMessageNumber = queued.message_number;
+    return k_EResultOK;
+}
+
+bool Steam_Networking_Sockets::flush_messages(std::map<HSteamNetConnection, Connect_Socket>::iterator connect_socket, bool ignore_window)
+{
+    Connect_Socket &sock = connect_socket->second;
+    if (!sock.send_queued_bytes && std::all_of(sock.send_lanes.begin(), sock.send_lanes.end(), [](const Send_Lane &l){ return l.queue.empty(); })) return true;
+
+    // unreliable data goes out right away, reliable data only while the peer keeps up
+    size_t backlog = get_network_backlog(sock);
+    size_t budget = backlog < SEND_WINDOW_BYTES ? SEND_WINDOW_BYTES - backlog : 0;
+    std::vector<bool> blocked(sock.send_lanes.size());
+    Networking_Sockets batch[2]{};
+    while (true) {
+        // highest priority first, then the lane with the least weighted bytes sent
+        Send_Lane *next = nullptr;
+        size_t next_idx = 0;
+        for (size_t i = 0; i < sock.send_lanes.size(); ++i) {
+            Send_Lane &l = sock.send_lanes[i];
+            if (l.queue.empty() || blocked[i]) continue;
+            if (!next || l.priority < next->priority || (l.priority == next->priority && l.virtual_time < next->virtual_time)) {
+                next = &l;
+                next_idx = i;
+            }
+        }
+
+        if (!next) break;
+
+        Queued_Send_Message &queued = next->queue.front();
+        size_t size = queued.data.size();
+        if (queued.reliable && !ignore_window && size > budget) {
+            // a single big message may still go out when nothing else is in flight
+            if (backlog || batch[1].batch_data_size()) {
+                blocked[next_idx] = true;
+                continue;
+            }
+        }
+
+        if (queued.reliable) budget -= std::min(size, budget);
+        sock.send_virtual_clock = next->virtual_time;
+        next->virtual_time += static_cast<double>(size) / next->weight;
+        next->pending_bytes[queued.reliable] -= size;
+        sock.send_queued_bytes -= size;
+
+        batch[queued.reliable].add_batch_data(std::move(queued.data));
+        batch[queued.reliable].add_batch_message_numbers(queued.message_number);
+        next->queue.pop_front();
+    }
+
+    auto send_data = [&](Networking_Sockets *data, bool reliable) {
+        Common_Message msg;
+        msg.set_source_id(sock.created_by.ConvertToUint64());
+        msg.set_dest_id(sock.remote_identity.GetSteamID64());
+        msg.set_allocated_networking_sockets(data);
+        data->set_type(Networking_Sockets::DATA);
+        data->set_virtual_port(sock.virtual_port);
+        data->set_real_port(sock.real_port);
+        data->set_connection_id_from(connect_socket->first);
+        data->set_connection_id(sock.remote_id);
+        return network->sendTo(&msg, reliable);
+    };
+
+    bool sent = true;
+    for (bool reliable : { true, false }) {
+        Networking_Sockets &data_batch = batch[reliable];
+        if (data_batch.batch_data_size() == 0) continue;
+
+        if (data_batch.batch_data_size() == 1 || !sock.peer_batching) {
+            // a single message, or any message to a peer which can't split batches, is sent the old way
+            for (int i = 0; i < data_batch.batch_data_size(); ++i) {
+                Networking_Sockets *data = new Networking_Sockets;
+                data->mutable_data()->swap(*data_batch.mutable_batch_data(i));
+                data->set_message_number(data_batch.batch_message_numbers(i));
+                sent = send_data(data, reliable) && sent;
+            }
+        } else {
+            Networking_Sockets *data = new Networking_Sockets;
+            data->mutable_batch_data()->Swap(data_batch.mutable_batch_data());
+            data->mutable_batch_message_numbers()->Swap(data_batch.mutable_batch_message_numbers());
+            sent = send_data(data, reliable) && sent;
+        }
+    }
+
+    return sent;
+}
+
+std::chrono::steady_clock::time_point Steam_Networking_Sockets::flush_expired_messages(std::chrono::steady_clock::time_point now)
+{
+    const auto nagle_time = std::chrono::microseconds(SEND_NAGLE_TIME_US);
+    auto next_deadline = std::chrono::steady_clock::time_point::max();
+    for (auto socket_conn = sbcs->connect_sockets.begin(); socket_conn != sbcs->connect_sockets.end(); ++socket_conn) {
+        const auto oldest_queued = [&socket_conn]() {
+            auto oldest = std::chrono::steady_clock::time_point::max();
+            for (auto &lane : socket_conn->second.send_lanes) {
+                if (lane.queue.size()) oldest = std::min(oldest, lane.queue.front().queued);
+            }
+            return oldest;
+        };
+
+        auto oldest = oldest_queued();
+        if (oldest == std::chrono::steady_clock::time_point::max()) continue;
+
+        // or what was held back while the peer was slow
+        if (now - oldest >= nagle_time) {
+            flush_messages(socket_conn);
+            oldest = oldest_queued();
+            if (oldest == std::chrono::steady_clock::time_point::max()) continue;
+        }
+
+        // still held back, try again after another Nagle time
+        next_deadline = std::min(next_deadline, std::max(oldest, now) + nagle_time);
+    }
+
+    return next_deadline;
+}
+
+void Steam_Networking_Sockets::schedule_nagle_flush(std::chrono::steady_clock::time_point deadline)
+{
+    std::lock_guard<std::mutex> lock(nagle_mutex);
+    // stopped for the shutdown, RunCallbacks() still sends the batches
+    if (nagle_thread_stop) return;
+
+    if (!nagle_thread.joinable()) {
+        nagle_thread = std::thread(&Steam_Networking_Sockets::nagle_thread_proc, this);
+    }
+
+    if (deadline < nagle_deadline) {
+        nagle_deadline = deadline;
+        nagle_cv.notify_one();
+    }
+}
+
+void Steam_Networking_Sockets::nagle_thread_proc()
+{
+    PRINT_DEBUG("Nagle thread started");
+    std::unique_lock<std::mutex> lock(nagle_mutex);
+    while (!nagle_thread_stop) {
+        if (nagle_deadline == std::chrono::steady_clock::time_point::max()) {
+            nagle_cv.wait(lock);
+            continue;
+        }
+
+        if (std::chrono::steady_clock::now() < nagle_deadline) {
+            nagle_cv.wait_until(lock, nagle_deadline);
+            continue;
+        }
+
+        nagle_deadline = std::chrono::steady_clock::time_point::max();
+        lock.unlock();
+
+        std::chrono::steady_clock::time_point next_deadline{};
+        {
+            std::lock_guard<std::recursive_mutex> global_lock(global_mutex);
+            if (nagle_thread_stop) break;
+
+            next_deadline = flush_expired_messages(std::chrono::steady_clock::now());
+        }
+
+        lock.lock();
+        nagle_deadline = std::min(nagle_deadline, next_deadline);
+    }
+
+    PRINT_DEBUG("Nagle thread stopped");
+}
+
+void Steam_Networking_Sockets::push_received_data(Connect_Socket &connect_socket, Networking_Sockets &&data)
+{
+    auto &queue = connect_socket.data;
+    if (data.batch_data_size() == 0) {
+        queue.push_back(std::move(data));
+        std::push_heap(queue.begin(), queue.end(), Connect_Socket::compare_snm_for_queue{});
+        return;
+    }
+
+    // split the batch, the payloads are moved and not copied
+    int count = std::min(data.batch_data_size(), data.batch_message_numbers_size());
+    for (int i = 0; i < count; ++i) {
+        Networking_Sockets single{};
+        single.set_type(Networking_Sockets::DATA);
+        single.set_message_number(data.batch_message_numbers(i));
+        single.mutable_data()->swap(*data.mutable_batch_data(i));
+        queue.push_back(std::move(single));
+        std::push_heap(queue.begin(), queue.end(), Connect_Socket::compare_snm_for_queue{});
+    }
+}
+
 shared_between_client_server* Steam_Networking_Sockets::get_shared_between_client_server()
 {
     return sbcs;
 }
 
+void Steam_Networking_Sockets::stop_nagle_thread()
+{
+    {
+        std::lock_guard<std::mutex> lock(nagle_mutex);
+        nagle_thread_stop = true;
+    }
+    nagle_cv.notify_one();
+
+    if (nagle_thread.joinable()) {
+        nagle_thread.join();
+    }
+}
+
 HSteamListenSocket Steam_Networking_Sockets::new_listen_socket(int nSteamConnectVirtualPort, int real_port)
 {
     HSteamListenSocket socket_id = get_socket_id();
@@ -169,6 +417,45 @@ HSteamListenSocket Steam_Networking_Sockets::new_listen_socket(int nSteamConnect
     return socket_id;
 }
 
+int Steam_Networking_Sockets::get_send_buffer_size_option(int nOptions, const SteamNetworkingConfigValue_t *pOptions)
+{
+    if (!pOptions) return 0;
+
+    int send_buffer_size = 0;
+    for (int i = 0; i < nOptions; ++i) {
+        const SteamNetworkingConfigValue_t &option = pOptions[i];
+        if (option.m_eValue != k_ESteamNetworkingConfig_SendBufferSize) {
+            PRINT_DEBUG("TODO config option %i", option.m_eValue);
+            continue;
+        }
+
+        if (option.m_eDataType == k_ESteamNetworkingConfig_Int32 && option.m_val.m_int32 >= 0) {
+            send_buffer_size = option.m_val.m_int32;
+        }
+    }
+
+    return send_buffer_size;
+}
+
+HSteamListenSocket Steam_Networking_Sockets::new_listen_socket(int nSteamConnectVirtualPort, int real_port, int nOptions, const SteamNetworkingConfigValue_t *pOptions)
+{
+    HSteamListenSocket socket_id = new_listen_socket(nSteamConnectVirtualPort, real_port);
+    if (socket_id == k_HSteamListenSocket_Invalid) return socket_id;
+
+    // the accepted connections inherit it
+    struct Listen_Socket *listen_socket = get_connection_socket(socket_id);
+    if (listen_socket) listen_socket->send_buffer_size = get_send_buffer_size_option(nOptions, pOptions);
+    return socket_id;
+}
+
+void Steam_Networking_Sockets::apply_connection_options(HSteamNetConnection hConn, int nOptions, const SteamNetworkingConfigValue_t *pOptions)
+{
+    auto connect_socket = sbcs->connect_sockets.find(hConn);
+    if (connect_socket == sbcs->connect_sockets.end()) return;
+
+    connect_socket->second.send_buffer_size = get_send_buffer_size_option(nOptions, pOptions);
+}
+
 ESteamNetworkingConnectionState Steam_Networking_Sockets::convert_status(enum connect_socket_status old_status)
 {
     if (old_status == CONNECT_SOCKET_NO_CONNECTION) return k_ESteamNetworkingConnectionState_None;
@@ -240,6 +527,8 @@ Steam_Networking_Sockets::Steam_Networking_Sockets(class Settings *settings, cla
 
 Steam_Networking_Sockets::~Steam_Networking_Sockets()
 {
+    stop_nagle_thread();
+
     this->network->rmCallback(CALLBACK_ID_USER_STATUS, settings->get_local_steam_id(), &Steam_Networking_Sockets::steam_callback, this);
     this->network->rmCallback(CALLBACK_ID_NETWORKING_SOCKETS, settings->get_local_steam_id(), &Steam_Networking_Sockets::steam_callback, this);
     this->run_every_runcb->remove(&Steam_Networking_Sockets::steam_run_every_runcb, this);
@@ -316,7 +605,7 @@ HSteamListenSocket Steam_Networking_Sockets::CreateListenSocketIP( const SteamNe
 {
     PRINT_DEBUG_ENTRY();
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    return new_listen_socket(SNS_DISABLED_PORT, localAddress.m_port);
+    return new_listen_socket(SNS_DISABLED_PORT, localAddress.m_port, nOptions, pOptions);
 }
 
 /// Creates a connection and begins talking to a "server" over UDP at the
@@ -366,6 +655,7 @@ HSteamNetConnection Steam_Networking_Sockets::ConnectByIPAddress( const SteamNet
     SteamNetworkingIdentity ip_id;
     ip_id.SetIPAddr(address);
     HSteamNetConnection socket = new_connect_socket(ip_id, SNS_DISABLED_PORT, address.m_port);
+    apply_connection_options(socket, nOptions, pOptions);
     send_packet_new_connection(socket);
     return socket;
 }
@@ -390,9 +680,8 @@ HSteamListenSocket Steam_Networking_Sockets::CreateListenSocketP2P( int nVirtual
 HSteamListenSocket Steam_Networking_Sockets::CreateListenSocketP2P( int nVirtualPort, int nOptions, const SteamNetworkingConfigValue_t *pOptions )
 {
     PRINT_DEBUG("%i", nVirtualPort);
-    //TODO config options
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    return new_listen_socket(nVirtualPort, SNS_DISABLED_PORT);
+    return new_listen_socket(nVirtualPort, SNS_DISABLED_PORT, nOptions, pOptions);
 }
 
 /// Begin connecting to a server that is identified using a platform-specific identifier.
@@ -437,8 +726,10 @@ HSteamNetConnection Steam_Networking_Sockets::ConnectP2P( const SteamNetworkingI
 HSteamNetConnection Steam_Networking_Sockets::ConnectP2P( const SteamNetworkingIdentity &identityRemote, int nVirtualPort, int nOptions, const SteamNetworkingConfigValue_t *pOptions )
 {
     PRINT_DEBUG("%i", nVirtualPort);
-    //TODO config options
-    return ConnectP2P(identityRemote, nVirtualPort);
+    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    HSteamNetConnection socket = ConnectP2P(identityRemote, nVirtualPort);
+    apply_connection_options(socket, nOptions, pOptions);
+    return socket;
 }
 
 /// Creates a connection and begins talking to a remote destination.  The remote host
@@ -545,6 +836,9 @@ bool Steam_Networking_Sockets::CloseConnection( HSteamNetConnection hPeer, int n
     if (connect_socket == sbcs->connect_sockets.end()) return false;
 
     if (connect_socket->second.status != CONNECT_SOCKET_CLOSED && connect_socket->second.status != CONNECT_SOCKET_TIMEDOUT) {
+        // messages still waiting in the lanes go out before the connection ends
+        flush_messages(connect_socket, true);
+
         //TODO send/nReason and pszDebug
         Common_Message msg;
         msg.set_source_id(connect_socket->second.created_by.ConvertToUint64());
@@ -725,32 +1019,20 @@ EResult Steam_Networking_Sockets::SendMessageToConnection( HSteamNetConnection h
 
     auto connect_socket = sbcs->connect_sockets.find(hConn);
     if (connect_socket == sbcs->connect_sockets.end()) return k_EResultInvalidParam;
-    if (connect_socket->second.status == CONNECT_SOCKET_CLOSED) return k_EResultNoConnection;
-    if (connect_socket->second.status == CONNECT_SOCKET_TIMEDOUT) return k_EResultNoConnection;
-    if (connect_socket->second.status != CONNECT_SOCKET_CONNECTED && connect_socket->second.status != CONNECT_SOCKET_CONNECTING) return k_EResultInvalidState;
 
-    Common_Message msg;
-    msg.set_source_id(connect_socket->second.created_by.ConvertToUint64());
-    msg.set_dest_id(connect_socket->second.remote_identity.GetSteamID64());
-    msg.set_allocated_networking_sockets(new Networking_Sockets);
-    msg.mutable_networking_sockets()->set_type(Networking_Sockets::DATA);
-    msg.mutable_networking_sockets()->set_virtual_port(connect_socket->second.virtual_port);
-    msg.mutable_networking_sockets()->set_real_port(connect_socket->second.real_port);
-    msg.mutable_networking_sockets()->set_connection_id_from(connect_socket->first);
-    msg.mutable_networking_sockets()->set_connection_id(connect_socket->second.remote_id);
-    msg.mutable_networking_sockets()->set_data(pData, cbData);
-    uint64 message_number = connect_socket->second.packet_send_counter;
-    msg.mutable_networking_sockets()->set_message_number(message_number);
-    connect_socket->second.packet_send_counter += 1;
-
-    bool reliable = false;
-    if (nSendFlags & k_nSteamNetworkingSend_Reliable) reliable = true;
-    if (network->sendTo(&msg, reliable)) {
-        if (pOutMessageNumber) *pOutMessageNumber = message_number;
-        return k_EResultOK;
+    int64 message_number = 0;
+    EResult result = queue_message(connect_socket, pData, cbData, nSendFlags, 0, &message_number);
+    if (result != k_EResultOK) return result;
+
+    // without k_nSteamNetworkingSend_NoNagle the message waits a bit for others to be coalesced with it
+    if ((nSendFlags & (k_nSteamNetworkingSend_NoNagle | k_nSteamNetworkingSend_NoDelay)) || connect_socket->second.send_queued_bytes >= SEND_BATCH_MAX_BYTES) {
+        if (!flush_messages(connect_socket)) return k_EResultFail;
+    } else {
+        schedule_nagle_flush(std::chrono::steady_clock::now() + std::chrono::microseconds(SEND_NAGLE_TIME_US));
     }
 
-    return k_EResultFail;
+    if (pOutMessageNumber) *pOutMessageNumber = message_number;
+    return k_EResultOK;
 }
 
 EResult Steam_Networking_Sockets::SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags )
@@ -795,9 +1077,26 @@ void Steam_Networking_Sockets::SendMessages( int nMessages, SteamNetworkingMessa
 {
     PRINT_DEBUG_ENTRY();
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    // everything for the same connection and delivery type goes out as one packet
+    std::vector<HSteamNetConnection> to_flush{};
+    bool nagle_wait = false;
     for (int i = 0; i < nMessages; ++i) {
+        SteamNetworkingMessage_t *pMsg = pMessages[i];
         int64 out_number = 0;
-        int result = SendMessageToConnection(pMessages[i]->m_conn, pMessages[i]->m_pData, pMessages[i]->m_cbSize, pMessages[i]->m_nFlags, &out_number);
+        EResult result = k_EResultInvalidParam;
+        auto connect_socket = sbcs->connect_sockets.find(pMsg->m_conn);
+        if (connect_socket != sbcs->connect_sockets.end()) {
+            result = queue_message(connect_socket, pMsg->m_pData, pMsg->m_cbSize, pMsg->m_nFlags, pMsg->m_idxLane, &out_number);
+        }
+
+        if (result == k_EResultOK) {
+            if ((pMsg->m_nFlags & (k_nSteamNetworkingSend_NoNagle | k_nSteamNetworkingSend_NoDelay)) || connect_socket->second.send_queued_bytes >= SEND_BATCH_MAX_BYTES) {
+                if (std::find(to_flush.begin(), to_flush.end(), pMsg->m_conn) == to_flush.end()) to_flush.push_back(pMsg->m_conn);
+            } else {
+                nagle_wait = true;
+            }
+        }
+
         if (pOutMessageNumberOrResult) {
             if (result == k_EResultOK) {
                 pOutMessageNumberOrResult[i] = out_number;
@@ -806,8 +1105,17 @@ void Steam_Networking_Sockets::SendMessages( int nMessages, SteamNetworkingMessa
             }
         }
 
-        pMessages[i]->m_pfnFreeData(pMessages[i]);
-        pMessages[i]->Release();
+        // Release() already frees the payload through m_pfnFreeData
+        pMsg->Release();
+    }
+
+    for (auto conn : to_flush) {
+        auto connect_socket = sbcs->connect_sockets.find(conn);
+        if (connect_socket != sbcs->connect_sockets.end()) flush_messages(connect_socket);
+    }
+
+    if (nagle_wait) {
+        schedule_nagle_flush(std::chrono::steady_clock::now() + std::chrono::microseconds(SEND_NAGLE_TIME_US));
     }
 }
 
@@ -820,9 +1128,15 @@ void Steam_Networking_Sockets::SendMessages( int nMessages, SteamNetworkingMessa
 /// on the next transmission time (often that means right now).
 EResult Steam_Networking_Sockets::FlushMessagesOnConnection( HSteamNetConnection hConn )
 {
-    PRINT_DEBUG_TODO();
+    PRINT_DEBUG("%u", hConn);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    return k_EResultOK;
+
+    auto connect_socket = sbcs->connect_sockets.find(hConn);
+    if (connect_socket == sbcs->connect_sockets.end()) return k_EResultInvalidParam;
+    if (connect_socket->second.status == CONNECT_SOCKET_CLOSED) return k_EResultNoConnection;
+    if (connect_socket->second.status == CONNECT_SOCKET_TIMEDOUT) return k_EResultNoConnection;
+
+    return flush_messages(connect_socket) ? k_EResultOK : k_EResultFail;
 }
 
 /// Fetch the next available message(s) from the connection, if any.
@@ -845,6 +1159,7 @@ int Steam_Networking_Sockets::ReceiveMessagesOnConnection( HSteamNetConnection h
     PRINT_DEBUG("%u %i", hConn, nMaxMessages);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     if (!ppOutMessages || !nMaxMessages) return 0;
+    network->dispatchReceived();
 
     SteamNetworkingMessage_t *msg = NULL;
     int messages = 0;
@@ -870,6 +1185,7 @@ int Steam_Networking_Sockets::ReceiveMessagesOnListenSocket( HSteamListenSocket
     PRINT_DEBUG("%u %i", hSocket, nMaxMessages);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     if (!ppOutMessages || !nMaxMessages) return 0;
+    network->dispatchReceived();
 
     SteamNetworkingMessage_t *msg = NULL;
     int messages = 0;
@@ -927,7 +1243,9 @@ EResult Steam_Networking_Sockets::GetConnectionRealTimeStatus( HSteamNetConnecti
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     auto connect_socket = sbcs->connect_sockets.find(hConn);
     if (connect_socket == sbcs->connect_sockets.end()) return k_EResultNoConnection;
+    if (nLanes < 0 || static_cast<size_t>(nLanes) > connect_socket->second.send_lanes.size() || (nLanes && !pLanes)) return k_EResultInvalidParam;
 
+    auto now = std::chrono::steady_clock::now();
     if (pStatus) {
         pStatus->m_eState = convert_status(connect_socket->second.status);
         pStatus->m_nPing = 10; //TODO: calculate real numbers?
@@ -938,15 +1256,34 @@ EResult Steam_Networking_Sockets::GetConnectionRealTimeStatus( HSteamNetConnecti
         pStatus->m_flOutBytesPerSec = 0.0;
         pStatus->m_flInPacketsPerSec = 0.0;
         pStatus->m_flInBytesPerSec = 0.0;
+        pStatus->m_cbPendingUnreliable = 0;
+        pStatus->m_cbPendingReliable = static_cast<int>(get_network_backlog(connect_socket->second));
         pStatus->m_cbSentUnackedReliable = 0;
         pStatus->m_usecQueueTime = 0;
+        for (auto &lane : connect_socket->second.send_lanes) {
+            pStatus->m_cbPendingUnreliable += static_cast<int>(lane.pending_bytes[0]);
+            pStatus->m_cbPendingReliable += static_cast<int>(lane.pending_bytes[1]);
+            if (lane.queue.size()) {
+                pStatus->m_usecQueueTime = std::max<SteamNetworkingMicroseconds>(pStatus->m_usecQueueTime, std::chrono::duration_cast<std::chrono::microseconds>(now - lane.queue.front().queued).count());
+            }
+        }
 
         //Note some games (volcanoids) might not allocate a struct the whole size of SteamNetworkingQuickConnectionStatus
         //keep this in mind in future interface updates
         //NOTE: need to implement GetQuickConnectionStatus seperately if this changes.
     }
 
-    //TODO: lanes
+    for (int i = 0; i < nLanes; ++i) {
+        const Send_Lane &lane = connect_socket->second.send_lanes[i];
+        pLanes[i] = {};
+        pLanes[i].m_cbPendingUnreliable = static_cast<int>(lane.pending_bytes[0]);
+        pLanes[i].m_cbPendingReliable = static_cast<int>(lane.pending_bytes[1]);
+        pLanes[i].m_cbSentUnackedReliable = 0;
+        pLanes[i].m_usecQueueTime = lane.queue.size()
+            ? std::chrono::duration_cast<std::chrono::microseconds>(now - lane.queue.front().queued).count()
+            : 0;
+    }
+
     return k_EResultOK;
 }
 
@@ -1118,6 +1455,9 @@ bool Steam_Networking_Sockets::CreateSocketPair( HSteamNetConnection *pOutConnec
     HSteamNetConnection con1 = new_connect_socket(remote_identity, 0, SNS_DISABLED_PORT, CONNECT_SOCKET_CONNECTED, k_HSteamListenSocket_Invalid, k_HSteamNetConnection_Invalid);
     HSteamNetConnection con2 = new_connect_socket(remote_identity, 0, SNS_DISABLED_PORT, CONNECT_SOCKET_CONNECTED, k_HSteamListenSocket_Invalid, con1);
     sbcs->connect_sockets[con1].remote_id = con2;
+    // both ends are this build
+    sbcs->connect_sockets[con1].peer_batching = true;
+    sbcs->connect_sockets[con2].peer_batching = true;
     *pOutConnection1 = con1;
     *pOutConnection2 = con2;
     return true;
@@ -1193,11 +1533,28 @@ bool Steam_Networking_Sockets::CreateSocketPair( HSteamNetConnection *pOutConnec
 /// SteamNetworkingMessage_t::m_idxLane
 EResult Steam_Networking_Sockets::ConfigureConnectionLanes( HSteamNetConnection hConn, int nNumLanes, const int *pLanePriorities, const uint16 *pLaneWeights )
 {
-    PRINT_DEBUG_TODO();
+    PRINT_DEBUG("%u %i %p %p", hConn, nNumLanes, pLanePriorities, pLaneWeights);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     auto connect_socket = sbcs->connect_sockets.find(hConn);
     if (connect_socket == sbcs->connect_sockets.end()) return k_EResultNoConnection;
-    //TODO
+    if (connect_socket->second.status == CONNECT_SOCKET_CLOSED || connect_socket->second.status == CONNECT_SOCKET_TIMEDOUT) return k_EResultInvalidState;
+
+    auto &lanes = connect_socket->second.send_lanes;
+    if (nNumLanes < 1 || nNumLanes > 255 || static_cast<size_t>(nNumLanes) < lanes.size()) return k_EResultInvalidParam;
+    if (pLaneWeights) {
+        for (int i = 0; i < nNumLanes; ++i) {
+            if (pLaneWeights[i] == 0) return k_EResultInvalidParam;
+        }
+    }
+
+    lanes.resize(nNumLanes);
+    for (int i = 0; i < nNumLanes; ++i) {
+        lanes[i].priority = pLanePriorities ? pLanePriorities[i] : 0;
+        lanes[i].weight = pLaneWeights ? pLaneWeights[i] : 1;
+        // the weights changed, start the shares over
+        lanes[i].virtual_time = connect_socket->second.send_virtual_clock;
+    }
+
     return k_EResultOK;
 }
 
@@ -1364,6 +1721,7 @@ int Steam_Networking_Sockets::ReceiveMessagesOnPollGroup( HSteamNetPollGroup hPo
 {
     PRINT_DEBUG("%u %i", hPollGroup, nMaxMessages);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    network->dispatchReceived();
     auto group = sbcs->poll_groups.find(hPollGroup);
     if (group == sbcs->poll_groups.end()) {
         return 0;
@@ -1583,9 +1941,8 @@ HSteamListenSocket Steam_Networking_Sockets::CreateHostedDedicatedServerListenSo
 HSteamListenSocket Steam_Networking_Sockets::CreateHostedDedicatedServerListenSocket( int nVirtualPort, int nOptions, const SteamNetworkingConfigValue_t *pOptions )
 {
     PRINT_DEBUG("old %i", nVirtualPort);
-    //TODO config options
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    return new_listen_socket(nVirtualPort, SNS_DISABLED_PORT);
+    return new_listen_socket(nVirtualPort, SNS_DISABLED_PORT, nOptions, pOptions);
 }
 
 
@@ -2020,6 +2377,9 @@ void Steam_Networking_Sockets::RunCallbacks()
 
         ++socket_conn;
     }
+
+    // the Nagle thread sends them on time, this only saves it a wake up
+    flush_expired_messages(current_time);
 }
 
 
@@ -2062,6 +2422,11 @@ void Steam_Networking_Sockets::Callback(Common_Message *msg)
                     SteamNetworkingIdentity identity;
                     identity.SetSteamID64(msg->source_id());
                     HSteamNetConnection new_connection = new_connect_socket(identity, virtual_port, real_port, CONNECT_SOCKET_NOT_ACCEPTED, conn->socket_id, static_cast<HSteamNetConnection>(msg->networking_sockets().connection_id_from()));
+                    auto new_socket = sbcs->connect_sockets.find(new_connection);
+                    if (new_socket != sbcs->connect_sockets.end()) {
+                        new_socket->second.peer_batching = !!(msg->networking_sockets().features() & Networking_Sockets::FEATURE_BATCH);
+                        new_socket->second.send_buffer_size = conn->send_buffer_size;
+                    }
                     launch_callback(new_connection, CONNECT_SOCKET_NO_CONNECTION);
                 }
             }
@@ -2075,6 +2440,7 @@ void Steam_Networking_Sockets::Callback(Common_Message *msg)
 
                 if (connect_socket->second.remote_identity.GetSteamID64() == msg->source_id() && connect_socket->second.status == CONNECT_SOCKET_CONNECTING) {
                     connect_socket->second.remote_id = static_cast<HSteamNetConnection>(msg->networking_sockets().connection_id_from());
+                    connect_socket->second.peer_batching = !!(msg->networking_sockets().features() & Networking_Sockets::FEATURE_BATCH);
                     connect_socket->second.status = CONNECT_SOCKET_CONNECTED;
                     launch_callback(connect_socket->first, CONNECT_SOCKET_CONNECTING);
                 }
@@ -2084,13 +2450,14 @@ void Steam_Networking_Sockets::Callback(Common_Message *msg)
             if (connect_socket != sbcs->connect_sockets.end()) {
                 if (connect_socket->second.remote_identity.GetSteamID64() == msg->source_id() && (connect_socket->second.status == CONNECT_SOCKET_CONNECTED)) {
                     PRINT_DEBUG("got data len %zu, num " "%" PRIu64 " on connection %u", msg->networking_sockets().data().size(), msg->networking_sockets().message_number(), connect_socket->first);
-                    connect_socket->second.data.push(msg->networking_sockets());
+                    // the message is only meant for this connection, take the payload instead of copying it
+                    push_received_data(connect_socket->second, std::move(*msg->mutable_networking_sockets()));
                 }
             } else {
                 connect_socket = std::find_if(sbcs->connect_sockets.begin(), sbcs->connect_sockets.end(), [msg](const auto &in) {return in.second.remote_identity.GetSteamID64() == msg->source_id() && (in.second.status == CONNECT_SOCKET_NOT_ACCEPTED || in.second.status == CONNECT_SOCKET_CONNECTED) && in.second.remote_id == msg->networking_sockets().connection_id_from();});
                 if (connect_socket != sbcs->connect_sockets.end()) {
                     PRINT_DEBUG("got data len %zu, num " "%" PRIu64 " on not accepted connection %u", msg->networking_sockets().data().size(), msg->networking_sockets().message_number(), connect_socket->first);
-                    connect_socket->second.data.push(msg->networking_sockets());
+                    push_received_data(connect_socket->second, std::move(*msg->mutable_networking_sockets()));
                 }
             }
         } else if (msg->networking_sockets().type() == Networking_Sockets::CONNECTION_END) {
@@ -16,6 +16,7 @@
    <http://www.gnu.org/licenses/>.  */
 
 #include "dll/steam_networking_utils.h"
+#include "dll/steam_networking_sockets.h"
 
 void Steam_Networking_Utils::steam_callback(void *object, Common_Message *msg)
 {
@@ -33,8 +34,9 @@ void Steam_Networking_Utils::steam_run_every_runcb(void *object)
     steam_networkingutils->RunCallbacks();
 }
 
-Steam_Networking_Utils::Steam_Networking_Utils(class Settings *settings, class Networking *network, class SteamCallResults *callback_results, class SteamCallBacks *callbacks, class RunEveryRunCB *run_every_runcb)
+Steam_Networking_Utils::Steam_Networking_Utils(class Settings *settings, class Networking *network, class SteamCallResults *callback_results, class SteamCallBacks *callbacks, class RunEveryRunCB *run_every_runcb, struct shared_between_client_server *sbcs)
 {
+    this->sbcs = sbcs;
     this->settings = settings;
     this->network = network;
     this->callback_results = callback_results;
@@ -51,18 +53,6 @@ Steam_Networking_Utils::~Steam_Networking_Utils()
     this->run_every_runcb->remove(&Steam_Networking_Utils::steam_run_every_runcb, this);
 }
 
-void Steam_Networking_Utils::free_steam_message_data(SteamNetworkingMessage_t *pMsg)
-{
-    free(pMsg->m_pData);
-    pMsg->m_pData = NULL;
-}
-
-void Steam_Networking_Utils::delete_steam_message(SteamNetworkingMessage_t *pMsg)
-{
-    if (pMsg->m_pfnFreeData) pMsg->m_pfnFreeData(pMsg);
-    delete pMsg;
-}
-
 /// Allocate and initialize a message object.  Usually the reason
 /// you call this is to pass it to ISteamNetworkingSockets::SendMessages.
 /// The returned object will have all of the relevant fields cleared to zero.
@@ -86,18 +76,10 @@ SteamNetworkingMessage_t* Steam_Networking_Utils::AllocateMessage( int cbAllocat
 {
     PRINT_DEBUG_ENTRY();
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    SteamNetworkingMessage_t *pMsg = new SteamNetworkingMessage_t();
-    pMsg->m_pfnFreeData = &free_steam_message_data;
-    pMsg->m_pfnRelease = &delete_steam_message;
     if (cbAllocateBuffer < 0)
         cbAllocateBuffer = 0;
 
-    pMsg->m_pData = nullptr;
-    if (cbAllocateBuffer)
-        pMsg->m_pData = malloc(cbAllocateBuffer);
-
-    pMsg->m_cbSize = cbAllocateBuffer;
-    return pMsg;
+    return new_networking_message(static_cast<size_t>(cbAllocateBuffer));
 }
 
 bool Steam_Networking_Utils::InitializeRelayAccess()
@@ -358,8 +340,47 @@ bool Steam_Networking_Utils::SetConnectionConfigValueString( HSteamNetConnection
 bool Steam_Networking_Utils::SetConfigValue( ESteamNetworkingConfigValue eValue, ESteamNetworkingConfigScope eScopeType, intptr_t scopeObj,
     ESteamNetworkingConfigDataType eDataType, const void *pArg )
 {
-    PRINT_DEBUG("TODO %i %i " "%" PRIdPTR " %i %p", eValue, eScopeType, scopeObj, eDataType, pArg);
+    PRINT_DEBUG("%i %i " "%" PRIdPTR " %i %p", eValue, eScopeType, scopeObj, eDataType, pArg);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
+
+    switch (eValue) {
+    case k_ESteamNetworkingConfig_SendBufferSize: {
+        if (eDataType != k_ESteamNetworkingConfig_Int32) return false;
+
+        int32 value = pArg ? *(const int32 *)pArg : 0;
+        if (value < 0) return false;
+
+        if (eScopeType == k_ESteamNetworkingConfig_Global) {
+            sbcs->send_buffer_size = pArg ? value : shared_between_client_server{}.send_buffer_size;
+            return true;
+        }
+
+        if (eScopeType == k_ESteamNetworkingConfig_Connection) {
+            auto connect_socket = sbcs->connect_sockets.find(static_cast<HSteamNetConnection>(scopeObj));
+            if (connect_socket == sbcs->connect_sockets.end()) return false;
+
+            // 0 means the connection follows the global value
+            connect_socket->second.send_buffer_size = value;
+            return true;
+        }
+
+        if (eScopeType == k_ESteamNetworkingConfig_ListenSocket) {
+            auto listen_socket = std::find_if(sbcs->listen_sockets.begin(), sbcs->listen_sockets.end(), [scopeObj](const Listen_Socket &item) { return item.socket_id == static_cast<HSteamListenSocket>(scopeObj); });
+            if (listen_socket == sbcs->listen_sockets.end()) return false;
+
+            // inherited by the connections accepted from now on
+            listen_socket->send_buffer_size = value;
+            return true;
+        }
+
+        return false;
+    }
+
+    default:
+        PRINT_DEBUG("TODO config value %i", eValue);
+        break;
+    }
+
     return true;
 }
 
@@ -374,8 +395,52 @@ bool Steam_Networking_Utils::SetConfigValue( ESteamNetworkingConfigValue eValue,
 ESteamNetworkingGetConfigValueResult Steam_Networking_Utils::GetConfigValue( ESteamNetworkingConfigValue eValue, ESteamNetworkingConfigScope eScopeType, intptr_t scopeObj,
     ESteamNetworkingConfigDataType *pOutDataType, void *pResult, size_t *cbResult )
 {
-    PRINT_DEBUG_TODO();
+    PRINT_DEBUG("%i %i " "%" PRIdPTR " %p %p", eValue, eScopeType, scopeObj, pResult, cbResult);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
+
+    switch (eValue) {
+    case k_ESteamNetworkingConfig_SendBufferSize: {
+        int32 value = sbcs->send_buffer_size;
+        auto result = k_ESteamNetworkingGetConfigValue_OKInherited;
+        if (eScopeType == k_ESteamNetworkingConfig_Global) {
+            result = k_ESteamNetworkingGetConfigValue_OK;
+        } else if (eScopeType == k_ESteamNetworkingConfig_Connection) {
+            auto connect_socket = sbcs->connect_sockets.find(static_cast<HSteamNetConnection>(scopeObj));
+            if (connect_socket == sbcs->connect_sockets.end()) return k_ESteamNetworkingGetConfigValue_BadScopeObj;
+
+            if (connect_socket->second.send_buffer_size > 0) {
+                value = connect_socket->second.send_buffer_size;
+                result = k_ESteamNetworkingGetConfigValue_OK;
+            }
+        } else if (eScopeType == k_ESteamNetworkingConfig_ListenSocket) {
+            auto listen_socket = std::find_if(sbcs->listen_sockets.begin(), sbcs->listen_sockets.end(), [scopeObj](const Listen_Socket &item) { return item.socket_id == static_cast<HSteamListenSocket>(scopeObj); });
+            if (listen_socket == sbcs->listen_sockets.end()) return k_ESteamNetworkingGetConfigValue_BadScopeObj;
+
+            if (listen_socket->send_buffer_size > 0) {
+                value = listen_socket->send_buffer_size;
+                result = k_ESteamNetworkingGetConfigValue_OK;
+            }
+        } else {
+            return k_ESteamNetworkingGetConfigValue_BadScopeObj;
+        }
+
+        if (pOutDataType) *pOutDataType = k_ESteamNetworkingConfig_Int32;
+        if (!cbResult) return k_ESteamNetworkingGetConfigValue_BadValue;
+        if (!pResult || *cbResult < sizeof(value)) {
+            *cbResult = sizeof(value);
+            return k_ESteamNetworkingGetConfigValue_BufferTooSmall;
+        }
+
+        *cbResult = sizeof(value);
+        std::memcpy(pResult, &value, sizeof(value));
+        return result;
+    }
+
+    default:
+        PRINT_DEBUG("TODO config value %i", eValue);
+        break;
+    }
+
     return k_ESteamNetworkingGetConfigValue_BadValue;
 }
 
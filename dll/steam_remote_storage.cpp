@@ -43,6 +43,16 @@ static void copy_file(const std::string &src_filepath, const std::string &dst_fi
 }
 
 
+// the same file can be referred to as "Save.dat" and "save.dat" or with either path separator,
+// all of them must map to the same worker and pending counter to keep their operations ordered
+static std::string io_file_key(const std::string &file_name)
+{
+    std::string key(common_helpers::to_lower(file_name));
+    std::replace(key.begin(), key.end(), '\\', '/');
+    return key;
+}
+
+
 void Steam_Remote_Storage::steam_run_every_runcb(void *object)
 {
     // PRINT_DEBUG_ENTRY();
@@ -61,12 +71,149 @@ Steam_Remote_Storage::Steam_Remote_Storage(class Settings *settings, class Ugc_R
     this->run_every_runcb = run_every_runcb;
 
     steam_cloud_enabled = true;
+
+    io_queues.resize(REMOTE_STORAGE_IO_WORKERS);
+    for (size_t i = 0; i < REMOTE_STORAGE_IO_WORKERS; ++i) {
+        io_workers.emplace_back(&Steam_Remote_Storage::io_worker_proc, this, i);
+    }
+
     this->run_every_runcb->add(&Steam_Remote_Storage::steam_run_every_runcb, this);
 }
 
 Steam_Remote_Storage::~Steam_Remote_Storage()
 {
 	this->run_every_runcb->remove(&Steam_Remote_Storage::steam_run_every_runcb, this);
+
+    // the workers finish whatever is still queued so pending saves aren't lost
+    {
+        std::lock_guard lock(io_mutex);
+        io_stop = true;
+    }
+    io_cv.notify_all();
+    for (auto &worker : io_workers) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+void Steam_Remote_Storage::io_worker_proc(size_t worker)
+{
+    auto &queue = io_queues[worker];
+    while (true) {
+        Async_Io_Op op{};
+        {
+            std::unique_lock lock(io_mutex);
+            io_cv.wait(lock, [&]{ return io_stop || !queue.empty(); });
+            if (queue.empty()) return; // stopping and nothing left
+
+            op = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        switch (op.type) {
+        case Async_Io_Op::Type::Write:
+            op.result = local_storage->store_data(Local_Storage::remote_storage_folder, op.file_name, op.data.data(), static_cast<unsigned int>(op.data.size()));
+            op.data.clear();
+            op.data.shrink_to_fit();
+        break;
+
+        case Async_Io_Op::Type::Read: {
+            // the size is checked here rather than when the read is issued, earlier writes to the file queued on this worker have landed by now
+            unsigned int size = local_storage->file_size(Local_Storage::remote_storage_folder, op.file_name);
+            if (size <= op.offset) {
+                op.result = -1;
+                break;
+            }
+
+            if ((size - op.offset) < op.to_read) op.to_read = size - op.offset;
+            // positional read of just the requested range
+            op.data.resize(op.to_read);
+            op.result = local_storage->get_data(Local_Storage::remote_storage_folder, op.file_name, op.data.data(), op.to_read, op.offset);
+        }
+        break;
+        }
+
+        PRINT_DEBUG("async %s of '%s' done %i", op.type == Async_Io_Op::Type::Write ? "write" : "read", op.file_name.c_str(), op.result);
+        {
+            std::lock_guard lock(io_mutex);
+            auto pending = io_pending.find(op.key);
+            if (io_pending.end() != pending && --pending->second == 0) io_pending.erase(pending);
+            io_done.push_back(std::move(op));
+        }
+        io_idle_cv.notify_all();
+    }
+}
+
+void Steam_Remote_Storage::queue_io(Async_Io_Op &&op)
+{
+    op.key = io_file_key(op.file_name);
+    size_t worker = std::hash<std::string>{}(op.key) % io_queues.size();
+    {
+        std::lock_guard lock(io_mutex);
+        ++io_pending[op.key];
+        io_queues[worker].push_back(std::move(op));
+    }
+    io_cv.notify_all();
+}
+
+// the workers never take the global mutex, so it's fine to wait for them while holding it
+void Steam_Remote_Storage::wait_io(const char *file_name)
+{
+    std::string key(io_file_key(file_name));
+    std::unique_lock lock(io_mutex);
+    io_idle_cv.wait(lock, [&]{ return io_pending.find(key) == io_pending.end(); });
+}
+
+void Steam_Remote_Storage::wait_all_io()
+{
+    std::unique_lock lock(io_mutex);
+    io_idle_cv.wait(lock, [&]{ return io_pending.empty(); });
+}
+
+void Steam_Remote_Storage::post_io_results()
+{
+    std::vector<Async_Io_Op> done{};
+    {
+        std::lock_guard lock(io_mutex);
+        if (io_done.empty()) return;
+        done.swap(io_done);
+    }
+
+    for (auto &op : done) {
+        switch (op.type) {
+        case Async_Io_Op::Type::Write: {
+            RemoteStorageFileWriteAsyncComplete_t data{};
+            data.m_eResult = op.result >= 0 && static_cast<size_t>(op.result) == op.to_read ? k_EResultOK : k_EResultFail;
+
+            callback_results->addCallResult(op.api_call, data.k_iCallback, &data, sizeof(data), 0.0);
+            callbacks->addCBResult(data.k_iCallback, &data, sizeof(data), 0.0);
+        }
+        break;
+
+        case Async_Io_Op::Type::Read: {
+            auto a_read = std::find_if(async_reads.begin(), async_reads.end(), [&op](Async_Read const& item) { return item.api_call == op.api_call; });
+            if (async_reads.end() == a_read) break;
+
+            RemoteStorageFileReadAsyncComplete_t data{};
+            data.m_hFileReadAsync = op.api_call;
+            data.m_nOffset = op.offset;
+            if (op.result >= 0 && static_cast<uint32>(op.result) == op.to_read) {
+                data.m_eResult = k_EResultOK;
+                data.m_cubRead = op.to_read;
+                a_read->to_read = op.to_read;
+                a_read->data = std::move(op.data);
+                a_read->ready = true;
+            } else {
+                data.m_eResult = k_EResultFail;
+                data.m_cubRead = 0;
+                async_reads.erase(a_read);
+            }
+
+            callback_results->addCallResult(op.api_call, data.k_iCallback, &data, sizeof(data), 0.0);
+            callbacks->addCBResult(data.k_iCallback, &data, sizeof(data), 0.0);
+        }
+        break;
+        }
+    }
 }
 
 // NOTE
@@ -86,6 +233,8 @@ bool Steam_Remote_Storage::FileWrite( const char *pchFile, const void *pvData, i
         return false;
     }
 
+    wait_io(pchFile);
+
     int data_stored = local_storage->store_data(Local_Storage::remote_storage_folder, pchFile, (char* )pvData, cubData);
     PRINT_DEBUG("%i, %u", data_stored, data_stored == cubData);
     return data_stored == cubData;
@@ -97,6 +246,7 @@ int32 Steam_Remote_Storage::FileRead( const char *pchFile, void *pvData, int32 c
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
 
     if (!pchFile || !pchFile[0] || !pvData || !cubDataToRead) return 0;
+    wait_io(pchFile);
     int read_data = local_storage->get_data(Local_Storage::remote_storage_folder, pchFile, (char* )pvData, cubDataToRead);
     if (read_data < 0) read_data = 0;
     PRINT_DEBUG("  Read %i", read_data);
@@ -113,12 +263,17 @@ SteamAPICall_t Steam_Remote_Storage::FileWriteAsync( const char *pchFile, const
         return k_uAPICallInvalid;
     }
 
-    bool success = local_storage->store_data(Local_Storage::remote_storage_folder, pchFile, (char* )pvData, cubData) == cubData;
-    RemoteStorageFileWriteAsyncComplete_t data;
-    data.m_eResult = success ? k_EResultOK : k_EResultFail;
-
-    auto ret = callback_results->addCallResult(data.k_iCallback, &data, sizeof(data), 0.01);
-    callbacks->addCBResult(data.k_iCallback, &data, sizeof(data), 0.01);
+    // the data is copied since the game may free its buffer right after this call,
+    // the call result is posted once an I/O worker wrote it to disk
+    Async_Io_Op op{};
+    op.type = Async_Io_Op::Type::Write;
+    op.api_call = callback_results->reserveCallResult();
+    op.file_name = pchFile;
+    op.to_read = cubData;
+    op.data.assign((const char *)pvData, (const char *)pvData + cubData);
+
+    SteamAPICall_t ret = op.api_call;
+    queue_io(std::move(op));
     return ret;
 }
 
@@ -130,28 +285,26 @@ SteamAPICall_t Steam_Remote_Storage::FileReadAsync( const char *pchFile, uint32
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
 
     if (!pchFile || !pchFile[0]) return k_uAPICallInvalid;
-    unsigned int size = local_storage->file_size(Local_Storage::remote_storage_folder, pchFile);
-
-    RemoteStorageFileReadAsyncComplete_t data;
-    if (size <= nOffset) {
-     return k_uAPICallInvalid;
-    }
-
-    if ((size - nOffset) < cubToRead) cubToRead = size - nOffset;
 
+    // the file size is checked by the I/O worker, after any write to the file queued before this read,
+    // an offset past the end of the file completes the call with k_EResultFail
     struct Async_Read a_read{};
-    data.m_eResult = k_EResultOK;
-    a_read.offset = data.m_nOffset = nOffset;
-    a_read.api_call = data.m_hFileReadAsync = callback_results->reserveCallResult();
-    a_read.to_read = data.m_cubRead = cubToRead;
+    a_read.offset = nOffset;
+    a_read.api_call = callback_results->reserveCallResult();
+    a_read.to_read = cubToRead;
     a_read.file_name = std::string(pchFile);
-    a_read.size = size;
 
     async_reads.push_back(a_read);
 
-    callback_results->addCallResult(data.m_hFileReadAsync, data.k_iCallback, &data, sizeof(data), 0.0);
-    callbacks->addCBResult(data.k_iCallback, &data, sizeof(data), 0.0);
-    return data.m_hFileReadAsync;
+    Async_Io_Op op{};
+    op.type = Async_Io_Op::Type::Read;
+    op.api_call = a_read.api_call;
+    op.file_name = a_read.file_name;
+    op.offset = nOffset;
+    op.to_read = cubToRead;
+    queue_io(std::move(op));
+
+    return a_read.api_call;
 }
 
 bool Steam_Remote_Storage::FileReadAsyncComplete( SteamAPICall_t hReadCall, void *pvBuffer, uint32 cubToRead )
@@ -164,16 +317,10 @@ bool Steam_Remote_Storage::FileReadAsyncComplete( SteamAPICall_t hReadCall, void
     if (async_reads.end() == a_read)
         return false;
 
-    if (cubToRead < a_read->to_read)
+    if (!a_read->ready || cubToRead < a_read->to_read)
         return false;
 
-    std::vector<char> temp(a_read->size);
-    int read_data = local_storage->get_data(Local_Storage::remote_storage_folder, a_read->file_name, (char* )&temp[0], a_read->size);
-    if (read_data < 0 || (static_cast<uint32>(read_data) < (a_read->to_read + a_read->offset))) {
-        return false;
-    }
-
-    memcpy(pvBuffer, &temp[0] + a_read->offset, a_read->to_read);
+    memcpy(pvBuffer, a_read->data.data(), a_read->to_read);
     async_reads.erase(a_read);
     return true;
 }
@@ -194,6 +341,7 @@ bool Steam_Remote_Storage::FileDelete( const char *pchFile )
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     if (!pchFile || !pchFile[0]) return false;
     
+    wait_io(pchFile);
     return local_storage->file_delete(Local_Storage::remote_storage_folder, pchFile);
 }
 
@@ -204,6 +352,7 @@ SteamAPICall_t Steam_Remote_Storage::FileShare( const char *pchFile )
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     if (!pchFile || !pchFile[0]) return k_uAPICallInvalid;
 
+    wait_io(pchFile);
     RemoteStorageFileShareResult_t data = {};
     if (local_storage->file_exists(Local_Storage::remote_storage_folder, pchFile)) {
         data.m_eResult = k_EResultOK;
@@ -269,6 +418,7 @@ bool Steam_Remote_Storage::FileWriteStreamClose( UGCFileWriteStreamHandle_t writ
     if (stream_writes.end() == request)
         return false;
 
+    wait_io(request->file_name.c_str());
     local_storage->store_data(Local_Storage::remote_storage_folder, request->file_name, request->file_data.data(), static_cast<unsigned int>(request->file_data.size()));
     stream_writes.erase(request);
     return true;
@@ -293,6 +443,7 @@ bool Steam_Remote_Storage::FileExists( const char *pchFile )
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     if (!pchFile || !pchFile[0]) return false;
     
+    wait_io(pchFile);
     return local_storage->file_exists(Local_Storage::remote_storage_folder, pchFile);
 }
 
@@ -302,6 +453,7 @@ bool Steam_Remote_Storage::FilePersisted( const char *pchFile )
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     if (!pchFile || !pchFile[0]) return false;
     
+    wait_io(pchFile);
     return local_storage->file_exists(Local_Storage::remote_storage_folder, pchFile);
 }
 
@@ -311,6 +463,7 @@ int32 Steam_Remote_Storage::GetFileSize( const char *pchFile )
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     if (!pchFile || !pchFile[0]) return 0;
     
+    wait_io(pchFile);
     return local_storage->file_size(Local_Storage::remote_storage_folder, pchFile);
 }
 
@@ -320,6 +473,7 @@ int64 Steam_Remote_Storage::GetFileTimestamp( const char *pchFile )
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     if (!pchFile || !pchFile[0]) return 0;
     
+    wait_io(pchFile);
     return local_storage->file_timestamp(Local_Storage::remote_storage_folder, pchFile);
 }
 
@@ -338,6 +492,7 @@ int32 Steam_Remote_Storage::GetFileCount()
     PRINT_DEBUG_ENTRY();
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     
+    wait_all_io();
     int32 num = local_storage->count_files(Local_Storage::remote_storage_folder);
     PRINT_DEBUG("count: %i", num);
     return num;
@@ -348,6 +503,7 @@ const char* Steam_Remote_Storage::GetFileNameAndSize( int iFile, int32 *pnFileSi
     PRINT_DEBUG("%i %p", iFile, pnFileSizeInBytes);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     
+    wait_all_io();
     std::string output_filename{};
     if (local_storage->iterate_file(Local_Storage::remote_storage_folder, iFile, output_filename, pnFileSizeInBytes)) {
         auto &request = requests_GetFileNameAndSize.create(std::chrono::minutes(15), std::move(output_filename));
@@ -442,6 +598,7 @@ SteamAPICall_t Steam_Remote_Storage::UGCDownload( UGCHandle_t hContent, uint32 u
     if (shared_files.count(hContent)) {
         data.m_eResult = k_EResultOK;
         data.m_ulSteamIDOwner = settings->get_local_steam_id().ConvertToUint64();
+        wait_io(shared_files[hContent].c_str());
         data.m_nSizeInBytes = local_storage->file_size(Local_Storage::remote_storage_folder, shared_files[hContent]);
 
         shared_files[hContent].copy(data.m_pchFileName, sizeof(data.m_pchFileName) - 1);
@@ -568,6 +725,7 @@ int32 Steam_Remote_Storage::UGCRead( UGCHandle_t hContent, void *pvData, int32 c
     {
     case Downloaded_File::DownloadSource::AfterFileShare: {
         PRINT_DEBUG("  source = AfterFileShare '%s'", dwf.file.c_str());
+        wait_io(dwf.file.c_str());
         read_data = local_storage->get_data(Local_Storage::remote_storage_folder, dwf.file, (char *)pvData, cubDataToRead, cOffset);
         total_size = dwf.total_size;
     }
@@ -576,23 +734,43 @@ int32 Steam_Remote_Storage::UGCRead( UGCHandle_t hContent, void *pvData, int32 c
     case Downloaded_File::DownloadSource::AfterSendQueryUGCRequest:
     case Downloaded_File::DownloadSource::FromUGCDownloadToLocation: {
         PRINT_DEBUG("  source = AfterSendQueryUGCRequest || FromUGCDownloadToLocation [%i]", (int)dwf.get_source());
-        auto mod = settings->getMod(dwf.mod_query_info.mod_id);
-        auto &mod_name = dwf.mod_query_info.is_primary_file
-            ? mod.primaryFileName
-            : mod.previewFileName;
+        if (dwf.content_fullpath.empty()) {
+            if (dwf.get_source() == Downloaded_File::DownloadSource::AfterSendQueryUGCRequest) {
+                auto mod = settings->getMod(dwf.mod_query_info.mod_id);
+                auto &mod_name = dwf.mod_query_info.is_primary_file
+                    ? mod.primaryFileName
+                    : mod.previewFileName;
+                std::string mod_base_path = dwf.mod_query_info.is_primary_file
+                    ? mod.path
+                    : Local_Storage::get_game_settings_path() + "mod_images" + PATH_SEPARATOR + std::to_string(mod.id);
+
+                dwf.content_fullpath = common_helpers::to_absolute(mod_name, mod_base_path);
+            } else { // Downloaded_File::DownloadSource::FromUGCDownloadToLocation
+                dwf.content_fullpath = dwf.download_to_location_fullpath;
+            }
+        }
 
-        std::string mod_fullpath{};
-        if (dwf.get_source() == Downloaded_File::DownloadSource::AfterSendQueryUGCRequest) {
-            std::string mod_base_path = dwf.mod_query_info.is_primary_file
-                ? mod.path
-                : Local_Storage::get_game_settings_path() + "mod_images" + PATH_SEPARATOR + std::to_string(mod.id);
+        // games stream big content in small chunks, map the file once instead of reopening it on every chunk
+        // small files are read directly, so they aren't kept mapped (can't be truncated on Windows while mapped)
+        if (!dwf.content_map && dwf.total_size >= UGC_READ_MAP_MIN_SIZE) {
+            dwf.content_map = std::make_unique<common_helpers::MappedFile>();
+            if (!dwf.content_map->open(dwf.content_fullpath)) {
+                PRINT_DEBUG("  couldn't map mod file '%s', falling back to regular reads", dwf.content_fullpath.c_str());
+            }
+        }
 
-            mod_fullpath = common_helpers::to_absolute(mod_name, mod_base_path);
-        } else { // Downloaded_File::DownloadSource::FromUGCDownloadToLocation
-            mod_fullpath = dwf.download_to_location_fullpath;
+        // the mapping doesn't follow a file that was written or truncated, reading a truncated part would crash on POSIX
+        if (dwf.content_map && dwf.content_map->is_open() && dwf.content_map->changed()) {
+            PRINT_DEBUG("  mod file '%s' changed while mapped, falling back to regular reads", dwf.content_fullpath.c_str());
+            dwf.content_map->close();
+        }
+
+        const std::string &mod_fullpath = dwf.content_fullpath;
+        if (dwf.content_map && dwf.content_map->is_open()) {
+            read_data = static_cast<int>(dwf.content_map->read(pvData, static_cast<size_t>(cubDataToRead), cOffset));
+        } else {
+            read_data = Local_Storage::get_file_data(mod_fullpath, (char *)pvData, cubDataToRead, cOffset);
         }
-        
-        read_data = Local_Storage::get_file_data(mod_fullpath, (char *)pvData, cubDataToRead, cOffset);
         PRINT_DEBUG("  mod file '%s' [%i]", mod_fullpath.c_str(), read_data);
         total_size = dwf.total_size;
     }
@@ -1259,6 +1437,7 @@ bool Steam_Remote_Storage::EndFileWriteBatch()
 
 void Steam_Remote_Storage::RunCallbacks()
 {
+    post_io_results();
     requests_GetFileNameAndSize.cleanup();
     requests_GetUGCDetails.cleanup();
 }
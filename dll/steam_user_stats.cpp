@@ -18,6 +18,11 @@
 #include "dll/steam_user_stats.h"
 #include <random>
 
+// how long changed stats may stay in memory before being written to disk
+#define STATS_FLUSH_INTERVAL 5.0
+// how long a burst of achievement changes is collected before achievements.json is rewritten
+#define ACHIEVEMENTS_SAVE_DELAY 1.0
+
 
 void Steam_User_Stats::steam_user_stats_network_low_level(void *object, Common_Message *msg)
 {
@@ -50,16 +55,6 @@ Steam_User_Stats::Steam_User_Stats(Settings *settings, class Networking *network
     load_achievements_db(); // steam_settings/achievements.json
     load_achievements(); // %appdata%/<emu saves folder>/<app id>/achievements.json
 
-    // discard achievements without a "name"
-    auto x = defined_achievements.begin();
-    while (x != defined_achievements.end()) {
-        if (!x->contains("name")) {
-            x = defined_achievements.erase(x);
-        } else {
-            ++x;
-        }
-    }
-
     for (auto & it : defined_achievements) {
         try {
             std::string name = static_cast<std::string const&>(it["name"]);
@@ -127,6 +122,9 @@ Steam_User_Stats::~Steam_User_Stats()
     }
     this->network->rmCallback(CALLBACK_ID_USER_STATUS, settings->get_local_steam_id(), &Steam_User_Stats::steam_user_stats_network_low_level, this);
     this->run_every_runcb->remove(&Steam_User_Stats::steam_user_stats_run_every_runcb, this);
+
+    flush_stats();
+    if (achievements_save_pending) save_achievements();
 }
 
 
@@ -438,8 +436,17 @@ bool Steam_User_Stats::IndicateAchievementProgress( CGameID nGameID, const char
 
 void Steam_User_Stats::steam_run_callback()
 {
-    send_updated_stats();
+    if (check_timedout(last_gameserver_stats_sync, settings->gameserver_stats_sync_interval_ms / 1000.0)) {
+        send_updated_stats();
+    }
     load_achievements_icons();
+
+    if (check_timedout(last_stats_flush, STATS_FLUSH_INTERVAL)) {
+        flush_stats();
+    }
+    if (achievements_save_pending && check_timedout(achievements_save_requested, ACHIEVEMENTS_SAVE_DELAY)) {
+        save_achievements();
+    }
 }
 
 
@@ -462,8 +469,9 @@ void Steam_User_Stats::network_callback_low_level(Common_Message *msg)
     
     case Low_Level::DISCONNECT: {
         for (auto &board : cached_leaderboards) {
-            board.remove_entries(steamid);
+            board.entries.remove(steamid);
         }
+        stats_gameservers.erase(steamid.ConvertToUint64());
         
         // PRINT_DEBUG("removed user %llu", (uint64)steamid.ConvertToUint64());
     }
@@ -65,6 +65,28 @@ void Steam_User_Stats::load_achievements_db()
 {
     std::string file_path = Local_Storage::get_game_settings_path() + achievements_user_file;
     local_storage->load_json(file_path, defined_achievements);
+
+    // discard achievements without a "name"
+    auto x = defined_achievements.begin();
+    while (x != defined_achievements.end()) {
+        if (!x->contains("name")) {
+            x = defined_achievements.erase(x);
+        } else {
+            ++x;
+        }
+    }
+
+    defined_achievements_index.clear();
+    if (!defined_achievements.is_array()) return;
+
+    defined_achievements_index.reserve(defined_achievements.size());
+    for (size_t idx = 0; idx < defined_achievements.size(); ++idx) {
+        try {
+            const auto &name = defined_achievements[idx]["name"].get_ref<const std::string &>();
+            // names are case insensitive, if some only differ in case the first one wins (same as a linear search)
+            defined_achievements_index.emplace(common_helpers::to_lower(name), idx);
+        } catch(...) {}
+    }
 }
 
 void Steam_User_Stats::load_achievements()
@@ -74,9 +96,18 @@ void Steam_User_Stats::load_achievements()
 
 void Steam_User_Stats::save_achievements()
 {
+    achievements_save_pending = false;
     local_storage->write_json_file("", achievements_user_file, user_achievements);
 }
 
+void Steam_User_Stats::queue_save_achievements()
+{
+    if (achievements_save_pending) return;
+
+    achievements_save_pending = true;
+    achievements_save_requested = std::chrono::high_resolution_clock::now();
+}
+
 int Steam_User_Stats::load_ach_icon(nlohmann::json &defined_ach, bool achieved)
 {
     const char *icon_handle_key = achieved ? "icon_handle" : "icon_gray_handle";
@@ -123,13 +154,10 @@ int Steam_User_Stats::load_ach_icon(nlohmann::json &defined_ach, bool achieved)
 
 nlohmann::detail::iter_impl<nlohmann::json> Steam_User_Stats::defined_achievements_find(const std::string &key)
 {
-    return std::find_if(
-        defined_achievements.begin(), defined_achievements.end(),
-        [&key](const nlohmann::json& item) {
-            const std::string &name = static_cast<const std::string &>( item.value("name", std::string()) );
-            return common_helpers::str_cmp_insensitive(key, name);
-        }
-    );
+    auto idx = defined_achievements_index.find(common_helpers::to_lower(key));
+    if (defined_achievements_index.end() == idx) return defined_achievements.end();
+
+    return defined_achievements.begin() + idx->second;
 }
 
 std::string Steam_User_Stats::get_value_for_language(const nlohmann::json &json, std::string_view key, std::string_view language)
@@ -220,7 +248,7 @@ Steam_User_Stats::InternalSetResult<bool> Steam_User_Stats::set_achievement_inte
             user_achievements[internal_name]["earned_time"] =
                 std::chrono::duration_cast<std::chrono::duration<uint32>>(std::chrono::system_clock::now().time_since_epoch()).count();
 
-            save_achievements();
+            queue_save_achievements();
 
             result.notify_server = !settings->disable_sharing_stats_with_gameserver;
 
@@ -274,7 +302,7 @@ Steam_User_Stats::InternalSetResult<bool> Steam_User_Stats::clear_achievement_in
             
             user_achievements[internal_name]["earned"] = false;
             user_achievements[internal_name]["earned_time"] = static_cast<uint32>(0);
-            save_achievements();
+            queue_save_achievements();
 
             result.notify_server = !settings->disable_sharing_stats_with_gameserver;
 
@@ -326,7 +354,7 @@ bool Steam_User_Stats::SetAchievement( const char *pchName )
 
     auto ret = set_achievement_internal(pchName);
     if (ret.success && ret.notify_server) {
-        auto &new_ach = (*pending_server_updates.mutable_user_achievements())[ret.internal_name];
+        auto &new_ach = (*pending_server_updates.mutable_user_achievements())[intern_ach_name(ret.internal_name)];
         new_ach.set_achieved(ret.current_val);
 
         if (settings->immediate_gameserver_stats) send_updated_stats();
@@ -342,7 +370,7 @@ bool Steam_User_Stats::ClearAchievement( const char *pchName )
 
     auto ret = clear_achievement_internal(pchName);
     if (ret.success && ret.notify_server) {
-        auto &new_ach = (*pending_server_updates.mutable_user_achievements())[ret.internal_name];
+        auto &new_ach = (*pending_server_updates.mutable_user_achievements())[intern_ach_name(ret.internal_name)];
         new_ach.set_achieved(ret.current_val);
 
         if (settings->immediate_gameserver_stats) send_updated_stats();
@@ -548,7 +576,7 @@ bool Steam_User_Stats::IndicateAchievementProgress( const char *pchName, uint32
             user_achievements[actual_ach_name]["progress"] = nCurProgress;
             user_achievements[actual_ach_name]["max_progress"] = nMaxProgress;
             
-            save_achievements();
+            queue_save_achievements();
             
             overlay->AddAchievementNotification(actual_ach_name, user_achievements[actual_ach_name], true);
         }
@@ -16,55 +16,206 @@
    <http://www.gnu.org/licenses/>.  */
 
 #include "dll/steam_user_stats.h"
+#include "common_helpers/mapped_file.hpp"
 #include <random>
 
+// rewrite a leaderboard file once it holds this many of our scores
+#define LEADERBOARD_MAX_FILE_ITEMS 32
+#define LEADERBOARD_MAX_DOWNLOADS 64
 
-// --- Steam_Leaderboard ---
 
-Steam_Leaderboard_Entry* Steam_Leaderboard::find_recent_entry(const CSteamID &steamid) const
+// --- Steam_Leaderboard_Entries ---
+
+Steam_Leaderboard_Entries::Steam_Leaderboard_Entries(ELeaderboardSortMethod sort_method):
+    sort_method(sort_method)
 {
-    auto my_it = std::find_if(entries.begin(), entries.end(), [&steamid](const Steam_Leaderboard_Entry &item) {
-        return item.steam_id == steamid;
-    });
-    if (entries.end() == my_it) return nullptr;
-    return const_cast<Steam_Leaderboard_Entry*>(&*my_it);
+
 }
 
-void Steam_Leaderboard::remove_entries(const CSteamID &steamid)
+bool Steam_Leaderboard_Entries::goes_before(const Node &a, const Node &b) const
 {
-    auto rm_it = std::remove_if(entries.begin(), entries.end(), [&](const Steam_Leaderboard_Entry &item){
-        return item.steam_id == steamid;
-    });
-    if (entries.end() != rm_it) entries.erase(rm_it, entries.end());
+    if (a.entry.score != b.entry.score) {
+        if (sort_method == k_ELeaderboardSortMethodAscending) return a.entry.score < b.entry.score;
+        if (sort_method == k_ELeaderboardSortMethodDescending) return a.entry.score > b.entry.score;
+    }
+
+    return a.seq < b.seq;
 }
 
-void Steam_Leaderboard::remove_duplicate_entries()
+uint32 Steam_Leaderboard_Entries::subtree_size(int32 node) const
 {
-    if (entries.size() <= 1) return;
+    return node < 0 ? 0 : nodes[node].size;
+}
 
-    auto rm = std::remove_if(entries.begin(), entries.end(), [&](const Steam_Leaderboard_Entry& item) {
-        auto recent = find_recent_entry(item.steam_id);
-        return &item != recent;
-    });
-    if (entries.end() != rm) entries.erase(rm, entries.end());
+void Steam_Leaderboard_Entries::update_size(int32 node)
+{
+    nodes[node].size = 1 + subtree_size(nodes[node].left) + subtree_size(nodes[node].right);
+}
+
+void Steam_Leaderboard_Entries::split(int32 node, const Node &key, int32 &left, int32 &right)
+{
+    if (node < 0) {
+        left = right = -1;
+        return;
+    }
+
+    if (goes_before(nodes[node], key)) {
+        split(nodes[node].right, key, nodes[node].right, right);
+        left = node;
+    } else {
+        split(nodes[node].left, key, left, nodes[node].left);
+        right = node;
+    }
+    update_size(node);
+}
+
+int32 Steam_Leaderboard_Entries::merge(int32 left, int32 right)
+{
+    if (left < 0) return right;
+    if (right < 0) return left;
+
+    if (nodes[left].priority > nodes[right].priority) {
+        nodes[left].right = merge(nodes[left].right, right);
+        update_size(left);
+        return left;
+    } else {
+        nodes[right].left = merge(left, nodes[right].left);
+        update_size(right);
+        return right;
+    }
+}
+
+void Steam_Leaderboard_Entries::insert_node(int32 node)
+{
+    // xorshift, only used to keep the tree balanced
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+
+    auto &n = nodes[node];
+    n.priority = rng_state;
+    n.size = 1;
+    n.left = n.right = -1;
+
+    int32 left = -1, right = -1;
+    split(root, nodes[node], left, right);
+    root = merge(merge(left, node), right);
+}
+
+void Steam_Leaderboard_Entries::erase_node(int32 &node, const Node &key)
+{
+    if (node < 0) return;
+
+    if (&nodes[node] == &key) {
+        node = merge(nodes[node].left, nodes[node].right);
+        return;
+    }
+
+    if (goes_before(key, nodes[node])) erase_node(nodes[node].left, key);
+    else erase_node(nodes[node].right, key);
+    update_size(node);
 }
 
-void Steam_Leaderboard::sort_entries()
+size_t Steam_Leaderboard_Entries::size() const
 {
-    if (sort_method == k_ELeaderboardSortMethodNone) return;
-    if (entries.size() <= 1) return;
+    return user_nodes.size();
+}
+
+const Steam_Leaderboard_Entry* Steam_Leaderboard_Entries::find(const CSteamID &steamid) const
+{
+    auto it = user_nodes.find(steamid.ConvertToUint64());
+    if (user_nodes.end() == it) return nullptr;
+    return &nodes[it->second].entry;
+}
 
-    std::sort(entries.begin(), entries.end(), [this](const Steam_Leaderboard_Entry &item1, const Steam_Leaderboard_Entry &item2) {
-        if (sort_method == k_ELeaderboardSortMethodAscending) {
-            return item1.score < item2.score;
-        } else { // k_ELeaderboardSortMethodDescending
-            return item1.score > item2.score;
+int Steam_Leaderboard_Entries::rank(const CSteamID &steamid) const
+{
+    auto it = user_nodes.find(steamid.ConvertToUint64());
+    if (user_nodes.end() == it) return -1;
+
+    const auto &target = nodes[it->second];
+    uint32 rank = subtree_size(target.left);
+    int32 node = root;
+    while (node >= 0 && node != it->second) {
+        if (goes_before(target, nodes[node])) {
+            node = nodes[node].left;
+        } else {
+            rank += subtree_size(nodes[node].left) + 1;
+            node = nodes[node].right;
         }
-    });
+    }
+
+    return static_cast<int>(rank);
+}
+
+const Steam_Leaderboard_Entry* Steam_Leaderboard_Entries::at(size_t rank) const
+{
+    if (rank >= size()) return nullptr;
+
+    int32 node = root;
+    while (node >= 0) {
+        uint32 left_size = subtree_size(nodes[node].left);
+        if (rank < left_size) {
+            node = nodes[node].left;
+        } else if (rank == left_size) {
+            return &nodes[node].entry;
+        } else {
+            rank -= left_size + 1;
+            node = nodes[node].right;
+        }
+    }
+
+    return nullptr;
+}
+
+int Steam_Leaderboard_Entries::upsert(const Steam_Leaderboard_Entry &entry)
+{
+    auto it = user_nodes.find(entry.steam_id.ConvertToUint64());
+    if (user_nodes.end() != it) {
+        auto &node = nodes[it->second];
+        // same position, no need to touch the tree
+        if (node.entry.score == entry.score || sort_method == k_ELeaderboardSortMethodNone) {
+            node.entry = entry;
+            return rank(entry.steam_id);
+        }
+
+        erase_node(root, node);
+        node.entry = entry;
+        node.seq = next_seq++;
+        insert_node(it->second);
+        return rank(entry.steam_id);
+    }
+
+    int32 node{};
+    if (free_nodes.size()) {
+        node = free_nodes.back();
+        free_nodes.pop_back();
+    } else {
+        node = static_cast<int32>(nodes.size());
+        nodes.emplace_back();
+    }
+
+    nodes[node].entry = entry;
+    nodes[node].seq = next_seq++;
+    user_nodes[entry.steam_id.ConvertToUint64()] = node;
+    insert_node(node);
+    return rank(entry.steam_id);
+}
 
+bool Steam_Leaderboard_Entries::remove(const CSteamID &steamid)
+{
+    auto it = user_nodes.find(steamid.ConvertToUint64());
+    if (user_nodes.end() == it) return false;
+
+    int32 node = it->second;
+    erase_node(root, nodes[node]);
+    nodes[node].entry = {};
+    free_nodes.push_back(node);
+    user_nodes.erase(it);
+    return true;
 }
 
-// --- Steam_Leaderboard ---
+// --- Steam_Leaderboard_Entries ---
 
 
 /*
@@ -72,6 +223,8 @@ layout of each item in the leaderboard file
 | steamid - lower 32-bits | steamid - higher 32-bits | score (4 bytes) | score details count (4 bytes) | score details array (4 bytes each) ...
   [0]                     | [1]                      | [2]             | [3]                            | [4]
   ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^ main header ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+
+new scores are appended to the file, when a user has more than one item the last one wins
 */
 
 std::vector<Steam_Leaderboard_Entry> Steam_User_Stats::load_leaderboard_entries(const std::string &name)
@@ -82,37 +235,41 @@ std::vector<Steam_Leaderboard_Entry> Steam_User_Stats::load_leaderboard_entries(
     std::vector<Steam_Leaderboard_Entry> out{};
 
     std::string leaderboard_name(common_helpers::to_lower(name));
-    unsigned read_bytes = local_storage->file_size(Local_Storage::leaderboard_storage_folder, leaderboard_name);
-    if ((read_bytes == 0) ||
-        (read_bytes < (ELEMENT_SIZE * MAIN_HEADER_ELEMENTS_COUNT)) ||
-        (read_bytes % ELEMENT_SIZE) != 0) {
-        return out;
-    }
+    if (!local_storage->file_exists(Local_Storage::leaderboard_storage_folder, leaderboard_name)) return out;
 
-    std::vector<uint32_t> output(read_bytes / ELEMENT_SIZE);
-    if (local_storage->get_data(Local_Storage::leaderboard_storage_folder, leaderboard_name, (char* )output.data(), read_bytes) != read_bytes) return out;
+    common_helpers::MappedFile file{};
+    std::string file_path(local_storage->get_path(Local_Storage::leaderboard_storage_folder) + PATH_SEPARATOR + Local_Storage::sanitize_string(leaderboard_name));
+    if (!file.open(file_path)) return out;
 
-    unsigned int i = 0;
+    // user -> index in out
+    std::unordered_map<uint64, size_t> user_entries{};
+    uint64_t offset = 0;
     while (true) {
-        if ((i + MAIN_HEADER_ELEMENTS_COUNT) > output.size()) break; // invalid main header, or end of buffer
+        uint32_t header[MAIN_HEADER_ELEMENTS_COUNT]{};
+        if (file.read(header, sizeof(header), offset) != sizeof(header)) break; // invalid main header, or end of file
+        offset += sizeof(header);
 
         Steam_Leaderboard_Entry new_entry{};
-        new_entry.steam_id = CSteamID((uint64)output[i] + (((uint64)output[i + 1]) << 32));
-        new_entry.score = (int32)output[i + 2];
-        uint32_t details_count = output[i + 3];
-        i += MAIN_HEADER_ELEMENTS_COUNT; // skip main header
+        new_entry.steam_id = CSteamID((uint64)header[0] + (((uint64)header[1]) << 32));
+        new_entry.score = (int32)header[2];
+        uint32_t details_count = header[3];
 
-        if ((i + details_count) > output.size()) break; // invalid score details count
+        if ((uint64_t)details_count * ELEMENT_SIZE > file.size() - offset) break; // invalid score details count
 
-        for (uint32_t j = 0; j < details_count; ++j) {
-            new_entry.score_details.push_back(output[i]);
-            ++i; // move past this score detail
-        }
+        new_entry.score_details.resize(details_count);
+        if (details_count) file.read(new_entry.score_details.data(), details_count * ELEMENT_SIZE, offset);
+        offset += (uint64_t)details_count * ELEMENT_SIZE;
 
         PRINT_DEBUG("'%s': user %llu, score %i, details count = %zu",
             name.c_str(), new_entry.steam_id.ConvertToUint64(), new_entry.score, new_entry.score_details.size()
         );
-        out.push_back(new_entry);
+        auto user_it = user_entries.find(new_entry.steam_id.ConvertToUint64());
+        if (user_entries.end() != user_it) {
+            out[user_it->second] = std::move(new_entry);
+        } else {
+            user_entries[new_entry.steam_id.ConvertToUint64()] = out.size();
+            out.push_back(std::move(new_entry));
+        }
     }
 
     PRINT_DEBUG("'%s' total entries = %zu", name.c_str(), out.size());
@@ -121,8 +278,8 @@ std::vector<Steam_Leaderboard_Entry> Steam_User_Stats::load_leaderboard_entries(
 
 void Steam_User_Stats::save_my_leaderboard_entry(const Steam_Leaderboard &leaderboard)
 {
-     auto my_entry = leaderboard.find_recent_entry(settings->get_local_steam_id());
-     if (!my_entry) return; // we don't have a score entry
+    auto my_entry = leaderboard.entries.find(settings->get_local_steam_id());
+    if (!my_entry) return; // we don't have a score entry
 
     PRINT_DEBUG("saving entries for leaderboard '%s'", leaderboard.name.c_str());
 
@@ -140,42 +297,43 @@ void Steam_User_Stats::save_my_leaderboard_entry(const Steam_Leaderboard &leader
 
     std::string leaderboard_name(common_helpers::to_lower(leaderboard.name));
     unsigned int buffer_size = static_cast<unsigned int>(output.size() * sizeof(output[0])); // in bytes
-    local_storage->store_data(Local_Storage::leaderboard_storage_folder, leaderboard_name, (char* )&output[0], buffer_size);
+    int file_size = local_storage->append_data(Local_Storage::leaderboard_storage_folder, leaderboard_name, (const char* )&output[0], buffer_size);
+    // only the last item matters, start over once enough old ones piled up
+    if (file_size < 0 || (unsigned int)file_size > buffer_size * LEADERBOARD_MAX_FILE_ITEMS) {
+        local_storage->store_data(Local_Storage::leaderboard_storage_folder, leaderboard_name, (char* )&output[0], buffer_size);
+    }
 }
 
-Steam_Leaderboard_Entry* Steam_User_Stats::update_leaderboard_entry(Steam_Leaderboard &leaderboard, const Steam_Leaderboard_Entry &entry, bool overwrite)
+int Steam_User_Stats::update_leaderboard_entry(Steam_Leaderboard &leaderboard, const Steam_Leaderboard_Entry &entry, bool overwrite)
 {
-    bool added = false;
-    auto user_entry = leaderboard.find_recent_entry(entry.steam_id);
-    if (!user_entry) { // user doesn't have an entry yet, create one
-        added = true;
-        leaderboard.entries.push_back(entry);
-        user_entry = &leaderboard.entries.back();
-    } else if (overwrite) {
-        added = true;
-        *user_entry = entry;
+    if (!overwrite) {
+        int rank = leaderboard.entries.rank(entry.steam_id);
+        if (rank >= 0) return rank;
     }
 
-    if (added) { // if we added a new entry then we have to sort and find the target entry again
-        leaderboard.sort_entries();
-        user_entry = leaderboard.find_recent_entry(entry.steam_id);
-        PRINT_DEBUG("added/updated entry for user %llu", entry.steam_id.ConvertToUint64());
+    PRINT_DEBUG("added/updated entry for user %llu", entry.steam_id.ConvertToUint64());
+    return leaderboard.entries.upsert(entry);
+}
+
+SteamLeaderboardEntries_t Steam_User_Stats::add_leaderboard_download(Steam_Leaderboard_Download &&download)
+{
+    // games are supposed to read the rows right away, drop the oldest downloads
+    while (leaderboard_downloads.size() >= LEADERBOARD_MAX_DOWNLOADS) {
+        leaderboard_downloads.erase(leaderboard_downloads.begin());
     }
-    
-    return user_entry;
+
+    SteamLeaderboardEntries_t handle = ++last_leaderboard_download;
+    leaderboard_downloads[handle] = std::move(download);
+    return handle;
 }
 
 
 unsigned int Steam_User_Stats::find_cached_leaderboard(const std::string &name)
 {
-    unsigned index = 1;
-    for (const auto &leaderboard : cached_leaderboards) {
-        if (common_helpers::str_cmp_insensitive(leaderboard.name, name)) return index;
-
-        ++index;
-    }
+    auto it = cached_leaderboards_index.find(common_helpers::to_lower(name));
+    if (cached_leaderboards_index.end() == it) return 0;
 
-    return 0;
+    return it->second;
 }
 
 unsigned int Steam_User_Stats::cache_leaderboard_ifneeded(const std::string &name, ELeaderboardSortMethod eLeaderboardSortMethod, ELeaderboardDisplayType eLeaderboardDisplayType)
@@ -190,18 +348,19 @@ unsigned int Steam_User_Stats::cache_leaderboard_ifneeded(const std::string &nam
     new_board.name = name;
     new_board.sort_method = eLeaderboardSortMethod;
     new_board.display_type = eLeaderboardDisplayType;
-    new_board.entries = load_leaderboard_entries(name);
-
-    new_board.sort_entries();
-    new_board.remove_duplicate_entries();
-
-    // save it in memory for later
-    cached_leaderboards.push_back(new_board);
-    board_handle = static_cast<unsigned int>(cached_leaderboards.size());
+    new_board.entries = Steam_Leaderboard_Entries(eLeaderboardSortMethod);
+    for (const auto &entry : load_leaderboard_entries(name)) {
+        new_board.entries.upsert(entry);
+    }
 
     PRINT_DEBUG("cached a new leaderboard '%s' %i %i",
         new_board.name.c_str(), (int)eLeaderboardSortMethod, (int)eLeaderboardDisplayType
     );
+
+    // save it in memory for later
+    cached_leaderboards.push_back(std::move(new_board));
+    board_handle = static_cast<unsigned int>(cached_leaderboards.size());
+    cached_leaderboards_index[common_helpers::to_lower(name)] = board_handle;
     return board_handle;
 }
 
@@ -209,7 +368,7 @@ void Steam_User_Stats::send_my_leaderboard_score(const Steam_Leaderboard &board,
 {
     if (!settings->share_leaderboards_over_network) return;
 
-    const auto my_entry = board.find_recent_entry(settings->get_local_steam_id());
+    const auto my_entry = board.entries.find(settings->get_local_steam_id());
     Leaderboards_Messages::UserScoreEntry *score_entry_msg = nullptr;
     
     if (my_entry) {
@@ -401,17 +560,45 @@ SteamAPICall_t Steam_User_Stats::DownloadLeaderboardEntries( SteamLeaderboard_t
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
     if (hSteamLeaderboard > cached_leaderboards.size() || hSteamLeaderboard <= 0) return k_uAPICallInvalid; //might return callresult even if hSteamLeaderboard is invalid
 
-    int entries_count = (int)cached_leaderboards[static_cast<unsigned>(hSteamLeaderboard - 1)].entries.size();
+    const auto &board = cached_leaderboards[static_cast<unsigned>(hSteamLeaderboard - 1)];
+    int entries_count = (int)board.entries.size();
+    // 0-based, [first, last)
+    int first = 0;
+    int last = entries_count;
     // https://partner.steamgames.com/doc/api/ISteamUserStats#ELeaderboardDataRequest
-    if (eLeaderboardDataRequest != k_ELeaderboardDataRequestFriends) {
-        int required_count = nRangeEnd - nRangeStart + 1;
-        if (required_count < 0) required_count = 0;
-        
-        if (required_count < entries_count) entries_count = required_count;
+    switch (eLeaderboardDataRequest) {
+    case k_ELeaderboardDataRequestGlobal:
+        first = nRangeStart - 1;
+        last = nRangeEnd;
+    break;
+
+    case k_ELeaderboardDataRequestGlobalAroundUser: {
+        int my_rank = board.entries.rank(settings->get_local_steam_id());
+        if (my_rank < 0) {
+            first = last = 0;
+        } else {
+            first = my_rank + nRangeStart;
+            last = my_rank + nRangeEnd + 1;
+        }
     }
+    break;
+
+    default: break; // k_ELeaderboardDataRequestFriends: everyone we know about
+    }
+    first = std::max(first, 0);
+    last = std::min(last, entries_count);
+
+    Steam_Leaderboard_Download download{};
+    download.board = hSteamLeaderboard;
+    if (last > first) download.entries.reserve(last - first);
+    for (int rank = first; rank < last; ++rank) {
+        download.entries.emplace_back(rank, *board.entries.at(rank));
+    }
+
+    entries_count = (int)download.entries.size();
     LeaderboardScoresDownloaded_t data{};
     data.m_hSteamLeaderboard = hSteamLeaderboard;
-    data.m_hSteamLeaderboardEntries = hSteamLeaderboard;
+    data.m_hSteamLeaderboardEntries = add_leaderboard_download(std::move(download));
     data.m_cEntryCount = entries_count;
     auto ret = callback_results->addCallResult(data.k_iCallback, &data, sizeof(data), 0.1); // TODO is this timing ok?
     callbacks->addCBResult(data.k_iCallback, &data, sizeof(data), 0.1);
@@ -431,6 +618,8 @@ SteamAPICall_t Steam_User_Stats::DownloadLeaderboardEntriesForUsers( SteamLeader
     if (hSteamLeaderboard > cached_leaderboards.size() || hSteamLeaderboard <= 0) return k_uAPICallInvalid; //might return callresult even if hSteamLeaderboard is invalid
 
     auto& board = cached_leaderboards[static_cast<unsigned>(hSteamLeaderboard - 1)];
+    Steam_Leaderboard_Download download{};
+    download.board = hSteamLeaderboard;
     bool ok = true;
     int total_count = 0;
     if (prgUsers && cUsers > 0) {
@@ -441,7 +630,11 @@ SteamAPICall_t Steam_User_Stats::DownloadLeaderboardEntriesForUsers( SteamLeader
                 PRINT_DEBUG("bad userid %llu", user_steamid.ConvertToUint64());
                 break;
             }
-            if (board.find_recent_entry(user_steamid)) ++total_count;
+            int rank = board.entries.rank(user_steamid);
+            if (rank >= 0) {
+                download.entries.emplace_back(rank, *board.entries.at(rank));
+                ++total_count;
+            }
 
             request_user_leaderboard_entry(board, user_steamid);
         }
@@ -453,7 +646,7 @@ SteamAPICall_t Steam_User_Stats::DownloadLeaderboardEntriesForUsers( SteamLeader
 
     LeaderboardScoresDownloaded_t data{};
     data.m_hSteamLeaderboard = hSteamLeaderboard;
-    data.m_hSteamLeaderboardEntries = hSteamLeaderboard;
+    data.m_hSteamLeaderboardEntries = add_leaderboard_download(std::move(download));
     data.m_cEntryCount = total_count;
     auto ret = callback_results->addCallResult(data.k_iCallback, &data, sizeof(data), 0.1); // TODO is this timing ok?
     callbacks->addCBResult(data.k_iCallback, &data, sizeof(data), 0.1);
@@ -479,18 +672,18 @@ bool Steam_User_Stats::GetDownloadedLeaderboardEntry( SteamLeaderboardEntries_t
 {
     PRINT_DEBUG("[%i] (%i) %llu %p %p", index, cDetailsMax, hSteamLeaderboardEntries, pLeaderboardEntry, pDetails);
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    if (hSteamLeaderboardEntries > cached_leaderboards.size() || hSteamLeaderboardEntries <= 0) return false;
-    
-    const auto &board = cached_leaderboards[static_cast<unsigned>(hSteamLeaderboardEntries - 1)];
-    if (index < 0 || static_cast<size_t>(index) >= board.entries.size()) return false;
+    auto download = leaderboard_downloads.find(hSteamLeaderboardEntries);
+    if (leaderboard_downloads.end() == download) return false;
+    if (index < 0 || static_cast<size_t>(index) >= download->second.entries.size()) return false;
 
-    const auto &target_entry = board.entries[index];
+    const auto &target_entry = download->second.entries[index].second;
     
     if (pLeaderboardEntry) {
         LeaderboardEntry_t entry{};
         entry.m_steamIDUser = target_entry.steam_id;
-        entry.m_nGlobalRank = 1 + (int)(&target_entry - &board.entries[0]);
+        entry.m_nGlobalRank = 1 + download->second.entries[index].first;
         entry.m_nScore = target_entry.score;
+        entry.m_cDetails = static_cast<int>(target_entry.score_details.size());
         
         *pLeaderboardEntry = entry;
     }
@@ -517,10 +710,8 @@ SteamAPICall_t Steam_User_Stats::UploadLeaderboardScore( SteamLeaderboard_t hSte
     if (hSteamLeaderboard > cached_leaderboards.size() || hSteamLeaderboard <= 0) return k_uAPICallInvalid; //TODO: might return callresult even if hSteamLeaderboard is invalid
 
     auto &board = cached_leaderboards[static_cast<unsigned>(hSteamLeaderboard - 1)];
-    auto my_entry = board.find_recent_entry(settings->get_local_steam_id());
-    int current_rank = my_entry
-        ? 1 + (int)(my_entry - &board.entries[0])
-        : 0;
+    auto my_entry = board.entries.find(settings->get_local_steam_id());
+    int current_rank = 1 + board.entries.rank(settings->get_local_steam_id());
     int new_rank = current_rank;
 
     bool score_updated = false;
@@ -557,8 +748,7 @@ SteamAPICall_t Steam_User_Stats::UploadLeaderboardScore( SteamLeaderboard_t hSte
             }
         }
         
-        update_leaderboard_entry(board, new_entry);
-        new_rank = 1 + (int)(board.find_recent_entry(settings->get_local_steam_id()) - &board.entries[0]);
+        new_rank = 1 + update_leaderboard_entry(board, new_entry);
 
         // check again in case this was a forced update
         // avoid disk write if score is the same
@@ -19,6 +19,29 @@
 #include <random>
 
 
+Stats_Store& Steam_User_Stats::get_stats_store()
+{
+    // the appid might only be known after this interface was created
+    uint32 appid = settings->get_local_game_id().AppID();
+    if (!stats_store_loaded || stats_store_appid != appid) {
+        stats_store.open(local_storage->get_path(""));
+        stats_store_loaded = true;
+        stats_store_appid = appid;
+    }
+
+    return stats_store;
+}
+
+void Steam_User_Stats::flush_stats()
+{
+    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    last_stats_flush = std::chrono::high_resolution_clock::now();
+    if (!stats_store.has_pending_writes()) return;
+
+    if (!stats_store.flush()) {
+        PRINT_DEBUG("failed to save stats, will retry later");
+    }
+}
 
 // change stats without sending back to server
 bool Steam_User_Stats::clear_stats_internal()
@@ -44,7 +67,7 @@ bool Steam_User_Stats::clear_stats_internal()
 
             stats_cache_int[stat_name] = data;
             
-            if (needs_disk_write) local_storage->store_data(Local_Storage::stats_storage_folder, stat_name, (char *)&data, sizeof(data));
+            if (needs_disk_write) get_stats_store().set(stat_name, &data, sizeof(data));
         }
         break;
 
@@ -61,7 +84,7 @@ bool Steam_User_Stats::clear_stats_internal()
 
             stats_cache_float[stat_name] = data;
             
-            if (needs_disk_write) local_storage->store_data(Local_Storage::stats_storage_folder, stat_name, (char *)&data, sizeof(data));
+            if (needs_disk_write) get_stats_store().set(stat_name, &data, sizeof(data));
         }
         break;
         
@@ -135,13 +158,10 @@ Steam_User_Stats::InternalSetResult<int32> Steam_User_Stats::set_stat_internal(
         }
     }
 
-    if (local_storage->store_data(Local_Storage::stats_storage_folder, stat_name, (char* )&nData, sizeof(nData)) == sizeof(nData)) {
-        stats_cache_int[stat_name] = nData;
-        result.success = true;
-        result.notify_server = !settings->disable_sharing_stats_with_gameserver;
-        return result;
-    }
-
+    get_stats_store().set(stat_name, &nData, sizeof(nData));
+    stats_cache_int[stat_name] = nData;
+    result.success = true;
+    result.notify_server = !settings->disable_sharing_stats_with_gameserver;
     return result;
 }
 
@@ -209,13 +229,10 @@ Steam_User_Stats::InternalSetResult<std::pair<GameServerStats_Messages::StatInfo
         }
     }
 
-    if (local_storage->store_data(Local_Storage::stats_storage_folder, stat_name, (char* )&fData, sizeof(fData)) == sizeof(fData)) {
-        stats_cache_float[stat_name] = fData;
-        result.success = true;
-        result.notify_server = !settings->disable_sharing_stats_with_gameserver;
-        return result;
-    }
-
+    get_stats_store().set(stat_name, &fData, sizeof(fData));
+    stats_cache_float[stat_name] = fData;
+    result.success = true;
+    result.notify_server = !settings->disable_sharing_stats_with_gameserver;
     return result;
 }
 
@@ -243,10 +260,9 @@ Steam_User_Stats::InternalSetResult<std::pair<GameServerStats_Messages::StatInfo
     result.internal_name = stat_name;
 
     char data[sizeof(float) + sizeof(float) + sizeof(double)];
-    int read_data = local_storage->get_data(Local_Storage::stats_storage_folder, stat_name, (char* )data, sizeof(*data));
     float oldcount = 0;
     double oldsessionlength = 0;
-    if (read_data == sizeof(data)) {
+    if (get_stats_store().get(stat_name, data, sizeof(data))) {
         memcpy(&oldcount, data + sizeof(float), sizeof(oldcount));
         memcpy(&oldsessionlength, data + sizeof(float) + sizeof(float), sizeof(oldsessionlength));
     }
@@ -262,13 +278,10 @@ Steam_User_Stats::InternalSetResult<std::pair<GameServerStats_Messages::StatInfo
     result.current_val.first = stats_data->second.type;
     result.current_val.second = average;
 
-    if (local_storage->store_data(Local_Storage::stats_storage_folder, stat_name, data, sizeof(data)) == sizeof(data)) {
-        stats_cache_float[stat_name] = average;
-        result.success = true;
-        result.notify_server = !settings->disable_sharing_stats_with_gameserver;
-        return result;
-    }
-
+    get_stats_store().set(stat_name, data, sizeof(data));
+    stats_cache_float[stat_name] = average;
+    result.success = true;
+    result.notify_server = !settings->disable_sharing_stats_with_gameserver;
     return result;
 }
 
@@ -326,8 +339,7 @@ bool Steam_User_Stats::GetStat( const char *pchName, int32 *pData )
     }
 
     int32 output = 0;
-    int read_data = local_storage->get_data(Local_Storage::stats_storage_folder, stat_name, (char* )&output, sizeof(output));
-    if (read_data == sizeof(int32)) {
+    if (get_stats_store().get(stat_name, &output, sizeof(output))) {
         stats_cache_int[stat_name] = output;
         if (pData) *pData = output;
         return true;
@@ -365,8 +377,7 @@ bool Steam_User_Stats::GetStat( const char *pchName, float *pData )
     }
 
     float output = 0.0;
-    int read_data = local_storage->get_data(Local_Storage::stats_storage_folder, stat_name, (char* )&output, sizeof(output));
-    if (read_data == sizeof(float)) {
+    if (get_stats_store().get(stat_name, &output, sizeof(output))) {
         stats_cache_float[stat_name] = output;
         if (pData) *pData = output;
         return true;
@@ -386,7 +397,7 @@ bool Steam_User_Stats::SetStat( const char *pchName, int32 nData )
 
     auto ret = set_stat_internal(pchName, nData );
     if (ret.success && ret.notify_server ) {
-        auto &new_stat = (*pending_server_updates.mutable_user_stats())[ret.internal_name];
+        auto &new_stat = (*pending_server_updates.mutable_user_stats())[intern_stat_name(ret.internal_name)];
         new_stat.set_stat_type(GameServerStats_Messages::StatInfo::STAT_TYPE_INT);
         new_stat.set_value_int(ret.current_val);
 
@@ -403,7 +414,7 @@ bool Steam_User_Stats::SetStat( const char *pchName, float fData )
 
     auto ret = set_stat_internal(pchName, fData);
     if (ret.success && ret.notify_server) {
-        auto &new_stat = (*pending_server_updates.mutable_user_stats())[ret.internal_name];
+        auto &new_stat = (*pending_server_updates.mutable_user_stats())[intern_stat_name(ret.internal_name)];
         new_stat.set_stat_type(ret.current_val.first);
         new_stat.set_value_float(ret.current_val.second);
 
@@ -420,7 +431,7 @@ bool Steam_User_Stats::UpdateAvgRateStat( const char *pchName, float flCountThis
 
     auto ret = update_avg_rate_stat_internal(pchName, flCountThisSession, dSessionLength);
     if (ret.success && ret.notify_server) {
-        auto &new_stat = (*pending_server_updates.mutable_user_stats())[ret.internal_name];
+        auto &new_stat = (*pending_server_updates.mutable_user_stats())[intern_stat_name(ret.internal_name)];
         new_stat.set_stat_type(ret.current_val.first);
         new_stat.set_value_float(ret.current_val.second);
 
@@ -444,6 +455,9 @@ bool Steam_User_Stats::StoreStats()
     PRINT_DEBUG_ENTRY();
     std::lock_guard<std::recursive_mutex> lock(global_mutex);
 
+    flush_stats();
+    if (achievements_save_pending) save_achievements();
+
     UserStatsStored_t data{};
     data.m_eResult = k_EResultOK;
     data.m_nGameID = settings->get_local_game_id().ToUint64();
@@ -533,7 +547,7 @@ bool Steam_User_Stats::ResetAllStats( bool bAchievementsToo )
         for (const auto &stat : settings->getStats()) {
             std::string stat_name(common_helpers::to_lower(stat.first));
 
-            auto &new_stat = (*pending_server_updates.mutable_user_stats())[stat_name];
+            auto &new_stat = (*pending_server_updates.mutable_user_stats())[intern_stat_name(stat_name)];
             new_stat.set_stat_type(stat.second.type);
 
             switch (stat.second.type)
@@ -586,11 +600,11 @@ bool Steam_User_Stats::ResetAllStats( bool bAchievementsToo )
                 PRINT_DEBUG("ERROR: %s", errorMessage);
             }
         }
-        if (needs_disk_write) save_achievements();
+        if (needs_disk_write) queue_save_achievements();
 
         if (!settings->disable_sharing_stats_with_gameserver) {
             for (const auto &item : user_achievements.items()) {
-                auto &new_ach = (*pending_server_updates.mutable_user_achievements())[item.key()];
+                auto &new_ach = (*pending_server_updates.mutable_user_achievements())[intern_ach_name(item.key())];
                 new_ach.set_achieved(false);
             }
         }
@@ -682,30 +696,83 @@ int32 Steam_User_Stats::GetGlobalStatHistory( const char *pchStatName, STEAM_ARR
 
 // --- steam callbacks
 
+uint32 Steam_User_Stats::intern_stat_name(const std::string &name)
+{
+    auto it = interned_stat_ids.find(name);
+    if (interned_stat_ids.end() != it) return it->second;
+
+    uint32 id = static_cast<uint32>(interned_stat_names.size());
+    interned_stat_names.push_back(name);
+    interned_stat_ids[name] = id;
+    return id;
+}
+
+uint32 Steam_User_Stats::intern_ach_name(const std::string &name)
+{
+    auto it = interned_ach_ids.find(name);
+    if (interned_ach_ids.end() != it) return it->second;
+
+    uint32 id = static_cast<uint32>(interned_ach_names.size());
+    interned_ach_names.push_back(name);
+    interned_ach_ids[name] = id;
+    return id;
+}
+
+GameServerStats_Messages::AllStats *Steam_User_Stats::to_all_stats(const GameServerStats_Messages::StatsDelta &delta) const
+{
+    auto all_stats = new GameServerStats_Messages::AllStats();
+    for (const auto &stat : delta.user_stats()) {
+        if (stat.first < interned_stat_names.size()) (*all_stats->mutable_user_stats())[interned_stat_names[stat.first]] = stat.second;
+    }
+    for (const auto &ach : delta.user_achievements()) {
+        if (ach.first < interned_ach_names.size()) (*all_stats->mutable_user_achievements())[interned_ach_names[ach.first]] = ach.second;
+    }
+
+    return all_stats;
+}
+
 void Steam_User_Stats::send_updated_stats()
 {
     if (pending_server_updates.user_stats().empty() && pending_server_updates.user_achievements().empty()) return;
     if (settings->disable_sharing_stats_with_gameserver) return;
 
-    auto new_updates_msg = new GameServerStats_Messages::AllStats(pending_server_updates);
-    pending_server_updates.clear_user_stats();
-    pending_server_updates.clear_user_achievements();
+    last_gameserver_stats_sync = std::chrono::high_resolution_clock::now();
 
-    auto gameserverstats_msg = new GameServerStats_Messages();
-    gameserverstats_msg->set_type(GameServerStats_Messages::UpdateUserStatsFromUser);
-    gameserverstats_msg->set_allocated_update_user_stats(new_updates_msg);
-    
-    Common_Message msg{};
-    // https://protobuf.dev/reference/cpp/cpp-generated/#string
-    // set_allocated_xxx() takes ownership of the allocated object, no need to delete
-    msg.set_allocated_gameserver_stats_messages(gameserverstats_msg);
-    msg.set_source_id(settings->get_local_steam_id().ConvertToUint64());
-    // here we send to all gameservers on the network because we don't know the server steamid
-    network->sendToAllGameservers(&msg, true);
+    // only the servers which requested our stats keep them
+    for (auto &server : stats_gameservers) {
+        auto gameserverstats_msg = new GameServerStats_Messages();
+        gameserverstats_msg->set_type(GameServerStats_Messages::UpdateUserStatsFromUser);
+        if (server.second.supports_delta) {
+            auto updates_msg = new GameServerStats_Messages::StatsDelta(pending_server_updates);
+
+            // tell this server about the ids it doesn't know yet
+            auto &stat_names = *updates_msg->mutable_stat_names();
+            for (auto &id = server.second.announced_stat_names; id < interned_stat_names.size(); ++id) {
+                stat_names[static_cast<uint32>(id)] = interned_stat_names[id];
+            }
+            auto &ach_names = *updates_msg->mutable_achievement_names();
+            for (auto &id = server.second.announced_ach_names; id < interned_ach_names.size(); ++id) {
+                ach_names[static_cast<uint32>(id)] = interned_ach_names[id];
+            }
 
-    PRINT_DEBUG("sent updated stats: %zu stats, %zu achievements",
-        new_updates_msg->user_stats().size(), new_updates_msg->user_achievements().size()
+            gameserverstats_msg->set_allocated_update_user_stats_delta(updates_msg);
+        } else {
+            gameserverstats_msg->set_allocated_update_user_stats(to_all_stats(pending_server_updates));
+        }
+
+        Common_Message msg{};
+        // https://protobuf.dev/reference/cpp/cpp-generated/#string
+        // set_allocated_xxx() takes ownership of the allocated object, no need to delete
+        msg.set_allocated_gameserver_stats_messages(gameserverstats_msg);
+        msg.set_source_id(settings->get_local_steam_id().ConvertToUint64());
+        msg.set_dest_id(server.first);
+        network->sendTo(&msg, true);
+    }
+
+    PRINT_DEBUG("sent updated stats to %zu servers: %zu stats, %zu achievements",
+        stats_gameservers.size(), (size_t)pending_server_updates.user_stats().size(), (size_t)pending_server_updates.user_achievements().size()
     );
+    pending_server_updates.Clear();
 }
 
 
@@ -722,14 +789,18 @@ void Steam_User_Stats::network_stats_initial(Common_Message *msg)
     }
 
     uint64 server_steamid = msg->source_id();
+    const auto &request = msg->gameserver_stats_messages().initial_user_stats();
+    // from now on this server gets our updates
+    auto &server = stats_gameservers[server_steamid];
+    server.supports_delta = request.supports_delta();
 
-    auto all_stats_msg = new GameServerStats_Messages::AllStats();
+    auto all_stats_msg = new GameServerStats_Messages::StatsDelta();
 
     // get all stats
     auto &stats_map = *all_stats_msg->mutable_user_stats();
     const auto &current_stats = settings->getStats();
     for (const auto &stat : current_stats) {
-        auto &this_stat = stats_map[stat.first];
+        auto &this_stat = stats_map[intern_stat_name(stat.first)];
         this_stat.set_stat_type(stat.second.type);
         switch (stat.second.type)
         {
@@ -758,7 +829,7 @@ void Steam_User_Stats::network_stats_initial(Common_Message *msg)
     auto &achievements_map = *all_stats_msg->mutable_user_achievements();
     for (const auto &ach : defined_achievements) {
         const std::string &name = static_cast<const std::string &>( ach.value("name", std::string()) );
-        auto &this_ach = achievements_map[name];
+        auto &this_ach = achievements_map[intern_ach_name(name)];
 
         // achieved or not
         bool achieved = false;
@@ -766,10 +837,30 @@ void Steam_User_Stats::network_stats_initial(Common_Message *msg)
         this_ach.set_achieved(achieved);
     }
 
+    size_t stats_count = stats_map.size();
+    size_t achievements_count = achievements_map.size();
+
     auto initial_stats_msg = new GameServerStats_Messages::InitialAllStats();
     // send back same api call id
-    initial_stats_msg->set_steam_api_call(msg->gameserver_stats_messages().initial_user_stats().steam_api_call());
-    initial_stats_msg->set_allocated_all_data(all_stats_msg);
+    initial_stats_msg->set_steam_api_call(request.steam_api_call());
+    if (request.supports_delta()) {
+        // the whole table of ids, this server might have missed some announcements
+        auto &stat_names = *all_stats_msg->mutable_stat_names();
+        for (size_t id = 0; id < interned_stat_names.size(); ++id) {
+            stat_names[static_cast<uint32>(id)] = interned_stat_names[id];
+        }
+        auto &ach_names = *all_stats_msg->mutable_achievement_names();
+        for (size_t id = 0; id < interned_ach_names.size(); ++id) {
+            ach_names[static_cast<uint32>(id)] = interned_ach_names[id];
+        }
+        server.announced_stat_names = interned_stat_names.size();
+        server.announced_ach_names = interned_ach_names.size();
+
+        initial_stats_msg->set_allocated_all_data_delta(all_stats_msg);
+    } else {
+        initial_stats_msg->set_allocated_all_data(to_all_stats(*all_stats_msg));
+        delete all_stats_msg;
+    }
 
     auto gameserverstats_msg = new GameServerStats_Messages();
     gameserverstats_msg->set_type(GameServerStats_Messages::Response_AllUserStats);
@@ -784,60 +875,90 @@ void Steam_User_Stats::network_stats_initial(Common_Message *msg)
     network->sendTo(&new_msg, true);
 
     PRINT_DEBUG("server requested all stats, sent %zu stats, %zu achievements",
-        initial_stats_msg->all_data().user_stats().size(), initial_stats_msg->all_data().user_achievements().size()
+        stats_count, achievements_count
     );
 
 
 }
 
 // server has updated/new stats
-void Steam_User_Stats::network_stats_updated(Common_Message *msg)
+void Steam_User_Stats::network_stat_updated(const char *stat_name, const GameServerStats_Messages::StatInfo &new_stat)
 {
-    if (!msg->gameserver_stats_messages().has_update_user_stats()) {
-        PRINT_DEBUG("error empty msg");
-        return;
+    switch (new_stat.stat_type())
+    {
+    case GameServerStats_Messages::StatInfo::STAT_TYPE_INT: {
+        set_stat_internal(stat_name, new_stat.value_int());
+    }
+    break;
+    
+    case GameServerStats_Messages::StatInfo::STAT_TYPE_AVGRATE:
+    case GameServerStats_Messages::StatInfo::STAT_TYPE_FLOAT: {
+        set_stat_internal(stat_name, new_stat.value_float());
+        // non-INT values could have avg values
+        if (new_stat.has_value_avg()) {
+            auto &avg_val = new_stat.value_avg();
+            update_avg_rate_stat_internal(stat_name, avg_val.count_this_session(), avg_val.session_length());
+        }
+    }
+    break;
+    
+    default:
+        PRINT_DEBUG("UpdateUserStats unhandled stat type %i", (int)new_stat.stat_type());
+    break;
     }
+}
 
-    auto &new_user_data = msg->gameserver_stats_messages().update_user_stats();
+void Steam_User_Stats::network_ach_updated(const char *ach_name, const GameServerStats_Messages::AchievementInfo &new_ach)
+{
+    if (new_ach.achieved()) {
+        set_achievement_internal(ach_name);
+    } else {
+        clear_achievement_internal(ach_name);
+    }
+}
 
-    // update our stats
-    for (auto &new_stat : new_user_data.user_stats()) {
-        switch (new_stat.second.stat_type())
-        {
-        case GameServerStats_Messages::StatInfo::STAT_TYPE_INT: {
-            set_stat_internal(new_stat.first.c_str(), new_stat.second.value_int());
-        }
-        break;
-        
-        case GameServerStats_Messages::StatInfo::STAT_TYPE_AVGRATE:
-        case GameServerStats_Messages::StatInfo::STAT_TYPE_FLOAT: {
-            set_stat_internal(new_stat.first.c_str(), new_stat.second.value_float());
-            // non-INT values could have avg values
-            if (new_stat.second.has_value_avg()) {
-                auto &avg_val = new_stat.second.value_avg();
-                update_avg_rate_stat_internal(new_stat.first.c_str(), avg_val.count_this_session(), avg_val.session_length());
+void Steam_User_Stats::network_stats_updated(Common_Message *msg)
+{
+    if (msg->gameserver_stats_messages().has_update_user_stats_delta()) {
+        auto &new_user_data = msg->gameserver_stats_messages().update_user_stats_delta();
+
+        // update our stats
+        for (auto &new_stat : new_user_data.user_stats()) {
+            if (new_stat.first >= interned_stat_names.size()) {
+                PRINT_DEBUG("UpdateUserStats unknown stat id %u", new_stat.first);
+                continue;
             }
+            network_stat_updated(interned_stat_names[new_stat.first].c_str(), new_stat.second);
         }
-        break;
-        
-        default:
-            PRINT_DEBUG("UpdateUserStats unhandled stat type %i", (int)new_stat.second.stat_type());
-        break;
+
+        // update achievements
+        for (auto &new_ach : new_user_data.user_achievements()) {
+            if (new_ach.first >= interned_ach_names.size()) {
+                PRINT_DEBUG("UpdateUserStats unknown achievement id %u", new_ach.first);
+                continue;
+            }
+            network_ach_updated(interned_ach_names[new_ach.first].c_str(), new_ach.second);
         }
-    }
 
-    // update achievements
-    for (auto &new_ach : new_user_data.user_achievements()) {
-        if (new_ach.second.achieved()) {
-            set_achievement_internal(new_ach.first.c_str());
-        } else {
-            clear_achievement_internal(new_ach.first.c_str());
+        PRINT_DEBUG("server sent updated user stats, %zu stats, %zu achievements",
+            new_user_data.user_stats().size(), new_user_data.user_achievements().size()
+        );
+    } else if (msg->gameserver_stats_messages().has_update_user_stats()) {
+        // from an older build
+        auto &new_user_data = msg->gameserver_stats_messages().update_user_stats();
+        for (auto &new_stat : new_user_data.user_stats()) {
+            network_stat_updated(new_stat.first.c_str(), new_stat.second);
+        }
+        for (auto &new_ach : new_user_data.user_achievements()) {
+            network_ach_updated(new_ach.first.c_str(), new_ach.second);
         }
+
+        PRINT_DEBUG("server sent updated user stats (by name), %zu stats, %zu achievements",
+            new_user_data.user_stats().size(), new_user_data.user_achievements().size()
+        );
+    } else {
+        PRINT_DEBUG("error empty msg");
     }
-    
-    PRINT_DEBUG("server sent updated user stats, %zu stats, %zu achievements",
-        new_user_data.user_stats().size(), new_user_data.user_achievements().size()
-    );
 }
 
 void Steam_User_Stats::network_callback_stats(Common_Message *msg)
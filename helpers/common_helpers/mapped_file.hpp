@@ -0,0 +1,159 @@
+#pragma once
+
+#include "common_helpers/os_detector.h"
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <filesystem>
+
+#if defined(__WINDOWS__)
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+
+namespace common_helpers
+{
+  // read-only memory mapping of a whole file
+  // the mapping doesn't follow changes to the file, check changed() before reading from it:
+  // on POSIX reading a part of the mapping which was truncated away raises SIGBUS,
+  // on Windows the file can't be truncated while it's mapped (ERROR_USER_MAPPED_FILE)
+  class MappedFile {
+    const char *view = nullptr;
+    uint64_t view_size = 0;
+
+#if defined(__WINDOWS__)
+    HANDLE file_handle = INVALID_HANDLE_VALUE;
+    HANDLE mapping_handle = nullptr;
+    FILETIME view_write_time{};
+#else
+    int fd = -1;
+    struct timespec view_mtime{};
+#endif
+
+  public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile& operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+      close();
+    }
+
+    // path is utf-8, returns false if the file can't be opened or mapped
+    bool open(const std::string &path) {
+      close();
+
+#if defined(__WINDOWS__)
+      // others can still write to, delete or rename the file, but not truncate it while it's mapped
+      file_handle = CreateFileW(std::filesystem::u8path(path).wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+      if (file_handle == INVALID_HANDLE_VALUE) return false;
+
+      LARGE_INTEGER size{};
+      if (!GetFileSizeEx(file_handle, &size) || size.QuadPart <= 0 || static_cast<uint64_t>(size.QuadPart) > SIZE_MAX ||
+          !GetFileTime(file_handle, nullptr, nullptr, &view_write_time)) {
+        close();
+        return false;
+      }
+
+      mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (!mapping_handle) {
+        close();
+        return false;
+      }
+
+      view = static_cast<const char *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+      if (!view) {
+        close();
+        return false;
+      }
+
+      view_size = static_cast<uint64_t>(size.QuadPart);
+#else
+      fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) return false;
+
+      struct stat st{};
+      if (fstat(fd, &st) != 0 || st.st_size <= 0 || static_cast<uint64_t>(st.st_size) > SIZE_MAX) {
+        close();
+        return false;
+      }
+
+      void *ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+      if (ptr == MAP_FAILED) {
+        close();
+        return false;
+      }
+
+      // content is usually streamed front to back
+      madvise(ptr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+      view = static_cast<const char *>(ptr);
+      view_size = static_cast<uint64_t>(st.st_size);
+      view_mtime = st.st_mtim;
+#endif
+
+      return true;
+    }
+
+    void close() {
+#if defined(__WINDOWS__)
+      if (view) UnmapViewOfFile(view);
+      if (mapping_handle) CloseHandle(mapping_handle);
+      if (file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+      mapping_handle = nullptr;
+      file_handle = INVALID_HANDLE_VALUE;
+#else
+      if (view) munmap(const_cast<char *>(view), static_cast<size_t>(view_size));
+      if (fd >= 0) ::close(fd);
+      fd = -1;
+#endif
+      view = nullptr;
+      view_size = 0;
+    }
+
+    bool is_open() const {
+      return view != nullptr;
+    }
+
+    uint64_t size() const {
+      return view_size;
+    }
+
+    // true if the file was written to or resized since it was mapped, or can't be checked anymore
+    bool changed() const {
+      if (!view) return true;
+
+#if defined(__WINDOWS__)
+      LARGE_INTEGER size{};
+      FILETIME write_time{};
+      if (!GetFileSizeEx(file_handle, &size) || !GetFileTime(file_handle, nullptr, nullptr, &write_time)) return true;
+
+      return static_cast<uint64_t>(size.QuadPart) != view_size || CompareFileTime(&write_time, &view_write_time) != 0;
+#else
+      struct stat st{};
+      if (fstat(fd, &st) != 0) return true;
+
+      return static_cast<uint64_t>(st.st_size) != view_size ||
+        st.st_mtim.tv_sec != view_mtime.tv_sec || st.st_mtim.tv_nsec != view_mtime.tv_nsec;
+#endif
+    }
+
+    // copies up to 'count' bytes starting at 'offset', returns the amount copied
+    size_t read(void *dst, size_t count, uint64_t offset) const {
+      if (!view || !count || offset >= view_size) return 0;
+
+      if (count > view_size - offset) count = static_cast<size_t>(view_size - offset);
+      std::memcpy(dst, view + offset, count);
+      return count;
+    }
+
+  };
+}
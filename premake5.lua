@@ -144,6 +144,12 @@ newoption {
     default = os.date("%Y_%m_%d-%H_%M_%S"),
 }
 
+newoption {
+    category = 'build',
+    trigger = "emutests",
+    description = "Add the tests & benchmarks of the emu to the workspace",
+}
+
 newoption {
     category = 'visual-includes',
     trigger = "incexamples",
@@ -1152,6 +1158,158 @@ project "tool_generate_interfaces"
 -- End tool_generate_interfaces
 
 
+-- Projects tests & benchmarks of the emu
+---------
+-- only added with --emutests, the emu sources are built once in a static lib and each test/benchmark
+-- is a console app made of that lib + a single file from 'tests/'
+-- tests are run with run_tests_linux.sh / run_tests_win.bat, benchmarks only print timings to compare between builds so they're run manually
+if _OPTIONS["emutests"] then
+
+project "lib_emu_tests"
+    kind "StaticLib"
+    location "%{wks.location}/%{prj.name}"
+    targetdir("build/" .. os_iden .. "/%{_ACTION}/%{cfg.buildcfg}/tests/lib/%{cfg.platform}")
+    targetname "emu_tests"
+
+
+    -- defines
+    ---------
+    filter {} -- reset the filter and remove all active keywords
+    removedefines {
+        "CONTROLLER_SUPPORT",
+    }
+
+
+    -- include dir
+    ---------
+    -- x32 include dir
+    filter { "platforms:x32", }
+        includedirs {
+            x32_deps_include,
+        }
+    -- x64 include dir
+    filter { "platforms:x64", }
+        includedirs {
+            x64_deps_include,
+        }
+
+
+    -- common source & header files
+    ---------
+    filter {} -- reset the filter and remove all active keywords
+    files { -- added to all filters, later defines will be appended
+        common_files,
+    }
+    removefiles {
+        "libs/gamepad/**",
+        detours_files,
+    }
+-- End lib_emu_tests
+
+
+local function emu_test_project(name, test_file)
+project(name)
+    kind "ConsoleApp"
+    location "%{wks.location}/%{prj.name}"
+    targetdir("build/" .. os_iden .. "/%{_ACTION}/%{cfg.buildcfg}/tests/emu")
+    targetname(name .. "_%{cfg.platform}")
+    dependson { "lib_emu_tests" }
+
+
+    -- defines
+    ---------
+    filter {} -- reset the filter and remove all active keywords
+    removedefines {
+        "CONTROLLER_SUPPORT",
+    }
+
+
+    -- include dir
+    ---------
+    -- x32 include dir
+    filter { "platforms:x32", }
+        includedirs {
+            x32_deps_include,
+        }
+    -- x64 include dir
+    filter { "platforms:x64", }
+        includedirs {
+            x64_deps_include,
+        }
+
+
+    -- common source & header files
+    ---------
+    filter {} -- reset the filter and remove all active keywords
+    files {
+        test_file,
+    }
+
+
+    -- libs to link
+    ---------
+    -- the emu lib first, the deps it uses come after it
+    filter {} -- reset the filter and remove all active keywords
+        links {
+            "lib_emu_tests",
+        }
+    -- Windows libs to link
+    filter { "system:windows", }
+        links {
+            common_link_win,
+        }
+    -- Linux libs to link
+    filter { "system:not windows", }
+        links {
+            common_link_linux,
+        }
+
+
+    -- libs search dir
+    ---------
+    -- x32 libs search dir
+    filter { "platforms:x32", }
+        libdirs {
+            x32_deps_libdir,
+        }
+    -- x64 libs search dir
+    filter { "platforms:x64", }
+        libdirs {
+            x64_deps_libdir,
+        }
+end
+
+-- Steam_HTTP online requests against a local stand-in server (steamhttp_base_url_override)
+emu_test_project("test_steam_http", "tests/test_steam_http.cpp")
+-- stats journal reopened after writes, avgrate stats read as floats and unreadable journals kept as backups
+emu_test_project("test_stats_store", "tests/test_stats_store.cpp")
+-- leaderboard entries against a sorted vector, download ranges and the leaderboard file rewrite
+emu_test_project("test_leaderboards", "tests/test_leaderboards.cpp")
+-- stats sync between a user and game servers with and without StatsDelta support
+emu_test_project("test_stats_sync", "tests/test_stats_sync.cpp")
+-- send buffer limit passed as an option to new connections and listen sockets, inherited by accepted connections
+emu_test_project("test_networking_sockets", "tests/test_networking_sockets.cpp")
+-- mod content written or truncated during a mapped UGCRead() sequence
+emu_test_project("test_ugc_read", "tests/test_ugc_read.cpp")
+-- 100 MB of framed Common_Messages over loopback TCP, the previous front-erased std::vector (before) vs TCP_Buffer (after)
+emu_test_project("bench_tcp_framing", "tests/bench_tcp_framing.cpp")
+-- loopback UDP packets per second, one syscall per packet vs sendmmsg/recvmmsg
+emu_test_project("bench_udp_batch", "tests/bench_udp_batch.cpp")
+-- 10k in-flight call results polled every frame while they complete
+emu_test_project("bench_call_results", "tests/bench_call_results.cpp")
+-- 1 GB mod content read in 64 KB chunks, reopening the file per chunk vs UGCRead from the mapping
+emu_test_project("bench_ugc_read", "tests/bench_ugc_read.cpp")
+-- 10k queued P2P packets across 8 channels, drained channel by channel
+emu_test_project("bench_p2p_channels", "tests/bench_p2p_channels.cpp")
+-- replay of a Source Query (A2S) corpus, cached responses vs rebuilt on each query
+emu_test_project("bench_source_query", "tests/bench_source_query.cpp")
+-- 50k synthetic item definitions, loading and property lookups
+emu_test_project("bench_inventory", "tests/bench_inventory.cpp")
+
+end
+-- End tests & benchmarks of the emu
+
+
 -- Project lib_steamnetworkingsockets START
 project "lib_steamnetworkingsockets"
     kind "SharedLib"
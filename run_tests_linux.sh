@@ -0,0 +1,29 @@
+#!/usr/bin/env bash
+
+
+build_base_dir="build/linux"
+script_dir=$( cd -- "$( dirname -- "${0}" )" &> /dev/null && pwd )
+
+[[ "$1" = '' ]] && {
+  echo "[X] missing build folder, ex: gmake2/release";
+  exit 1;
+}
+
+tests_dir="$script_dir/$build_base_dir/$1/tests/emu"
+[[ -d "$tests_dir" ]] || {
+  echo "[X] tests folder wasn't found, generate the projects with --emutests";
+  exit 1;
+}
+
+# the benchmarks in the same folder are run manually
+failed=0
+for test_exe in "$tests_dir"/test_*; do
+  [[ -x "$test_exe" ]] || continue
+  echo "// running $(basename "$test_exe")"
+  "$test_exe" || {
+    echo "[X] $(basename "$test_exe") failed";
+    failed=1;
+  }
+done
+
+exit $failed
@@ -0,0 +1,41 @@
+@echo off
+setlocal EnableDelayedExpansion
+cd /d "%~dp0"
+
+set "ROOT=%cd%"
+set "BUILD_DIR=%ROOT%\build\win"
+
+if "%~1" equ "" (
+  1>&2 echo:missing build folder arg, ex: vs2022\release
+  goto :end_script_with_err
+)
+
+set "TESTS_DIR=%BUILD_DIR%\%~1\tests\emu"
+if not exist "%TESTS_DIR%\" (
+  1>&2 echo:tests folder wasn't found, generate the projects with --emutests
+  goto :end_script_with_err
+)
+
+:: the benchmarks in the same folder are run manually
+set /a "FAILED=0"
+for %%A in ("%TESTS_DIR%\test_*.exe") do (
+  echo:// running %%~nxA
+  call "%%~A" || (
+    1>&2 echo:%%~nxA failed
+    set /a "FAILED=1"
+  )
+)
+
+if %FAILED% neq 0 (
+  goto :end_script_with_err
+)
+
+goto :end_script
+
+:end_script
+  endlocal
+  exit /b 0
+
+:end_script_with_err
+  endlocal
+  exit /b 1
@@ -0,0 +1,74 @@
+// 10k in-flight call results in SteamCallResults: the game polls every pending call each frame
+// (like ISteamUtils::IsAPICallCompleted/GetAPICallResult) while a part of them completes per frame
+// usage: bench_call_results [in-flight calls count] [completed per frame]
+
+#include "dll/base.h"
+
+#include "bench_common.h"
+
+#include <iostream>
+
+struct Test_Result_t {
+    enum { k_iCallback = 1234567 };
+    uint64 value{};
+    char padding[120]{};
+};
+
+int main(int argc, char **argv)
+{
+    size_t calls_count = argc > 1 ? std::stoull(argv[1]) : 10000;
+    size_t completed_per_frame = argc > 2 ? std::stoull(argv[2]) : 100;
+
+    SteamCallResults results{};
+    std::vector<SteamAPICall_t> calls{};
+    calls.reserve(calls_count);
+
+    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+
+    double reserve_ms = time_ms([&]{
+        for (size_t i = 0; i < calls_count; ++i) {
+            calls.push_back(results.reserveCallResult());
+        }
+    });
+
+    size_t frames = 0;
+    size_t polls = 0;
+    size_t completed = 0;
+    size_t received = 0;
+    std::vector<bool> done(calls_count);
+    double frames_ms = time_ms([&]{
+        while (received < calls_count) {
+            // the async work finishing this frame
+            for (size_t i = 0; i < completed_per_frame && completed < calls_count; ++i, ++completed) {
+                Test_Result_t data{};
+                data.value = completed;
+                results.addCallResult(calls[completed], data.k_iCallback, &data, sizeof(data), 0.0);
+            }
+
+            results.runCallResults();
+
+            for (size_t i = 0; i < calls_count; ++i) {
+                if (done[i]) continue;
+
+                ++polls;
+                Test_Result_t data{};
+                if (results.callback_result(calls[i], &data, sizeof(data))) {
+                    done[i] = true;
+                    ++received;
+                    if (data.value != i) {
+                        std::cerr << "wrong result for call " << i << std::endl;
+                        exit(1);
+                    }
+                }
+            }
+
+            ++frames;
+        }
+    });
+
+    std::cout << calls_count << " in-flight call results, " << completed_per_frame << " completed per frame" << std::endl;
+    std::cout << "reserveCallResult: " << reserve_ms << " ms" << std::endl;
+    std::cout << frames << " frames (addCallResult + runCallResults + poll of all pending calls): " << frames_ms << " ms, "
+              << (frames_ms / frames) << " ms/frame, " << (frames_ms * 1000000.0 / polls) << " ns/poll" << std::endl;
+    return 0;
+}
@@ -0,0 +1,17 @@
+// helpers shared by the benchmarks
+
+#ifndef __INCLUDED_BENCH_COMMON_H__
+#define __INCLUDED_BENCH_COMMON_H__
+
+#include <chrono>
+
+// runs fn() once, returns how long it took in milliseconds
+template<typename Fn>
+static double time_ms(Fn fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+#endif // __INCLUDED_BENCH_COMMON_H__
@@ -0,0 +1,149 @@
+// builds a synthetic items.json with 50k item definitions and times Inventory_Store::load_definitions(),
+// Inventory_Store::find_property(), then the same definitions through Steam_Inventory:
+// the first load (reading + parsing the file), GetItemDefinitionIDs() and GetItemDefinitionProperty()
+// the file is written to steam_settings/ next to the executable and deleted at the end
+// usage: bench_inventory [definitions count] [lookups count]
+
+#include "dll/steam_inventory.h"
+
+#include "bench_common.h"
+
+#include <iostream>
+#include <random>
+
+static const char *property_names[] = {
+    "name", "type", "description", "display_type", "background_color", "name_color", "icon_url",
+    "icon_url_large", "marketable", "tradable", "price_category", "tags", "exchange", "promo",
+};
+
+static nlohmann::json make_definitions(size_t count)
+{
+    nlohmann::json defined_items = nlohmann::json::object();
+    for (size_t i = 0; i < count; ++i) {
+        std::string id(std::to_string(100 + i * 3));
+        nlohmann::json def = nlohmann::json::object();
+        def["itemdefid"] = id;
+        def["name"] = "Benchmark item " + id;
+        def["type"] = (i % 10) ? "item" : "bundle";
+        def["description"] = "A synthetic item definition used to measure the inventory lookups, number " + id;
+        def["display_type"] = "Weapon skin";
+        def["background_color"] = "3C352E";
+        def["name_color"] = "D2D2D2";
+        def["icon_url"] = "https://example.invalid/icons/" + id + ".png";
+        def["icon_url_large"] = "https://example.invalid/icons/" + id + "_large.png";
+        def["marketable"] = (i % 2) ? "true" : "false";
+        def["tradable"] = "true";
+        def["price_category"] = "1;VLV" + std::to_string(100 + i % 50);
+        def["tags"] = "rarity:common;quality:normal;slot:" + std::to_string(i % 8);
+        // a few non-string values, they're listed but not readable
+        def["quantity"] = static_cast<int>(i % 5);
+        if (i % 7 == 0) def["exchange"] = id + "x3";
+        defined_items[id] = std::move(def);
+    }
+
+    return defined_items;
+}
+
+int main(int argc, char **argv)
+{
+    size_t definitions_count = argc > 1 ? std::stoull(argv[1]) : 50000;
+    size_t lookups_count = argc > 2 ? std::stoull(argv[2]) : 1000000;
+
+    nlohmann::json defined_items{};
+    double build_ms = time_ms([&]{ defined_items = make_definitions(definitions_count); });
+    std::string items_json(defined_items.dump());
+    std::cout << definitions_count << " definitions, items.json is " << (items_json.size() / (1024.0 * 1024.0))
+              << " MB (built in " << build_ms << " ms)" << std::endl;
+
+    // random ids and property names, some of them missing
+    std::mt19937 rng(1234);
+    std::vector<std::pair<SteamItemDef_t, const char *>> lookups(lookups_count);
+    for (auto &l : lookups) {
+        l.first = static_cast<SteamItemDef_t>(100 + (rng() % (definitions_count + definitions_count / 10)) * 3);
+        l.second = property_names[rng() % (sizeof(property_names) / sizeof(property_names[0]))];
+    }
+
+    Inventory_Store store{};
+    double load_ms = time_ms([&]{ store.load_definitions(defined_items); });
+
+    size_t found = 0;
+    size_t value_bytes = 0;
+    double find_ms = time_ms([&]{
+        for (const auto &l : lookups) {
+            auto definition = store.find_definition(l.first);
+            if (!definition) continue;
+
+            auto property = store.find_property(*definition, l.second);
+            if (!property || !property->is_string) continue;
+
+            ++found;
+            value_bytes += store.get_property_value(*property).size();
+        }
+    });
+
+    std::cout << "Inventory_Store::load_definitions: " << load_ms << " ms" << std::endl;
+    std::cout << "Inventory_Store::find_definition + find_property: " << (find_ms * 1000000.0 / lookups_count)
+              << " ns/lookup, " << found << "/" << lookups_count << " found" << std::endl;
+
+    // Steam_Inventory reads the definitions from steam_settings/items.json next to the executable
+    const std::string items_path(Local_Storage::get_game_settings_path() + "items.json");
+    if (std::filesystem::exists(std::filesystem::u8path(items_path))) {
+        std::cerr << "'" << items_path << "' already exists, not overwriting it" << std::endl;
+        return 1;
+    }
+    std::error_code ec{};
+    std::filesystem::create_directories(std::filesystem::u8path(Local_Storage::get_game_settings_path()), ec);
+    {
+        std::ofstream file(std::filesystem::u8path(items_path), std::ios::binary | std::ios::trunc);
+        file << items_json;
+    }
+
+    auto save_dir = std::filesystem::temp_directory_path(ec) / "gbe_bench_inventory";
+    Settings settings(CSteamID((uint64)76561197960287930ULL), CGameID(480), "bench", "english", false);
+    Local_Storage local_storage(save_dir.u8string() + PATH_SEPARATOR);
+    SteamCallResults callback_results{};
+    SteamCallBacks callbacks(&callback_results);
+    RunEveryRunCB run_every_runcb{};
+    Steam_Inventory inventory(&settings, &callback_results, &callbacks, &run_every_runcb, &local_storage);
+
+    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    double first_load_ms = time_ms([&]{
+        inventory.LoadItemDefinitions();
+        run_every_runcb.run();
+    });
+
+    uint32 ids_count = 0;
+    std::vector<SteamItemDef_t> ids{};
+    constexpr int ids_calls = 100;
+    double ids_ms = time_ms([&]{
+        for (int i = 0; i < ids_calls; ++i) {
+            ids_count = 0;
+            inventory.GetItemDefinitionIDs(nullptr, &ids_count);
+            ids.resize(ids_count);
+            inventory.GetItemDefinitionIDs(ids.data(), &ids_count);
+        }
+    });
+
+    size_t steam_found = 0;
+    char value[1024];
+    double property_ms = time_ms([&]{
+        for (const auto &l : lookups) {
+            uint32 value_size = sizeof(value);
+            if (inventory.GetItemDefinitionProperty(l.first, l.second, value, &value_size)) ++steam_found;
+        }
+    });
+
+    std::filesystem::remove(std::filesystem::u8path(items_path), ec);
+    std::filesystem::remove_all(save_dir, ec);
+
+    std::cout << "Steam_Inventory first load (read + parse + load_definitions): " << first_load_ms << " ms" << std::endl;
+    std::cout << "Steam_Inventory::GetItemDefinitionIDs (size + fill): " << (ids_ms / ids_calls) << " ms/call, " << ids_count << " ids" << std::endl;
+    std::cout << "Steam_Inventory::GetItemDefinitionProperty: " << (property_ms * 1000000.0 / lookups_count)
+              << " ns/call, " << steam_found << "/" << lookups_count << " found" << std::endl;
+
+    if (ids_count != store.get_definitions().size() || steam_found != found) {
+        std::cerr << "Steam_Inventory doesn't agree with Inventory_Store" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+// 10k P2P packets queued across 8 channels in Steam_Networking (ISteamNetworking), then read back
+// the way games do it: each system drains its own channel with IsP2PPacketAvailable() + ReadP2PPacket()
+// the packets come from a few peers through Networking's local delivery, so no LAN is needed
+// usage: bench_p2p_channels [packets count] [channels count] [peers count]
+
+#include "dll/steam_networking.h"
+
+#include "bench_common.h"
+
+#include <iostream>
+
+constexpr uint32 APP_ID = 480;
+constexpr uint64 RECEIVER_ID = 76561197960287930ULL;
+
+struct Peer {
+    std::unique_ptr<Settings> settings{};
+    std::unique_ptr<Steam_Networking> networking{};
+};
+
+int main(int argc, char **argv)
+{
+    size_t packets_count = argc > 1 ? std::stoull(argv[1]) : 10000;
+    int channels_count = argc > 2 ? std::stoi(argv[2]) : 8;
+    size_t peers_count = argc > 3 ? std::stoull(argv[3]) : 4;
+
+    Networking network(CSteamID(RECEIVER_ID), APP_ID, DEFAULT_PORT, nullptr, false, Network_IO_Backend::sweep, false);
+    SteamCallResults callback_results{};
+    SteamCallBacks callbacks(&callback_results);
+    RunEveryRunCB run_every_runcb{};
+    Settings receiver_settings(CSteamID(RECEIVER_ID), CGameID(APP_ID), "receiver", "english", false);
+    Steam_Networking receiver(&receiver_settings, &network, &callbacks, &run_every_runcb);
+
+    std::vector<Peer> peers(peers_count);
+    for (size_t i = 0; i < peers_count; ++i) {
+        CSteamID id(RECEIVER_ID + 1 + i);
+        network.addListenId(id);
+        peers[i].settings = std::make_unique<Settings>(id, CGameID(APP_ID), "peer" + std::to_string(i), "english", false);
+        peers[i].networking = std::make_unique<Steam_Networking>(peers[i].settings.get(), &network, &callbacks, &run_every_runcb);
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+
+    // open the sessions both ways before measuring, the first packet of a new session is special
+    char data[256]{};
+    uint32 size = 0;
+    CSteamID remote{};
+    for (auto &peer : peers) {
+        if (!receiver.SendP2PPacket(peer.settings->get_local_steam_id(), data, sizeof(data), k_EP2PSendUnreliable, 0) ||
+            !peer.networking->SendP2PPacket(CSteamID(RECEIVER_ID), data, sizeof(data), k_EP2PSendUnreliable, 0)) {
+            std::cerr << "couldn't send, the networking failed to start" << std::endl;
+            return 1;
+        }
+    }
+    network.Run();
+    run_every_runcb.run();
+    while (receiver.ReadP2PPacket(data, sizeof(data), &size, &remote, 0)) {}
+
+    double send_ms = time_ms([&]{
+        for (size_t i = 0; i < packets_count; ++i) {
+            int channel = static_cast<int>(i % channels_count);
+            memcpy(data, &i, sizeof(i));
+            peers[(i / channels_count) % peers_count].networking->SendP2PPacket(CSteamID(RECEIVER_ID), data, sizeof(data), k_EP2PSendUnreliable, channel);
+        }
+    });
+
+    // delivery to Steam_Networking::Callback() then RunCallbacks() which queues them per channel
+    double queue_ms = time_ms([&]{
+        network.Run();
+        run_every_runcb.run();
+    });
+
+    size_t received = 0;
+    size_t polls = 0;
+    double read_ms = time_ms([&]{
+        for (int channel = 0; channel < channels_count; ++channel) {
+            ++polls;
+            while (receiver.IsP2PPacketAvailable(&size, channel)) {
+                ++polls;
+                if (receiver.ReadP2PPacket(data, sizeof(data), &size, &remote, channel)) ++received;
+            }
+        }
+    });
+
+    std::cout << packets_count << " packets across " << channels_count << " channels from " << peers_count << " peers" << std::endl;
+    std::cout << "SendP2PPacket: " << send_ms << " ms" << std::endl;
+    std::cout << "delivery + RunCallbacks: " << queue_ms << " ms" << std::endl;
+    std::cout << "IsP2PPacketAvailable + ReadP2PPacket per channel: " << read_ms << " ms, "
+              << (read_ms * 1000000.0 / polls) << " ns/poll, received " << received << "/" << packets_count << std::endl;
+    return received == packets_count ? 0 : 1;
+}
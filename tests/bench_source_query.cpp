@@ -0,0 +1,162 @@
+// replays a corpus of Source Query (A2S) datagrams, like a capture of server browsers and query
+// spammers hitting a server: challenge requests, A2S_PLAYER/A2S_RULES with the challenge they got back,
+// A2S_INFO with and without a challenge, stale challenges and junk, from many source addresses
+// it's replayed once with the cached responses, then with the state changing before every query
+// which rebuilds the response each time like the serialization done on every query before the caches
+// usage: bench_source_query [replays count] [corpus size] [source addresses count]
+
+#include "dll/source_query.h"
+
+#include <iostream>
+#include <random>
+
+struct Corpus_Entry {
+    uint32_t src_ip{};
+    std::vector<uint8_t> data{};
+};
+
+static std::vector<uint8_t> make_query(char header, const void *payload, size_t payload_size)
+{
+    std::vector<uint8_t> query{ 0xFF, 0xFF, 0xFF, 0xFF, static_cast<uint8_t>(header) };
+    query.insert(query.end(), (const uint8_t *)payload, (const uint8_t *)payload + payload_size);
+    return query;
+}
+
+static std::vector<uint8_t> make_query(char header, uint32_t challenge)
+{
+    return make_query(header, &challenge, sizeof(challenge));
+}
+
+static std::vector<uint8_t> make_info_query(bool with_challenge, uint32_t challenge)
+{
+    constexpr const char payload[] = "Source Engine Query";
+    auto query = make_query('T', payload, sizeof(payload));
+    if (with_challenge) query.insert(query.end(), (const uint8_t *)&challenge, (const uint8_t *)&challenge + sizeof(challenge));
+    return query;
+}
+
+static std::shared_ptr<Source_Query_State> make_state()
+{
+    auto state = std::make_shared<Source_Query_State>();
+    Gameserver &server = state->server;
+    server.set_server_name("gbe benchmark server | 24/7 custom maps | fastdl");
+    server.set_map_name("de_benchmark_v2");
+    server.set_mod_dir("cstrike");
+    server.set_product("Counter-Strike: Source");
+    server.set_appid(240);
+    server.set_max_player_count(32);
+    server.set_dedicated_server(true);
+    server.set_secure(true);
+    server.set_version(7654321);
+    server.set_port(27015);
+    server.set_offline(false);
+    // big enough to need a split A2S_RULES response
+    for (int i = 0; i < 80; ++i) {
+        (*server.mutable_values())["sv_benchmark_rule_" + std::to_string(i)] = "value_" + std::to_string(i * 7919);
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < 24; ++i) {
+        Gameserver_Player_Info_t info{};
+        info.name = "player_" + std::to_string(i);
+        info.score = i * 3;
+        info.join_time = now - std::chrono::seconds(i * 60);
+        state->players.emplace_back(CSteamID((uint64)76561197960287930ULL + i), std::move(info));
+    }
+
+    return state;
+}
+
+static uint32_t get_challenge(Source_Query &query, uint32_t ip)
+{
+    auto reply = query.handle_source_query(make_query('U', 0xFFFFFFFFul).data(), 9, ip);
+    uint32_t challenge{};
+    if (reply && reply->size() == 1 && (*reply)[0].size() == 9) memcpy(&challenge, &(*reply)[0][5], sizeof(challenge));
+    return challenge;
+}
+
+struct Replay_Result {
+    size_t replies{};
+    size_t packets{};
+    size_t bytes{};
+    double seconds{};
+};
+
+template<typename Fn>
+static Replay_Result replay(Source_Query &query, const std::vector<Corpus_Entry> &corpus, size_t replays, Fn before_query)
+{
+    Replay_Result res{};
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < replays; ++r) {
+        for (const auto &entry : corpus) {
+            before_query();
+            auto reply = query.handle_source_query(entry.data.data(), entry.data.size(), entry.src_ip);
+            if (!reply) continue;
+
+            ++res.replies;
+            res.packets += reply->size();
+            for (const auto &packet : *reply) res.bytes += packet.size();
+        }
+    }
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return res;
+}
+
+static void print_result(const char *name, const Replay_Result &res, size_t queries)
+{
+    std::cout << name << (size_t)(queries / res.seconds) << " queries/s, " << res.replies << " replies, "
+              << res.packets << " packets, " << (res.bytes / (1024.0 * 1024.0)) << " MB" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    size_t replays = argc > 1 ? std::stoull(argv[1]) : 10;
+    size_t corpus_size = argc > 2 ? std::stoull(argv[2]) : 100000;
+    size_t addresses_count = argc > 3 ? std::stoull(argv[3]) : 1000;
+
+    Source_Query query{};
+    query.set_state(make_state(), Source_Query::Cached_Response_Type::all);
+
+    std::vector<uint32_t> addresses(addresses_count);
+    std::vector<uint32_t> challenges(addresses_count);
+    for (size_t i = 0; i < addresses_count; ++i) {
+        addresses[i] = 0x0A000000u + static_cast<uint32_t>(i) * 2654435761u % 0x00FFFFFFu;
+        challenges[i] = get_challenge(query, addresses[i]);
+    }
+
+    // fixed seed so every run replays the same corpus
+    std::mt19937 rng(1234);
+    std::vector<Corpus_Entry> corpus(corpus_size);
+    for (auto &entry : corpus) {
+        size_t addr = rng() % addresses_count;
+        entry.src_ip = addresses[addr];
+        uint32_t challenge = challenges[addr];
+        switch (rng() % 20) {
+        case 0: case 1: case 2: case 3: entry.data = make_info_query(false, 0); break;
+        case 4: case 5: case 6: case 7: entry.data = make_info_query(true, challenge); break;
+        case 8: case 9: entry.data = make_query('U', 0xFFFFFFFFul); break;
+        case 10: case 11: case 12: case 13: entry.data = make_query('U', challenge); break;
+        case 14: entry.data = make_query('V', 0xFFFFFFFFul); break;
+        case 15: case 16: case 17: entry.data = make_query('V', challenge); break;
+        // a challenge issued to another address
+        case 18: entry.data = make_query('U', challenges[(addr + 1) % addresses_count]); break;
+        default: entry.data = { 0xFF, 0xFF, 0xFF, 0xFF, 'W' }; break;
+        }
+    }
+
+    size_t queries = replays * corpus_size;
+    std::cout << "replaying " << corpus_size << " queries from " << addresses_count << " addresses " << replays << " times" << std::endl;
+
+    auto cached = replay(query, corpus, replays, []{});
+    // republishing the same state only bumps the generations, so only the rebuild of the responses is measured
+    // (fine here since nothing else reads the state concurrently)
+    auto same_state = make_state();
+    auto rebuilt = replay(query, corpus, replays, [&]{
+        query.set_state(same_state, Source_Query::Cached_Response_Type::all);
+    });
+
+    print_result("cached responses:                ", cached, queries);
+    print_result("responses rebuilt on each query: ", rebuilt, queries);
+    return cached.replies == 0 ? 1 : 0;
+}
@@ -0,0 +1,181 @@
+// streams 100 MB of framed Common_Messages through a loopback TCP pair the same way Networking does
+// (send_buffer_tcp(), recv_tcp() and unbuffer_tcp()), once with the previous std::vector<char> buffers
+// which erased the consumed bytes from the front after every send/frame (before), and once with TCP_Buffer (after)
+// usage: bench_tcp_framing [payload size in bytes] [backlog in KB]
+
+#include "dll/network.h"
+
+#include <iostream>
+
+#if defined(STEAM_WIN32)
+    #define close_sock closesocket
+#else
+    #define close_sock close
+#endif
+
+constexpr size_t TOTAL_BYTES = 100ULL * 1024 * 1024;
+
+// from network.cpp
+unsigned int receive_buffer_amount(sock_t sock);
+
+// the buffers before TCP_Buffer
+class Front_Erase_Buffer {
+    std::vector<char> storage{};
+
+public:
+    size_t size() const { return storage.size(); }
+    char *data() { return storage.data(); }
+
+    char *append(size_t count)
+    {
+        size_t old_size = storage.size();
+        storage.resize(old_size + count);
+        return storage.data() + old_size;
+    }
+
+    void discard_back(size_t count) { storage.resize(storage.size() - count); }
+    void consume(size_t count) { storage.erase(storage.begin(), storage.begin() + count); }
+};
+
+static bool set_nonblocking(sock_t sock)
+{
+#if defined(STEAM_WIN32)
+    u_long mode = 1;
+    return ioctlsocket(sock, FIONBIO, &mode) == 0;
+#else
+    return fcntl(sock, F_SETFL, O_NONBLOCK) == 0;
+#endif
+}
+
+static bool loopback_pair(sock_t &a, sock_t &b)
+{
+    sock_t listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    if (bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0 ||
+        getsockname(listener, (sockaddr *)&addr, &addr_len) != 0) {
+        close_sock(listener);
+        return false;
+    }
+
+    a = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (connect(a, (sockaddr *)&addr, sizeof(addr)) != 0) {
+        close_sock(listener);
+        close_sock(a);
+        return false;
+    }
+    b = accept(listener, nullptr, nullptr);
+    close_sock(listener);
+
+    // same as the emu sockets
+    int nodelay = 1;
+    setsockopt(a, IPPROTO_TCP, TCP_NODELAY, (char *)&nodelay, sizeof(nodelay));
+    setsockopt(b, IPPROTO_TCP, TCP_NODELAY, (char *)&nodelay, sizeof(nodelay));
+    return set_nonblocking(a) && set_nonblocking(b);
+}
+
+// like send_tcp_pending(), one send() of whatever is pending
+template<typename Buffer>
+static void send_pending(sock_t sock, Buffer &buffer)
+{
+    if (buffer.size() == 0) return;
+
+    int len = send(sock, buffer.data(), static_cast<int>(buffer.size()), MSG_NOSIGNAL);
+    if (len > 0) buffer.consume(len);
+}
+
+// returns the MB/s or a negative value on failure
+template<typename Buffer>
+static double stream(const Common_Message &msg, size_t backlog)
+{
+    sock_t sender{}, receiver{};
+    if (!loopback_pair(sender, receiver)) return -1;
+
+    const uint32 msg_size = static_cast<uint32>(msg.ByteSizeLong());
+    const size_t frames = TOTAL_BYTES / (sizeof(uint32) + msg_size);
+    size_t frames_sent = 0;
+    size_t frames_received = 0;
+    Buffer send_buffer{};
+    Buffer recv_buffer{};
+    Common_Message parsed{};
+
+    auto start = std::chrono::steady_clock::now();
+    while (frames_received < frames) {
+        // like send_buffer_tcp(), each message tries to send what's pending right away
+        // a game queues messages faster than the socket drains them, the backlog is what the buffers carry around
+        while (frames_sent < frames && send_buffer.size() < backlog) {
+            char *frame = send_buffer.append(sizeof(uint32) + msg_size);
+            memcpy(frame, &msg_size, sizeof(msg_size));
+            msg.SerializeToArray(frame + sizeof(uint32), msg_size);
+            ++frames_sent;
+
+            send_pending(sender, send_buffer);
+        }
+
+        // the next Networking::Run() retries the rest
+        send_pending(sender, send_buffer);
+
+        // like recv_tcp(), as much as the socket has
+        unsigned int size = receive_buffer_amount(receiver);
+        if (size > 0) {
+            char *dest = recv_buffer.append(size);
+            int len = recv(receiver, dest, size, MSG_NOSIGNAL);
+            recv_buffer.discard_back(size - (len > 0 ? len : 0));
+        }
+
+        // like unbuffer_tcp() until no whole frame is left
+        while (recv_buffer.size() >= sizeof(uint32)) {
+            uint32 length{};
+            memcpy(&length, recv_buffer.data(), sizeof(length));
+            if (sizeof(length) + length > recv_buffer.size()) break;
+
+            if (!parsed.ParseFromArray(recv_buffer.data() + sizeof(uint32), length)) {
+                close_sock(sender);
+                close_sock(receiver);
+                return -1;
+            }
+            recv_buffer.consume(sizeof(length) + length);
+            ++frames_received;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    close_sock(sender);
+    close_sock(receiver);
+    return (frames * (sizeof(uint32) + msg_size)) / (1024.0 * 1024.0) / seconds;
+}
+
+int main(int argc, char **argv)
+{
+#if defined(STEAM_WIN32)
+    WSADATA wsa_data{};
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+
+    size_t payload_size = argc > 1 ? std::stoull(argv[1]) : 1024;
+    size_t backlog = (argc > 2 ? std::stoull(argv[2]) : 4096) * 1024;
+
+    Common_Message msg{};
+    msg.set_source_id(76561197960287930ULL);
+    msg.set_dest_id(76561197960287931ULL);
+    msg.mutable_network()->set_channel(1);
+    msg.mutable_network()->set_type(Network_pb::DATA);
+    msg.mutable_network()->set_data(std::string(payload_size, 'x'));
+
+    std::cout << "streaming " << (TOTAL_BYTES / (1024 * 1024)) << " MB, message size " << msg.ByteSizeLong()
+              << " bytes, backlog " << (backlog / 1024) << " KB" << std::endl;
+
+    double before = stream<Front_Erase_Buffer>(msg, backlog);
+    double after = stream<TCP_Buffer>(msg, backlog);
+    if (before < 0 || after < 0) {
+        std::cerr << "loopback stream failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "before (front-erased std::vector): " << before << " MB/s" << std::endl;
+    std::cout << "after (TCP_Buffer):                " << after << " MB/s" << std::endl;
+    std::cout << "speedup: " << (after / before) << "x" << std::endl;
+    return 0;
+}
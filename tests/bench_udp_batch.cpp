@@ -0,0 +1,205 @@
+// packets per second of unreliable Common_Messages over a loopback UDP socket, comparing the LAN
+// transport's previous path (a fresh std::vector + sendto() per packet, recvfrom() per datagram)
+// with the batched one (reusable packet queue + sendmmsg(), recvmmsg() of UDP_BATCH_SIZE datagrams)
+// the batched calls are Linux only, other platforms only run the first mode
+// usage: bench_udp_batch [packets count] [payload size in bytes]
+
+#include "dll/network.h"
+
+#include <iostream>
+
+#if defined(STEAM_WIN32)
+    #define close_sock closesocket
+#else
+    #define close_sock close
+#endif
+
+// same values as network.cpp
+#define MAX_UDP_SIZE 16384
+#define UDP_BATCH_SIZE 32
+
+// packets sent before draining the receiver, small enough to fit in the socket receive buffer
+constexpr size_t BURST_SIZE = 256;
+
+static bool set_nonblocking(sock_t sock)
+{
+#if defined(STEAM_WIN32)
+    u_long mode = 1;
+    return ioctlsocket(sock, FIONBIO, &mode) == 0;
+#else
+    return fcntl(sock, F_SETFL, O_NONBLOCK) == 0;
+#endif
+}
+
+static sock_t bind_loopback(sockaddr_in &addr)
+{
+    sock_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    int buf_size = 4 * 1024 * 1024;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *)&buf_size, sizeof(buf_size));
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (char *)&buf_size, sizeof(buf_size));
+
+    addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    if (bind(sock, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+        getsockname(sock, (sockaddr *)&addr, &addr_len) != 0 ||
+        !set_nonblocking(sock)) {
+        close_sock(sock);
+        return static_cast<sock_t>(~0);
+    }
+
+    return sock;
+}
+
+struct Result {
+    size_t received{};
+    double seconds{};
+};
+
+static size_t parse_packet(const char *data, int len, Common_Message &msg)
+{
+    return (len > 0 && msg.ParseFromArray(data, len) && msg.has_network()) ? 1 : 0;
+}
+
+static Result run_single(sock_t sender, sock_t receiver, const sockaddr_in &dest, Common_Message &msg, size_t packets)
+{
+    Result res{};
+    Common_Message parsed{};
+    char data[MAX_UDP_SIZE];
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t sent = 0; sent < packets;) {
+        for (size_t burst = 0; burst < BURST_SIZE && sent < packets; ++burst, ++sent) {
+            size_t size = msg.ByteSizeLong();
+            std::vector<char> buffer(size, 0);
+            msg.SerializeToArray(&buffer[0], static_cast<int>(size));
+            sendto(sender, &buffer[0], static_cast<int>(size), MSG_NOSIGNAL, (const sockaddr *)&dest, sizeof(dest));
+        }
+
+        while (true) {
+            sockaddr_in from{};
+            socklen_t from_len = sizeof(from);
+            int len = recvfrom(receiver, data, sizeof(data), 0, (sockaddr *)&from, &from_len);
+            if (len < 0) break;
+
+            res.received += parse_packet(data, len, parsed);
+        }
+    }
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return res;
+}
+
+#if defined(__linux__)
+static Result run_batched(sock_t sender, sock_t receiver, const sockaddr_in &dest, Common_Message &msg, size_t packets)
+{
+    Result res{};
+    Common_Message parsed{};
+    std::vector<char> recv_data(UDP_BATCH_SIZE * MAX_UDP_SIZE);
+    std::vector<char> send_data{};
+    std::vector<size_t> send_offsets{};
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t sent = 0; sent < packets;) {
+        send_data.clear();
+        send_offsets.clear();
+        for (size_t burst = 0; burst < BURST_SIZE && sent < packets; ++burst, ++sent) {
+            size_t size = msg.ByteSizeLong();
+            size_t offset = send_data.size();
+            send_data.resize(offset + size);
+            msg.SerializeToArray(&send_data[offset], static_cast<int>(size));
+            send_offsets.push_back(offset);
+        }
+
+        struct mmsghdr msgs[UDP_BATCH_SIZE]{};
+        struct iovec iovecs[UDP_BATCH_SIZE]{};
+        for (size_t first = 0; first < send_offsets.size(); first += UDP_BATCH_SIZE) {
+            unsigned int batch = static_cast<unsigned int>(std::min(send_offsets.size() - first, (size_t)UDP_BATCH_SIZE));
+            for (unsigned int i = 0; i < batch; ++i) {
+                size_t end = (first + i + 1 < send_offsets.size()) ? send_offsets[first + i + 1] : send_data.size();
+                iovecs[i].iov_base = &send_data[send_offsets[first + i]];
+                iovecs[i].iov_len = end - send_offsets[first + i];
+                msgs[i].msg_hdr.msg_iov = &iovecs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+                msgs[i].msg_hdr.msg_name = (void *)&dest;
+                msgs[i].msg_hdr.msg_namelen = sizeof(dest);
+            }
+
+            unsigned int done = 0;
+            while (done < batch) {
+                int ret = sendmmsg(sender, &msgs[done], batch - done, MSG_NOSIGNAL);
+                done += ret > 0 ? ret : 1;
+            }
+        }
+
+        while (true) {
+            struct mmsghdr recv_msgs[UDP_BATCH_SIZE]{};
+            struct iovec recv_iovecs[UDP_BATCH_SIZE]{};
+            struct sockaddr_in addrs[UDP_BATCH_SIZE]{};
+            for (int i = 0; i < UDP_BATCH_SIZE; ++i) {
+                recv_iovecs[i].iov_base = &recv_data[i * MAX_UDP_SIZE];
+                recv_iovecs[i].iov_len = MAX_UDP_SIZE;
+                recv_msgs[i].msg_hdr.msg_iov = &recv_iovecs[i];
+                recv_msgs[i].msg_hdr.msg_iovlen = 1;
+                recv_msgs[i].msg_hdr.msg_name = &addrs[i];
+                recv_msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+            }
+
+            int count = recvmmsg(receiver, recv_msgs, UDP_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+            if (count <= 0) break;
+
+            for (int i = 0; i < count; ++i) {
+                res.received += parse_packet(&recv_data[i * MAX_UDP_SIZE], static_cast<int>(recv_msgs[i].msg_len), parsed);
+            }
+            if (count < UDP_BATCH_SIZE) break;
+        }
+    }
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return res;
+}
+#endif
+
+static void print_result(const char *name, const Result &res, size_t packets)
+{
+    std::cout << name << (size_t)(res.received / res.seconds) << " packets/s, received "
+              << res.received << "/" << packets << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+#if defined(STEAM_WIN32)
+    WSADATA wsa_data{};
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+
+    size_t packets = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    size_t payload_size = argc > 2 ? std::stoull(argv[2]) : 200;
+
+    sockaddr_in sender_addr{}, receiver_addr{};
+    sock_t sender = bind_loopback(sender_addr);
+    sock_t receiver = bind_loopback(receiver_addr);
+    if (sender == static_cast<sock_t>(~0) || receiver == static_cast<sock_t>(~0)) {
+        std::cerr << "failed to bind loopback sockets" << std::endl;
+        return 1;
+    }
+
+    Common_Message msg{};
+    msg.set_source_id(76561197960287930ULL);
+    msg.set_dest_id(76561197960287931ULL);
+    msg.mutable_network()->set_channel(0);
+    msg.mutable_network()->set_type(Network_pb::DATA);
+    msg.mutable_network()->set_data(std::string(payload_size, 'x'));
+
+    std::cout << "sending " << packets << " packets of " << msg.ByteSizeLong() << " bytes in bursts of " << BURST_SIZE << std::endl;
+
+    print_result("one call per packet: ", run_single(sender, receiver, receiver_addr, msg, packets), packets);
+#if defined(__linux__)
+    print_result("sendmmsg/recvmmsg:   ", run_batched(sender, receiver, receiver_addr, msg, packets), packets);
+#endif
+
+    close_sock(sender);
+    close_sock(receiver);
+    return 0;
+}
@@ -0,0 +1,118 @@
+// reads a 1 GB mod file in 64 KB chunks, once with Local_Storage::get_file_data() for each chunk
+// (the previous UGCRead() path, which reopened the file every time) and once through
+// Steam_Remote_Storage::UGCDownload() + UGCRead() (the content is mapped once per handle)
+// the file is created in the temp dir and deleted at the end
+// usage: bench_ugc_read [file size in MB] [chunk size in KB]
+
+#include "dll/steam_remote_storage.h"
+
+#include <iostream>
+
+constexpr PublishedFileId_t MOD_ID = 123456;
+constexpr UGCHandle_t MOD_HANDLE = 654321;
+
+static uint64 checksum(uint64 sum, const char *data, size_t size)
+{
+    for (size_t i = 0; i + sizeof(uint64) <= size; i += 4096) {
+        uint64 v{};
+        memcpy(&v, data + i, sizeof(v));
+        sum = sum * 31 + v;
+    }
+
+    return sum;
+}
+
+static void print_result(const char *name, uint64 file_size, double seconds)
+{
+    std::cout << name << seconds << " s, " << (file_size / (1024.0 * 1024.0) / seconds) << " MB/s" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    uint64 file_size = (argc > 1 ? std::stoull(argv[1]) : 1024) * 1024 * 1024;
+    size_t chunk_size = (argc > 2 ? std::stoull(argv[2]) : 64) * 1024;
+    if (file_size > (uint64)std::numeric_limits<int32>::max()) {
+        std::cerr << "UGC content size is an int32, max 2047 MB" << std::endl;
+        return 1;
+    }
+
+    std::error_code ec{};
+    auto dir = std::filesystem::temp_directory_path(ec) / "gbe_bench_ugc_read";
+    std::filesystem::create_directories(dir, ec);
+    const std::string dir_str(dir.u8string());
+    const std::string file_name("content.bin");
+    const std::string file_path(common_helpers::to_absolute(file_name, dir_str));
+
+    {
+        std::ofstream file(std::filesystem::u8path(file_path), std::ios::binary | std::ios::trunc);
+        std::vector<char> block(1024 * 1024);
+        for (uint64 written = 0; written < file_size; written += block.size()) {
+            for (size_t i = 0; i < block.size(); i += sizeof(uint64)) {
+                uint64 v = written + i;
+                memcpy(&block[i], &v, sizeof(v));
+            }
+            file.write(block.data(), static_cast<std::streamsize>(std::min<uint64>(block.size(), file_size - written)));
+        }
+        if (!file) {
+            std::cerr << "failed to create '" << file_path << "'" << std::endl;
+            return 1;
+        }
+    }
+
+    Settings settings(CSteamID((uint64)76561197960287930ULL), CGameID(480), "bench", "english", false);
+    Mod_entry details{};
+    details.primaryFileName = file_name;
+    details.primaryFileSize = static_cast<int32>(file_size);
+    settings.addMod(MOD_ID, "bench", dir_str);
+    settings.addModDetails(MOD_ID, details);
+
+    Ugc_Remote_Storage_Bridge ugc_bridge(&settings);
+    ugc_bridge.add_ugc_query_result(MOD_HANDLE, MOD_ID, true);
+
+    Local_Storage local_storage(dir_str + PATH_SEPARATOR);
+    SteamCallResults callback_results{};
+    SteamCallBacks callbacks(&callback_results);
+    RunEveryRunCB run_every_runcb{};
+    Steam_Remote_Storage remote_storage(&settings, &ugc_bridge, &local_storage, &callback_results, &callbacks, &run_every_runcb);
+
+    std::vector<char> chunk(chunk_size);
+    std::cout << "reading " << (file_size / (1024 * 1024)) << " MB in " << (chunk_size / 1024) << " KB chunks" << std::endl;
+
+    // warm the page cache so both runs read from memory
+    uint64 expected = 0;
+    for (uint64 offset = 0; offset < file_size; offset += chunk_size) {
+        int read = Local_Storage::get_file_data(file_path, chunk.data(), static_cast<unsigned int>(chunk_size), static_cast<unsigned int>(offset));
+        expected = checksum(expected, chunk.data(), read > 0 ? read : 0);
+    }
+
+    uint64 sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64 offset = 0; offset < file_size; offset += chunk_size) {
+        int read = Local_Storage::get_file_data(file_path, chunk.data(), static_cast<unsigned int>(chunk_size), static_cast<unsigned int>(offset));
+        sum = checksum(sum, chunk.data(), read > 0 ? read : 0);
+    }
+    double get_file_data_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    int result = sum == expected ? 0 : 1;
+
+    sum = 0;
+    start = std::chrono::steady_clock::now();
+    remote_storage.UGCDownload(MOD_HANDLE, 0);
+    for (uint64 offset = 0; offset < file_size; offset += chunk_size) {
+        int32 read = remote_storage.UGCRead(MOD_HANDLE, chunk.data(), static_cast<int32>(chunk_size), static_cast<uint32>(offset), k_EUGCRead_ContinueReadingUntilFinished);
+        if (read < 0) {
+            std::cerr << "UGCRead failed at offset " << offset << std::endl;
+            result = 1;
+            break;
+        }
+        sum = checksum(sum, chunk.data(), read);
+    }
+    double ugc_read_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (sum != expected) result = 1;
+
+    print_result("Local_Storage::get_file_data per chunk: ", file_size, get_file_data_s);
+    print_result("UGCRead (mapped):                       ", file_size, ugc_read_s);
+
+    std::filesystem::remove_all(dir, ec);
+    if (result) std::cerr << "the content read doesn't match the file" << std::endl;
+    return result;
+}
@@ -0,0 +1,54 @@
+// helpers shared by the tests
+// a test counts its failed checks and keeps going, main() returns report_checks()
+
+#ifndef __INCLUDED_TEST_COMMON_H__
+#define __INCLUDED_TEST_COMMON_H__
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if (ok) return;
+
+    std::cerr << "failed: " << what << std::endl;
+    ++failures;
+}
+
+// prints how the checks went, returns the exit code of the test
+static int report_checks()
+{
+    if (failures) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
+
+// unique per run, so nothing left by a previous run is picked up
+static std::string test_run_id()
+{
+    return std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+}
+
+// new folder '<test_name>_<run id>' in the temp folder, removed by the test when it's done
+static std::filesystem::path create_test_folder(const std::string &test_name)
+{
+    auto folder = std::filesystem::temp_directory_path() / (test_name + "_" + test_run_id());
+    std::filesystem::create_directories(folder);
+    return folder;
+}
+
+// a port for the loopback networking, runs of the same test don't share it
+static unsigned short test_random_port()
+{
+    return static_cast<unsigned short>(40000 + std::chrono::steady_clock::now().time_since_epoch().count() % 20000);
+}
+
+#endif // __INCLUDED_TEST_COMMON_H__
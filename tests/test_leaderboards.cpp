@@ -0,0 +1,374 @@
+// checks the leaderboard entries (Steam_Leaderboard_Entries) against a sorted vector after random
+// upserts/removals, the order of equal scores, the ranges of DownloadLeaderboardEntries(), and the
+// leaderboard file: the last record of a user wins and the file is rewritten once it holds too many records
+
+#include "dll/steam_user_stats.h"
+
+#include "test_common.h"
+
+#include <random>
+
+constexpr uint64 LOCAL_STEAMID = 76561197960287930ULL;
+constexpr uint64 OTHER_STEAMID_BASE = 76561197960300000ULL;
+constexpr auto RESULT_TIMEOUT = std::chrono::seconds(5);
+
+// --- Steam_Leaderboard_Entries against a sorted vector
+
+struct Oracle_Entry {
+    uint64 steamid{};
+    int32 score{};
+    uint64 seq{}; // when the score was set, orders equal scores
+};
+
+struct Oracle {
+    ELeaderboardSortMethod sort_method{};
+    std::vector<Oracle_Entry> entries{};
+    uint64 next_seq{};
+
+    void sort()
+    {
+        std::sort(entries.begin(), entries.end(), [this](const Oracle_Entry &a, const Oracle_Entry &b) {
+            if (a.score != b.score) {
+                if (sort_method == k_ELeaderboardSortMethodAscending) return a.score < b.score;
+                if (sort_method == k_ELeaderboardSortMethodDescending) return a.score > b.score;
+            }
+            return a.seq < b.seq;
+        });
+    }
+
+    int rank(uint64 steamid) const
+    {
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].steamid == steamid) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    void upsert(uint64 steamid, int32 score)
+    {
+        int pos = rank(steamid);
+        if (pos >= 0) {
+            auto &entry = entries[pos];
+            // an entry only moves when its score changes
+            if (entry.score != score && sort_method != k_ELeaderboardSortMethodNone) entry.seq = next_seq++;
+            entry.score = score;
+        } else {
+            entries.push_back({ steamid, score, next_seq++ });
+        }
+        sort();
+    }
+
+    bool remove(uint64 steamid)
+    {
+        int pos = rank(steamid);
+        if (pos < 0) return false;
+        entries.erase(entries.begin() + pos);
+        return true;
+    }
+};
+
+static bool same_entries(const Steam_Leaderboard_Entries &entries, const Oracle &oracle)
+{
+    if (entries.size() != oracle.entries.size()) return false;
+    if (entries.at(entries.size())) return false;
+
+    for (size_t i = 0; i < oracle.entries.size(); ++i) {
+        const auto &expected = oracle.entries[i];
+        auto entry = entries.at(i);
+        if (!entry || entry->steam_id.ConvertToUint64() != expected.steamid || entry->score != expected.score) return false;
+        if (entries.rank(CSteamID(expected.steamid)) != static_cast<int>(i)) return false;
+
+        auto found = entries.find(CSteamID(expected.steamid));
+        if (!found || found->score != expected.score) return false;
+    }
+
+    return true;
+}
+
+static void test_entries_against_oracle(ELeaderboardSortMethod sort_method)
+{
+    std::string what("random upserts/removals, sort method " + std::to_string((int)sort_method));
+    std::mt19937 rng(1234 + (unsigned)sort_method);
+
+    Steam_Leaderboard_Entries entries(sort_method);
+    Oracle oracle{};
+    oracle.sort_method = sort_method;
+
+    for (unsigned op = 0; op < 5000; ++op) {
+        uint64 steamid = OTHER_STEAMID_BASE + rng() % 200;
+        if (rng() % 5 == 0) {
+            bool removed = entries.remove(CSteamID(steamid));
+            check(removed == oracle.remove(steamid), what + ": remove() result");
+            check(entries.rank(CSteamID(steamid)) == -1 && !entries.find(CSteamID(steamid)), what + ": removed entry still found");
+        } else {
+            // a small range of scores, so there are plenty of ties
+            Steam_Leaderboard_Entry entry{};
+            entry.steam_id = CSteamID(steamid);
+            entry.score = static_cast<int32>(rng() % 50) - 25;
+            entry.score_details = { static_cast<int32>(op) };
+            int rank = entries.upsert(entry);
+            oracle.upsert(steamid, entry.score);
+            check(rank == oracle.rank(steamid), what + ": rank returned by upsert()");
+            check(entries.find(entry.steam_id) && entries.find(entry.steam_id)->score_details == entry.score_details, what + ": replaced details");
+        }
+
+        if (op % 250 == 0 && !same_entries(entries, oracle)) {
+            check(false, what + ": rank()/at() after op " + std::to_string(op));
+            return;
+        }
+    }
+
+    check(same_entries(entries, oracle), what + ": rank()/at() at the end");
+}
+
+static std::vector<uint64> order_of(const Steam_Leaderboard_Entries &entries)
+{
+    std::vector<uint64> order{};
+    for (size_t i = 0; i < entries.size(); ++i) {
+        order.push_back(entries.at(i)->steam_id.ConvertToUint64() - OTHER_STEAMID_BASE);
+    }
+    return order;
+}
+
+static void test_ties()
+{
+    const auto upsert = [](Steam_Leaderboard_Entries &entries, uint64 user, int32 score) {
+        Steam_Leaderboard_Entry entry{};
+        entry.steam_id = CSteamID(OTHER_STEAMID_BASE + user);
+        entry.score = score;
+        return entries.upsert(entry);
+    };
+
+    // equal scores keep the order they were set in, whatever the sort method
+    Steam_Leaderboard_Entries ascending(k_ELeaderboardSortMethodAscending);
+    Steam_Leaderboard_Entries descending(k_ELeaderboardSortMethodDescending);
+    for (auto entries : { &ascending, &descending }) {
+        upsert(*entries, 1, 10);
+        upsert(*entries, 2, 5);
+        upsert(*entries, 3, 10);
+        upsert(*entries, 4, 5);
+    }
+    check(order_of(ascending) == std::vector<uint64>{ 2, 4, 1, 3 }, "ties in ascending order");
+    check(order_of(descending) == std::vector<uint64>{ 1, 3, 2, 4 }, "ties in descending order");
+
+    // the same score again doesn't move the entry
+    check(upsert(descending, 1, 10) == 0, "same score keeps the rank");
+    check(order_of(descending) == std::vector<uint64>{ 1, 3, 2, 4 }, "same score keeps the order");
+
+    // a new score goes after the entries which already had it
+    check(upsert(descending, 1, 5) == 3, "replaced score ranked after the older equal ones");
+    check(order_of(descending) == std::vector<uint64>{ 3, 2, 4, 1 }, "order after replacing a score");
+    check(upsert(ascending, 4, 10) == 3, "replaced score ranked after the older equal ones (ascending)");
+    check(order_of(ascending) == std::vector<uint64>{ 2, 1, 3, 4 }, "order after replacing a score (ascending)");
+
+    check(descending.remove(CSteamID(OTHER_STEAMID_BASE + 2)), "remove an entry");
+    check(order_of(descending) == std::vector<uint64>{ 3, 4, 1 }, "order after removing an entry");
+    check(!descending.remove(CSteamID(OTHER_STEAMID_BASE + 2)), "remove an entry twice");
+}
+
+// --- Steam_User_Stats leaderboards
+
+struct Record {
+    uint64 steamid{};
+    int32 score{};
+    std::vector<int32> details{};
+};
+
+// same layout save_my_leaderboard_entry() uses
+static std::vector<uint32_t> to_file_records(const std::vector<Record> &records)
+{
+    std::vector<uint32_t> out{};
+    for (const auto &record : records) {
+        out.push_back((uint32_t)(record.steamid & 0xFFFFFFFF));
+        out.push_back((uint32_t)(record.steamid >> 32));
+        out.push_back((uint32_t)record.score);
+        out.push_back((uint32_t)record.details.size());
+        for (auto detail : record.details) out.push_back((uint32_t)detail);
+    }
+    return out;
+}
+
+struct Stats_Env {
+    Settings settings;
+    Networking network;
+    Local_Storage local_storage;
+    SteamCallResults callback_results{};
+    SteamCallBacks callbacks;
+    RunEveryRunCB run_every_runcb{};
+    std::unique_ptr<Steam_User_Stats> stats{};
+
+    Stats_Env(const std::string &save_folder):
+        settings(CSteamID((uint64)LOCAL_STEAMID), CGameID(480), "test", "english", false),
+        network(CSteamID((uint64)LOCAL_STEAMID), 480, 0, nullptr, true, Network_IO_Backend::sweep, false),
+        local_storage(save_folder),
+        callbacks(&callback_results)
+    {
+        local_storage.setAppId(480);
+        stats = std::make_unique<Steam_User_Stats>(&settings, &network, &local_storage, &callback_results, &callbacks, &run_every_runcb, nullptr);
+    }
+
+    template<typename T>
+    bool wait_result(SteamAPICall_t call, T &data)
+    {
+        auto start = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() - start < RESULT_TIMEOUT) {
+            {
+                std::lock_guard<std::recursive_mutex> lock(global_mutex);
+                callback_results.runCallResults();
+                if (callback_results.callback_result(call, &data, sizeof(data))) return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return false;
+    }
+
+    SteamLeaderboard_t find_board(const char *name, ELeaderboardSortMethod sort_method)
+    {
+        LeaderboardFindResult_t found{};
+        auto call = stats->FindOrCreateLeaderboard(name, sort_method, k_ELeaderboardDisplayTypeNumeric);
+        if (!wait_result(call, found) || !found.m_bLeaderboardFound) return 0;
+        return found.m_hSteamLeaderboard;
+    }
+
+    // (1-based global rank, score) of each downloaded row
+    std::vector<std::pair<int, int32>> download(SteamLeaderboard_t board, ELeaderboardDataRequest request, int start, int end)
+    {
+        std::vector<std::pair<int, int32>> rows{};
+        LeaderboardScoresDownloaded_t downloaded{};
+        auto call = stats->DownloadLeaderboardEntries(board, request, start, end);
+        if (!wait_result(call, downloaded)) return { { -1, -1 } };
+
+        for (int i = 0; i < downloaded.m_cEntryCount; ++i) {
+            LeaderboardEntry_t entry{};
+            if (!stats->GetDownloadedLeaderboardEntry(downloaded.m_hSteamLeaderboardEntries, i, &entry, nullptr, 0)) return { { -1, -1 } };
+            rows.emplace_back(entry.m_nGlobalRank, entry.m_nScore);
+        }
+        return rows;
+    }
+};
+
+// expected rows for the 1-based global ranks [first, last] of the "ranked" board
+static std::vector<std::pair<int, int32>> ranked_rows(const std::vector<int32> &scores, int first, int last)
+{
+    std::vector<std::pair<int, int32>> rows{};
+    for (int rank = first; rank <= last; ++rank) {
+        rows.emplace_back(rank, scores[rank - 1]);
+    }
+    return rows;
+}
+
+static void test_ranges(const std::string &save_folder)
+{
+    Stats_Env env(save_folder);
+
+    // 20 other users with scores 10..200, user 1 has an older record which must be ignored,
+    // and our own score (105) with details
+    std::vector<Record> records{};
+    records.push_back({ OTHER_STEAMID_BASE + 1, 999, {} });
+    for (int32 i = 1; i <= 20; ++i) {
+        records.push_back({ OTHER_STEAMID_BASE + i, i * 10, {} });
+    }
+    records.push_back({ LOCAL_STEAMID, 105, { 7, 8 } });
+    auto data = to_file_records(records);
+    env.local_storage.store_data(Local_Storage::leaderboard_storage_folder, "ranked", (char *)data.data(), (unsigned int)(data.size() * sizeof(data[0])));
+
+    // the scores in rank order, we're 11th
+    std::vector<int32> scores{};
+    for (int32 i = 20; i >= 11; --i) scores.push_back(i * 10);
+    scores.push_back(105);
+    for (int32 i = 10; i >= 1; --i) scores.push_back(i * 10);
+
+    auto board = env.find_board("ranked", k_ELeaderboardSortMethodDescending);
+    check(board != 0, "find the ranked board");
+    check(env.stats->GetLeaderboardEntryCount(board) == 21, "entries loaded from the file, one per user");
+
+    check(env.download(board, k_ELeaderboardDataRequestGlobal, 1, 5) == ranked_rows(scores, 1, 5), "global [1, 5]");
+    check(env.download(board, k_ELeaderboardDataRequestGlobal, 19, 30) == ranked_rows(scores, 19, 21), "global [19, 30] clamped to the last entry");
+    check(env.download(board, k_ELeaderboardDataRequestGlobal, 0, 2) == ranked_rows(scores, 1, 2), "global [0, 2] clamped to the first entry");
+    check(env.download(board, k_ELeaderboardDataRequestGlobal, 25, 30).empty(), "global range past the end");
+    check(env.download(board, k_ELeaderboardDataRequestGlobal, 5, 4).empty(), "global range with end before start");
+
+    check(env.download(board, k_ELeaderboardDataRequestGlobalAroundUser, -2, 2) == ranked_rows(scores, 9, 13), "around user [-2, 2]");
+    check(env.download(board, k_ELeaderboardDataRequestGlobalAroundUser, -20, 0) == ranked_rows(scores, 1, 11), "around user [-20, 0] clamped to the first entry");
+    check(env.download(board, k_ELeaderboardDataRequestGlobalAroundUser, 0, 20) == ranked_rows(scores, 11, 21), "around user [0, 20] clamped to the last entry");
+
+    // the last record of user 1 wins
+    check(env.download(board, k_ELeaderboardDataRequestGlobal, 21, 21) == std::vector<std::pair<int, int32>>{ { 21, 10 } }, "last record of a user wins");
+
+    // our own row with its details
+    LeaderboardScoresDownloaded_t downloaded{};
+    CSteamID users[] = { CSteamID((uint64)(OTHER_STEAMID_BASE + 5)), CSteamID((uint64)LOCAL_STEAMID), CSteamID((uint64)(OTHER_STEAMID_BASE + 500)) };
+    auto call = env.stats->DownloadLeaderboardEntriesForUsers(board, users, 3);
+    check(env.wait_result(call, downloaded) && downloaded.m_cEntryCount == 2, "download for users skips those without an entry");
+
+    LeaderboardEntry_t entry{};
+    int32 details[4]{};
+    check(env.stats->GetDownloadedLeaderboardEntry(downloaded.m_hSteamLeaderboardEntries, 1, &entry, details, 4), "get our downloaded entry");
+    check(entry.m_steamIDUser.ConvertToUint64() == LOCAL_STEAMID && entry.m_nGlobalRank == 11 && entry.m_nScore == 105, "our downloaded entry");
+    check(entry.m_cDetails == 2 && details[0] == 7 && details[1] == 8, "our downloaded details");
+}
+
+static void test_file_rewrite(const std::string &save_folder)
+{
+    constexpr unsigned RECORD_SIZE = 5 * sizeof(uint32_t); // header + 1 detail
+    std::string board_name("appended");
+    std::filesystem::path file_path{};
+
+    {
+        Stats_Env env(save_folder);
+        file_path = std::filesystem::u8path(env.local_storage.get_path(Local_Storage::leaderboard_storage_folder) + PATH_SEPARATOR + Local_Storage::sanitize_string(board_name));
+        auto board = env.find_board(board_name.c_str(), k_ELeaderboardSortMethodDescending);
+        check(board != 0, "find the appended board");
+
+        // each new score is appended, up to 32 records
+        for (int32 score = 1; score <= 32; ++score) {
+            int32 detail = score * 2;
+            env.stats->UploadLeaderboardScore(board, k_ELeaderboardUploadScoreMethodForceUpdate, score, &detail, 1);
+        }
+        check(std::filesystem::file_size(file_path) == 32 * RECORD_SIZE, "scores appended to the file");
+
+        // one more and it's rewritten with only the latest score
+        int32 detail = 66;
+        env.stats->UploadLeaderboardScore(board, k_ELeaderboardUploadScoreMethodForceUpdate, 33, &detail, 1);
+        check(std::filesystem::file_size(file_path) == RECORD_SIZE, "file rewritten past 32 records");
+
+        detail = 68;
+        env.stats->UploadLeaderboardScore(board, k_ELeaderboardUploadScoreMethodForceUpdate, 34, &detail, 1);
+        check(std::filesystem::file_size(file_path) == 2 * RECORD_SIZE, "appending again after the rewrite");
+    }
+
+    {
+        Stats_Env env(save_folder);
+        auto board = env.find_board(board_name.c_str(), k_ELeaderboardSortMethodDescending);
+        check(env.stats->GetLeaderboardEntryCount(board) == 1, "one entry after reloading the appended file");
+
+        LeaderboardScoresDownloaded_t downloaded{};
+        CSteamID me((uint64)LOCAL_STEAMID);
+        auto call = env.stats->DownloadLeaderboardEntriesForUsers(board, &me, 1);
+        LeaderboardEntry_t entry{};
+        int32 detail = 0;
+        check(env.wait_result(call, downloaded) &&
+            env.stats->GetDownloadedLeaderboardEntry(downloaded.m_hSteamLeaderboardEntries, 0, &entry, &detail, 1) &&
+            entry.m_nScore == 34 && detail == 68,
+            "last appended score wins after reloading");
+    }
+}
+
+int main()
+{
+    for (auto sort_method : { k_ELeaderboardSortMethodAscending, k_ELeaderboardSortMethodDescending, k_ELeaderboardSortMethodNone }) {
+        test_entries_against_oracle(sort_method);
+    }
+    test_ties();
+
+    auto folder = create_test_folder("test_leaderboards");
+    std::string save_folder(folder.u8string() + PATH_SEPARATOR);
+
+    test_ranges(save_folder);
+    test_file_rewrite(save_folder);
+
+    std::error_code ec{};
+    std::filesystem::remove_all(folder, ec);
+
+    return report_checks();
+}
@@ -0,0 +1,116 @@
+// k_ESteamNetworkingConfig_SendBufferSize passed as an option when a connection or a listen socket is created:
+// the connection keeps it, the connections accepted by the listen socket inherit it, and sends past it
+// return k_EResultLimitExceeded, the listen socket scope of SetConfigValue()/GetConfigValue() too
+
+#include "dll/steam_networking_sockets.h"
+#include "dll/steam_networking_utils.h"
+
+#include "test_common.h"
+
+constexpr uint64 USER_STEAMID = 76561197960287930ULL;
+constexpr uint64 SERVER_STEAMID = 90071992547409921ULL;
+constexpr auto CONNECT_TIMEOUT = std::chrono::seconds(5);
+
+constexpr int32 CONNECTION_LIMIT = 2000;
+constexpr int32 LISTEN_LIMIT = 1000;
+
+static bool get_send_buffer_size(Steam_Networking_Utils &utils, ESteamNetworkingConfigScope scope, intptr_t scope_obj, int32 &value, ESteamNetworkingGetConfigValueResult expected)
+{
+    size_t size = sizeof(value);
+    ESteamNetworkingConfigDataType type{};
+    return expected == utils.GetConfigValue(k_ESteamNetworkingConfig_SendBufferSize, scope, scope_obj, &type, &value, &size)
+        && k_ESteamNetworkingConfig_Int32 == type;
+}
+
+int main()
+{
+    Settings user_settings(CSteamID((uint64)USER_STEAMID), CGameID(480), "user", "english", false);
+    Settings server_settings(CSteamID((uint64)SERVER_STEAMID), CGameID(480), "server", "english", false);
+    uint16 port = test_random_port();
+    Networking network(CSteamID((uint64)USER_STEAMID), 480, port, nullptr, false, Network_IO_Backend::sweep, false);
+    // the user and the server share the same networking, the messages between them are delivered locally
+    network.addListenId(CSteamID((uint64)SERVER_STEAMID));
+    SteamCallResults callback_results{};
+    SteamCallBacks callbacks(&callback_results);
+    RunEveryRunCB run_every_runcb{};
+
+    auto user = std::make_unique<Steam_Networking_Sockets>(&user_settings, &network, &callback_results, &callbacks, &run_every_runcb, nullptr);
+    auto server = std::make_unique<Steam_Networking_Sockets>(&server_settings, &network, &callback_results, &callbacks, &run_every_runcb, user->get_shared_between_client_server());
+    auto utils = std::make_unique<Steam_Networking_Utils>(&user_settings, &network, &callback_results, &callbacks, &run_every_runcb, user->get_shared_between_client_server());
+    shared_between_client_server *sbcs = user->get_shared_between_client_server();
+
+    const auto run_frame = [&]() {
+        {
+            std::lock_guard<std::recursive_mutex> lock(global_mutex);
+            network.Run();
+            run_every_runcb.run();
+            callback_results.runCallResults();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    };
+
+    std::vector<char> payload(CONNECTION_LIMIT + 500, 'x');
+
+    SteamNetworkingConfigValue_t listen_option{};
+    listen_option.SetInt32(k_ESteamNetworkingConfig_SendBufferSize, LISTEN_LIMIT);
+    HSteamListenSocket listen_socket = server->CreateListenSocketP2P(0, 1, &listen_option);
+    check(k_HSteamListenSocket_Invalid != listen_socket, "create the listen socket");
+
+    int32 value = 0;
+    check(get_send_buffer_size(*utils, k_ESteamNetworkingConfig_ListenSocket, listen_socket, value, k_ESteamNetworkingGetConfigValue_OK) && LISTEN_LIMIT == value,
+        "listen socket limit from the options");
+
+    SteamNetworkingIdentity server_identity{};
+    server_identity.SetSteamID64(SERVER_STEAMID);
+    SteamNetworkingConfigValue_t connection_option{};
+    connection_option.SetInt32(k_ESteamNetworkingConfig_SendBufferSize, CONNECTION_LIMIT);
+    HSteamNetConnection connection = user->ConnectP2P(server_identity, 0, 1, &connection_option);
+    check(k_HSteamNetConnection_Invalid != connection, "connect to the server");
+
+    check(get_send_buffer_size(*utils, k_ESteamNetworkingConfig_Connection, connection, value, k_ESteamNetworkingGetConfigValue_OK) && CONNECTION_LIMIT == value,
+        "connection limit from the options");
+    // the global limit would take it
+    check(k_EResultLimitExceeded == user->SendMessageToConnection(connection, &payload[0], CONNECTION_LIMIT + 1, k_nSteamNetworkingSend_Reliable),
+        "send past the limit of the connection options");
+
+    // the connection request reaches the listen socket
+    auto start = std::chrono::steady_clock::now();
+    HSteamNetConnection accepted = k_HSteamNetConnection_Invalid;
+    while (k_HSteamNetConnection_Invalid == accepted && std::chrono::steady_clock::now() - start < CONNECT_TIMEOUT) {
+        run_frame();
+        std::lock_guard<std::recursive_mutex> lock(global_mutex);
+        for (const auto &conn : sbcs->connect_sockets) {
+            if (conn.second.listen_socket_id == listen_socket) accepted = conn.first;
+        }
+    }
+    check(k_HSteamNetConnection_Invalid != accepted, "the listen socket gets the connection");
+
+    if (k_HSteamNetConnection_Invalid != accepted) {
+        check(k_EResultOK == server->AcceptConnection(accepted), "accept the connection");
+        check(get_send_buffer_size(*utils, k_ESteamNetworkingConfig_Connection, accepted, value, k_ESteamNetworkingGetConfigValue_OK) && LISTEN_LIMIT == value,
+            "accepted connection inherits the listen socket limit");
+        check(k_EResultLimitExceeded == server->SendMessageToConnection(accepted, &payload[0], LISTEN_LIMIT + 1, k_nSteamNetworkingSend_Reliable),
+            "send past the inherited limit");
+        check(k_EResultOK == server->SendMessageToConnection(accepted, &payload[0], LISTEN_LIMIT / 2, k_nSteamNetworkingSend_Reliable),
+            "send under the inherited limit");
+    }
+
+    // listen socket scope
+    int32 new_limit = 3000;
+    check(utils->SetConfigValue(k_ESteamNetworkingConfig_SendBufferSize, k_ESteamNetworkingConfig_ListenSocket, listen_socket, k_ESteamNetworkingConfig_Int32, &new_limit),
+        "set the listen socket limit");
+    check(get_send_buffer_size(*utils, k_ESteamNetworkingConfig_ListenSocket, listen_socket, value, k_ESteamNetworkingGetConfigValue_OK) && new_limit == value,
+        "read back the listen socket limit");
+    check(utils->SetConfigValue(k_ESteamNetworkingConfig_SendBufferSize, k_ESteamNetworkingConfig_ListenSocket, listen_socket, k_ESteamNetworkingConfig_Int32, nullptr),
+        "remove the listen socket limit");
+    check(get_send_buffer_size(*utils, k_ESteamNetworkingConfig_ListenSocket, listen_socket, value, k_ESteamNetworkingGetConfigValue_OKInherited) && sbcs->send_buffer_size == value,
+        "listen socket follows the global limit");
+    check(!utils->SetConfigValue(k_ESteamNetworkingConfig_SendBufferSize, k_ESteamNetworkingConfig_ListenSocket, listen_socket + 1000, k_ESteamNetworkingConfig_Int32, &new_limit),
+        "set the limit of an unknown listen socket");
+
+    utils.reset();
+    server.reset();
+    user.reset();
+
+    return report_checks();
+}
@@ -0,0 +1,120 @@
+// reopens the stats journal (Stats_Store) in a temporary save folder and checks the values read back,
+// including the average of an avgrate stat read as a float, and that a journal which can't be read
+// is moved to a backup instead of being overwritten
+
+#include "dll/stats_store.h"
+
+#include "test_common.h"
+
+static std::string read_all(const std::filesystem::path &path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::in);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+static void write_all(const std::filesystem::path &path, const std::string &content)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::out | std::ios::trunc);
+    file.write(content.data(), content.size());
+}
+
+int main()
+{
+    auto folder = create_test_folder("test_stats_store");
+    std::string save_folder(folder.u8string() + PATH_SEPARATOR);
+    auto journal = folder / Stats_Store::journal_file;
+
+    // same layout UpdateAvgRateStat() saves: avg, count, session length
+    float avg = 2.5f;
+    float count = 10.0f;
+    double session = 4.0;
+    char avgrate[sizeof(float) + sizeof(float) + sizeof(double)];
+    memcpy(avgrate, &avg, sizeof(avg));
+    memcpy(avgrate + sizeof(float), &count, sizeof(count));
+    memcpy(avgrate + sizeof(float) * 2, &session, sizeof(session));
+
+    int32 kills = 42;
+    float distance = 1234.5f;
+
+    {
+        Stats_Store store{};
+        store.open(save_folder);
+        check(store.is_open(), "open a new store");
+        store.set("kills", &kills, sizeof(kills));
+        store.set("distance", &distance, sizeof(distance));
+        store.set("accuracy", avgrate, sizeof(avgrate));
+        check(store.flush(), "flush");
+    }
+
+    {
+        Stats_Store store{};
+        store.open(save_folder);
+
+        int32 kills_read = 0;
+        check(store.get("kills", &kills_read, sizeof(kills_read)) && kills == kills_read, "int stat after reopening");
+
+        float distance_read = 0;
+        check(store.get("distance", &distance_read, sizeof(distance_read)) && distance == distance_read, "float stat after reopening");
+
+        // GetStat(float) only reads the average
+        float avg_read = 0;
+        check(store.get("accuracy", &avg_read, sizeof(avg_read)) && avg == avg_read, "avgrate stat read as a float after reopening");
+
+        char avgrate_read[sizeof(avgrate)]{};
+        check(store.get("accuracy", avgrate_read, sizeof(avgrate_read)) && memcmp(avgrate, avgrate_read, sizeof(avgrate)) == 0, "whole avgrate stat after reopening");
+
+        // the other way around isn't a valid read
+        check(!store.get("kills", avgrate_read, sizeof(avgrate_read)), "read more than the stored value");
+        check(!store.get("missing", &kills_read, sizeof(kills_read)), "read a stat that was never saved");
+    }
+
+    // a journal with a version this build doesn't know, ex: written by a newer build
+    std::string unknown_journal("GBSJ");
+    uint32_t unknown_version = 1000;
+    unknown_journal.append((const char *)&unknown_version, sizeof(unknown_version));
+    unknown_journal.append("records of a newer build");
+    write_all(journal, unknown_journal);
+
+    // legacy stats folder, must not be imported over an existing journal
+    auto legacy_folder = folder / "stats";
+    std::filesystem::create_directories(legacy_folder);
+    write_all(legacy_folder / "legacy", std::string((const char *)&kills, sizeof(kills)));
+
+    {
+        Stats_Store store{};
+        store.open(save_folder);
+        check(store.is_open(), "open after an unreadable journal");
+
+        int32 kills_read = 0;
+        check(!store.get("kills", &kills_read, sizeof(kills_read)), "no stats from the unreadable journal");
+        check(!store.get("legacy", &kills_read, sizeof(kills_read)), "legacy stats not imported over an existing journal");
+
+        store.set("kills", &kills, sizeof(kills));
+        check(store.flush(), "flush after an unreadable journal");
+    }
+
+    check(read_all(folder / (std::string(Stats_Store::journal_file) + ".bak")) == unknown_journal, "unreadable journal kept as a backup");
+
+    {
+        Stats_Store store{};
+        store.open(save_folder);
+
+        int32 kills_read = 0;
+        check(store.get("kills", &kills_read, sizeof(kills_read)) && kills == kills_read, "new journal after the backup");
+    }
+
+    // without any journal the legacy stats folder is imported
+    std::filesystem::remove(journal);
+    {
+        Stats_Store store{};
+        store.open(save_folder);
+
+        int32 legacy_read = 0;
+        check(store.get("legacy", &legacy_read, sizeof(legacy_read)) && kills == legacy_read, "legacy stats imported without a journal");
+    }
+
+    std::error_code ec{};
+    std::filesystem::remove_all(folder, ec);
+
+    return report_checks();
+}
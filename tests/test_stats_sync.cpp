@@ -0,0 +1,261 @@
+// syncs stats between a user (Steam_User_Stats) and game servers through a loopback Networking:
+// a server which supports StatsDelta (Steam_GameServerStats), a server of an older build which
+// only understands AllStats, and a user of an older build talking to the new server
+// every update has to decode back to the same names and values on each side, including the
+// stats which got their ids after a server requested the user's stats
+
+#include "dll/steam_user_stats.h"
+#include "dll/steam_gameserverstats.h"
+
+#include "test_common.h"
+
+constexpr uint64 USER_STEAMID = 76561197960287930ULL;
+constexpr uint64 OLD_USER_STEAMID = 76561197960287931ULL;
+constexpr uint64 SERVER_STEAMID = 90071992547409921ULL;
+constexpr uint64 LATE_SERVER_STEAMID = 90071992547409922ULL;
+constexpr uint64 OLD_SERVER_STEAMID = 90071992547409923ULL;
+constexpr auto SYNC_TIMEOUT = std::chrono::seconds(5);
+
+// what a peer of an older build received
+struct Old_Peer {
+    uint64 steamid{};
+    std::vector<GameServerStats_Messages> received{};
+
+    static void network_callback(void *object, Common_Message *msg)
+    {
+        auto peer = (Old_Peer *)object;
+        if (msg->dest_id() != peer->steamid) return;
+        peer->received.push_back(msg->gameserver_stats_messages());
+    }
+};
+
+struct Sync_Env {
+    Settings user_settings;
+    Settings server_settings;
+    Settings late_server_settings;
+    Networking network;
+    Local_Storage local_storage;
+    SteamCallResults callback_results{};
+    SteamCallBacks callbacks;
+    RunEveryRunCB run_every_runcb{};
+
+    Sync_Env(const std::string &save_folder, uint16 port):
+        user_settings(CSteamID((uint64)USER_STEAMID), CGameID(480), "user", "english", false),
+        server_settings(CSteamID((uint64)SERVER_STEAMID), CGameID(480), "server", "english", false),
+        late_server_settings(CSteamID((uint64)LATE_SERVER_STEAMID), CGameID(480), "late server", "english", false),
+        network(CSteamID((uint64)USER_STEAMID), 480, port, nullptr, false, Network_IO_Backend::sweep, false),
+        local_storage(save_folder),
+        callbacks(&callback_results)
+    {
+        local_storage.setAppId(480);
+        // everyone shares the same networking, the messages between them are delivered locally
+        for (uint64 id : { OLD_USER_STEAMID, SERVER_STEAMID, LATE_SERVER_STEAMID, OLD_SERVER_STEAMID }) {
+            network.addListenId(CSteamID(id));
+        }
+    }
+
+    void run_frame()
+    {
+        std::lock_guard<std::recursive_mutex> lock(global_mutex);
+        network.Run();
+        run_every_runcb.run();
+        callback_results.runCallResults();
+    }
+
+    // runs frames until done() or the timeout
+    template<typename Fn>
+    bool run_until(Fn done)
+    {
+        auto start = std::chrono::steady_clock::now();
+        while (!done()) {
+            if (std::chrono::steady_clock::now() - start > SYNC_TIMEOUT) return false;
+            run_frame();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    void send(uint64 from, uint64 to, GameServerStats_Messages *stats_msg)
+    {
+        Common_Message msg{};
+        msg.set_allocated_gameserver_stats_messages(stats_msg);
+        msg.set_source_id(from);
+        msg.set_dest_id(to);
+        network.sendTo(&msg, true);
+    }
+};
+
+static Stat_config stat_config(GameServerStats_Messages::StatInfo::Stat_Type type)
+{
+    Stat_config cfg{};
+    cfg.type = type;
+    cfg.default_value_int = 0;
+    return cfg;
+}
+
+static bool server_has(Steam_GameServerStats &server, uint64 user, const char *name, int32 expected)
+{
+    int32 value = 0;
+    return server.GetUserStat(CSteamID(user), name, &value) && expected == value;
+}
+
+static bool server_has(Steam_GameServerStats &server, uint64 user, const char *name, float expected)
+{
+    float value = 0;
+    return server.GetUserStat(CSteamID(user), name, &value) && expected == value;
+}
+
+// the stats the old server got in its last update/response, by name
+static std::map<std::string, GameServerStats_Messages::StatInfo> last_old_stats(const Old_Peer &peer, GameServerStats_Messages::Types type)
+{
+    for (auto it = peer.received.rbegin(); it != peer.received.rend(); ++it) {
+        if (it->type() != type) continue;
+
+        const auto &all_stats = GameServerStats_Messages::Response_AllUserStats == type
+            ? it->initial_user_stats().all_data()
+            : it->update_user_stats();
+        return { all_stats.user_stats().begin(), all_stats.user_stats().end() };
+    }
+    return {};
+}
+
+static bool old_stat_is(const std::map<std::string, GameServerStats_Messages::StatInfo> &stats, const std::string &name, int32 expected)
+{
+    auto it = stats.find(name);
+    return stats.end() != it && GameServerStats_Messages::StatInfo::STAT_TYPE_INT == it->second.stat_type() && expected == it->second.value_int();
+}
+
+static bool old_stat_is(const std::map<std::string, GameServerStats_Messages::StatInfo> &stats, const std::string &name, float expected)
+{
+    auto it = stats.find(name);
+    return stats.end() != it && GameServerStats_Messages::StatInfo::STAT_TYPE_FLOAT == it->second.stat_type() && expected == it->second.value_float();
+}
+
+static bool request_stats(Sync_Env &env, Steam_GameServerStats &server, uint64 user)
+{
+    GSStatsReceived_t received{};
+    auto call = server.RequestUserStats(CSteamID(user));
+    return env.run_until([&]() { return env.callback_results.callback_result(call, &received, sizeof(received)); }) &&
+        k_EResultOK == received.m_eResult;
+}
+
+int main()
+{
+    auto folder = create_test_folder("test_stats_sync");
+    std::string save_folder(folder.u8string() + PATH_SEPARATOR);
+
+    Sync_Env env(save_folder, test_random_port());
+    env.user_settings.setStatDefiniton("kills", stat_config(GameServerStats_Messages::StatInfo::STAT_TYPE_INT));
+    env.user_settings.setStatDefiniton("distance", stat_config(GameServerStats_Messages::StatInfo::STAT_TYPE_FLOAT));
+    // stats interned after the servers requested ours
+    env.user_settings.allow_unknown_stats = true;
+
+    auto user = std::make_unique<Steam_User_Stats>(&env.user_settings, &env.network, &env.local_storage, &env.callback_results, &env.callbacks, &env.run_every_runcb, nullptr);
+    auto server = std::make_unique<Steam_GameServerStats>(&env.server_settings, &env.network, &env.callback_results, &env.callbacks, &env.run_every_runcb);
+    Old_Peer old_server{ OLD_SERVER_STEAMID };
+    Old_Peer old_user{ OLD_USER_STEAMID };
+    env.network.setCallback(CALLBACK_ID_GAMESERVER_STATS, CSteamID((uint64)OLD_SERVER_STEAMID), &Old_Peer::network_callback, &old_server);
+    env.network.setCallback(CALLBACK_ID_GAMESERVER_STATS, CSteamID((uint64)OLD_USER_STEAMID), &Old_Peer::network_callback, &old_user);
+
+    user->SetStat("kills", 1);
+    env.run_frame();
+
+    // initial requests, the new server asks for StatsDelta and the old one doesn't know about it
+    check(request_stats(env, *server, USER_STEAMID), "new server requests the user's stats");
+    check(server_has(*server, USER_STEAMID, "kills", 1) && server_has(*server, USER_STEAMID, "distance", 0.0f), "new server initial stats");
+
+    auto old_request = new GameServerStats_Messages::InitialAllStats();
+    old_request->set_steam_api_call(1);
+    auto old_request_msg = new GameServerStats_Messages();
+    old_request_msg->set_type(GameServerStats_Messages::Request_AllUserStats);
+    old_request_msg->set_allocated_initial_user_stats(old_request);
+    env.send(OLD_SERVER_STEAMID, USER_STEAMID, old_request_msg);
+    check(env.run_until([&]() { return old_server.received.size() >= 1; }), "old server gets the initial response");
+    if (old_server.received.size()) {
+        const auto &response = old_server.received.back().initial_user_stats();
+        check(response.has_all_data() && !response.has_all_data_delta(), "old server gets AllStats");
+        auto stats = last_old_stats(old_server, GameServerStats_Messages::Response_AllUserStats);
+        check(old_stat_is(stats, "kills", 1) && old_stat_is(stats, "distance", 0.0f), "old server initial stats");
+    }
+
+    // later updates go to both, each in its own format, with a stat the servers never heard of
+    user->SetStat("kills", 5);
+    user->SetStat("distance", 2.5f);
+    user->SetStat("late_stat", 7);
+    check(env.run_until([&]() { return server_has(*server, USER_STEAMID, "late_stat", 7); }), "new server learns the name of a stat interned after its request");
+    check(server_has(*server, USER_STEAMID, "kills", 5) && server_has(*server, USER_STEAMID, "distance", 2.5f), "new server updated stats");
+    check(env.run_until([&]() { return old_stat_is(last_old_stats(old_server, GameServerStats_Messages::UpdateUserStatsFromUser), "late_stat", 7); }), "old server update with a new stat");
+    {
+        auto stats = last_old_stats(old_server, GameServerStats_Messages::UpdateUserStatsFromUser);
+        check(old_stat_is(stats, "kills", 5) && old_stat_is(stats, "distance", 2.5f), "old server updated stats");
+    }
+
+    // a server which requests the stats after all of that gets the whole id table, and the names
+    // interned after its request in its updates, without breaking the first server
+    auto late_server = std::make_unique<Steam_GameServerStats>(&env.late_server_settings, &env.network, &env.callback_results, &env.callbacks, &env.run_every_runcb);
+    check(request_stats(env, *late_server, USER_STEAMID), "late server requests the user's stats");
+    check(server_has(*late_server, USER_STEAMID, "late_stat", 7) && server_has(*late_server, USER_STEAMID, "kills", 5), "late server initial stats");
+
+    user->SetStat("later_stat", 9.5f);
+    user->SetStat("kills", 6);
+    check(env.run_until([&]() { return server_has(*late_server, USER_STEAMID, "later_stat", 9.5f) && server_has(*server, USER_STEAMID, "later_stat", 9.5f); }), "both new servers learn the name of a stat interned after their requests");
+    check(server_has(*late_server, USER_STEAMID, "kills", 6) && server_has(*server, USER_STEAMID, "kills", 6), "both new servers updated stats");
+    check(env.run_until([&]() { return old_stat_is(last_old_stats(old_server, GameServerStats_Messages::UpdateUserStatsFromUser), "later_stat", 9.5f); }), "old server update with another new stat");
+
+    // a server update reaches the user, and from there the other servers
+    check(server->SetUserStat(CSteamID((uint64)USER_STEAMID), "late_stat", 70), "new server sets a user stat");
+    check(env.run_until([&]() { int32 value = 0; return user->GetStat("late_stat", &value) && 70 == value; }), "user gets the server's update");
+
+    // a user of an older build answers the new server with AllStats
+    GSStatsReceived_t received{};
+    auto call = server->RequestUserStats(CSteamID((uint64)OLD_USER_STEAMID));
+    check(env.run_until([&]() { return old_user.received.size() >= 1; }), "old user gets the request");
+    if (old_user.received.size()) {
+        const auto &request = old_user.received.back().initial_user_stats();
+        check(request.supports_delta(), "new server asks for StatsDelta");
+
+        GameServerStats_Messages::StatInfo kills{};
+        kills.set_stat_type(GameServerStats_Messages::StatInfo::STAT_TYPE_INT);
+        kills.set_value_int(3);
+        auto all_stats = new GameServerStats_Messages::AllStats();
+        (*all_stats->mutable_user_stats())["kills"] = kills;
+        auto response = new GameServerStats_Messages::InitialAllStats();
+        response->set_steam_api_call(request.steam_api_call());
+        response->set_allocated_all_data(all_stats);
+        auto response_msg = new GameServerStats_Messages();
+        response_msg->set_type(GameServerStats_Messages::Response_AllUserStats);
+        response_msg->set_allocated_initial_user_stats(response);
+        env.send(OLD_USER_STEAMID, SERVER_STEAMID, response_msg);
+    }
+    check(env.run_until([&]() { return env.callback_results.callback_result(call, &received, sizeof(received)); }) && k_EResultOK == received.m_eResult, "new server gets the old user's stats");
+    check(server_has(*server, OLD_USER_STEAMID, "kills", 3), "new server reads the old user's stats by name");
+
+    GameServerStats_Messages::StatInfo kills{};
+    kills.set_stat_type(GameServerStats_Messages::StatInfo::STAT_TYPE_INT);
+    kills.set_value_int(4);
+    auto update = new GameServerStats_Messages::AllStats();
+    (*update->mutable_user_stats())["kills"] = kills;
+    auto update_msg = new GameServerStats_Messages();
+    update_msg->set_type(GameServerStats_Messages::UpdateUserStatsFromUser);
+    update_msg->set_allocated_update_user_stats(update);
+    env.send(OLD_USER_STEAMID, SERVER_STEAMID, update_msg);
+    check(env.run_until([&]() { return server_has(*server, OLD_USER_STEAMID, "kills", 4); }), "new server applies the old user's update");
+
+    size_t old_user_received = old_user.received.size();
+    check(server->SetUserStat(CSteamID((uint64)OLD_USER_STEAMID), "kills", 8), "new server sets a stat of the old user");
+    check(env.run_until([&]() { return old_user.received.size() > old_user_received; }), "old user gets the server's update");
+    if (old_user.received.size() > old_user_received) {
+        const auto &msg = old_user.received.back();
+        auto it = msg.update_user_stats().user_stats().find("kills");
+        check(GameServerStats_Messages::UpdateUserStatsFromServer == msg.type() && msg.update_user_stats().user_stats().end() != it && 8 == it->second.value_int(),
+            "old user gets AllStats keyed by name");
+    }
+
+    late_server.reset();
+    server.reset();
+    user.reset();
+    std::error_code ec{};
+    std::filesystem::remove_all(folder, ec);
+
+    return report_checks();
+}
@@ -0,0 +1,456 @@
+// sends online requests through Steam_HTTP with 'steamhttp_base_url_override' pointing at a local
+// stand-in server, then checks the response bodies, the cached files written for them, streamed
+// responses, and the order the shared HTTP thread starts queued requests in (prioritize/defer/cancel)
+
+#include "dll/steam_http.h"
+
+#include "test_common.h"
+
+#if defined(STEAM_WIN32)
+    typedef SOCKET sock_t;
+    #define close_sock closesocket
+#else
+    typedef int sock_t;
+    #define INVALID_SOCKET -1
+    #define close_sock close
+#endif
+
+// more than HTTP_MAX_ACTIVE_TRANSFERS, so some of them have to wait in the queue
+constexpr unsigned REQUESTS_COUNT = 20;
+// HTTP_MAX_ACTIVE_TRANSFERS, enough to fill every slot
+constexpr unsigned BLOCKERS_COUNT = 8;
+constexpr unsigned STREAM_BODY_SIZE = 256 * 1024;
+constexpr unsigned STREAM_CHUNK_SIZE = 16 * 1024;
+constexpr auto TEST_TIMEOUT = std::chrono::seconds(30);
+
+constexpr const char FAKE_HOST[] = "api.example.invalid";
+
+static std::atomic<bool> server_stop = false;
+
+// "in:<path>" when a request arrives and "out:<path>" when its response is sent, in order
+static std::mutex server_events_mutex{};
+static std::vector<std::string> server_events{};
+
+static void add_server_event(const std::string &event)
+{
+    std::lock_guard<std::mutex> lock(server_events_mutex);
+    server_events.push_back(event);
+}
+
+// position of the event, or -1
+static long find_server_event(const std::string &event)
+{
+    std::lock_guard<std::mutex> lock(server_events_mutex);
+    auto it = std::find(server_events.begin(), server_events.end(), event);
+    if (server_events.end() == it) return -1;
+    return static_cast<long>(it - server_events.begin());
+}
+
+static std::string stand_in_body(const std::string &path)
+{
+    return "stand-in:" + path;
+}
+
+static std::string stream_body()
+{
+    std::string body(STREAM_BODY_SIZE, '\0');
+    for (size_t i = 0; i < body.size(); ++i) {
+        body[i] = static_cast<char>('a' + i % 26);
+    }
+    return body;
+}
+
+// value of 'name' in the query of 'path', 0 if it's missing
+static unsigned query_value(const std::string &path, const std::string &name)
+{
+    auto query = path.find('?');
+    if (std::string::npos == query) return 0;
+
+    auto pos = path.find(name + "=", query);
+    if (std::string::npos == pos) return 0;
+    return static_cast<unsigned>(std::strtoul(path.c_str() + pos + name.size() + 1, nullptr, 10));
+}
+
+static bool send_all(sock_t client, const char *data, size_t size)
+{
+    while (size) {
+        // the client closes the connection of a cancelled transfer, that must not raise SIGPIPE
+        int len = send(client, data, static_cast<int>(size), MSG_NOSIGNAL);
+        if (len <= 0) return false;
+
+        data += len;
+        size -= len;
+    }
+
+    return true;
+}
+
+// answers every "GET <path>" on the connection, the connection is kept alive
+// "delay=<ms>" in the query waits before answering, paths under "/stream/" get stream_body() in small pieces
+static void stand_in_connection(sock_t client)
+{
+    std::string received{};
+    char buf[4096];
+    while (!server_stop) {
+        auto headers_end = received.find("\r\n\r\n");
+        if (std::string::npos == headers_end) {
+            int len = recv(client, buf, sizeof(buf), 0);
+            if (len <= 0) break;
+
+            received.append(buf, len);
+            continue;
+        }
+
+        std::string request_line(received.substr(0, received.find("\r\n")));
+        received.erase(0, headers_end + 4);
+
+        auto path_start = request_line.find(' ');
+        auto path_end = request_line.find(' ', path_start + 1);
+        std::string path(request_line.substr(path_start + 1, path_end - path_start - 1));
+        add_server_event("in:" + path);
+
+        unsigned delay_ms = query_value(path, "delay");
+        if (delay_ms) std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+
+        bool streamed = path.find("/stream/") != std::string::npos;
+        std::string body(streamed ? stream_body() : stand_in_body(path));
+        std::string headers =
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: " + std::to_string(body.size()) + "\r\n"
+            "\r\n";
+        if (!send_all(client, headers.c_str(), headers.size())) break;
+
+        bool sent = true;
+        size_t chunk_size = streamed ? STREAM_CHUNK_SIZE : body.size();
+        for (size_t offset = 0; sent && offset < body.size(); offset += chunk_size) {
+            // give the client time to see each piece on its own
+            if (streamed && offset) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            sent = send_all(client, body.c_str() + offset, std::min(chunk_size, body.size() - offset));
+        }
+        if (!sent) break;
+
+        add_server_event("out:" + path);
+    }
+
+    close_sock(client);
+}
+
+static void stand_in_server(sock_t listener)
+{
+    std::vector<std::thread> connections{};
+    while (!server_stop) {
+        sock_t client = accept(listener, nullptr, nullptr);
+        if (INVALID_SOCKET == client) break;
+
+        connections.emplace_back(stand_in_connection, client);
+    }
+
+    for (auto &t : connections) {
+        t.join();
+    }
+}
+
+static sock_t listen_loopback(unsigned short &port)
+{
+    sock_t listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (INVALID_SOCKET == listener) return INVALID_SOCKET;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t addr_len = sizeof(addr);
+    if (bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listener, 64) != 0 ||
+        getsockname(listener, (sockaddr *)&addr, &addr_len) != 0) {
+        close_sock(listener);
+        return INVALID_SOCKET;
+    }
+
+    port = ntohs(addr.sin_port);
+    return listener;
+}
+
+// where Steam_HTTP caches the response of 'url_path' (the url without the scheme)
+static std::string cached_file_path(const std::string &url_path)
+{
+    return Local_Storage::get_game_settings_path() + "http" + PATH_SEPARATOR + Local_Storage::sanitize_string(url_path);
+}
+
+static std::string read_cached_file(const std::string &url_path)
+{
+    std::string file_path(cached_file_path(url_path));
+    unsigned int file_size = file_size_(file_path);
+    std::string data(file_size, '\0');
+    if (file_size) {
+        int read = Local_Storage::get_file_data(file_path, &data[0], file_size, 0);
+        data.resize(read > 0 ? read : 0);
+    }
+    return data;
+}
+
+// what the streaming callbacks of a request reported
+struct Stream_State {
+    HTTPRequestHandle handle{};
+    bool headers_received{};
+    bool data_before_headers{};
+    std::vector<HTTPRequestDataReceived_t> chunks{};
+};
+
+// one per callback type, they all report to the same state
+class Stream_Listener : public CCallbackBase {
+public:
+    Stream_State *state{};
+
+    void Run(void *pvParam) override
+    {
+        if (GetICallback() == HTTPRequestHeadersReceived_t::k_iCallback) {
+            auto data = (HTTPRequestHeadersReceived_t *)pvParam;
+            if (data->m_hRequest == state->handle) state->headers_received = true;
+        } else if (GetICallback() == HTTPRequestDataReceived_t::k_iCallback) {
+            auto data = (HTTPRequestDataReceived_t *)pvParam;
+            if (data->m_hRequest != state->handle) return;
+            if (!state->headers_received) state->data_before_headers = true;
+            state->chunks.push_back(*data);
+        }
+    }
+
+    void Run(void *pvParam, bool bIOFailure, SteamAPICall_t hSteamAPICall) override
+    {
+        Run(pvParam);
+    }
+
+    int GetCallbackSizeBytes() override
+    {
+        if (GetICallback() == HTTPRequestHeadersReceived_t::k_iCallback) return sizeof(HTTPRequestHeadersReceived_t);
+        return sizeof(HTTPRequestDataReceived_t);
+    }
+};
+
+int main()
+{
+#if defined(STEAM_WIN32)
+    WSADATA wsa_data{};
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    unsigned short port = 0;
+    sock_t listener = listen_loopback(port);
+    check(INVALID_SOCKET != listener, "listen on loopback");
+    if (INVALID_SOCKET == listener) return report_checks();
+    std::thread server(stand_in_server, listener);
+
+    Settings settings(CSteamID((uint64)76561197960287930ULL), CGameID(480), "test", "english", false);
+    settings.download_steamhttp_requests = true;
+    settings.steamhttp_base_url_override = "http://127.0.0.1:" + std::to_string(port);
+
+    SteamCallResults callback_results{};
+    SteamCallBacks callbacks(&callback_results);
+    RunEveryRunCB run_every_runcb{};
+    // the steam http instance must be gone before the server stops, it joins its thread
+    auto http = std::make_unique<Steam_HTTP>(&settings, nullptr, &callback_results, &callbacks, &run_every_runcb);
+
+    // unique per run so nothing is served from the files cached by a previous run
+    std::string run_path("/test_steam_http/" + test_run_id());
+
+    auto start = std::chrono::steady_clock::now();
+    const auto timed_out = [&start]() {
+        return std::chrono::steady_clock::now() - start > TEST_TIMEOUT;
+    };
+
+    const auto run_frame = [&]() {
+        {
+            std::lock_guard<std::recursive_mutex> lock(global_mutex);
+            run_every_runcb.run();
+            callback_results.runCallResults();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    };
+
+    struct Sent {
+        HTTPRequestHandle handle{};
+        SteamAPICall_t call{};
+        std::string path{};
+        bool done{};
+        HTTPRequestCompleted_t completed{};
+    };
+
+    const auto send_request = [&](const std::string &path, bool streaming) {
+        Sent s{};
+        s.path = path;
+        s.handle = http->CreateHTTPRequest(k_EHTTPMethodGET, ("https://" + std::string(FAKE_HOST) + s.path).c_str());
+        bool ok = s.handle && (streaming
+            ? http->SendHTTPRequestAndStreamResponse(s.handle, &s.call)
+            : http->SendHTTPRequest(s.handle, &s.call));
+        if (!ok) s.call = k_uAPICallInvalid;
+        check(k_uAPICallInvalid != s.call, "send request '" + path + "'");
+        return s;
+    };
+
+    // runs frames until every request in 'sent' completed, false if it timed out
+    const auto wait_completed = [&](std::vector<Sent *> sent) {
+        unsigned done_count = 0;
+        for (auto s : sent) {
+            if (s->done || k_uAPICallInvalid == s->call) ++done_count;
+        }
+
+        while (done_count < sent.size()) {
+            if (timed_out()) return false;
+
+            run_frame();
+            for (auto s : sent) {
+                if (s->done || !callback_results.callback_result(s->call, &s->completed, sizeof(s->completed))) continue;
+
+                s->done = true;
+                ++done_count;
+            }
+        }
+
+        return true;
+    };
+
+    const auto response_body = [&](const Sent &s) {
+        uint32 body_size = 0;
+        std::string body{};
+        if (s.completed.m_bRequestSuccessful && http->GetHTTPResponseBodySize(s.handle, &body_size)) {
+            body.resize(body_size);
+            if (body_size) http->GetHTTPResponseBodyData(s.handle, (uint8 *)&body[0], body_size);
+        }
+        return body;
+    };
+
+    // plain requests, more than the thread runs at once
+    {
+        std::vector<Sent> sent{};
+        for (unsigned i = 0; i < REQUESTS_COUNT; ++i) {
+            sent.push_back(send_request(run_path + "/item_" + std::to_string(i) + "?page=" + std::to_string(i), false));
+        }
+
+        std::vector<Sent *> waiting{};
+        for (auto &s : sent) waiting.push_back(&s);
+        check(wait_completed(waiting), "the plain requests complete");
+
+        for (auto &s : sent) {
+            if (!s.done) continue;
+
+            std::string expected(stand_in_body(s.path));
+            std::string body(response_body(s));
+            check(body == expected, "response for '" + s.path + "', got '" + body + "'");
+
+            // the responses are cached like any other online request
+            std::string cached(read_cached_file(FAKE_HOST + s.path));
+            check(cached == expected, "cached file for '" + s.path + "', got '" + cached + "'");
+            http->ReleaseHTTPRequest(s.handle);
+        }
+    }
+
+    // streamed response, the data must arrive in order and in more than one piece before the completion
+    if (!failures) {
+        Stream_State stream{};
+        Stream_Listener headers_listener{}, data_listener{};
+        headers_listener.state = data_listener.state = &stream;
+        callbacks.addCallBack(HTTPRequestHeadersReceived_t::k_iCallback, &headers_listener);
+        callbacks.addCallBack(HTTPRequestDataReceived_t::k_iCallback, &data_listener);
+
+        Sent s = send_request(run_path + "/stream/body", true);
+        stream.handle = s.handle;
+        check(wait_completed({ &s }), "the streamed request completes");
+
+        std::string expected(stream_body());
+        std::string received{};
+        for (const auto &chunk : stream.chunks) {
+            bool in_order = chunk.m_cOffset == received.size();
+            check(in_order, "streamed data at offset " + std::to_string(chunk.m_cOffset) + ", expected " + std::to_string(received.size()));
+            if (!in_order) break;
+
+            std::string piece(chunk.m_cBytesReceived, '\0');
+            bool got = http->GetHTTPStreamingResponseBodyData(s.handle, chunk.m_cOffset, (uint8 *)&piece[0], chunk.m_cBytesReceived);
+            check(got, "get the streamed data at offset " + std::to_string(chunk.m_cOffset));
+            if (!got) break;
+            received += piece;
+        }
+
+        check(stream.headers_received && !stream.data_before_headers, "the headers callback is posted before the data");
+        check(stream.chunks.size() >= 2, "the streamed data arrives in more than one piece, got " + std::to_string(stream.chunks.size()));
+        check(received == expected && s.completed.m_unBodySize == expected.size(),
+            "streamed response, got " + std::to_string(received.size()) + " bytes, completed with " + std::to_string(s.completed.m_unBodySize));
+        check(read_cached_file(FAKE_HOST + s.path) == expected, "cached file for the streamed response");
+
+        http->ReleaseHTTPRequest(s.handle);
+        callbacks.rmCallBack(HTTPRequestHeadersReceived_t::k_iCallback, &headers_listener);
+        callbacks.rmCallBack(HTTPRequestDataReceived_t::k_iCallback, &data_listener);
+    }
+
+    // queue order, every slot is taken by a blocker so the queued requests wait, one blocker answers
+    // quickly and another one is cancelled, each one frees a slot for the next queued request
+    if (!failures) {
+        std::vector<Sent> blockers{};
+        for (unsigned i = 0; i < BLOCKERS_COUNT; ++i) {
+            unsigned delay_ms = i == 0 ? 400 : 2000;
+            blockers.push_back(send_request(run_path + "/blocker_" + std::to_string(i) + "?delay=" + std::to_string(delay_ms), false));
+        }
+
+        // all the blockers must be running before anything else is queued
+        bool blocking = false;
+        while (!blocking && !timed_out()) {
+            run_frame();
+            blocking = true;
+            for (auto &b : blockers) {
+                if (find_server_event("in:" + b.path) < 0) blocking = false;
+            }
+        }
+        check(blocking, "the blockers start");
+
+        Sent deferred = send_request(run_path + "/deferred?delay=600", false);
+        Sent normal = send_request(run_path + "/normal?delay=600", false);
+        Sent prioritized = send_request(run_path + "/prioritized?delay=600", false);
+        Sent cancelled = send_request(run_path + "/cancelled?delay=600", false);
+        check(http->PrioritizeHTTPRequest(prioritized.handle) && http->DeferHTTPRequest(deferred.handle), "prioritize/defer");
+        http->ReleaseHTTPRequest(cancelled.handle);
+        // an active transfer, its slot goes to the prioritized request
+        http->ReleaseHTTPRequest(blockers.back().handle);
+
+        std::vector<Sent *> waiting{ &deferred, &normal, &prioritized };
+        for (size_t i = 0; i + 1 < blockers.size(); ++i) waiting.push_back(&blockers[i]);
+        check(wait_completed(waiting), "the queued requests complete");
+
+        long prioritized_in = find_server_event("in:" + prioritized.path);
+        long normal_in = find_server_event("in:" + normal.path);
+        long deferred_in = find_server_event("in:" + deferred.path);
+        check(prioritized_in >= 0 && normal_in >= prioritized_in && deferred_in >= normal_in,
+            "queued requests start in order, got " + std::to_string(prioritized_in) + " " + std::to_string(normal_in) + " " + std::to_string(deferred_in));
+        check(prioritized_in < find_server_event("out:" + blockers.front().path), "the cancelled transfer frees its slot");
+        check(normal_in > find_server_event("out:" + blockers.front().path), "no more transfers than HTTP_MAX_ACTIVE_TRANSFERS running");
+        check(find_server_event("in:" + cancelled.path) < 0, "the cancelled request isn't sent");
+
+        HTTPRequestCompleted_t completed{};
+        check(!callback_results.callback_result(blockers.back().call, &completed, sizeof(completed)), "the cancelled transfer doesn't complete");
+
+        for (auto s : waiting) http->ReleaseHTTPRequest(s->handle);
+    }
+
+    http.reset();
+
+    server_stop = true;
+    // unblock accept()
+    sock_t wakeup = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    connect(wakeup, (sockaddr *)&addr, sizeof(addr));
+    close_sock(wakeup);
+    server.join();
+    close_sock(listener);
+
+    // only the files of this run, then the folders above them if nothing else is in there
+    std::error_code ec{};
+    auto http_dir = std::filesystem::u8path(Local_Storage::get_game_settings_path() + "http");
+    auto run_dir = std::filesystem::u8path(cached_file_path(FAKE_HOST + run_path));
+    std::filesystem::remove_all(run_dir, ec);
+    for (auto dir = run_dir.parent_path(); dir != http_dir && std::filesystem::remove(dir, ec); dir = dir.parent_path()) { }
+
+    return report_checks();
+}
@@ -0,0 +1,84 @@
+// reads mod content through Steam_Remote_Storage::UGCDownload() + UGCRead() while the file changes:
+// the content is mapped for the read sequence, a write must show up in the next reads and a truncated
+// file must not be read through the old mapping (SIGBUS on POSIX)
+
+#include "dll/steam_remote_storage.h"
+
+#include "test_common.h"
+
+constexpr PublishedFileId_t MOD_ID = 123456;
+constexpr UGCHandle_t MOD_HANDLE = 654321;
+// big enough to be mapped
+constexpr uint64 FILE_SIZE = UGC_READ_MAP_MIN_SIZE * 2;
+constexpr uint64 TRUNCATED_SIZE = UGC_READ_MAP_MIN_SIZE / 4;
+constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+static std::vector<char> pattern(char seed, size_t size)
+{
+    std::vector<char> data(size);
+    for (size_t i = 0; i < size; ++i) data[i] = static_cast<char>(seed + i % 251);
+    return data;
+}
+
+int main()
+{
+    auto dir = create_test_folder("test_ugc_read");
+    const std::string dir_str(dir.u8string());
+    const std::string file_name("content.bin");
+    const std::string file_path(common_helpers::to_absolute(file_name, dir_str));
+
+    {
+        std::ofstream file(std::filesystem::u8path(file_path), std::ios::binary | std::ios::trunc);
+        auto data = pattern('a', FILE_SIZE);
+        file.write(data.data(), data.size());
+    }
+
+    Settings settings(CSteamID((uint64)76561197960287930ULL), CGameID(480), "test", "english", false);
+    Mod_entry details{};
+    details.primaryFileName = file_name;
+    details.primaryFileSize = static_cast<int32>(FILE_SIZE);
+    settings.addMod(MOD_ID, "test", dir_str);
+    settings.addModDetails(MOD_ID, details);
+
+    Ugc_Remote_Storage_Bridge ugc_bridge(&settings);
+    ugc_bridge.add_ugc_query_result(MOD_HANDLE, MOD_ID, true);
+
+    Local_Storage local_storage(dir_str + PATH_SEPARATOR);
+    SteamCallResults callback_results{};
+    SteamCallBacks callbacks(&callback_results);
+    RunEveryRunCB run_every_runcb{};
+    auto remote_storage = std::make_unique<Steam_Remote_Storage>(&settings, &ugc_bridge, &local_storage, &callback_results, &callbacks, &run_every_runcb);
+
+    std::vector<char> chunk(CHUNK_SIZE);
+    const auto read_at = [&](uint64 offset) {
+        return remote_storage->UGCRead(MOD_HANDLE, chunk.data(), static_cast<int32>(CHUNK_SIZE), static_cast<uint32>(offset), k_EUGCRead_ContinueReading);
+    };
+
+    remote_storage->UGCDownload(MOD_HANDLE, 0);
+    auto original = pattern('a', FILE_SIZE);
+    check(read_at(0) == static_cast<int32>(CHUNK_SIZE) && memcmp(chunk.data(), original.data(), CHUNK_SIZE) == 0, "first chunk");
+
+    // written while the read sequence is going on
+    auto written = pattern('k', CHUNK_SIZE);
+    {
+        std::fstream file(std::filesystem::u8path(file_path), std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(UGC_READ_MAP_MIN_SIZE);
+        file.write(written.data(), written.size());
+        check(!!file, "write to the mapped file");
+    }
+    check(read_at(UGC_READ_MAP_MIN_SIZE) == static_cast<int32>(CHUNK_SIZE) && memcmp(chunk.data(), written.data(), CHUNK_SIZE) == 0, "chunk written during the read sequence");
+
+    // Windows doesn't let a mapped file be truncated, there's nothing to read past the end there
+    std::error_code ec{};
+    std::filesystem::resize_file(std::filesystem::u8path(file_path), TRUNCATED_SIZE, ec);
+    if (!ec) {
+        check(read_at(FILE_SIZE - CHUNK_SIZE) <= 0, "read past the end of the truncated file");
+        check(read_at(0) == static_cast<int32>(CHUNK_SIZE) && memcmp(chunk.data(), original.data(), CHUNK_SIZE) == 0, "first chunk of the truncated file");
+    }
+
+    remote_storage->UGCRead(MOD_HANDLE, chunk.data(), 0, 0, k_EUGCRead_Close);
+    remote_storage.reset();
+    std::filesystem::remove_all(dir, ec);
+
+    return report_checks();
+}